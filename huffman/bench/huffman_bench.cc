@@ -0,0 +1,526 @@
+/**
+ * @file huffman_bench.cc
+ *
+ * Throughput benchmarks for each phase of {@link huffman.c} across word sizes
+ * and input distributions. Run through benchmark.sh, which writes results as
+ * JSON for comparison between releases.
+ *
+ * Set HUFFMAN_BENCH_TEXT to the path of a text file to benchmark real text;
+ * otherwise text is generated from a fixed vocabulary.
+ */
+
+// Includes
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "../src/inc/huffman.h"
+#include "../src/huffman.c"
+#include "../src/basemap.c"
+#include "benchmark/benchmark.h"
+
+/**
+ * Size of benchmark input in bytes (4 MB).
+ */
+#define HUFFMAN_BENCH_VOLUME (uint64_t) (1048576 * 4)
+
+/**
+ * Number of distinct words drawn from by the uniform and Zipfian
+ * distributions, where word size allows.
+ */
+#define HUFFMAN_BENCH_ALPHABET (uint64_t) 4096
+
+/**
+ * Input distributions.
+ */
+enum BenchDistribution {
+	/**Words drawn uniformly from a fixed alphabet.*/
+	DIST_UNIFORM,
+	/**Words drawn from a fixed alphabet with Zipfian (s = 1) frequencies.*/
+	DIST_ZIPF,
+	/**A single word repeated.*/
+	DIST_CONSTANT,
+	/**Natural language text, independent of word size.*/
+	DIST_TEXT,
+	/**Random bytes, independent of word size.*/
+	DIST_RANDOM,
+	/**Runs of 1 to 256 of a word drawn uniformly from a fixed alphabet.*/
+	DIST_RUNS,
+	NUM_DISTRIBUTIONS
+};
+
+/**
+ * Names of input distributions, used in benchmark labels.
+ */
+static const char* const distNames[NUM_DISTRIBUTIONS] = {
+	"uniform", "zipf", "constant", "text", "random", "runs"
+};
+
+/**
+ * Word sizes swept by every benchmark.
+ */
+static const uint8_t benchWordSizes[] = {2, 3, 4, 6, 8, 12, 13, 16, 24, 31, 32, 48, 60};
+
+/**
+ * Vocabulary used to generate text when no text file is provided.
+ */
+static const char* const benchVocabulary[] = {
+	"the", "of", "and", "to", "a", "in", "is", "that", "for", "it", "as", "was",
+	"with", "be", "by", "on", "not", "he", "this", "are", "or", "his", "from",
+	"at", "which", "but", "have", "an", "had", "they", "you", "were", "their",
+	"one", "all", "we", "can", "her", "has", "there", "been", "if", "more",
+	"when", "will", "would", "who", "so", "no", "compression", "table",
+	"frequency", "word", "stream", "block", "value", "header", "mapping"
+};
+
+/**
+ * Deterministic xorshift generator, so inputs are identical between runs.
+ *
+ * @param[in,out] state Generator state, must be non-zero.
+ *
+ * @return Next pseudo-random value.
+ */
+static uint64_t bench_rand(uint64_t* state) {
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+/**
+ * Generates text by reading HUFFMAN_BENCH_TEXT, repeated to fill dst, or from
+ * {@link benchVocabulary} with Zipfian word frequencies.
+ *
+ * @param[out]    dst   Destination for text.
+ * @param[in,out] state Generator state.
+ */
+static void generate_text(std::vector<uint8_t>& dst,
+						  uint64_t* state) {
+	const char* path = getenv("HUFFMAN_BENCH_TEXT");
+	const uint64_t vocabSize = sizeof(benchVocabulary) / sizeof(benchVocabulary[0]);
+	uint64_t pos = 0, len, i;
+
+	if (path != NULL) {
+		FILE* file = fopen(path, "rb");
+		if (file != NULL) {
+			len = fread(dst.data(), 1, dst.size(), file);
+			fclose(file);
+			for (i = len; len > 0 && i < dst.size(); i++) {
+				dst[i] = dst[i % len];
+			}
+			if (len > 0) {
+				return;
+			}
+		}
+	}
+	while (pos < dst.size()) {
+		// Zipfian choice of word by rejection on 1 / (rank + 1)
+		uint64_t rank;
+		do {
+			rank = bench_rand(state) % vocabSize;
+		} while (bench_rand(state) % (rank + 1) != 0);
+		const char* word = benchVocabulary[rank];
+		for (i = 0; word[i] != '\0' && pos < dst.size(); i++) {
+			dst[pos++] = (uint8_t) word[i];
+		}
+		if (pos < dst.size()) {
+			dst[pos++] = (bench_rand(state) % 12 == 0) ? '.' : ' ';
+		}
+	}
+}
+
+/**
+ * Generates benchmark input of {@link HUFFMAN_BENCH_VOLUME} bytes.
+ *
+ * @param[in] dist     Input distribution.
+ * @param[in] wordSize Word size used for compression.
+ *
+ * @return Generated input.
+ */
+static std::vector<uint8_t> generate_input(BenchDistribution dist,
+										   uint8_t wordSize) {
+	std::vector<uint8_t> data(HUFFMAN_BENCH_VOLUME);
+	std::vector<uint64_t> alphabet;
+	std::vector<double> cdf;
+	uint64_t state = 0x9E3779B97F4A7C15ull ^ ((uint64_t) dist << 8) ^ wordSize;
+	uint64_t mask = (((uint64_t) 1) << wordSize) - 1;
+	uint64_t alphabetSize, numWords, word = 0, i;
+	uint64_t runLeft = 0;
+	uint8_t* currPtr = data.data();
+	uint8_t currBit = 0;
+	uint64_t remaining = data.size();
+	uint8_t finalBits;
+
+	if (dist == DIST_TEXT) {
+		generate_text(data, &state);
+		return data;
+	}
+	if (dist == DIST_RANDOM) {
+		for (i = 0; i < data.size(); i++) {
+			data[i] = (uint8_t) bench_rand(&state);
+		}
+		return data;
+	}
+
+	// Alphabet of distinct words
+	alphabetSize = (wordSize < 12) ? ((uint64_t) 1) << wordSize : HUFFMAN_BENCH_ALPHABET;
+	for (i = 0; i < alphabetSize; i++) {
+		alphabet.push_back((wordSize < 12) ? i : (bench_rand(&state) & mask));
+	}
+	if (dist == DIST_ZIPF) {
+		double total = 0.0;
+		for (i = 0; i < alphabetSize; i++) {
+			total += 1.0 / (double) (i + 1);
+			cdf.push_back(total);
+		}
+		for (i = 0; i < alphabetSize; i++) {
+			cdf[i] /= total;
+		}
+	}
+
+	numWords = get_word_count(&finalBits, data.size(), wordSize);
+	for (i = 0; i < numWords; i++) {
+		if (dist == DIST_CONSTANT) {
+			word = alphabet[alphabetSize / 2];
+		} else if (dist == DIST_UNIFORM) {
+			word = alphabet[bench_rand(&state) % alphabetSize];
+		} else if (dist == DIST_RUNS) {
+			if (runLeft == 0) {
+				word = alphabet[bench_rand(&state) % alphabetSize];
+				runLeft = bench_rand(&state) % 256 + 1;
+			}
+			runLeft--;
+		} else {
+			double u = (double) (bench_rand(&state) >> 11) / (double) (((uint64_t) 1) << 53);
+			uint64_t lo = 0, hi = alphabetSize - 1;
+			while (lo < hi) {
+				uint64_t mid = (lo + hi) / 2;
+				if (cdf[mid] < u) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			word = alphabet[lo];
+		}
+		if (i == numWords - 1 && finalBits != 0) {
+			put_bits(&currPtr, &currBit, &remaining, word >> (wordSize - finalBits), finalBits);
+		} else {
+			put_bits(&currPtr, &currBit, &remaining, word, wordSize);
+		}
+	}
+	return data;
+}
+
+/**
+ * Labels a benchmark with its distribution and word size, and reports
+ * throughput.
+ *
+ * @param[in,out] state Benchmark state.
+ * @param[in]     bytes Number of input bytes processed per iteration.
+ */
+static void finish_bench(benchmark::State& state,
+						 uint64_t bytes) {
+	state.SetBytesProcessed((int64_t) (state.iterations() * bytes));
+	state.SetLabel(distNames[state.range(0)]);
+	state.counters["wordSize"] = (double) state.range(1);
+}
+
+/**
+ * Benchmarks building the frequency table ({@link generate_table}).
+ */
+static void BM_histogram(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	HuffmanContext ctx;
+	HuffmanHeader hdr;
+	HuffmanHashTable table;
+
+	huffman_context_init(&ctx);
+	for (auto _ : state) {
+		HuffmanContextMark mark;
+		context_enter(&mark, &ctx);
+		if (generate_table(&hdr, &table, src.data(), src.size(), wordSize, NULL, &ctx) != ERR_NO_ERR) {
+			state.SkipWithError("generate_table failed");
+			context_leave(&ctx, &mark);
+			break;
+		}
+		table_free(&ctx, table.table, table.size);
+		context_leave(&ctx, &mark);
+	}
+	state.counters["uniqueWords"] = (double) hdr.uniqueWords;
+	huffman_context_free(&ctx);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks sorting the frequency table ({@link sort_table}). Throughput is
+ * relative to input size.
+ */
+static void BM_sort(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	HuffmanHeader hdr, sortHdr;
+	HuffmanHashTable table, sorted;
+
+	if (generate_table(&hdr, &table, src.data(), src.size(), wordSize, NULL, NULL) != ERR_NO_ERR) {
+		state.SkipWithError("generate_table failed");
+		return;
+	}
+	std::vector<uint64_t> copy(2 * table.size);
+	sorted.table = copy.data();
+	sorted.size = table.size;
+	for (auto _ : state) {
+		state.PauseTiming();
+		memcpy(copy.data(), table.table, 2 * sizeof(uint64_t) * table.size);
+		sortHdr = hdr;
+		state.ResumeTiming();
+		if (sort_table(&sortHdr, &sorted) != ERR_NO_ERR) {
+			state.SkipWithError("sort_table failed");
+			break;
+		}
+	}
+	free(table.table);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks choosing a mapping from a sorted table ({@link select_builtin}),
+ * which calculates the compressed size under every built-in mapping and
+ * depth. Throughput is relative to input size.
+ */
+static void BM_size(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	HuffmanHeader hdr;
+	HuffmanHashTable table;
+	HuffmanStats best;
+
+	if (build_sorted_table(&hdr, &table, src.data(), src.size(), wordSize, NULL, NULL) != ERR_NO_ERR) {
+		state.SkipWithError("build_sorted_table failed");
+		return;
+	}
+	for (auto _ : state) {
+		if (select_builtin(&best, &hdr, &table, 0) != ERR_NO_ERR) {
+			state.SkipWithError("select_builtin failed");
+			break;
+		}
+		benchmark::DoNotOptimize(best);
+	}
+	free(table.table);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks {@link huffman_compress_ctx} with a reused context.
+ */
+static void BM_compress(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	std::vector<uint8_t> dst(2 * src.size() + 1024);
+	HuffmanContext ctx;
+	HuffmanHeader hdr;
+	uint64_t dstSize = 0;
+
+	huffman_context_init(&ctx);
+	for (auto _ : state) {
+		dstSize = dst.size();
+		if (huffman_compress_ctx(dst.data(), &dstSize, &hdr, src.data(), src.size(),
+				wordSize, &ctx) != ERR_NO_ERR) {
+			state.SkipWithError("huffman_compress_ctx failed");
+			break;
+		}
+	}
+	state.counters["ratio"] = (double) dstSize / (double) src.size();
+	huffman_context_free(&ctx);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks {@link huffman_compress_checksum} with a reused context, to be
+ * compared with BM_compress.
+ */
+static void BM_compress_checksum(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	std::vector<uint8_t> dst(2 * src.size() + 1024);
+	HuffmanContext ctx;
+	HuffmanHeader hdr;
+	uint64_t dstSize = 0;
+
+	huffman_context_init(&ctx);
+	for (auto _ : state) {
+		dstSize = dst.size();
+		if (huffman_compress_checksum(dst.data(), &dstSize, &hdr, src.data(), src.size(),
+				wordSize, &ctx) != ERR_NO_ERR) {
+			state.SkipWithError("huffman_compress_checksum failed");
+			break;
+		}
+	}
+	state.counters["ratio"] = (double) dstSize / (double) src.size();
+	huffman_context_free(&ctx);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks {@link huffman_compress_runs} with a reused context.
+ */
+static void BM_compress_runs(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	std::vector<uint8_t> dst(2 * src.size() + 1024);
+	HuffmanContext ctx;
+	HuffmanHeader hdr;
+	uint64_t dstSize = 0;
+
+	huffman_context_init(&ctx);
+	for (auto _ : state) {
+		dstSize = dst.size();
+		if (huffman_compress_runs(dst.data(), &dstSize, &hdr, src.data(), src.size(),
+				wordSize, &ctx) != ERR_NO_ERR) {
+			state.SkipWithError("huffman_compress_runs failed");
+			break;
+		}
+	}
+	state.counters["ratio"] = (double) dstSize / (double) src.size();
+	huffman_context_free(&ctx);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks {@link huffman_decompress_ctx} with a reused context.
+ * Throughput is relative to decompressed size.
+ */
+static void BM_decompress(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	std::vector<uint8_t> dst(2 * src.size() + 1024);
+	std::vector<uint8_t> out(src.size());
+	HuffmanContext ctx;
+	HuffmanHeader hdr;
+	uint64_t dstSize = dst.size();
+	uint64_t outSize;
+
+	huffman_context_init(&ctx);
+	if (huffman_compress_ctx(dst.data(), &dstSize, &hdr, src.data(), src.size(),
+			wordSize, &ctx) != ERR_NO_ERR) {
+		state.SkipWithError("huffman_compress_ctx failed");
+		huffman_context_free(&ctx);
+		return;
+	}
+	for (auto _ : state) {
+		outSize = out.size();
+		if (huffman_decompress_ctx(out.data(), &outSize, dst.data(), dstSize, &ctx) != ERR_NO_ERR) {
+			state.SkipWithError("huffman_decompress_ctx failed");
+			break;
+		}
+	}
+	huffman_context_free(&ctx);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks {@link huffman_decompress_ctx} on frames from
+ * {@link huffman_compress_checksum} with a reused context, to be compared
+ * with BM_decompress. Throughput is relative to decompressed size.
+ */
+static void BM_decompress_checksum(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	std::vector<uint8_t> dst(2 * src.size() + 1024);
+	std::vector<uint8_t> out(src.size());
+	HuffmanContext ctx;
+	HuffmanHeader hdr;
+	uint64_t dstSize = dst.size();
+	uint64_t outSize;
+
+	huffman_context_init(&ctx);
+	if (huffman_compress_checksum(dst.data(), &dstSize, &hdr, src.data(), src.size(),
+			wordSize, &ctx) != ERR_NO_ERR) {
+		state.SkipWithError("huffman_compress_checksum failed");
+		huffman_context_free(&ctx);
+		return;
+	}
+	for (auto _ : state) {
+		outSize = out.size();
+		if (huffman_decompress_ctx(out.data(), &outSize, dst.data(), dstSize, &ctx) != ERR_NO_ERR) {
+			state.SkipWithError("huffman_decompress_ctx failed");
+			break;
+		}
+	}
+	huffman_context_free(&ctx);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Benchmarks {@link huffman_decompress_ctx} on frames from
+ * {@link huffman_compress_interleaved} with {@link HUFFMAN_MAX_STREAMS}
+ * streams and a reused context. Throughput is relative to decompressed size.
+ */
+static void BM_decompress_interleaved(benchmark::State& state) {
+	BenchDistribution dist = (BenchDistribution) state.range(0);
+	uint8_t wordSize = (uint8_t) state.range(1);
+	std::vector<uint8_t> src = generate_input(dist, wordSize);
+	std::vector<uint8_t> dst(2 * src.size() + 1024);
+	std::vector<uint8_t> out(src.size());
+	HuffmanContext ctx;
+	HuffmanHeader hdr;
+	uint64_t dstSize = dst.size();
+	uint64_t outSize;
+
+	huffman_context_init(&ctx);
+	if (huffman_compress_interleaved(dst.data(), &dstSize, &hdr, src.data(), src.size(),
+			wordSize, HUFFMAN_MAX_STREAMS, &ctx) != ERR_NO_ERR) {
+		state.SkipWithError("huffman_compress_interleaved failed");
+		huffman_context_free(&ctx);
+		return;
+	}
+	for (auto _ : state) {
+		outSize = out.size();
+		if (huffman_decompress_ctx(out.data(), &outSize, dst.data(), dstSize, &ctx) != ERR_NO_ERR) {
+			state.SkipWithError("huffman_decompress_ctx failed");
+			break;
+		}
+	}
+	huffman_context_free(&ctx);
+	finish_bench(state, src.size());
+}
+
+/**
+ * Registers every distribution and word size for a benchmark.
+ *
+ * @param[in,out] bench Benchmark to be configured.
+ */
+static void bench_args(benchmark::internal::Benchmark* bench) {
+	bench->ArgNames({"dist", "wordSize"});
+	for (int dist = 0; dist < NUM_DISTRIBUTIONS; dist++) {
+		for (uint64_t w = 0; w < sizeof(benchWordSizes) / sizeof(benchWordSizes[0]); w++) {
+			bench->Args({dist, benchWordSizes[w]});
+		}
+	}
+	bench->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK(BM_histogram)->Apply(bench_args);
+BENCHMARK(BM_sort)->Apply(bench_args);
+BENCHMARK(BM_size)->Apply(bench_args);
+BENCHMARK(BM_compress)->Apply(bench_args);
+BENCHMARK(BM_compress_checksum)->Apply(bench_args);
+BENCHMARK(BM_compress_runs)->Apply(bench_args);
+BENCHMARK(BM_decompress)->Apply(bench_args);
+BENCHMARK(BM_decompress_checksum)->Apply(bench_args);
+BENCHMARK(BM_decompress_interleaved)->Apply(bench_args);
+
+BENCHMARK_MAIN();
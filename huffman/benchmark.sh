@@ -0,0 +1,28 @@
+ORANGE='\033[0;33m'
+NC='\033[0m' # No Color
+
+# create, populate, move to benchmark directory
+echo -e "${ORANGE}[Create bench-build directory]${NC}"
+rm -r bench-build;
+mkdir bench-build;
+cp -r src bench-build/src;
+cp -r bench bench-build/bench;
+cd bench-build;
+mkdir lib;
+
+# build google benchmark library
+echo -e "${ORANGE}[Build benchmark library]${NC}"
+mkdir benchmark_out;
+cd benchmark_out;
+cmake -DCMAKE_BUILD_TYPE=Release -DBENCHMARK_ENABLE_TESTING=OFF ../../../lib/benchmark;
+make;
+cp ./src/*.a ../lib;
+cd ..;
+
+# build benchmarks using framework
+echo -e "${ORANGE}[Build benchmarks]${NC}"
+g++ -std=gnu++11 -O2 -Isrc/inc -Isrc -I../../lib/benchmark/include/ -pthread ./bench/huffman_bench.cc lib/libbenchmark.a -o./huffman_bench;
+
+# run benchmarks, extra arguments (e.g. --benchmark_filter) passed through
+echo -e "${ORANGE}[Run benchmarks]${NC}"
+./huffman_bench --benchmark_out=huffman_bench.json --benchmark_out_format=json "$@";
@@ -11,19 +11,196 @@ extern "C" {
 #endif
 
 // Includes
+#include <stddef.h>
+#include <string.h>
+
 #include "huffman.h"
 #include "basemap.h"
 
 /////////// helpers
 
+#ifndef THROW_ERR
 /**
- * Gets ceiling of uint64 division.
+ * Enables throwing of {@link HuffmanError} to calling function if error
+ * occurred.
+ *
+ * @param[in] f Function to be called.
  */
-static uint64_t div_ceil_u64(uint64_t dividend, uint64_t divisor) {
-	if (dividend % divisor != 0) {
-		return 1 + (dividend / divisor);
+#define THROW_ERR(f) err = (f); if (err != ERR_NO_ERR) { return err; }
+#endif
+
+/**
+ * Reads the next 64 bits starting at an arbitrary bit position, with the
+ * first bit in the most significant position. Bits past the end of src are
+ * read as 0.
+ *
+ * @param[in] src     Start of data.
+ * @param[in] srcSize Length of src in bytes.
+ * @param[in] pos     Bit offset from start of src. Range 0 - 8 * srcSize.
+ *
+ * @return 64-bit window of src.
+ */
+static inline uint64_t peek_bits64(const uint8_t* src,
+								   uint64_t srcSize,
+								   uint64_t pos) {
+	const uint8_t* ptr = src + pos / 8;
+	uint64_t remaining = srcSize - pos / 8;
+	uint8_t start = pos % 8;
+	uint64_t window = 0;
+	if (remaining >= 9) {
+		memcpy(&window, ptr, sizeof(window));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		window = __builtin_bswap64(window);
+#endif
+		return (window << start) | (((uint64_t)ptr[8] << start) >> 8);
+	}
+	// Tail of data; at most 8 bytes remain
+	for (uint64_t i = 0; i < remaining; i++) {
+		window |= (uint64_t)ptr[i] << (56 - 8 * i);
 	}
-	return dividend / divisor;
+	return window << start;
+}
+
+/**
+ * Counts a run of 0 bits too long to fit in one window. Only used for
+ * unary prefixes of 64 bits or more.
+ *
+ * @param[out] zeros   Number of 0 bits before the next 1 bit.
+ * @param[in]  src     Start of data.
+ * @param[in]  srcSize Length of src in bytes.
+ * @param[in]  pos     Bit offset from start of src of first 0 bit.
+ * @param[in]  limit   Largest run accepted.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if src ends before the run.\n
+ *         {@link ERR_INVALID_DATA} if the run is longer than limit.
+ */
+static HuffmanError count_zero_run(uint64_t* zeros,
+								   const uint8_t* src,
+								   uint64_t srcSize,
+								   uint64_t pos,
+								   uint64_t limit) {
+	uint64_t total = 0;
+	uint64_t window;
+	while ((window = peek_bits64(src, srcSize, pos + total)) == 0) {
+		if (8 * srcSize - (pos + total) <= 64) {
+			return ERR_INSUFFICIENT_SPACE;
+		}
+		total += 64;
+		if (total > limit) {
+			return ERR_INVALID_DATA;
+		}
+	}
+	total += __builtin_clzll(window);
+	if (total > limit) {
+		return ERR_INVALID_DATA;
+	}
+	*zeros = total;
+	return ERR_NO_ERR;
+}
+
+/**
+ * Validates the parameters of a parse function and converts the position
+ * to a bit offset.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null, or if value of src is null.\n
+ *         {@link ERR_INVALID_VALUE} if start is out of accepted range.
+ */
+static inline HuffmanError check_parse_params(uint64_t* dst,
+											  uint8_t** src,
+											  uint8_t* start,
+											  uint64_t* srcSize,
+											  const HuffmanMapContext* ctx) {
+	if (dst == NULL || src == NULL || *src == NULL || start == NULL ||
+			srcSize == NULL || ctx == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (*start >= 8 || (*srcSize == 0 && *start != 0)) {
+		return ERR_INVALID_VALUE;
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * Moves a position forward by a bit offset from its current byte.
+ *
+ * @param[in,out] src     Pointer to current byte. Updated to new byte.
+ * @param[in,out] start   Current bit. Updated to new bit. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining. Updated to new remainder.
+ * @param[in]     pos     Bit offset of new position from current byte.
+ */
+static inline void commit_position(uint8_t** src,
+								   uint8_t* start,
+								   uint64_t* srcSize,
+								   uint64_t pos) {
+	*src += pos / 8;
+	*srcSize -= pos / 8;
+	*start = (uint8_t)(pos % 8);
+}
+
+/**
+ * Decodes one index at a bit offset of data, advancing the offset.
+ */
+typedef HuffmanError (*decode_fcn) (uint64_t* dst,
+									const uint8_t* src,
+									uint64_t srcSize,
+									uint64_t* pos,
+									const HuffmanMapContext* ctx);
+
+/**
+ * Parses indices from interleaved streams, index i coming from stream
+ * i % numStreams. Each round decodes one index from every stream; as the
+ * streams do not depend on each other, the decodes of a round can proceed in
+ * parallel.
+ *
+ * @param[in]     decode     Decoder of mapping, inlined into the loop.
+ * @param[out]    dst        Destination for count parsed indices.
+ * @param[in]     count      Number of indices to parse.
+ * @param[in]     numStreams Number of streams. Range 1 - {@link HUFFMAN_MAX_STREAMS}.
+ * @param[in,out] src        Current byte of each stream. Updated to first byte following parsed values.
+ * @param[in,out] start      Current bit of each stream. Updated to bit following parsed values. Range 0-7.
+ * @param[in,out] srcSize    Number of bytes remaining in each stream. Updated on success.
+ * @param[in]     ctx        Mapping constants.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if numStreams or a start is out of accepted range.\n
+ *         Other errors as raised by decode. Positions are only updated if
+ *         every index was parsed.
+ */
+__attribute__((always_inline))
+static inline HuffmanError parse_streams(decode_fcn decode,
+										 uint64_t* dst,
+										 uint64_t count,
+										 uint8_t numStreams,
+										 uint8_t** src,
+										 uint8_t* start,
+										 uint64_t* srcSize,
+										 const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	uint64_t pos[HUFFMAN_MAX_STREAMS];
+	uint64_t i, s, n;
+	if (src == NULL || start == NULL || srcSize == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (numStreams == 0 || numStreams > HUFFMAN_MAX_STREAMS) {
+		return ERR_INVALID_VALUE;
+	}
+	for (s = 0; s < numStreams; s++) {
+		THROW_ERR(check_parse_params(dst, &src[s], &start[s], &srcSize[s], ctx))
+		pos[s] = start[s];
+	}
+	for (i = 0; i < count; i += n) {
+		n = (count - i < numStreams) ? count - i : numStreams;
+		for (s = 0; s < n; s++) {
+			THROW_ERR(decode(&dst[i + s], src[s], srcSize[s], &pos[s], ctx))
+		}
+	}
+	for (s = 0; s < numStreams; s++) {
+		commit_position(&src[s], &start[s], &srcSize[s], pos[s]);
+	}
+	return ERR_NO_ERR;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -38,9 +215,47 @@ static uint64_t div_ceil_u64(uint64_t dividend, uint64_t divisor) {
  * Mapping table for one-hot encoding.
  */
 HuffmanCompressor OneHot = {
+	name: "one_hot",
+	maxDepth: 0,
+	initContext: NULL,
 	getSize: one_hot_get_compressed_size,
+	getSizes: one_hot_get_compressed_sizes,
 	getVal: one_hot_get_compressed_val,
-	parseIdx: one_hot_parse_compressed_idx
+	parseIdx: one_hot_parse_compressed_idx,
+	parseIdxBulk: one_hot_parse_compressed_idx_bulk,
+	parseIdxStreams: one_hot_parse_compressed_idx_streams
+};
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Mapping table for fixed-depth tree encoding.
+ */
+HuffmanCompressor FixDepthTree = {
+	name: "fix_depth_tree",
+	maxDepth: HUFFMAN_MAX_WORD_SIZE,
+	initContext: NULL,
+	getSize: fix_depth_tree_get_compressed_size,
+	getSizes: fix_depth_tree_get_compressed_sizes,
+	getVal: fix_depth_tree_get_compressed_val,
+	parseIdx: fix_depth_tree_parse_compressed_idx,
+	parseIdxBulk: fix_depth_tree_parse_compressed_idx_bulk,
+	parseIdxStreams: fix_depth_tree_parse_compressed_idx_streams
+};
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Mapping table for log-depth tree encoding.
+ */
+HuffmanCompressor LogDepthTree = {
+	name: "log_depth_tree",
+	maxDepth: 0,
+	initContext: NULL,
+	getSize: log_depth_tree_get_compressed_size,
+	getSizes: log_depth_tree_get_compressed_sizes,
+	getVal: log_depth_tree_get_compressed_val,
+	parseIdx: log_depth_tree_parse_compressed_idx,
+	parseIdxBulk: log_depth_tree_parse_compressed_idx_bulk,
+	parseIdxStreams: log_depth_tree_parse_compressed_idx_streams
 };
 
 /**
@@ -48,132 +263,572 @@ HuffmanCompressor OneHot = {
  * Determines number of bits needed for given word using one-hot encoding
  * mapping.
  *
- * @param[in] idx    Index of word in frequency table (0 being most frequent).
- * @param[in] maxIdx Total number of unique words. Actual value is maxIdx + 1.
- * @param[in] depth  Unused.
+ * @param[in] idx Index of word in frequency table (0 being most frequent).
+ * @param[in] ctx Mapping constants. Unused.
  *
  * @return Number of bits required for given word.
  */
-uint64_t one_hot_get_compressed_size(uint64_t idx, uint64_t maxIdx, uint8_t depth) {
+uint64_t one_hot_get_compressed_size(uint64_t idx,
+									 const HuffmanMapContext* ctx) {
 	return idx + 1;
 }
 
+/**
+ * @ingroup HuffmanBaseMaps
+ * Determines number of bits needed for a range of words using one-hot
+ * encoding mapping.
+ *
+ * @param[out] dst      Destination for count sizes.
+ * @param[in]  startIdx Index of first word in frequency table.
+ * @param[in]  count    Number of sizes to be written.
+ * @param[in]  ctx      Mapping constants. Unused.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INVALID_VALUE} if a size in the range exceeds 255 bits.
+ */
+HuffmanError one_hot_get_compressed_sizes(uint8_t* dst,
+										  uint64_t startIdx,
+										  uint64_t count,
+										  const HuffmanMapContext* ctx) {
+	if (startIdx + count > 0xFF) {
+		return ERR_INVALID_VALUE;
+	}
+	for (uint64_t i = 0; i < count; i++) {
+		dst[i] = (uint8_t)(startIdx + i + 1);
+	}
+	return ERR_NO_ERR;
+}
+
 /**
  * @ingroup HuffmanBaseMaps
  * Determines value for given word using one-hot encoding mapping.
  *
- * @param[in] idx    Index of word in frequency table (0 being most frequent).
- * @param[in] maxIdx Total number of unique words. Actual value is maxIdx + 1.
- * @param[in] depth  Unused.
+ * @param[in] idx Index of word in frequency table (0 being most frequent).
+ * @param[in] ctx Mapping constants. Unused.
  *
  * @return Value of word using one-hot encoding (always 0x1).
  */
 uint64_t one_hot_get_compressed_val(uint64_t idx,
-									uint64_t maxIdx,
-									uint8_t depth) {
+									const HuffmanMapContext* ctx) {
 	return (uint64_t)0x1;
 }
 
+/**
+ * Decodes one index coded with one-hot encoding mapping.
+ *
+ * @see one_hot_parse_compressed_idx
+ */
+static inline HuffmanError one_hot_decode(uint64_t* dst,
+										  const uint8_t* src,
+										  uint64_t srcSize,
+										  uint64_t* pos,
+										  const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	uint64_t zeros;
+	uint64_t window = peek_bits64(src, srcSize, *pos);
+	if (window != 0) {
+		zeros = __builtin_clzll(window);
+	} else {
+		THROW_ERR(count_zero_run(&zeros, src, srcSize, *pos, ctx->uniqueWords))
+	}
+	if (zeros >= ctx->uniqueWords) {
+		return ERR_INVALID_DATA;
+	}
+	*dst = zeros;
+	*pos += zeros + 1;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses the index of the next word coded with one-hot encoding mapping.
+ * The index is the leading-zero count of a 64-bit window; indices of 64 and
+ * above scan further windows.
+ *
+ * @param[out]    dst     Destination for parsed index.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte of following value.
+ * @param[in,out] start   Bit from which to start. Updated to bit of following value. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
+ * @param[in]     ctx     Mapping constants.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null, or if value of src is null.\n
+ *         {@link ERR_INVALID_VALUE} if start is out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if src ends before the value.\n
+ *         {@link ERR_INVALID_DATA} if the index is not less than
+ *              {@link HuffmanMapContext#uniqueWords}.
+ */
 HuffmanError one_hot_parse_compressed_idx(uint64_t* dst,
 										  uint8_t** src,
 										  uint8_t* start,
-										  uint8_t size,
-										  uint64_t maxIdx,
-										  uint8_t depth) {
+										  uint64_t* srcSize,
+										  const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	THROW_ERR(check_parse_params(dst, src, start, srcSize, ctx))
+	uint64_t pos = *start;
+	THROW_ERR(one_hot_decode(dst, *src, *srcSize, &pos, ctx))
+	commit_position(src, start, srcSize, pos);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses a block of indices coded with one-hot encoding mapping.
+ *
+ * @see one_hot_parse_compressed_idx
+ *
+ * @param[out]    dst     Destination for count parsed indices.
+ * @param[in]     count   Number of indices to parse.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte following block.
+ * @param[in,out] start   Bit from which to start. Updated to bit following block. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
+ * @param[in]     ctx     Mapping constants.
+ *
+ * @return As {@link one_hot_parse_compressed_idx}. Position is only
+ *         updated if the whole block was parsed.
+ */
+HuffmanError one_hot_parse_compressed_idx_bulk(uint64_t* dst,
+											   uint64_t count,
+											   uint8_t** src,
+											   uint8_t* start,
+											   uint64_t* srcSize,
+											   const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	THROW_ERR(check_parse_params(dst, src, start, srcSize, ctx))
+	const uint8_t* base = *src;
+	const uint64_t size = *srcSize;
+	uint64_t pos = *start;
+	for (uint64_t i = 0; i < count; i++) {
+		THROW_ERR(one_hot_decode(&dst[i], base, size, &pos, ctx))
+	}
+	commit_position(src, start, srcSize, pos);
 	return ERR_NO_ERR;
 }
 
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses indices coded with one-hot encoding mapping from
+ * interleaved streams.
+ *
+ * @see parse_streams
+ *
+ * @param[out]    dst        Destination for count parsed indices.
+ * @param[in]     count      Number of indices to parse.
+ * @param[in]     numStreams Number of streams. Range 1 - {@link HUFFMAN_MAX_STREAMS}.
+ * @param[in,out] src        Current byte of each stream. Updated to first byte following parsed values.
+ * @param[in,out] start      Current bit of each stream. Updated to bit following parsed values. Range 0-7.
+ * @param[in,out] srcSize    Number of bytes remaining in each stream. Updated on success.
+ * @param[in]     ctx        Mapping constants.
+ *
+ * @return As {@link parse_streams}.
+ */
+HuffmanError one_hot_parse_compressed_idx_streams(uint64_t* dst,
+												  uint64_t count,
+												  uint8_t numStreams,
+												  uint8_t** src,
+												  uint8_t* start,
+												  uint64_t* srcSize,
+												  const HuffmanMapContext* ctx) {
+	return parse_streams(one_hot_decode, dst, count, numStreams, src, start, srcSize, ctx);
+}
+
 /**
  * @ingroup HuffmanBaseMaps
  * Determines number of bits needed for given word using fixed-depth tree
- * encoding mapping.
+ * encoding mapping. Words are grouped into blocks of 2^depth; index 0 is
+ * coded as a single bit and block g (1-based) as g zeros, a one and a
+ * depth-bit suffix.
  *
- * @param[in] idx    Index of word in frequency table (0 being most frequent).
- * @param[in] maxIdx Total number of unique words.. Actual value is maxIdx + 1
- * @param[in] depth  Depth of left branches of tree.
+ * @param[in] idx Index of word in frequency table (0 being most frequent).
+ * @param[in] ctx Mapping constants, including depth of left branches of tree.
  *
  * @return Number of bits required for given word.
  */
 uint64_t fix_depth_tree_get_compressed_size(uint64_t idx,
-											uint64_t maxIdx,
-											uint8_t depth) {
-	if (idx == 0) {
-		return 1;
+											const HuffmanMapContext* ctx) {
+	// 1 for idx 0, else 1 + depth + ceil(idx / 2^depth)
+	return 1 + (uint64_t)(idx != 0) * (ctx->depth + ((idx + ctx->mask) >> ctx->depth));
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Determines number of bits needed for a range of words using fixed-depth tree
+ * encoding mapping. Equivalent to {@link fix_depth_tree_get_compressed_size}
+ * for each index.
+ *
+ * @param[out] dst      Destination for count sizes.
+ * @param[in]  startIdx Index of first word in frequency table.
+ * @param[in]  count    Number of sizes to be written.
+ * @param[in]  ctx      Mapping constants, including depth of left branches of tree.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INVALID_VALUE} if a size in the range exceeds 255 bits.
+ */
+HuffmanError fix_depth_tree_get_compressed_sizes(uint8_t* dst,
+												 uint64_t startIdx,
+												 uint64_t count,
+												 const HuffmanMapContext* ctx) {
+	if (count == 0) {
+		return ERR_NO_ERR;
 	}
-	static uint8_t cached_depth = depth;
-	static uint64_t pow2 = ((uint64_t) 1) << ((uint64_t) depth); // 2^k
-	if (cached_depth != depth) { // TODO see if caching actually helps here
-		cached_depth = depth;
-		pow2 = ((uint64_t) 1) << ((uint64_t) depth);
+	// Sizes increase with index, so only the last one needs checking
+	if (fix_depth_tree_get_compressed_size(startIdx + count - 1, ctx) > 0xFF) {
+		return ERR_INVALID_VALUE;
 	}
-	return 1 + depth + div_ceil_u64(idx, pow2);
+	const uint64_t depth = ctx->depth;
+	const uint64_t mask = ctx->mask;
+	for (uint64_t i = 0; i < count; i++) {
+		uint64_t idx = startIdx + i;
+		dst[i] = (uint8_t)(1 + (uint64_t)(idx != 0) * (depth + ((idx + mask) >> depth)));
+	}
+	return ERR_NO_ERR;
 }
 
 /**
  * @ingroup HuffmanBaseMaps
  * Determines value for given word using fixed-depth tree encoding mapping.
+ * The depth-bit suffix is (-idx) mod 2^depth, so the value is
+ * 2^depth | ((-idx) mod 2^depth) for all non-zero indices.
  *
- * @param[in] idx    Index of word in frequency table (0 being most frequent).
- * @param[in] maxIdx Total number of unique words. Actual value is maxIdx + 1.
- * @param[in] depth  Depth of left branches of tree.
+ * @param[in] idx Index of word in frequency table (0 being most frequent).
+ * @param[in] ctx Mapping constants, including depth of left branches of tree.
  *
  * @return Value of word using fixed-depth tree encoding.
  */
 uint64_t fix_depth_tree_get_compressed_val(uint64_t idx,
-										   uint64_t maxIdx,
-										   uint8_t depth) {
-	if (idx == 0) {
-		return 1;
+										   const HuffmanMapContext* ctx) {
+	// 1 for idx 0, else 2^(k+1) - (i % (2^k)), or 2^k when divisible
+	return 1 + (uint64_t)(idx != 0) * ((ctx->pow2 | ((0 - idx) & ctx->mask)) - 1);
+}
+
+/**
+ * Decodes one index coded with fixed-depth tree encoding mapping.
+ *
+ * @see fix_depth_tree_parse_compressed_idx
+ */
+static inline HuffmanError fix_depth_tree_decode(uint64_t* dst,
+												 const uint8_t* src,
+												 uint64_t srcSize,
+												 uint64_t* pos,
+												 const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	const uint64_t depth = ctx->depth;
+	const uint64_t avail = 8 * srcSize - *pos;
+	// Largest block number, bounds prefix length and prevents overflow
+	const uint64_t maxGroup = (ctx->uniqueWords >> depth) + 1;
+	uint64_t group, suffix, numBits, idx;
+	uint64_t window = peek_bits64(src, srcSize, *pos);
+
+	if (window != 0 && __builtin_clzll(window) + 1 + depth <= 64) {
+		// Prefix, 1 and suffix all in one window
+		group = __builtin_clzll(window);
+		if (group > maxGroup) {
+			return ERR_INVALID_DATA;
+		}
+		suffix = (window >> (63 - group - depth)) & ctx->mask;
+	} else {
+		if (window != 0) {
+			group = __builtin_clzll(window);
+		} else {
+			THROW_ERR(count_zero_run(&group, src, srcSize, *pos, maxGroup))
+		}
+		if (group > maxGroup) {
+			return ERR_INVALID_DATA;
+		}
+		// (x >> 1) >> (63 - depth) avoids shifting by 64 when depth is 0
+		suffix = (peek_bits64(src, srcSize, *pos + group + 1) >> 1) >> (63 - depth);
 	}
-	static uint8_t cached_depth = depth;
-	static uint64_t pow2 = ((uint64_t) 1) << ((uint64_t) depth); // 2^k
-	if (cached_depth != depth) { // TODO see if caching actually helps here
-		cached_depth = depth;
-		pow2 = ((uint64_t) 1) << ((uint64_t) depth);
+	// Index 0 is the single bit 1; otherwise (group << depth) - suffix
+	numBits = 1 + (uint64_t)(group != 0) * (group + depth);
+	idx = (uint64_t)(group != 0) * ((group << depth) - suffix);
+	if (numBits > avail) {
+		return ERR_INSUFFICIENT_SPACE;
 	}
-	if (idx % pow2 == 0) {
-		return pow2;
+	if (idx >= ctx->uniqueWords) {
+		return ERR_INVALID_DATA;
 	}
-	return pow2 * 2 - (idx % pow2); // 2^(k+1) - (i % (2^k))
+	*dst = idx;
+	*pos += numBits;
+	return ERR_NO_ERR;
 }
 
 /**
  * @ingroup HuffmanBaseMaps
- * Determines value for given word using log-depth tree encoding mapping.
+ * Parses the index of the next word coded with fixed-depth tree encoding
+ * mapping. The block number is the leading-zero count of a 64-bit window and
+ * the suffix is taken with one mask and shift.
  *
- * @param[in] idx    Index of word in frequency table (0 being most frequent).
- * @param[in] maxIdx Total number of unique words. Actual value is maxIdx + 1.
- * @param[in] depth  Unused.
+ * @param[out]    dst     Destination for parsed index.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte of following value.
+ * @param[in,out] start   Bit from which to start. Updated to bit of following value. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
+ * @param[in]     ctx     Mapping constants.
  *
- * @return Value of word using log-depth tree encoding.
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null, or if value of src is null.\n
+ *         {@link ERR_INVALID_VALUE} if start is out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if src ends before the value.\n
+ *         {@link ERR_INVALID_DATA} if the index is not less than
+ *              {@link HuffmanMapContext#uniqueWords}.
  */
-uint64_t log_depth_tree_get_compressed_size(uint64_t idx,
-											uint64_t maxIdx,
-											uint8_t depth) {
-	if (idx == 0) {
-		return 0x1;
+HuffmanError fix_depth_tree_parse_compressed_idx(uint64_t* dst,
+												 uint8_t** src,
+												 uint8_t* start,
+												 uint64_t* srcSize,
+												 const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	THROW_ERR(check_parse_params(dst, src, start, srcSize, ctx))
+	uint64_t pos = *start;
+	THROW_ERR(fix_depth_tree_decode(dst, *src, *srcSize, &pos, ctx))
+	commit_position(src, start, srcSize, pos);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses a block of indices coded with fixed-depth tree encoding mapping.
+ *
+ * @see fix_depth_tree_parse_compressed_idx
+ *
+ * @param[out]    dst     Destination for count parsed indices.
+ * @param[in]     count   Number of indices to parse.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte following block.
+ * @param[in,out] start   Bit from which to start. Updated to bit following block. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
+ * @param[in]     ctx     Mapping constants.
+ *
+ * @return As {@link fix_depth_tree_parse_compressed_idx}. Position is only
+ *         updated if the whole block was parsed.
+ */
+HuffmanError fix_depth_tree_parse_compressed_idx_bulk(uint64_t* dst,
+													  uint64_t count,
+													  uint8_t** src,
+													  uint8_t* start,
+													  uint64_t* srcSize,
+													  const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	THROW_ERR(check_parse_params(dst, src, start, srcSize, ctx))
+	const uint8_t* base = *src;
+	const uint64_t size = *srcSize;
+	uint64_t pos = *start;
+	for (uint64_t i = 0; i < count; i++) {
+		THROW_ERR(fix_depth_tree_decode(&dst[i], base, size, &pos, ctx))
 	}
-	return 0;
+	commit_position(src, start, srcSize, pos);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses indices coded with fixed-depth tree encoding mapping from
+ * interleaved streams.
+ *
+ * @see parse_streams
+ *
+ * @param[out]    dst        Destination for count parsed indices.
+ * @param[in]     count      Number of indices to parse.
+ * @param[in]     numStreams Number of streams. Range 1 - {@link HUFFMAN_MAX_STREAMS}.
+ * @param[in,out] src        Current byte of each stream. Updated to first byte following parsed values.
+ * @param[in,out] start      Current bit of each stream. Updated to bit following parsed values. Range 0-7.
+ * @param[in,out] srcSize    Number of bytes remaining in each stream. Updated on success.
+ * @param[in]     ctx        Mapping constants.
+ *
+ * @return As {@link parse_streams}.
+ */
+HuffmanError fix_depth_tree_parse_compressed_idx_streams(uint64_t* dst,
+														 uint64_t count,
+														 uint8_t numStreams,
+														 uint8_t** src,
+														 uint8_t* start,
+														 uint64_t* srcSize,
+														 const HuffmanMapContext* ctx) {
+	return parse_streams(fix_depth_tree_decode, dst, count, numStreams, src, start, srcSize, ctx);
 }
 
 /**
  * @ingroup HuffmanBaseMaps
  * Determines number of bits needed for given word using log-depth tree
- * encoding mapping.
+ * encoding mapping. Index i is coded as idx + 1 in Elias-gamma form:
+ * floor(log2(i + 1)) zeros followed by the floor(log2(i + 1)) + 1 bits of
+ * i + 1.
+ *
+ * @param[in] idx Index of word in frequency table (0 being most frequent).
+ * @param[in] ctx Mapping constants. Unused.
  *
- * @param[in] idx    Index of word in frequency table (0 being most frequent).
- * @param[in] maxIdx Total number of unique words. Actual value is maxIdx + 1.
- * @param[in] depth  Unused.
+ * @return Number of bits required for given word.
+ */
+uint64_t log_depth_tree_get_compressed_size(uint64_t idx,
+											const HuffmanMapContext* ctx) {
+	return 2 * (uint64_t)(63 - __builtin_clzll(idx + 1)) + 1;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Determines number of bits needed for a range of words using log-depth tree
+ * encoding mapping. Equivalent to {@link log_depth_tree_get_compressed_size}
+ * for each index; sizes never exceed 121 bits.
+ *
+ * @param[out] dst      Destination for count sizes.
+ * @param[in]  startIdx Index of first word in frequency table.
+ * @param[in]  count    Number of sizes to be written.
+ * @param[in]  ctx      Mapping constants. Unused.
+ *
+ * @return {@link ERR_NO_ERR}.
+ */
+HuffmanError log_depth_tree_get_compressed_sizes(uint8_t* dst,
+												 uint64_t startIdx,
+												 uint64_t count,
+												 const HuffmanMapContext* ctx) {
+	for (uint64_t i = 0; i < count; i++) {
+		dst[i] = (uint8_t)(2 * (63 - __builtin_clzll(startIdx + i + 1)) + 1);
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Determines value for given word using log-depth tree encoding mapping.
+ * The leading zeros are implied by {@link log_depth_tree_get_compressed_size}.
+ *
+ * @param[in] idx Index of word in frequency table (0 being most frequent).
+ * @param[in] ctx Mapping constants. Unused.
  *
  * @return Value of word using log-depth tree encoding.
  */
 uint64_t log_depth_tree_get_compressed_val(uint64_t idx,
-										   uint64_t maxIdx,
-										   uint8_t depth) {
-	if (idx == 0) {
-		return 0x1;
+										   const HuffmanMapContext* ctx) {
+	return idx + 1;
+}
+
+/**
+ * Decodes one index coded with log-depth tree encoding mapping.
+ *
+ * @see log_depth_tree_parse_compressed_idx
+ */
+static inline HuffmanError log_depth_tree_decode(uint64_t* dst,
+												 const uint8_t* src,
+												 uint64_t srcSize,
+												 uint64_t* pos,
+												 const HuffmanMapContext* ctx) {
+	const uint64_t avail = 8 * srcSize - *pos;
+	uint64_t window = peek_bits64(src, srcSize, *pos);
+	uint64_t zeros, val;
+	if (window == 0) {
+		// Either truncated or a prefix longer than any valid index
+		return (avail <= 64) ? ERR_INSUFFICIENT_SPACE : ERR_INVALID_DATA;
+	}
+	zeros = __builtin_clzll(window);
+	if (zeros > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_DATA;
+	}
+	if (2 * zeros + 1 > avail) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	if (2 * zeros + 1 <= 64) {
+		val = window >> (63 - 2 * zeros);
+	} else {
+		val = peek_bits64(src, srcSize, *pos + zeros) >> (63 - zeros);
+	}
+	if (val - 1 >= ctx->uniqueWords) {
+		return ERR_INVALID_DATA;
+	}
+	*dst = val - 1;
+	*pos += 2 * zeros + 1;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses the index of the next word coded with log-depth tree encoding
+ * mapping. The prefix length is found with a leading-zero count of a 64-bit
+ * window and the value with a single shift; codes longer than 64 bits
+ * (indices of 2^31 and above) take a second window instead of a loop.
+ *
+ * @param[out]    dst     Destination for parsed index.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte of following value.
+ * @param[in,out] start   Bit from which to start. Updated to bit of following value. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
+ * @param[in]     ctx     Mapping constants.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null, or if value of src is null.\n
+ *         {@link ERR_INVALID_VALUE} if start is out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if src ends before the value.\n
+ *         {@link ERR_INVALID_DATA} if the value is malformed or its index is
+ *              not less than {@link HuffmanMapContext#uniqueWords}.
+ */
+HuffmanError log_depth_tree_parse_compressed_idx(uint64_t* dst,
+												 uint8_t** src,
+												 uint8_t* start,
+												 uint64_t* srcSize,
+												 const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	THROW_ERR(check_parse_params(dst, src, start, srcSize, ctx))
+	uint64_t pos = *start;
+	THROW_ERR(log_depth_tree_decode(dst, *src, *srcSize, &pos, ctx))
+	commit_position(src, start, srcSize, pos);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses a block of indices coded with log-depth tree encoding mapping.
+ *
+ * @see log_depth_tree_parse_compressed_idx
+ *
+ * @param[out]    dst     Destination for count parsed indices.
+ * @param[in]     count   Number of indices to parse.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte following block.
+ * @param[in,out] start   Bit from which to start. Updated to bit following block. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
+ * @param[in]     ctx     Mapping constants.
+ *
+ * @return As {@link log_depth_tree_parse_compressed_idx}. Position is only
+ *         updated if the whole block was parsed.
+ */
+HuffmanError log_depth_tree_parse_compressed_idx_bulk(uint64_t* dst,
+													  uint64_t count,
+													  uint8_t** src,
+													  uint8_t* start,
+													  uint64_t* srcSize,
+													  const HuffmanMapContext* ctx) {
+	HuffmanError err;
+	THROW_ERR(check_parse_params(dst, src, start, srcSize, ctx))
+	const uint8_t* base = *src;
+	const uint64_t size = *srcSize;
+	uint64_t pos = *start;
+	for (uint64_t i = 0; i < count; i++) {
+		THROW_ERR(log_depth_tree_decode(&dst[i], base, size, &pos, ctx))
 	}
-	return 0;
+	commit_position(src, start, srcSize, pos);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanBaseMaps
+ * Parses indices coded with log-depth tree encoding mapping from
+ * interleaved streams.
+ *
+ * @see parse_streams
+ *
+ * @param[out]    dst        Destination for count parsed indices.
+ * @param[in]     count      Number of indices to parse.
+ * @param[in]     numStreams Number of streams. Range 1 - {@link HUFFMAN_MAX_STREAMS}.
+ * @param[in,out] src        Current byte of each stream. Updated to first byte following parsed values.
+ * @param[in,out] start      Current bit of each stream. Updated to bit following parsed values. Range 0-7.
+ * @param[in,out] srcSize    Number of bytes remaining in each stream. Updated on success.
+ * @param[in]     ctx        Mapping constants.
+ *
+ * @return As {@link parse_streams}.
+ */
+HuffmanError log_depth_tree_parse_compressed_idx_streams(uint64_t* dst,
+														 uint64_t count,
+														 uint8_t numStreams,
+														 uint8_t** src,
+														 uint8_t* start,
+														 uint64_t* srcSize,
+														 const HuffmanMapContext* ctx) {
+	return parse_streams(log_depth_tree_decode, dst, count, numStreams, src, start, srcSize, ctx);
 }
 
 #ifdef __cplusplus
@@ -13,12 +13,30 @@
 extern "C" {
 #endif
 
+// Feature-test macro for mkstemp and fdopen under strict -std=c99/c11
+#if !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 // Includes
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <pthread.h>
+#define HUFFMAN_THREADS
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HUFFMAN_X86_DISPATCH
+#include <immintrin.h>
+#endif
 
 #include "huffman.h"
+#include "basemap.h"
 
 ////////////////////////////////////////////////////////////////
 ///
@@ -36,6 +54,67 @@ extern "C" {
  */
 #define THROW_ERR(f) err = (f); if (err != ERR_NO_ERR) { return err; }
 
+#ifdef HUFFMAN_INSTRUMENT
+#include <time.h>
+
+/**
+ * @ingroup HuffmanHelpers
+ * Reads a monotonic clock for {@link HuffmanInstrumentation}.
+ *
+ * @return Time in nanoseconds.
+ */
+static inline uint64_t instrument_now(void) {
+#if defined(__unix__) || defined(__APPLE__)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#else
+	return (uint64_t) clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Instrumentation of a context, or null.
+ */
+#define INSTRUMENTATION(ctx) ((ctx) ? (ctx)->instrumentation : NULL)
+
+/**
+ * @ingroup HuffmanHelpers
+ * Declares timer t and starts it if ctx is instrumented.
+ */
+#define INSTRUMENT_START(ctx, t) uint64_t t = INSTRUMENTATION(ctx) ? instrument_now() : 0
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds time elapsed since {@link INSTRUMENT_START} to a field.
+ */
+#define INSTRUMENT_STOP(ctx, t, field) do { if (INSTRUMENTATION(ctx)) { \
+		(ctx)->instrumentation->field += instrument_now() - (t); } } while (0)
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds n to a field. n is not evaluated if ctx is not instrumented.
+ */
+#define INSTRUMENT_ADD(ctx, field, n) do { if (INSTRUMENTATION(ctx)) { \
+		(ctx)->instrumentation->field += (n); } } while (0)
+
+/**
+ * @ingroup HuffmanHelpers
+ * Raises a field to n if smaller. n is not evaluated if ctx is not
+ * instrumented.
+ */
+#define INSTRUMENT_MAX(ctx, field, n) do { if (INSTRUMENTATION(ctx)) { \
+		uint64_t instrumentVal = (n); \
+		if ((ctx)->instrumentation->field < instrumentVal) { \
+			(ctx)->instrumentation->field = instrumentVal; } } } while (0)
+#else
+#define INSTRUMENT_START(ctx, t)
+#define INSTRUMENT_STOP(ctx, t, field) do {} while (0)
+#define INSTRUMENT_ADD(ctx, field, n) do {} while (0)
+#define INSTRUMENT_MAX(ctx, field, n) do {} while (0)
+#endif
+
 /**
  * @ingroup HuffmanHelpers
  * Ceiling of log base 2 for uint64_t value.
@@ -248,809 +327,8928 @@ static HuffmanError put_bits(uint8_t** dst,
 
 /**
  * @ingroup HuffmanHelpers
- * Constructs a header for a Huffman compressed data. Does not include
- * value map. File header size is
- * {@link HUFFMAN_WORD_SIZE_NUM_BITS} + ceil(log2(wordSize)) + wordSize bits.
+ * Reads a value beginning at an arbitrary position, checking that it lies
+ * within the source.
  *
- * @see parse_header
- *
- * @param[in,out] dst     Pointer to first byte in which to set data. Updated to first byte of following section.
- * @param[out]    start   Starting bit of next section. Range 0-7.
- * @param[in,out] dstSize Number of bytes free in dst. Updated to remaining number of bytes on success.
- * @param[in]     header  Header data from which to generate output.
+ * @param[out]    dst     Destination for parsed value.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte of following section.
+ * @param[in,out] start   Bit from which to start. Updated to bit of following section. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
+ * @param[in]     size    Number of bits to read. Range 1-64.
  *
  * @return {@link ERR_NO_ERR} if no error occurred.\n
- * 		   {@link ERR_NULL_PTR} if a parameter is null, or if value of dst is null.\n
- * 		   {@link ERR_INVALID_VALUE} if start or any member of header are out of accepted range.\n
- * 		   {@link ERR_INSUFFICIENT_SPACE} if function requires more than dstSize bytes to write data.\n
- * 		   Other errors as raised by {@link put_bits}.
+ *         {@link ERR_INSUFFICIENT_SPACE} if fewer than size bits remain.\n
+ *         Other errors as raised by {@link extract_bits}.
  */
-static HuffmanError build_header(uint8_t** dst,
-								 uint8_t* start,
-								 uint64_t* dstSize,
-								 HuffmanHeader* header) {
-	// Input validation
-	if (dst == NULL || *dst == NULL || start == NULL || dstSize == NULL || header == NULL) {
+static HuffmanError read_bits(uint64_t* dst,
+							  uint8_t** src,
+							  uint8_t* start,
+							  uint64_t* srcSize,
+							  uint8_t size) {
+	if (src == NULL || *src == NULL || start == NULL || srcSize == NULL) {
 		return ERR_NULL_PTR;
 	}
-	uint64_t maxWords = (((uint64_t)0x1) << header->wordSize);
-	if (header->wordSize < HUFFMAN_MIN_WORD_SIZE || header->wordSize > HUFFMAN_MAX_WORD_SIZE ||
-			header->uniqueWords > maxWords || header->padBits >= header->wordSize) {
-		return ERR_INVALID_VALUE;
-	}
-	// Ensure enough space is available
-	uint8_t log2wordSize = log2_ceil_u8(header->wordSize);
-	// Number of bits required to store header
-	uint8_t reqBits = HUFFMAN_WORD_SIZE_NUM_BITS + log2wordSize + header->wordSize;
-	uint8_t reqBytes = reqBits / 8;
-	if (*dstSize < reqBytes || (*dstSize == reqBytes && (reqBits % 8) > 0)) {
+	if (*srcSize < ((uint64_t) *start + size + 7) / 8) {
 		return ERR_INSUFFICIENT_SPACE;
 	}
-
 	HuffmanError err;
-	uint8_t* currDst = *dst;
-	uint8_t currBit = 0;
-	uint64_t newSize = *dstSize;
-
-	// word size
-	THROW_ERR(put_bits(&currDst, &currBit, &newSize, (uint64_t)header->wordSize, (uint8_t)HUFFMAN_WORD_SIZE_NUM_BITS))
-	// pad bits
-	THROW_ERR(put_bits(&currDst, &currBit, &newSize, (uint64_t)header->padBits, log2wordSize))
-	// unique words
-	THROW_ERR(put_bits(&currDst, &currBit, &newSize, header->uniqueWords - 1, header->wordSize))
-
-	// update after all successful
-	(*dst) = currDst;
-	(*start) = currBit;
-	(*dstSize) = newSize;
-
-	return err;
+	uint8_t* prev = *src;
+	THROW_ERR(extract_bits(dst, src, start, size))
+	*srcSize -= (uint64_t) (*src - prev);
+	return ERR_NO_ERR;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Parses a header from Huffman compressed data into a {@link HuffmanHeader}
- * struct. Does not include value map.
- *
- * @see build_header
+ * Writes a code of any length. Codes longer than 64 bits are written as
+ * leading zeros followed by the low 64 bits of val.
  *
- * @param[out]    header  Destination for parsed values.
- * @param[in,out] src     Pointer to byte from which to read. Updated to first byte of following section.
- * @param[out]    start   Starting bit of next section. Range 0-7.
- * @param[in,out] srcSize Length of src in bytes. Updated to remaining number of bytes on success.
+ * @param[in,out] dst     Pointer to first byte in which to set data. Updated to first byte of following section.
+ * @param[in,out] start   Bit from which to start. Updated to first bit of following section. Range 0-7.
+ * @param[in,out] dstSize Number of bytes free in dst. Updated to remaining number of bytes on success.
+ * @param[in]     val     Code value.
+ * @param[in]     size    Code length in bits.
  *
- * @return {@link ERR_NO_ERR} if no error occurred.\n
- *         {@link ERR_NULL_PTR} if a parameter is null, or if value of src is null.\n
- *         {@link ERR_INVALID_VALUE} if start or srcSize are out of accepted range.\n
- *         {@link ERR_INSUFFICIENT_SPACE} if header occupies more bytes than srcSize.\n
- *         {@link ERR_INVALID_DATA} if the provided data contains invalid values.\n
- *         Other errors as raised by {@link extract_bits}.
+ * @return Errors as raised by {@link put_bits}.
  */
-static HuffmanError parse_header(HuffmanHeader* header,
-								 uint8_t** src,
-								 uint8_t* start,
-								 uint64_t* srcSize) {
-	if (header == NULL || src == NULL || *src == NULL || start == NULL || srcSize == NULL) {
-		return ERR_NULL_PTR;
-	}
-	if (*srcSize < 2) { // require minimum 6 + 1 + 2 bits = 1 byte + 1 bit
-		return ERR_INVALID_VALUE;
-	}
-	uint64_t temp = 0;
-	uint8_t size;
-	uint8_t* tempPtr = *src;
-	uint8_t tempStart = 0;
-	uint64_t newSize = *srcSize;
+static HuffmanError put_code(uint8_t** dst,
+							 uint8_t* start,
+							 uint64_t* dstSize,
+							 uint64_t val,
+							 uint64_t size) {
 	HuffmanError err;
-
-	// parse wordSize
-	size = HUFFMAN_WORD_SIZE_NUM_BITS;
-	THROW_ERR(extract_bits(&temp, &tempPtr, &tempStart, size))
-
-	// invalid wordSize
-	if (temp < HUFFMAN_MIN_WORD_SIZE || temp > HUFFMAN_MAX_WORD_SIZE) {
-		return ERR_INVALID_DATA;
-	}
-
-	// apply offset to obtain actual value
-	header->wordSize = (uint8_t)temp;
-
-	// Ensure enough space is available
-	uint8_t log2wordSize = log2_ceil_u8(header->wordSize);
-	// Number of bits required to store header
-	uint8_t reqBits = HUFFMAN_WORD_SIZE_NUM_BITS + log2wordSize + header->wordSize;
-	uint8_t reqBytes = reqBits / 8;
-	if (*srcSize < reqBytes || (*srcSize == reqBytes && (reqBits % 8) > 0)) {
-		return ERR_INSUFFICIENT_SPACE;
+	uint64_t zeros;
+	while (size > 64) {
+		zeros = (size - 64 < 64) ? size - 64 : 64;
+		THROW_ERR(put_bits(dst, start, dstSize, 0, (uint8_t) zeros))
+		size -= zeros;
 	}
+	return put_bits(dst, start, dstSize, val, (uint8_t) size);
+}
 
-	// Parse padBits
-	size = log2_ceil_u8(header->wordSize);
-	THROW_ERR(extract_bits(&temp, &tempPtr, &tempStart, size))
-	// Ensure padBits in valid range
-	if (temp >= (uint64_t)header->wordSize) {
-		return ERR_INVALID_DATA;
+/**
+ * @ingroup HuffmanHelpers
+ * Writes a value as groups of 7 bits, least significant group first, with
+ * the high bit of each 8-bit group set if another group follows.
+ *
+ * @see read_varint
+ *
+ * @param[in,out] dst     Pointer to first byte in which to set data. Updated to first byte of following section.
+ * @param[in,out] start   Bit from which to start. Updated to first bit of following section. Range 0-7.
+ * @param[in,out] dstSize Number of bytes free in dst. Updated to remaining number of bytes on success.
+ * @param[in]     val     Value to be written.
+ *
+ * @return Errors as raised by {@link put_bits}.
+ */
+static HuffmanError put_varint(uint8_t** dst,
+							   uint8_t* start,
+							   uint64_t* dstSize,
+							   uint64_t val) {
+	HuffmanError err;
+	while (val >= 0x80) {
+		THROW_ERR(put_bits(dst, start, dstSize, 0x80 | (val & 0x7F), 8))
+		val >>= 7;
 	}
-	header->padBits = (uint8_t)temp;
-
-	// parse uniqueWords
-	size = header->wordSize;
-	THROW_ERR(extract_bits(&temp, &tempPtr, &tempStart, size))
-	header->uniqueWords = temp + 1;
-
-	// success, update val
-	(*src) = tempPtr;
-	(*start) = tempStart;
-	(*srcSize) -= reqBytes;
-
-	return ERR_NO_ERR;
+	return put_bits(dst, start, dstSize, val, 8);
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Obtains pointer to location of table value.
+ * Reads a value written by {@link put_varint}.
  *
- * @param[in] table Reference to table.
- * @param[in] idx   Index of value to be retrieved.
+ * @param[out]    dst     Destination for parsed value.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte of following section.
+ * @param[in,out] start   Bit from which to start. Updated to bit of following section. Range 0-7.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated on success.
  *
- * @return Pointer to value at provided index.
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INVALID_DATA} if value does not fit in 64 bits.\n
+ *         Other errors as raised by {@link read_bits}.
  */
-static inline uint64_t* get_table_value(uint64_t* table,
-										uint64_t idx) {
-	return &table[2 * idx];
+static HuffmanError read_varint(uint64_t* dst,
+								uint8_t** src,
+								uint8_t* start,
+								uint64_t* srcSize) {
+	HuffmanError err;
+	uint64_t group;
+	uint8_t shift = 0;
+	*dst = 0;
+	do {
+		if (shift > 63) {
+			return ERR_INVALID_DATA;
+		}
+		THROW_ERR(read_bits(&group, src, start, srcSize, 8))
+		if (shift == 63 && (group & 0x7E)) {
+			return ERR_INVALID_DATA;
+		}
+		*dst |= (group & 0x7F) << shift;
+		shift += 7;
+	} while (group & 0x80);
+	return ERR_NO_ERR;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Obtains pointer to location of table id.
+ * Determines the number of bytes written by {@link put_varint}.
  *
- * @param[in] table Reference to table.
- * @param[in] idx   Index of id to be retrieved.
+ * @param[in] val Value to be written.
  *
- * @return Pointer to id at provided index.
+ * @return Size in bytes.
  */
-static inline uint64_t* get_table_id(uint64_t* table,
-								 	 uint64_t idx) {
-	return &table[2 * idx + 1];
+static inline uint8_t get_varint_bytes(uint64_t val) {
+	uint8_t bytes = 1;
+	while (val >= 0x80) {
+		val >>= 7;
+		bytes++;
+	}
+	return bytes;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Hashing function for table used in {@link generate_table}.
+ * Determines how data of a given size is split into words.
  *
- * @param[in] val    Value to be hashed
- * @param[in] maxVal Maximum value (table size).
+ * @param[out] finalBits Number of data bits in last word, or 0 if last word
+ *                       is complete.
+ * @param[in]  srcSize   Size of data in bytes.
+ * @param[in]  wordSize  Word size used for compression.
  *
- * @return Hashing function result.
+ * @return Number of words including incomplete last word.
  */
-static inline uint64_t get_hash(uint64_t val,
-								uint64_t maxVal) {
-	// todo implement variable FNV with folding
-	return val % maxVal;
+static uint64_t get_word_count(uint8_t* finalBits,
+							   uint64_t srcSize,
+							   uint8_t wordSize) {
+	// Complicated formula to avoid int overflow, as in generate_table
+	*finalBits = (uint8_t) ((uint64_t) 8 * (srcSize % (uint64_t) wordSize)
+			% (uint64_t) wordSize);
+	return (srcSize / wordSize) * 8 +
+			((uint64_t) 8 * (srcSize % (uint64_t) wordSize) + wordSize - 1) / wordSize;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Searches hash table for entry that is empty or matches desired id.
- *
- * @param[out] dstIdx        Matching or unoccupied index.
- * @param[in]  table         Table to be searched.
- * @param[in]  searchId      Desired id.
- * @param[in]  assumeNoMatch If true, algorithm assumes table does not contain
- *							 matching id (for example, when resizing table).
+ * Reads complete words one at a time with {@link extract_bits}.
  *
- * @return {@link ERR_NO_ERR} if no error occurred.\n
- *		   {@link ERR_NULL_PTR} if dstIdx or table are null.
- *		   {@link ERR_INSUFFICIENT_SPACE} if table is full and no entry with
- *				matching value was found. Indicates a larger table is needed.
+ * @param[out] dst      Destination for words.
+ * @param[in]  src      Byte holding first word.
+ * @param[in]  start    Bit of src at which first word starts. Range 0-7.
+ * @param[in]  end      End of readable data.
+ * @param[in]  count    Number of words to read, all lying before end.
+ * @param[in]  wordSize Word size used for compression.
  */
-static HuffmanError search_table(uint64_t* dstIdx,
-								 HuffmanHashTable* table,
-								 uint64_t searchId,
-								 bool assumeNoMatch) {
-	if (dstIdx == NULL || table == NULL || table->table == NULL) {
-		return ERR_NULL_PTR;
+static void unpack_words_portable(uint64_t* dst,
+								  const uint8_t* src,
+								  uint8_t start,
+								  const uint8_t* end,
+								  uint64_t count,
+								  uint8_t wordSize) {
+	uint8_t* currPtr = (uint8_t*) src;
+	uint64_t i;
+	(void) end;
+	for (i = 0; i < count; i++) {
+		extract_bits(&dst[i], &currPtr, &start, wordSize);
 	}
+}
 
-	uint64_t* id, *val;
-	uint64_t curr = get_hash(searchId, table->size);
-	uint64_t last = (curr + (table->size - 1)) % table->size;
-
-	// todo analyze hash & step function performance
-	while (curr != last) {
-		// Check for empty
-		val = get_table_value(table->table, curr);
-		if (*val == 0) {
-			*dstIdx = curr;
-			return ERR_NO_ERR;
-		}
-
-		// Check for identical id
-		if (!assumeNoMatch) { // todo measure effect of skipping this step during resize
-			id = get_table_id(table->table, curr);
-			if (*id == searchId) {
-				*dstIdx = curr;
-				return ERR_NO_ERR;
-			}
-		}
-
-		// Not found, move to next index
-		curr = (curr + 1) % table->size; // todo consider different step functions
+/**
+ * @ingroup HuffmanHelpers
+ * Writes complete words one at a time with {@link put_bits}.
+ *
+ * @param[in,out] dst      Byte in which to write first word.
+ * @param[in]     start    Bit of dst at which first word starts. Range 0-7.
+ * @param[in]     end      End of writable space, which must hold all words.
+ * @param[in]     src      Words to be written.
+ * @param[in]     count    Number of words to write.
+ * @param[in]     wordSize Word size used for compression.
+ */
+static void pack_words_portable(uint8_t* dst,
+								uint8_t start,
+								uint8_t* end,
+								const uint64_t* src,
+								uint64_t count,
+								uint8_t wordSize) {
+	uint64_t dstSize = (uint64_t) (end - dst);
+	uint64_t i;
+	for (i = 0; i < count; i++) {
+		put_bits(&dst, &start, &dstSize, src[i], wordSize);
 	}
-	// Table full and id not found
-	return ERR_INSUFFICIENT_SPACE;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Attempts to resize a table to a new, larger size.
- *
- * @warning Must be able to allocate new table prior to releasing existing table.
+ * Replaces a window of words by its runs of equal words, in order.
  *
- * @param[in,out] table     Table to be resized. Updated with new table
- *							pointer & size if successful.
- * @param[in]     newSize   Maximum number of entries in resized table.
+ * @param[in,out] words   Window of words, replaced by the word of each run.
+ * @param[out]    lengths Length of each run.
+ * @param[in]     count   Number of words in window. Range 1-64.
  *
- * @return {@link ERR_NO_ERR} if no error occurred.\n
- *		   {@link ERR_NULL_PTR} if table is null or points to null.\n
- *		   {@link ERR_INVALID_VALUE} if sizes are 0 or new table size is less
- *				than existing table size.
- *		   {@link ERR_INSUFFICIENT_SPACE} if unable to allocate new table.
+ * @return Number of runs.
  */
-static HuffmanError resize_table(HuffmanHashTable* table, uint64_t newSize) {
-	if (table == NULL || table->table == NULL) {
-		return ERR_NULL_PTR;
-	}
-
-	if (table->size == 0 || newSize == 0 || newSize <= table->size) {
-		return ERR_INVALID_VALUE;
+static uint64_t split_runs_portable(uint64_t* words,
+									uint64_t* lengths,
+									uint64_t count) {
+	uint64_t runs = 0, j, length;
+	for (j = 0; j < count; j += length) {
+		for (length = 1; j + length < count && words[j + length] == words[j]; length++);
+		words[runs] = words[j];
+		lengths[runs++] = length;
 	}
+	return runs;
+}
 
-	// Init pointers and allocate
-	uint64_t* oldTable = table->table;
-	HuffmanHashTable newTable;
-	newTable.size = newSize;
-	newTable.table = (uint64_t*) malloc(2 * sizeof(uint64_t) * newSize);
-	if (!newTable.table) {
-		return ERR_INSUFFICIENT_SPACE;
+/**
+ * @ingroup HuffmanHelpers
+ * Looks up the word of each rank.
+ *
+ * @param[out] dst   Destination for words, which may be idx.
+ * @param[in]  words Words by rank.
+ * @param[in]  idx   Ranks to be looked up.
+ * @param[in]  count Number of ranks.
+ */
+static void gather_words_portable(uint64_t* dst,
+								  const uint64_t* words,
+								  const uint64_t* idx,
+								  uint64_t count) {
+	uint64_t i;
+	for (i = 0; i < count; i++) {
+		dst[i] = words[idx[i]];
 	}
-	memset(newTable.table, 0x00, 2 * sizeof(uint64_t) * newTable.size);
-
-	uint64_t currIdx, dstIdx;
-	uint64_t val, id;
-	uint64_t *dstVal, *dstId;
-	HuffmanError err;
-
-	for (currIdx = 0; currIdx < table->size; currIdx++) {
-		val = *get_table_value(oldTable, currIdx);
-
-		// Entry found
-		if (val) {
-			id = *get_table_id(oldTable, currIdx);
-
-			err = search_table(&dstIdx, &newTable, id, true);
-			if (err) {
-				// Should be unreachable
-				free(newTable.table);
-				return err;
-			}
+}
 
-			// Copy entry
-			dstVal = get_table_value(newTable.table, dstIdx);
-			dstId  = get_table_id(newTable.table, dstIdx);
-			*dstVal = val;
-			*dstId = id;
-		}
-	}
+/**
+ * @ingroup HuffmanHelpers
+ * Slicing-by-8 tables for CRC32C (Castagnoli, reflected polynomial
+ * {@link HUFFMAN_CRC32C_POLY}). Row 0 advances a CRC by one byte, row k by
+ * one byte followed by k zero bytes. Built with the kernels at startup.
+ */
+static uint32_t crc32cTable[8][256];
 
-	// Release and migrate pointer
-	free(oldTable);
-	table->table = newTable.table;
-	table->size = newTable.size;
-	return ERR_NO_ERR;
-}
+/**
+ * @ingroup HuffmanHelpers
+ * x^(2^n) modulo the CRC32C polynomial, for combining CRCs. Built with
+ * {@link crc32cTable}. x^(2^31) is x again, so the powers repeat with
+ * period 31.
+ */
+static uint32_t crc32cPowers[31];
 
 /**
  * @ingroup HuffmanHelpers
- * Adds a word to the table, or increments if already in table. Also handles
- * resizing table.
- *
- * @see generate_table
+ * Updates a CRC32C eight bytes at a time with {@link crc32cTable}. The CRC is
+ * neither inverted before nor after.
  *
- * @param[in,out] table    Table to be updated
- * @param[out]    numWords Number of words in table
- * @param[in]     word     Word to be added/incremented
- * @param[in]     maxSize  Maximum size of table
+ * @param[in] crc  CRC of preceding data.
+ * @param[in] src  Data to be added.
+ * @param[in] size Size of data in bytes.
  *
- * @return {@link ERR_NO_ERR} if no error occurred.\n
- *		   {@link ERR_NULL_PTR} if table or numWords are null.\n
- *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate
- *      		sufficient memory for table.\n
- *         {@link ERR_OVERFLOW} if more than {@link HUFFMAN_MAX_UINT64}
- *      		of the same word are found.\n
- *         Other errors as raised by {@link extract_bits}.
+ * @return CRC including data.
  */
-static HuffmanError add_to_table(HuffmanHashTable* table,
-								 uint64_t* numWords,
-								 uint64_t word,
-								 uint64_t maxSize) {
-	if (table == NULL || table->table == NULL || numWords == NULL) {
-		return ERR_NULL_PTR;
+static uint32_t crc32c_portable(uint32_t crc,
+								const uint8_t* src,
+								uint64_t size) {
+	uint32_t lo, hi;
+	for (; size >= 8; size -= 8, src += 8) {
+		lo = crc ^ ((uint32_t) src[0] | (uint32_t) src[1] << 8 |
+				(uint32_t) src[2] << 16 | (uint32_t) src[3] << 24);
+		hi = (uint32_t) src[4] | (uint32_t) src[5] << 8 |
+				(uint32_t) src[6] << 16 | (uint32_t) src[7] << 24;
+		crc = crc32cTable[7][lo & 0xFF] ^ crc32cTable[6][(lo >> 8) & 0xFF] ^
+				crc32cTable[5][(lo >> 16) & 0xFF] ^ crc32cTable[4][lo >> 24] ^
+				crc32cTable[3][hi & 0xFF] ^ crc32cTable[2][(hi >> 8) & 0xFF] ^
+				crc32cTable[1][(hi >> 16) & 0xFF] ^ crc32cTable[0][hi >> 24];
 	}
-
-	if (table->size == 0 || maxSize < table->size) {
-		return ERR_INVALID_VALUE;
+	for (; size > 0; size--, src++) {
+		crc = (crc >> 8) ^ crc32cTable[0][(crc ^ *src) & 0xFF];
 	}
+	return crc;
+}
 
-	HuffmanError err;
-	uint64_t idx;
-	uint64_t *dstVal, *dstId;
-
-	// Find in hash table
-	err = search_table(&idx, table, word, false);
+#ifdef HUFFMAN_X86_DISPATCH
+/**
+ * @ingroup HuffmanHelpers
+ * Reads complete words as {@link unpack_words_portable} does, loading 8 bytes
+ * per word while they lie before end.
+ */
+__attribute__((target("bmi2")))
+static void unpack_words_bmi2(uint64_t* dst,
+							  const uint8_t* src,
+							  uint8_t start,
+							  const uint8_t* end,
+							  uint64_t count,
+							  uint8_t wordSize) {
+	uint64_t pos = start, i = 0, val;
+	// Word must fit in 8 bytes from any starting bit
+	if (wordSize <= 57) {
+		for (; i < count && src + (pos >> 3) + 8 <= end; i++, pos += wordSize) {
+			memcpy(&val, src + (pos >> 3), sizeof(val));
+			val = __builtin_bswap64(val);
+			dst[i] = _bzhi_u64(val >> (64 - (pos & 7) - wordSize), wordSize);
+		}
+	}
+	unpack_words_portable(dst + i, src + (pos >> 3), (uint8_t) (pos & 7), end, count - i, wordSize);
+}
 
-	// Check for full table, resize if necessary
-	if (err == ERR_INSUFFICIENT_SPACE) {
-		if (table->size < maxSize) {
-			// Resize table
-			uint64_t newSize = (table->size * 2 <= maxSize) ? table->size * 2 : maxSize;
-			err = resize_table(table, newSize);
-			if (err) {
-				// Error occurred in resizing
-				return err;
-			}
+/**
+ * @ingroup HuffmanHelpers
+ * Writes complete words as {@link pack_words_portable} does, storing 8 bytes
+ * per word while they lie before end. Bytes following the words up to end
+ * may be cleared.
+ */
+__attribute__((target("bmi2")))
+static void pack_words_bmi2(uint8_t* dst,
+							uint8_t start,
+							uint8_t* end,
+							const uint64_t* src,
+							uint64_t count,
+							uint8_t wordSize) {
+	uint64_t acc, out, bits, bytes, i, b;
+	// Pending bits must fit in 8 bytes with another word
+	if (wordSize > 56) {
+		pack_words_portable(dst, start, end, src, count, wordSize);
+		return;
+	}
 
-			// Find in new hash table
-			err = search_table(&idx, table, word, false);
-			if (err) {
-				// Should be unreachable
-				return err;
-			}
+	// Keep bits preceding first word, left-aligned
+	acc = (uint64_t) (*dst & (0xFF ^ ((1 << (8 - start)) - 1))) << 56;
+	bits = start;
+	for (i = 0; i < count; i++) {
+		acc |= _bzhi_u64(src[i], wordSize) << (64 - bits - wordSize);
+		bits += wordSize;
+		bytes = bits >> 3;
+		if (dst + 8 <= end) {
+			out = __builtin_bswap64(acc);
+			memcpy(dst, &out, sizeof(out));
 		} else {
-			// Cannot resize table
-			return ERR_INSUFFICIENT_SPACE;
+			for (b = 0; b < bytes; b++) {
+				dst[b] = (uint8_t) (acc >> (56 - 8 * b));
+			}
 		}
-	} else if (err != ERR_NO_ERR) {
-		// Should be unreachable
-		return err;
+		dst += bytes;
+		acc <<= 8 * bytes;
+		bits &= 7;
 	}
-
-	// Add to table, check for value overflow
-	dstVal = get_table_value(table->table, idx);
-	dstId = get_table_id(table->table, idx);
-	if (*dstVal == HUFFMAN_MAX_UINT64) {
-		return ERR_OVERFLOW;
-	} else if (*dstVal == 0) {
-		if (*numWords == HUFFMAN_MAX_UINT64) {
-			return ERR_OVERFLOW;
-		}
-		(*numWords)++;
-		*dstId = word;
+	if (bits > 0) {
+		*dst = (uint8_t) (acc >> 56);
 	}
-	*dstVal = *dstVal + 1;
-
-	return ERR_NO_ERR;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Generates and populates hash table of word frequencies.
+ * Replaces a window of words by its runs as {@link split_runs_portable} does,
+ * given the positions of the last word of each run.
  *
- * @warning This allocates a table that must be freed later.
+ * @param[in,out] words   Window of words, replaced by the word of each run.
+ * @param[out]    lengths Length of each run.
+ * @param[in]     ends    Bit i set if word i is the last of its run.
  *
- * @param[out] hdr      Header populated with metadata.
- * @param[out] dst      Pointer to table. Table data must be freed by calling function.
- * @param[in]  src      Data to be converted.
- * @param[in]  srcSize  Size of data in bytes.
- * @param[in]  wordSize Word size used for compression.
+ * @return Number of runs.
+ */
+static inline uint64_t split_runs_at(uint64_t* words,
+									 uint64_t* lengths,
+									 uint64_t ends) {
+	uint64_t runs = 0, begin = 0, last;
+	while (ends) {
+		last = (uint64_t) __builtin_ctzll(ends);
+		words[runs] = words[last];
+		lengths[runs++] = last + 1 - begin;
+		begin = last + 1;
+		ends &= ends - 1;
+	}
+	return runs;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Finds which words of a window are the last of their run.
  *
- * @return {@link ERR_NO_ERR} if no error occurred.\n
- *         {@link ERR_NULL_PTR} if a parameter is null.\n
- *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
- *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate
- *      		sufficient memory for table.\n
- *         {@link ERR_OVERFLOW} if more than {@link HUFFMAN_MAX_UINT64}
- *      		of the same word are found.\n
- *         Other errors as raised by {@link extract_bits}.
+ * @param[in] same  Bit i set if word i equals word i + 1.
+ * @param[in] count Number of words in window. Range 1-64.
+ *
+ * @return Bit i set if word i is the last of its run.
  */
-static HuffmanError generate_table(HuffmanHeader* hdr,
-								   HuffmanHashTable* dst,
-								   uint8_t* src,
-								   uint64_t srcSize,
-								   uint8_t wordSize) {
-	if (hdr == NULL || dst == NULL || src == NULL) {
-		return ERR_NULL_PTR;
+static inline uint64_t get_run_ends(uint64_t same,
+									uint64_t count) {
+	return ~same & ((count < 64) ? (((uint64_t) 1) << count) - 1 : HUFFMAN_MAX_UINT64);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Replaces a window of words by its runs as {@link split_runs_portable} does,
+ * comparing 2 words at a time.
+ */
+__attribute__((target("sse4.2")))
+static uint64_t split_runs_sse42(uint64_t* words,
+								 uint64_t* lengths,
+								 uint64_t count) {
+	uint64_t same = 0, k = 0;
+	__m128i a, b;
+	for (; k + 2 < count; k += 2) {
+		a = _mm_loadu_si128((const __m128i*) (words + k));
+		b = _mm_loadu_si128((const __m128i*) (words + k + 1));
+		same |= (uint64_t) _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(a, b))) << k;
 	}
+	for (; k + 1 < count; k++) {
+		same |= (uint64_t) (words[k] == words[k + 1]) << k;
+	}
+	return split_runs_at(words, lengths, get_run_ends(same, count));
+}
 
-	if (srcSize < 1 ||
-			wordSize < HUFFMAN_MIN_WORD_SIZE ||
-			wordSize > HUFFMAN_MAX_WORD_SIZE) {
-		return ERR_INVALID_VALUE;
+/**
+ * @ingroup HuffmanHelpers
+ * Replaces a window of words by its runs as {@link split_runs_portable} does,
+ * comparing 4 words at a time.
+ */
+__attribute__((target("avx2")))
+static uint64_t split_runs_avx2(uint64_t* words,
+								uint64_t* lengths,
+								uint64_t count) {
+	uint64_t same = 0, k = 0;
+	__m256i a, b;
+	for (; k + 4 < count; k += 4) {
+		a = _mm256_loadu_si256((const __m256i*) (words + k));
+		b = _mm256_loadu_si256((const __m256i*) (words + k + 1));
+		same |= (uint64_t) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b))) << k;
+	}
+	for (; k + 1 < count; k++) {
+		same |= (uint64_t) (words[k] == words[k + 1]) << k;
 	}
+	return split_runs_at(words, lengths, get_run_ends(same, count));
+}
 
-	HuffmanHashTable table;
-	uint8_t* currPtr = src;
-	uint8_t  currBit = 0;
-	uint8_t* maxPtr;
-	uint64_t numWords = 0;
-	uint64_t currWord;
-	HuffmanError err;
+/**
+ * @ingroup HuffmanHelpers
+ * Replaces a window of words by its runs as {@link split_runs_portable} does,
+ * comparing 8 words at a time.
+ */
+__attribute__((target("avx512f")))
+static uint64_t split_runs_avx512(uint64_t* words,
+								  uint64_t* lengths,
+								  uint64_t count) {
+	uint64_t same = 0, k = 0;
+	__m512i a, b;
+	for (; k + 8 < count; k += 8) {
+		a = _mm512_loadu_si512((const void*) (words + k));
+		b = _mm512_loadu_si512((const void*) (words + k + 1));
+		same |= (uint64_t) _mm512_cmpeq_epi64_mask(a, b) << k;
+	}
+	for (; k + 1 < count; k++) {
+		same |= (uint64_t) (words[k] == words[k + 1]) << k;
+	}
+	return split_runs_at(words, lengths, get_run_ends(same, count));
+}
 
-	// Determine how many bits in last word (complicated formula to avoid int overflow)
-	uint8_t finalBits = (uint8_t) ((uint64_t) 8 * (srcSize % (uint64_t) wordSize)
-			% (uint64_t) wordSize);
-	uint8_t padBits = wordSize - finalBits;
+/**
+ * @ingroup HuffmanHelpers
+ * Looks up the word of each rank as {@link gather_words_portable} does,
+ * 4 ranks at a time.
+ */
+__attribute__((target("avx2")))
+static void gather_words_avx2(uint64_t* dst,
+							  const uint64_t* words,
+							  const uint64_t* idx,
+							  uint64_t count) {
+	uint64_t i = 0;
+	__m256i ranks;
+	for (; i + 4 <= count; i += 4) {
+		ranks = _mm256_loadu_si256((const __m256i*) (idx + i));
+		_mm256_storeu_si256((__m256i*) (dst + i),
+				_mm256_i64gather_epi64((const long long*) words, ranks, 8));
+	}
+	gather_words_portable(dst + i, words, idx + i, count - i);
+}
 
-	// Set maximum pointer
-	if (finalBits == 0) {
-		maxPtr = &src[srcSize];
-	} else {
-		maxPtr = &src[srcSize - ((finalBits + 7) / 8)];
+/**
+ * @ingroup HuffmanHelpers
+ * Looks up the word of each rank as {@link gather_words_portable} does,
+ * 8 ranks at a time.
+ */
+__attribute__((target("avx512f")))
+static void gather_words_avx512(uint64_t* dst,
+								const uint64_t* words,
+								const uint64_t* idx,
+								uint64_t count) {
+	uint64_t i = 0;
+	__m512i ranks;
+	for (; i + 8 <= count; i += 8) {
+		ranks = _mm512_loadu_si512((const void*) (idx + i));
+		_mm512_storeu_si512((void*) (dst + i), _mm512_i64gather_epi64(ranks, words, 8));
 	}
+	gather_words_portable(dst + i, words, idx + i, count - i);
+}
 
-	// Max size range 16 to 16 * 2^59 bytes
-	// NOTE: fails if wordSize = 60 and 2^60 unique words found
-	uint64_t maxSize = (wordSize < 59) ? ((uint64_t)1) << wordSize : ((uint64_t)1) << 59;
+/**
+ * @ingroup HuffmanHelpers
+ * Updates a CRC32C as {@link crc32c_portable} does with the SSE4.2 crc32
+ * instruction.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc,
+							 const uint8_t* src,
+							 uint64_t size) {
+	uint64_t state = crc, block;
+	for (; size >= 8; size -= 8, src += 8) {
+		memcpy(&block, src, 8);
+		state = _mm_crc32_u64(state, block);
+	}
+	crc = (uint32_t) state;
+	for (; size > 0; size--, src++) {
+		crc = _mm_crc32_u8(crc, *src);
+	}
+	return crc;
+}
+#endif
 
-	// Table initially 1/256th to all of max size, depending on word size
-	table.size = 1 << (wordSize - wordSize / 4);
+/**
+ * @ingroup HuffmanHelpers
+ * Kernels bound to the best implementation for the CPU's features.
+ *
+ * @see huffman_set_cpu_features
+ */
+typedef struct HuffmanKernels_struct {
+	/**
+	 * Bit-unpacks words, see {@link unpack_words_portable}.
+	 */
+	void (*unpack)(uint64_t*, const uint8_t*, uint8_t, const uint8_t*, uint64_t, uint8_t);
+	/**
+	 * Bit-packs words, see {@link pack_words_portable}.
+	 */
+	void (*pack)(uint8_t*, uint8_t, uint8_t*, const uint64_t*, uint64_t, uint8_t);
+	/**
+	 * Splits a window into runs while counting words, see
+	 * {@link split_runs_portable}.
+	 */
+	uint64_t (*splitRuns)(uint64_t*, uint64_t*, uint64_t);
+	/**
+	 * Looks up decoded words by rank, see {@link gather_words_portable}.
+	 */
+	void (*gather)(uint64_t*, const uint64_t*, const uint64_t*, uint64_t);
+	/**
+	 * Updates a CRC32C, see {@link crc32c_portable}.
+	 */
+	uint32_t (*crc32c)(uint32_t, const uint8_t*, uint64_t);
+} HuffmanKernels;
 
-	// Initialize table
-	table.table = (uint64_t*) malloc(2 * sizeof(uint64_t) * table.size);
-	if (!table.table) {
-		return ERR_INSUFFICIENT_SPACE;
-	}
-	memset(table.table, 0x0, 2 * sizeof(uint64_t) * table.size);
+/**
+ * @ingroup HuffmanHelpers
+ * Kernels currently in use, portable until bound at startup.
+ */
+static HuffmanKernels kernels = {
+	unpack_words_portable,
+	pack_words_portable,
+	split_runs_portable,
+	gather_words_portable,
+	crc32c_portable
+};
 
-	// Parse all complete words in file
-	while (currPtr != maxPtr || (finalBits > 0 && currBit != (64 - finalBits) % 8)) {
-		// Get next word
-		err = extract_bits(&currWord, &currPtr, &currBit, wordSize);
-		if (err != ERR_NO_ERR) {
-			free(table.table);
-			return err;
-		}
+/**
+ * @ingroup HuffmanHelpers
+ * CPU features of current kernels.
+ */
+static uint32_t cpuFeatures = 0;
 
-		err = add_to_table(&table, &numWords, currWord, maxSize);
-		if (err) {
-			free(table.table);
-			return err;
+/**
+ * @ingroup HuffmanHelpers
+ * Multiplies two polynomials modulo the CRC32C polynomial, in the reflected
+ * bit order of CRCs.
+ *
+ * @param[in] a First factor. Must be nonzero.
+ * @param[in] b Second factor.
+ *
+ * @return Product modulo polynomial.
+ */
+static uint32_t crc32c_multiply(uint32_t a,
+								uint32_t b) {
+	uint32_t m = (uint32_t) 1 << 31;
+	uint32_t p = 0;
+	while (true) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0) {
+				break;
+			}
 		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ HUFFMAN_CRC32C_POLY : b >> 1;
 	}
+	return p;
+}
 
-	// Handle incomplete word & padding
-	if (finalBits != 0) {
-		uint64_t highIdx, lowIdx;
-		uint64_t *highVal, *lowVal;
-		uint64_t *id;
-		uint64_t highWord;
-		bool skipLow = false, skipHigh = false;
-
-		// Get next word
-		err = extract_bits(&currWord, &currPtr, &currBit, finalBits);
-		if (err != ERR_NO_ERR) {
-			free(table.table);
-			return err;
+/**
+ * @ingroup HuffmanHelpers
+ * Builds {@link crc32cTable} and {@link crc32cPowers}.
+ */
+static void init_crc32c_tables(void) {
+	uint32_t crc, i, k;
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (k = 0; k < 8; k++) {
+			crc = (crc & 1) ? (crc >> 1) ^ HUFFMAN_CRC32C_POLY : crc >> 1;
 		}
-		currWord = currWord << padBits;
-
-		// Find index if padding with 0's
-		err = search_table(&lowIdx, &table, currWord, false);
-		if (err) { // Full table & not in table
+		crc32cTable[0][i] = crc;
+	}
+	for (i = 0; i < 256; i++) {
+		for (k = 1; k < 8; k++) {
+			crc32cTable[k][i] = (crc32cTable[k - 1][i] >> 8) ^
+					crc32cTable[0][crc32cTable[k - 1][i] & 0xFF];
+		}
+	}
+	// x^1, then repeated squaring
+	crc32cPowers[0] = (uint32_t) 1 << 30;
+	for (i = 1; i < 31; i++) {
+		crc32cPowers[i] = crc32c_multiply(crc32cPowers[i - 1], crc32cPowers[i - 1]);
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines which CPU features with kernels are supported.
+ *
+ * @return Supported features, any of {@link HUFFMAN_CPU_SSE42},
+ *         {@link HUFFMAN_CPU_AVX2}, {@link HUFFMAN_CPU_AVX512} and
+ *         {@link HUFFMAN_CPU_BMI2}.
+ */
+static uint32_t detect_cpu_features(void) {
+	uint32_t features = 0;
+#ifdef HUFFMAN_X86_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2")) {
+		features |= HUFFMAN_CPU_SSE42;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		features |= HUFFMAN_CPU_AVX2;
+	}
+	if (__builtin_cpu_supports("avx512f")) {
+		features |= HUFFMAN_CPU_AVX512;
+	}
+	if (__builtin_cpu_supports("bmi2")) {
+		features |= HUFFMAN_CPU_BMI2;
+	}
+#endif
+	return features;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Parses a list of CPU features as held by {@link HUFFMAN_CPU_ENV}. Unknown
+ * names are ignored.
+ *
+ * @param[in] list Comma-separated feature names.
+ *
+ * @return Features named in list.
+ */
+static uint32_t parse_cpu_features(const char* list) {
+	static const char* const names[] = {"sse4.2", "avx2", "avx512", "bmi2"};
+	static const uint32_t flags[] = {HUFFMAN_CPU_SSE42, HUFFMAN_CPU_AVX2,
+			HUFFMAN_CPU_AVX512, HUFFMAN_CPU_BMI2};
+	uint32_t features = 0;
+	size_t length, i;
+	while (*list) {
+		length = strcspn(list, ",");
+		for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+			if (length == strlen(names[i]) && strncmp(list, names[i], length) == 0) {
+				features |= flags[i];
+			}
+		}
+		list += length;
+		if (*list == ',') {
+			list++;
+		}
+	}
+	return features;
+}
+
+#if defined(__GNUC__)
+/**
+ * @ingroup HuffmanHelpers
+ * Binds kernels at startup to the CPU's features, limited by
+ * {@link HUFFMAN_CPU_ENV} if set.
+ */
+__attribute__((constructor))
+static void init_cpu_features(void) {
+	const char* env = getenv(HUFFMAN_CPU_ENV);
+	huffman_set_cpu_features(env ? parse_cpu_features(env) : HUFFMAN_CPU_SSE42 |
+			HUFFMAN_CPU_AVX2 | HUFFMAN_CPU_AVX512 | HUFFMAN_CPU_BMI2);
+}
+#endif
+
+/**
+ * Gets the CPU features used by the bit-unpack, bit-pack, histogram, decode
+ * and checksum kernels.
+ *
+ * @return Features in use, any of {@link HUFFMAN_CPU_SSE42},
+ *         {@link HUFFMAN_CPU_AVX2}, {@link HUFFMAN_CPU_AVX512} and
+ *         {@link HUFFMAN_CPU_BMI2}.
+ */
+uint32_t huffman_get_cpu_features(void) {
+	return cpuFeatures;
+}
+
+/**
+ * Binds the bit-unpack, bit-pack, histogram, decode and checksum kernels to
+ * the best implementation using only the given CPU features, falling back to
+ * portable code. Features the CPU lacks are ignored. Kernels are bound at
+ * startup to every supported feature, limited by {@link HUFFMAN_CPU_ENV} if
+ * set. All kernels produce identical results.
+ *
+ * @warning Not thread-safe. Must not be called while other threads use the
+ *          library.
+ *
+ * @param[in] features Features allowed, any of {@link HUFFMAN_CPU_SSE42},
+ *                     {@link HUFFMAN_CPU_AVX2}, {@link HUFFMAN_CPU_AVX512} and
+ *                     {@link HUFFMAN_CPU_BMI2}, or 0 for portable code.
+ *
+ * @return Features in use.
+ */
+uint32_t huffman_set_cpu_features(uint32_t features) {
+	features &= detect_cpu_features();
+	init_crc32c_tables();
+	kernels.unpack = unpack_words_portable;
+	kernels.pack = pack_words_portable;
+	kernels.splitRuns = split_runs_portable;
+	kernels.gather = gather_words_portable;
+	kernels.crc32c = crc32c_portable;
+#ifdef HUFFMAN_X86_DISPATCH
+	if (features & HUFFMAN_CPU_BMI2) {
+		kernels.unpack = unpack_words_bmi2;
+		kernels.pack = pack_words_bmi2;
+	}
+	if (features & HUFFMAN_CPU_AVX512) {
+		kernels.splitRuns = split_runs_avx512;
+		kernels.gather = gather_words_avx512;
+	} else if (features & HUFFMAN_CPU_AVX2) {
+		kernels.splitRuns = split_runs_avx2;
+		kernels.gather = gather_words_avx2;
+	} else if (features & HUFFMAN_CPU_SSE42) {
+		kernels.splitRuns = split_runs_sse42;
+	}
+	if (features & HUFFMAN_CPU_SSE42) {
+		kernels.crc32c = crc32c_sse42;
+	}
+#endif
+	cpuFeatures = features;
+	return features;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Reads complete words with the bound kernel.
+ *
+ * @param[out]    dst      Destination for words.
+ * @param[in,out] src      Byte holding first word. Updated to byte following words.
+ * @param[in,out] start    Bit of src at which first word starts. Updated to bit following words. Range 0-7.
+ * @param[in]     end      End of readable data.
+ * @param[in]     count    Number of words to read.
+ * @param[in]     wordSize Word size used for compression.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if the words do not lie before end.
+ */
+static HuffmanError unpack_words(uint64_t* dst,
+								 uint8_t** src,
+								 uint8_t* start,
+								 const uint8_t* end,
+								 uint64_t count,
+								 uint8_t wordSize) {
+	uint64_t bits = *start + count * wordSize;
+	if ((bits + 7) / 8 > (uint64_t) (end - *src)) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	kernels.unpack(dst, *src, *start, end, count, wordSize);
+	*src += bits / 8;
+	*start = (uint8_t) (bits % 8);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Writes complete words with the bound kernel.
+ *
+ * @param[in,out] dst      Byte in which to write first word. Updated to byte following words.
+ * @param[in,out] start    Bit of dst at which first word starts. Updated to bit following words. Range 0-7.
+ * @param[in,out] dstSize  Number of bytes free in dst. Updated to remaining number of bytes on success.
+ * @param[in]     src      Words to be written.
+ * @param[in]     count    Number of words to write.
+ * @param[in]     wordSize Word size used for compression.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if the words do not fit in dst.
+ */
+static HuffmanError pack_words(uint8_t** dst,
+							   uint8_t* start,
+							   uint64_t* dstSize,
+							   const uint64_t* src,
+							   uint64_t count,
+							   uint8_t wordSize) {
+	uint64_t bits = *start + count * wordSize;
+	if ((bits + 7) / 8 > *dstSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	if (count > 0) {
+		kernels.pack(*dst, *start, *dst + *dstSize, src, count, wordSize);
+	}
+	*dst += bits / 8;
+	*start = (uint8_t) (bits % 8);
+	*dstSize -= bits / 8;
+	return ERR_NO_ERR;
+}
+
+/**
+ * Updates a CRC32C (Castagnoli) with the bound checksum kernel. The CRC is
+ * inverted before and after, so 0 starts a checksum and the result of one
+ * call may be passed to the next to continue it.
+ *
+ * @param[in] crc     CRC of preceding data, or 0.
+ * @param[in] src     Data to be added.
+ * @param[in] srcSize Size of data in bytes.
+ *
+ * @return CRC including data.
+ */
+uint32_t huffman_crc32c(uint32_t crc,
+						const uint8_t* src,
+						uint64_t srcSize) {
+	return ~kernels.crc32c(~crc, src, srcSize);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Combines the CRC32C of two consecutive pieces of data without reading
+ * them again.
+ *
+ * @param[in] crcA  CRC of first piece, from {@link huffman_crc32c}.
+ * @param[in] crcB  CRC of second piece, from {@link huffman_crc32c}.
+ * @param[in] sizeB Size of second piece in bytes.
+ *
+ * @return CRC of both pieces.
+ */
+static uint32_t crc32c_combine(uint32_t crcA,
+							   uint32_t crcB,
+							   uint64_t sizeB) {
+	// Shift crcA past sizeB bytes: multiply by x^(8 * sizeB)
+	uint32_t shift = (uint32_t) 1 << 31;
+	uint8_t k = 3;
+	for (; sizeB > 0; sizeB >>= 1, k++) {
+		if (sizeB & 1) {
+			shift = crc32c_multiply(crc32cPowers[k % 31], shift);
+		}
+	}
+	return crc32c_multiply(shift, crcA) ^ crcB;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds the bytes between a checksum position and a new position to a
+ * CRC32C, then moves the checksum position. Called by coding loops on data
+ * they have just read or written, so checksums reuse data in cache.
+ *
+ * @param[in,out] crc    CRC to be updated, or null to skip.
+ * @param[in,out] crcPtr First byte not yet in crc. Updated to end.
+ * @param[in]     end    Byte following data to be added.
+ */
+static inline void update_crc(uint32_t* crc,
+							  const uint8_t** crcPtr,
+							  const uint8_t* end) {
+	if (crc && end > *crcPtr) {
+		*crc = huffman_crc32c(*crc, *crcPtr, (uint64_t) (end - *crcPtr));
+		*crcPtr = end;
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Writes a CRC32C from the next byte boundary,
+ * {@link HUFFMAN_CHECKSUM_BYTES} bytes least significant first.
+ *
+ * @param[in,out] dst     Pointer to byte in which to set data. Updated to first byte following checksum.
+ * @param[in,out] start   Bit from which to start. Updated to 0.
+ * @param[in,out] dstSize Number of bytes free in dst. Updated to remaining number of bytes.
+ * @param[in]     crc     Checksum to be written.
+ *
+ * @return Errors as raised by {@link put_bits}.
+ */
+static HuffmanError put_checksum(uint8_t** dst,
+								 uint8_t* start,
+								 uint64_t* dstSize,
+								 uint32_t crc) {
+	HuffmanError err;
+	if (*start > 0) {
+		THROW_ERR(put_bits(dst, start, dstSize, 0, 8 - *start))
+	}
+	for (uint8_t i = 0; i < HUFFMAN_CHECKSUM_BYTES; i++) {
+		THROW_ERR(put_bits(dst, start, dstSize, (crc >> (8 * i)) & 0xFF, 8))
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Reads a CRC32C stored as 4 bytes little-endian from a byte boundary.
+ *
+ * @param[in] src First byte of CRC32C.
+ *
+ * @return CRC32C read.
+ */
+static inline uint32_t get_checksum(const uint8_t* src) {
+	uint32_t crc = 0;
+	for (uint8_t i = 0; i < HUFFMAN_CHECKSUM_BYTES; i++) {
+		crc |= (uint32_t) src[i] << (8 * i);
+	}
+	return crc;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Reads a CRC32C written by {@link put_checksum}.
+ *
+ * @param[out]    crc     Checksum read.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte following checksum.
+ * @param[in,out] start   Bit from which to start. Updated to 0.
+ * @param[in,out] srcSize Number of bytes remaining in src. Updated to remaining number of bytes.
+ *
+ * @return Errors as raised by {@link read_bits}.
+ */
+static HuffmanError read_checksum(uint32_t* crc,
+								  uint8_t** src,
+								  uint8_t* start,
+								  uint64_t* srcSize) {
+	HuffmanError err;
+	uint64_t val;
+	if (*start > 0) {
+		THROW_ERR(read_bits(&val, src, start, srcSize, 8 - *start))
+	}
+	*crc = 0;
+	for (uint8_t i = 0; i < HUFFMAN_CHECKSUM_BYTES; i++) {
+		THROW_ERR(read_bits(&val, src, start, srcSize, 8))
+		*crc |= (uint32_t) val << (8 * i);
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Constructs a header for a Huffman compressed data. Does not include
+ * value map. File header size is
+ * {@link HUFFMAN_WORD_SIZE_NUM_BITS} + ceil(log2(wordSize)) + wordSize bits.
+ *
+ * @see parse_header
+ *
+ * @param[in,out] dst     Pointer to first byte in which to set data. Updated to first byte of following section.
+ * @param[out]    start   Starting bit of next section. Range 0-7.
+ * @param[in,out] dstSize Number of bytes free in dst. Updated to remaining number of bytes on success.
+ * @param[in]     header  Header data from which to generate output.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ * 		   {@link ERR_NULL_PTR} if a parameter is null, or if value of dst is null.\n
+ * 		   {@link ERR_INVALID_VALUE} if start or any member of header are out of accepted range.\n
+ * 		   {@link ERR_INSUFFICIENT_SPACE} if function requires more than dstSize bytes to write data.\n
+ * 		   Other errors as raised by {@link put_bits}.
+ */
+static HuffmanError build_header(uint8_t** dst,
+								 uint8_t* start,
+								 uint64_t* dstSize,
+								 HuffmanHeader* header) {
+	// Input validation
+	if (dst == NULL || *dst == NULL || start == NULL || dstSize == NULL || header == NULL) {
+		return ERR_NULL_PTR;
+	}
+	uint64_t maxWords = (((uint64_t)0x1) << header->wordSize);
+	if (header->wordSize < HUFFMAN_MIN_WORD_SIZE || header->wordSize > HUFFMAN_MAX_WORD_SIZE ||
+			header->uniqueWords > maxWords || header->padBits >= header->wordSize) {
+		return ERR_INVALID_VALUE;
+	}
+	// Ensure enough space is available
+	uint8_t log2wordSize = log2_ceil_u8(header->wordSize);
+	// Number of bits required to store header
+	uint8_t reqBits = HUFFMAN_WORD_SIZE_NUM_BITS + log2wordSize + header->wordSize;
+	uint8_t reqBytes = reqBits / 8;
+	if (*dstSize < reqBytes || (*dstSize == reqBytes && (reqBits % 8) > 0)) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+
+	HuffmanError err;
+	uint8_t* currDst = *dst;
+	uint8_t currBit = 0;
+	uint64_t newSize = *dstSize;
+
+	// word size
+	THROW_ERR(put_bits(&currDst, &currBit, &newSize, (uint64_t)header->wordSize, (uint8_t)HUFFMAN_WORD_SIZE_NUM_BITS))
+	// pad bits
+	THROW_ERR(put_bits(&currDst, &currBit, &newSize, (uint64_t)header->padBits, log2wordSize))
+	// unique words
+	THROW_ERR(put_bits(&currDst, &currBit, &newSize, header->uniqueWords - 1, header->wordSize))
+
+	// update after all successful
+	(*dst) = currDst;
+	(*start) = currBit;
+	(*dstSize) = newSize;
+
+	return err;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Parses a header from Huffman compressed data into a {@link HuffmanHeader}
+ * struct. Does not include value map.
+ *
+ * @see build_header
+ *
+ * @param[out]    header  Destination for parsed values.
+ * @param[in,out] src     Pointer to byte from which to read. Updated to first byte of following section.
+ * @param[out]    start   Starting bit of next section. Range 0-7.
+ * @param[in,out] srcSize Length of src in bytes. Updated to remaining number of bytes on success.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null, or if value of src is null.\n
+ *         {@link ERR_INVALID_VALUE} if start or srcSize are out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if header occupies more bytes than srcSize.\n
+ *         {@link ERR_INVALID_DATA} if the provided data contains invalid values.\n
+ *         Other errors as raised by {@link extract_bits}.
+ */
+static HuffmanError parse_header(HuffmanHeader* header,
+								 uint8_t** src,
+								 uint8_t* start,
+								 uint64_t* srcSize) {
+	if (header == NULL || src == NULL || *src == NULL || start == NULL || srcSize == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (*srcSize < 2) { // require minimum 6 + 1 + 2 bits = 1 byte + 1 bit
+		return ERR_INVALID_VALUE;
+	}
+	uint64_t temp = 0;
+	uint8_t size;
+	uint8_t* tempPtr = *src;
+	uint8_t tempStart = 0;
+	uint64_t newSize = *srcSize;
+	HuffmanError err;
+
+	// parse wordSize
+	size = HUFFMAN_WORD_SIZE_NUM_BITS;
+	THROW_ERR(extract_bits(&temp, &tempPtr, &tempStart, size))
+
+	// invalid wordSize
+	if (temp < HUFFMAN_MIN_WORD_SIZE || temp > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_DATA;
+	}
+
+	// apply offset to obtain actual value
+	header->wordSize = (uint8_t)temp;
+
+	// Ensure enough space is available
+	uint8_t log2wordSize = log2_ceil_u8(header->wordSize);
+	// Number of bits required to store header
+	uint8_t reqBits = HUFFMAN_WORD_SIZE_NUM_BITS + log2wordSize + header->wordSize;
+	uint8_t reqBytes = reqBits / 8;
+	if (*srcSize < reqBytes || (*srcSize == reqBytes && (reqBits % 8) > 0)) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+
+	// Parse padBits
+	size = log2_ceil_u8(header->wordSize);
+	THROW_ERR(extract_bits(&temp, &tempPtr, &tempStart, size))
+	// Ensure padBits in valid range
+	if (temp >= (uint64_t)header->wordSize) {
+		return ERR_INVALID_DATA;
+	}
+	header->padBits = (uint8_t)temp;
+
+	// parse uniqueWords
+	size = header->wordSize;
+	THROW_ERR(extract_bits(&temp, &tempPtr, &tempStart, size))
+	header->uniqueWords = temp + 1;
+
+	// success, update val
+	(*src) = tempPtr;
+	(*start) = tempStart;
+	(*srcSize) -= reqBytes;
+
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Minimum alignment of tables, in bytes.
+ */
+#define HUFFMAN_ARENA_ALIGN 16
+
+/**
+ * @ingroup HuffmanHelpers
+ * Trailer following each overflow block of a {@link HuffmanContext}. Placed
+ * after the block contents so the contents keep their requested alignment.
+ */
+typedef struct HuffmanOverflowBlock_struct {
+	/**
+	 * Next most recently allocated overflow block.
+	 */
+	struct HuffmanOverflowBlock_struct* next;
+	/**
+	 * Size of block contents in bytes.
+	 */
+	uint64_t size;
+	/**
+	 * Bytes counted in {@link HuffmanContext#overflowBytes} for block,
+	 * including the alignment padding it would need in the arena.
+	 */
+	uint64_t reserve;
+	/**
+	 * Value of {@link HuffmanContext#numAllocs} when block was allocated.
+	 */
+	uint64_t seq;
+} HuffmanOverflowBlock;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Arena state saved on entry to a public function so that everything it
+ * allocates can be released on return.
+ */
+typedef struct HuffmanContextMark_struct {
+	/**
+	 * Value of {@link HuffmanContext#arenaUsed} on entry.
+	 */
+	uint64_t arenaUsed;
+	/**
+	 * Value of {@link HuffmanContext#padOffset} on entry.
+	 */
+	uint64_t padOffset;
+	/**
+	 * Value of {@link HuffmanContext#numAllocs} on entry. Overflow blocks
+	 * allocated since are released on return.
+	 */
+	uint64_t numAllocs;
+} HuffmanContextMark;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Default {@link alloc_fcn}. Honours alignments above
+ * {@link HUFFMAN_ARENA_ALIGN} where posix_memalign is available.
+ */
+static void* default_alloc(uint64_t size,
+						   uint64_t align,
+						   void* user) {
+	(void) user;
+#if defined(__unix__) || defined(__APPLE__)
+	if (align > HUFFMAN_ARENA_ALIGN) {
+		void* ptr;
+		if (posix_memalign(&ptr, (size_t) align, (size_t) size) != 0) {
+			return NULL;
+		}
+		return ptr;
+	}
+#else
+	(void) align;
+#endif
+	return malloc((size_t) size);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Default {@link free_fcn}.
+ */
+static void default_free(void* ptr,
+						 uint64_t size,
+						 void* user) {
+	(void) size;
+	(void) user;
+	free(ptr);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Default {@link realloc_fcn}. Falls back to allocate and copy when realloc
+ * cannot guarantee the requested alignment.
+ */
+static void* default_realloc(void* ptr,
+							 uint64_t oldSize,
+							 uint64_t newSize,
+							 uint64_t align,
+							 void* user) {
+	if (align <= HUFFMAN_ARENA_ALIGN) {
+		return realloc(ptr, (size_t) newSize);
+	}
+	void* newPtr = default_alloc(newSize, align, user);
+	if (newPtr) {
+		memcpy(newPtr, ptr, (size_t) ((oldSize < newSize) ? oldSize : newSize));
+		default_free(ptr, oldSize, user);
+	}
+	return newPtr;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocator used when no context is provided, and by default for contexts.
+ */
+static const HuffmanAllocator defaultAllocator = {
+	default_alloc, default_realloc, default_free, NULL
+};
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines alignment requested for an allocation.
+ *
+ * @param[in] bytes Size of allocation in bytes.
+ *
+ * @return {@link HUFFMAN_HUGE_PAGE_SIZE} for allocations of at least that
+ *         size, otherwise {@link HUFFMAN_ARENA_ALIGN}.
+ */
+static inline uint64_t alloc_align(uint64_t bytes) {
+	return (bytes >= HUFFMAN_HUGE_PAGE_SIZE) ? HUFFMAN_HUGE_PAGE_SIZE : HUFFMAN_ARENA_ALIGN;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Obtains the allocator of a context. Contexts that were zeroed rather than
+ * initialized use the default allocator.
+ *
+ * @param[in] ctx Context to be queried.
+ *
+ * @return Allocator of context.
+ */
+static inline const HuffmanAllocator* context_allocator(const HuffmanContext* ctx) {
+	return (ctx->allocator.allocate != NULL) ? &ctx->allocator : &defaultAllocator;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Grows the arena of an empty context to the largest demand seen so far.
+ * Memory is left as is if allocation fails.
+ *
+ * @param[in,out] ctx Context to be updated.
+ */
+static void context_grow(HuffmanContext* ctx) {
+	if (ctx->arenaUsed != 0 || ctx->overflow != NULL ||
+			ctx->arenaPeak <= ctx->arenaSize) {
+		return;
+	}
+	const HuffmanAllocator* allocator = context_allocator(ctx);
+	uint64_t align = alloc_align(ctx->arenaPeak);
+	uint8_t* arena;
+
+	if (ctx->arena == NULL) {
+		arena = (uint8_t*) allocator->allocate(ctx->arenaPeak, align, allocator->user);
+	} else if (allocator->reallocate != NULL) {
+		arena = (uint8_t*) allocator->reallocate(ctx->arena, ctx->arenaSize,
+				ctx->arenaPeak, align, allocator->user);
+	} else {
+		// Arena is empty, nothing to copy
+		arena = (uint8_t*) allocator->allocate(ctx->arenaPeak, align, allocator->user);
+		if (arena) {
+			allocator->release(ctx->arena, ctx->arenaSize, allocator->user);
+		}
+	}
+	if (!arena) {
+		return;
+	}
+	ctx->arena = arena;
+	ctx->arenaSize = ctx->arenaPeak;
+	ctx->numAllocs++;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Saves the arena state of a context. May be passed a null context.
+ *
+ * @param[out] mark Destination for arena state.
+ * @param[in]  ctx  Context to be saved.
+ */
+static void context_enter(HuffmanContextMark* mark,
+						  HuffmanContext* ctx) {
+	mark->arenaUsed = 0;
+	mark->padOffset = 0;
+	mark->numAllocs = 0;
+	if (ctx != NULL) {
+		mark->arenaUsed = ctx->arenaUsed;
+		mark->padOffset = ctx->padOffset;
+		mark->numAllocs = ctx->numAllocs;
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Releases everything allocated from a context since {@link context_enter},
+ * then grows the arena if the released allocations did not fit in it. May be
+ * passed a null context.
+ *
+ * @param[in,out] ctx  Context to be restored.
+ * @param[in]     mark Arena state saved on entry.
+ */
+static void context_leave(HuffmanContext* ctx,
+						  const HuffmanContextMark* mark) {
+	if (ctx == NULL) {
+		return;
+	}
+	const HuffmanAllocator* allocator = context_allocator(ctx);
+	HuffmanOverflowBlock* block;
+	// Blocks are listed newest first, and some may already be released
+	while (ctx->overflow != NULL &&
+			((HuffmanOverflowBlock*) ctx->overflow)->seq >= mark->numAllocs) {
+		block = (HuffmanOverflowBlock*) ctx->overflow;
+		ctx->overflow = block->next;
+		ctx->overflowBytes -= block->reserve;
+		allocator->release((uint8_t*) block - block->size,
+				block->size + sizeof(HuffmanOverflowBlock), allocator->user);
+	}
+	ctx->arenaUsed = mark->arenaUsed;
+	ctx->padOffset = mark->padOffset;
+	context_grow(ctx);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocates memory from the arena of ctx if one is provided, falling back to
+ * a separate allocation from its allocator when the arena is full.
+ * Allocations of at least {@link HUFFMAN_HUGE_PAGE_SIZE} bytes are aligned to
+ * that size.
+ *
+ * @param[in,out] ctx   Context to allocate from, or null to use the default
+ *                      allocator.
+ * @param[in]     bytes Number of bytes requested.
+ *
+ * @return Pointer to memory, or null if allocation failed.
+ */
+static void* context_alloc(HuffmanContext* ctx,
+						   uint64_t bytes) {
+	uint64_t align = alloc_align(bytes);
+	uint8_t* ptr;
+
+	if (ctx == NULL) {
+		return default_alloc(bytes, align, NULL);
+	}
+
+	const HuffmanAllocator* allocator = context_allocator(ctx);
+	uint64_t offset = ctx->arenaUsed;
+	bytes = (bytes + HUFFMAN_ARENA_ALIGN - 1) & ~((uint64_t) HUFFMAN_ARENA_ALIGN - 1);
+	if (ctx->arena != NULL) {
+		offset += (0 - (uint64_t) (uintptr_t) &ctx->arena[offset]) & (align - 1);
+		// An allocator may treat alignment as a hint, leaving padding too
+		// small to record state in
+		if (offset != ctx->arenaUsed && offset - ctx->arenaUsed < 2 * sizeof(uint64_t)) {
+			offset += align;
+		}
+	}
+	if (ctx->arena != NULL && offset <= ctx->arenaSize &&
+			ctx->arenaSize - offset >= bytes) {
+		ptr = &ctx->arena[offset];
+		if (offset != ctx->arenaUsed) {
+			// Record state before padding in the padding itself, at least
+			// 16 bytes ending at an aligned address, so context_free can
+			// rewind it
+			((uint64_t*) ptr)[-2] = ctx->arenaUsed;
+			((uint64_t*) ptr)[-1] = ctx->padOffset;
+			ctx->padOffset = offset;
+		}
+		ctx->arenaUsed = offset + bytes;
+	} else {
+		HuffmanOverflowBlock* block;
+		ptr = (uint8_t*) allocator->allocate(bytes + sizeof(HuffmanOverflowBlock),
+				align, allocator->user);
+		if (!ptr) {
+			return NULL;
+		}
+		block = (HuffmanOverflowBlock*) (ptr + bytes);
+		block->next = (HuffmanOverflowBlock*) ctx->overflow;
+		// Reserve the padding block would need at the same offset of an arena
+		// of peak size, which is aligned to the largest alignment requested
+		offset = ctx->arenaUsed + ctx->overflowBytes;
+		block->size = bytes;
+		block->reserve = bytes + ((0 - offset) & (align - 1));
+		block->seq = ctx->numAllocs;
+		ctx->overflow = block;
+		ctx->overflowBytes += block->reserve;
+		ctx->numAllocs++;
+	}
+	if (ctx->arenaUsed + ctx->overflowBytes > ctx->arenaPeak) {
+		ctx->arenaPeak = ctx->arenaUsed + ctx->overflowBytes;
+	}
+	return ptr;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Checks whether memory is the most recent allocation from the arena of a
+ * context.
+ *
+ * @param[in] ctx   Context memory was allocated from.
+ * @param[in] ptr   Memory to be checked.
+ * @param[in] bytes Number of bytes requested when allocating.
+ *
+ * @return True if ptr ends where the free space of the arena begins.
+ */
+static inline bool context_is_top(const HuffmanContext* ctx,
+								  const void* ptr,
+								  uint64_t bytes) {
+	bytes = (bytes + HUFFMAN_ARENA_ALIGN - 1) & ~((uint64_t) HUFFMAN_ARENA_ALIGN - 1);
+	return ptr != NULL && ctx->arena != NULL && bytes <= ctx->arenaUsed &&
+			(const uint8_t*) ptr == &ctx->arena[ctx->arenaUsed - bytes];
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Finds the overflow block holding memory allocated by {@link context_alloc}.
+ *
+ * @param[out] prev Block listed before the one found, or null if it is first.
+ * @param[in]  ctx  Context memory was allocated from.
+ * @param[in]  ptr  Memory to be found.
+ *
+ * @return Block holding ptr, or null if ptr is null or in the arena.
+ */
+static HuffmanOverflowBlock* context_find_overflow(HuffmanOverflowBlock** prev,
+												   const HuffmanContext* ctx,
+												   const void* ptr) {
+	HuffmanOverflowBlock* block = (HuffmanOverflowBlock*) ctx->overflow;
+	*prev = NULL;
+	while (ptr != NULL && block != NULL &&
+			(const uint8_t*) block - block->size != (const uint8_t*) ptr) {
+		*prev = block;
+		block = block->next;
+	}
+	return (ptr != NULL) ? block : NULL;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Resizes an overflow block of a context with the reallocate function of its
+ * allocator, so that growing it need not hold old and new copies in the
+ * context at once.
+ *
+ * @param[in,out] ctx      Context memory was allocated from.
+ * @param[in]     ptr      Memory to be resized.
+ * @param[in]     newBytes Number of bytes to keep.
+ *
+ * @return Pointer to resized memory, or null if ptr is not in an overflow
+ *         block or could not be resized, in which case it is left as is.
+ */
+static void* context_realloc_overflow(HuffmanContext* ctx,
+									  void* ptr,
+									  uint64_t newBytes) {
+	const HuffmanAllocator* allocator = context_allocator(ctx);
+	HuffmanOverflowBlock* prev;
+	HuffmanOverflowBlock* block = context_find_overflow(&prev, ctx, ptr);
+	HuffmanOverflowBlock saved;
+	uint64_t align = alloc_align(newBytes);
+	uint64_t offset;
+	uint8_t* dst;
+
+	if (block == NULL || allocator->reallocate == NULL) {
+		return NULL;
+	}
+	newBytes = (newBytes + HUFFMAN_ARENA_ALIGN - 1) & ~((uint64_t) HUFFMAN_ARENA_ALIGN - 1);
+	saved = *block;
+	dst = (uint8_t*) allocator->reallocate(ptr, saved.size + sizeof(HuffmanOverflowBlock),
+			newBytes + sizeof(HuffmanOverflowBlock), align, allocator->user);
+	if (!dst) {
+		return NULL;
+	}
+
+	// Trailer moves with the end of the block, keeping its place in the list
+	block = (HuffmanOverflowBlock*) (dst + newBytes);
+	*block = saved;
+	offset = ctx->arenaUsed + ctx->overflowBytes - saved.reserve;
+	block->size = newBytes;
+	block->reserve = newBytes + ((0 - offset) & (align - 1));
+	if (prev) {
+		prev->next = block;
+	} else {
+		ctx->overflow = block;
+	}
+	ctx->overflowBytes += block->reserve - saved.reserve;
+	if (ctx->arenaUsed + ctx->overflowBytes > ctx->arenaPeak) {
+		ctx->arenaPeak = ctx->arenaUsed + ctx->overflowBytes;
+	}
+	return dst;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Releases memory allocated by {@link context_alloc}. Overflow blocks and the
+ * most recent arena allocation, along with any alignment padding preceding
+ * it, are released immediately. Other arena memory is only released when the
+ * public function that allocated it returns.
+ *
+ * @param[in,out] ctx   Context memory was allocated from, or null.
+ * @param[in]     ptr   Memory to be released.
+ * @param[in]     bytes Number of bytes requested when allocating.
+ */
+static void context_free(HuffmanContext* ctx,
+						 void* ptr,
+						 uint64_t bytes) {
+	if (ctx == NULL) {
+		default_free(ptr, bytes, NULL);
+		return;
+	}
+	if (context_is_top(ctx, ptr, bytes)) {
+		bytes = (bytes + HUFFMAN_ARENA_ALIGN - 1) & ~((uint64_t) HUFFMAN_ARENA_ALIGN - 1);
+		ctx->arenaUsed -= bytes;
+		if (ctx->padOffset != 0 && ctx->arenaUsed == ctx->padOffset) {
+			ctx->arenaUsed = ((uint64_t*) ptr)[-2];
+			ctx->padOffset = ((uint64_t*) ptr)[-1];
+		}
+		return;
+	}
+
+	const HuffmanAllocator* allocator = context_allocator(ctx);
+	HuffmanOverflowBlock* prev;
+	HuffmanOverflowBlock* block = context_find_overflow(&prev, ctx, ptr);
+	if (block == NULL) {
+		// Arena memory below the top
+		return;
+	}
+	if (prev) {
+		prev->next = block->next;
+	} else {
+		ctx->overflow = block->next;
+	}
+	ctx->overflowBytes -= block->reserve;
+	allocator->release((uint8_t*) block - block->size,
+			block->size + sizeof(HuffmanOverflowBlock), allocator->user);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocation rearranged by {@link context_repack}.
+ */
+typedef struct HuffmanRepack_struct {
+	/**
+	 * Allocation, updated if moved and set to null if released.
+	 */
+	void** ptr;
+	/**
+	 * Number of bytes requested when allocating.
+	 */
+	uint64_t bytes;
+	/**
+	 * Number of bytes to keep, or 0 to release. Only the highest allocation
+	 * kept may grow.
+	 */
+	uint64_t newBytes;
+} HuffmanRepack;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Releases, shrinks or grows a set of allocations at once. When they are the
+ * most recent allocations from the arena of ctx, those kept are moved down
+ * over the space released, so tables that grow several times or are
+ * converted in place hold no more arena memory than their latest size.
+ * Otherwise released memory is handled as {@link context_free} does,
+ * overflow blocks are resized by the allocator, and other allocations that
+ * grow are copied to new memory. Contents are kept up to
+ * the smaller of their old and new sizes.
+ *
+ * @param[in,out] ctx    Context memory was allocated from, or null.
+ * @param[in,out] blocks Allocations to be rearranged, in any order.
+ * @param[in]     num    Number of allocations.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if an allocation could not grow, in
+ *              which case it is left as is.
+ */
+static HuffmanError context_repack(HuffmanContext* ctx,
+								   HuffmanRepack* blocks,
+								   uint8_t num) {
+	HuffmanRepack swap;
+	HuffmanError err = ERR_NO_ERR;
+	uint64_t used, padOffset;
+	uint8_t* dst;
+	int i, j;
+
+	// Order by address
+	for (i = 1; i < num; i++) {
+		for (j = i; j > 0 && (uint8_t*) *blocks[j].ptr < (uint8_t*) *blocks[j - 1].ptr; j--) {
+			swap = blocks[j];
+			blocks[j] = blocks[j - 1];
+			blocks[j - 1] = swap;
+		}
+	}
+
+	// Rewind if every allocation is at the top of the arena, and any growing
+	// allocation is the last kept
+	i = num;
+	for (j = num - 1; j >= 0 && blocks[j].newBytes == 0; j--);
+	// An allocation that newly needs huge-page alignment may land above its
+	// old contents, which the padding header would then overwrite
+	bool movable = j < 0 || alloc_align(blocks[j].newBytes) <= alloc_align(blocks[j].bytes);
+	for (j--; j >= 0; j--) {
+		movable = movable && blocks[j].newBytes <= blocks[j].bytes;
+	}
+	if (ctx != NULL && movable) {
+		used = ctx->arenaUsed;
+		padOffset = ctx->padOffset;
+		for (i = num - 1; i >= 0 && context_is_top(ctx, *blocks[i].ptr, blocks[i].bytes); i--) {
+			context_free(ctx, *blocks[i].ptr, blocks[i].bytes);
+		}
+		if (i >= 0) {
+			ctx->arenaUsed = used;
+			ctx->padOffset = padOffset;
+		}
+	}
+
+	if (i < 0) {
+		// Allocate again from the bottom, which never lies above the old
+		// contents. Only the last may not fit, in which case it is restored.
+		for (i = 0; i < num; i++) {
+			if (blocks[i].newBytes == 0) {
+				*blocks[i].ptr = NULL;
+				continue;
+			}
+			dst = (uint8_t*) context_alloc(ctx, blocks[i].newBytes);
+			if (!dst) {
+				err = ERR_INSUFFICIENT_SPACE;
+				blocks[i].newBytes = blocks[i].bytes;
+				dst = (uint8_t*) context_alloc(ctx, blocks[i].bytes);
+			}
+			memmove(dst, *blocks[i].ptr, (blocks[i].bytes < blocks[i].newBytes) ?
+					blocks[i].bytes : blocks[i].newBytes);
+			*blocks[i].ptr = dst;
+		}
+		return err;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (blocks[i].newBytes == 0) {
+			context_free(ctx, *blocks[i].ptr, blocks[i].bytes);
+			*blocks[i].ptr = NULL;
+		} else if (ctx == NULL && blocks[i].newBytes != blocks[i].bytes) {
+			// Resized in place where possible, so only 16-byte aligned
+			dst = (uint8_t*) realloc(*blocks[i].ptr, (size_t) blocks[i].newBytes);
+			if (dst) {
+				*blocks[i].ptr = dst;
+			} else {
+				err = ERR_INSUFFICIENT_SPACE;
+			}
+		} else if (blocks[i].newBytes != blocks[i].bytes &&
+				(dst = (uint8_t*) context_realloc_overflow(ctx, *blocks[i].ptr,
+						blocks[i].newBytes)) != NULL) {
+			*blocks[i].ptr = dst;
+		} else if (blocks[i].newBytes > blocks[i].bytes) {
+			dst = (uint8_t*) context_alloc(ctx, blocks[i].newBytes);
+			if (dst) {
+				memcpy(dst, *blocks[i].ptr, blocks[i].bytes);
+				context_free(ctx, *blocks[i].ptr, blocks[i].bytes);
+				*blocks[i].ptr = dst;
+			} else {
+				err = ERR_INSUFFICIENT_SPACE;
+			}
+		}
+	}
+	return err;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocates a zeroed hash table using {@link context_alloc}.
+ *
+ * @param[in,out] ctx  Context to allocate from, or null to use the default
+ *                     allocator.
+ * @param[in]     size Number of entries in table.
+ *
+ * @return Pointer to table, or null if allocation failed.
+ */
+static uint64_t* table_alloc(HuffmanContext* ctx,
+							 uint64_t size) {
+	uint64_t* table = (uint64_t*) context_alloc(ctx, 2 * sizeof(uint64_t) * size);
+	if (table) {
+		memset(table, 0x00, 2 * sizeof(uint64_t) * size);
+		INSTRUMENT_ADD(ctx, tableBytes, 2 * sizeof(uint64_t) * size);
+		INSTRUMENT_MAX(ctx, peakTableBytes, ctx->instrumentation->tableBytes);
+	}
+	return table;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Releases a table allocated by {@link table_alloc}.
+ *
+ * @param[in,out] ctx   Context table was allocated from, or null.
+ * @param[in]     table Table to be released.
+ * @param[in]     size  Number of entries in table.
+ */
+static void table_free(HuffmanContext* ctx,
+					   uint64_t* table,
+					   uint64_t size) {
+	context_free(ctx, table, 2 * sizeof(uint64_t) * size);
+	if (table) {
+		INSTRUMENT_ADD(ctx, tableBytes, -(2 * sizeof(uint64_t) * size));
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Obtains pointer to location of table value.
+ *
+ * @param[in] table Reference to table.
+ * @param[in] idx   Index of value to be retrieved.
+ *
+ * @return Pointer to value at provided index.
+ */
+static inline uint64_t* get_table_value(uint64_t* table,
+										uint64_t idx) {
+	return &table[2 * idx];
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Obtains pointer to location of table id.
+ *
+ * @param[in] table Reference to table.
+ * @param[in] idx   Index of id to be retrieved.
+ *
+ * @return Pointer to id at provided index.
+ */
+static inline uint64_t* get_table_id(uint64_t* table,
+								 	 uint64_t idx) {
+	return &table[2 * idx + 1];
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Hashing function for table used in {@link generate_table}.
+ *
+ * @param[in] val    Value to be hashed
+ * @param[in] maxVal Maximum value (table size).
+ *
+ * @return Hashing function result.
+ */
+static inline uint64_t get_hash(uint64_t val,
+								uint64_t maxVal) {
+	// todo implement variable FNV with folding
+	return val % maxVal;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Searches hash table for entry that is empty or matches desired id.
+ *
+ * @param[out] dstIdx        Matching or unoccupied index.
+ * @param[in]  table         Table to be searched.
+ * @param[in]  searchId      Desired id.
+ * @param[in]  assumeNoMatch If true, algorithm assumes table does not contain
+ *							 matching id (for example, when resizing table).
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *		   {@link ERR_NULL_PTR} if dstIdx or table are null.
+ *		   {@link ERR_INSUFFICIENT_SPACE} if table is full and no entry with
+ *				matching value was found. Indicates a larger table is needed.
+ */
+static HuffmanError search_table(uint64_t* dstIdx,
+								 HuffmanHashTable* table,
+								 uint64_t searchId,
+								 bool assumeNoMatch) {
+	if (dstIdx == NULL || table == NULL || table->table == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	uint64_t* id, *val;
+	uint64_t curr = get_hash(searchId, table->size);
+	uint64_t last = (curr + (table->size - 1)) % table->size;
+
+	// todo analyze hash & step function performance
+	while (curr != last) {
+		// Check for empty
+		val = get_table_value(table->table, curr);
+		if (*val == 0) {
+			*dstIdx = curr;
+			return ERR_NO_ERR;
+		}
+
+		// Check for identical id
+		if (!assumeNoMatch) { // todo measure effect of skipping this step during resize
+			id = get_table_id(table->table, curr);
+			if (*id == searchId) {
+				*dstIdx = curr;
+				return ERR_NO_ERR;
+			}
+		}
+
+		// Not found, move to next index
+		curr = (curr + 1) % table->size; // todo consider different step functions
+	}
+	// Table full and id not found
+	return ERR_INSUFFICIENT_SPACE;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Attempts to resize a table to a new, larger size.
+ *
+ * @warning Must be able to allocate new table prior to releasing existing table.
+ *
+ * @param[in,out] table     Table to be resized. Updated with new table
+ *							pointer & size if successful.
+ * @param[in]     newSize   Maximum number of entries in resized table.
+ * @param[in,out] ctx       Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *		   {@link ERR_NULL_PTR} if table is null or points to null.\n
+ *		   {@link ERR_INVALID_VALUE} if sizes are 0 or new table size is less
+ *				than existing table size.
+ *		   {@link ERR_INSUFFICIENT_SPACE} if unable to allocate new table.
+ */
+static HuffmanError resize_table(HuffmanHashTable* table,
+								 uint64_t newSize,
+								 HuffmanContext* ctx) {
+	if (table == NULL || table->table == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	if (table->size == 0 || newSize == 0 || newSize <= table->size) {
+		return ERR_INVALID_VALUE;
+	}
+
+	INSTRUMENT_START(ctx, start);
+	INSTRUMENT_ADD(ctx, resizeCalls, 1);
+
+	// Init pointers and allocate
+	uint64_t* oldTable = table->table;
+	HuffmanHashTable newTable;
+	newTable.size = newSize;
+	newTable.table = table_alloc(ctx, newSize);
+	if (!newTable.table) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+
+	uint64_t currIdx, dstIdx;
+	uint64_t val, id;
+	uint64_t *dstVal, *dstId;
+	HuffmanError err;
+
+	for (currIdx = 0; currIdx < table->size; currIdx++) {
+		val = *get_table_value(oldTable, currIdx);
+
+		// Entry found
+		if (val) {
+			id = *get_table_id(oldTable, currIdx);
+
+			err = search_table(&dstIdx, &newTable, id, true);
+			if (err) {
+				// Should be unreachable
+				table_free(ctx, newTable.table, newTable.size);
+				return err;
+			}
+
+			// Copy entry
+			dstVal = get_table_value(newTable.table, dstIdx);
+			dstId  = get_table_id(newTable.table, dstIdx);
+			*dstVal = val;
+			*dstId = id;
+		}
+	}
+
+	// Release old table and move new one down over it
+	HuffmanRepack blocks[2] = {
+		{(void**) &oldTable, 2 * sizeof(uint64_t) * table->size, 0},
+		{(void**) &newTable.table, 2 * sizeof(uint64_t) * newSize, 2 * sizeof(uint64_t) * newSize}
+	};
+	context_repack(ctx, blocks, 2);
+	INSTRUMENT_ADD(ctx, tableBytes, -(2 * sizeof(uint64_t) * table->size));
+	table->table = newTable.table;
+	table->size = newTable.size;
+	INSTRUMENT_STOP(ctx, start, resizeNs);
+	return ERR_NO_ERR;
+}
+
+
+/**
+ * @ingroup HuffmanHelpers
+ * Mark set in the ids of table entries, or in the entries of a set of words
+ * seen, that {@link place_entries} or {@link tiered_place_seen} are yet to
+ * move to their slot. Words have at most {@link HUFFMAN_MAX_WORD_SIZE} bits.
+ */
+#define HUFFMAN_UNPLACED (((uint64_t)1) << 63)
+
+/**
+ * @ingroup HuffmanHelpers
+ * Moves entries of a table rearranged in place, such as after growing its
+ * allocation, to their slots. Entries to be moved have
+ * {@link HUFFMAN_UNPLACED} set in their id. An entry takes over the slot of
+ * any entry not yet moved that it probes, which is then moved in turn, so no
+ * second table is needed.
+ *
+ * @param[in,out] table Table to be updated. Must have an empty entry.
+ * @param[in]     end   Number of leading entries that may be marked.
+ */
+static void place_entries(HuffmanHashTable* table,
+						  uint64_t end) {
+	uint64_t currIdx, dstIdx;
+	uint64_t val, id, nextVal, nextId;
+
+	for (currIdx = 0; currIdx < end; currIdx++) {
+		val = *get_table_value(table->table, currIdx);
+		id = *get_table_id(table->table, currIdx);
+		if (!val || !(id & HUFFMAN_UNPLACED)) {
+			continue;
+		}
+		*get_table_value(table->table, currIdx) = 0;
+		*get_table_id(table->table, currIdx) = 0;
+		while (val) {
+			id &= ~HUFFMAN_UNPLACED;
+			dstIdx = get_hash(id, table->size);
+			while (*get_table_value(table->table, dstIdx) &&
+					!(*get_table_id(table->table, dstIdx) & HUFFMAN_UNPLACED)) {
+				dstIdx = (dstIdx + 1) % table->size;
+			}
+			nextVal = *get_table_value(table->table, dstIdx);
+			nextId = *get_table_id(table->table, dstIdx);
+			*get_table_value(table->table, dstIdx) = val;
+			*get_table_id(table->table, dstIdx) = id;
+			val = nextVal;
+			id = nextId;
+		}
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds a word to the table, or increments if already in table. Also handles
+ * resizing table.
+ *
+ * @see generate_table
+ *
+ * @param[in,out] table    Table to be updated
+ * @param[out]    numWords Number of words in table
+ * @param[in]     word     Word to be added/incremented
+ * @param[in]     maxSize  Maximum size of table
+ * @param[in,out] ctx      Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *		   {@link ERR_NULL_PTR} if table or numWords are null.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate
+ *      		sufficient memory for table.\n
+ *         {@link ERR_OVERFLOW} if more than {@link HUFFMAN_MAX_UINT64}
+ *      		of the same word are found.\n
+ *         Other errors as raised by {@link extract_bits}.
+ */
+static HuffmanError add_to_table(HuffmanHashTable* table,
+								 uint64_t* numWords,
+								 uint64_t word,
+								 uint64_t maxSize,
+								 HuffmanContext* ctx) {
+	if (table == NULL || table->table == NULL || numWords == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	if (table->size == 0 || maxSize < table->size) {
+		return ERR_INVALID_VALUE;
+	}
+
+	HuffmanError err;
+	uint64_t idx;
+	uint64_t *dstVal, *dstId;
+
+	// Find in hash table
+	err = search_table(&idx, table, word, false);
+
+	// Check for full table, resize if necessary
+	if (err == ERR_INSUFFICIENT_SPACE) {
+		INSTRUMENT_ADD(ctx, totalProbes, table->size - 1);
+		if (table->size < maxSize) {
+			// Resize table
+			uint64_t newSize = (table->size * 2 <= maxSize) ? table->size * 2 : maxSize;
+			err = resize_table(table, newSize, ctx);
+			if (err) {
+				// Error occurred in resizing
+				return err;
+			}
+
+			// Find in new hash table
+			err = search_table(&idx, table, word, false);
+			if (err) {
+				// Should be unreachable
+				return err;
+			}
+		} else {
+			// Cannot resize table
+			return ERR_INSUFFICIENT_SPACE;
+		}
+	} else if (err != ERR_NO_ERR) {
+		// Should be unreachable
+		return err;
+	}
+
+#ifdef HUFFMAN_INSTRUMENT
+	// Entries probed in successful search
+	uint64_t probes = (idx + table->size - get_hash(word, table->size)) % table->size + 1;
+	INSTRUMENT_ADD(ctx, totalProbes, probes);
+	INSTRUMENT_MAX(ctx, maxProbes, probes);
+#endif
+
+	// Add to table, check for value overflow
+	dstVal = get_table_value(table->table, idx);
+	dstId = get_table_id(table->table, idx);
+	if (*dstVal == HUFFMAN_MAX_UINT64) {
+		return ERR_OVERFLOW;
+	} else if (*dstVal == 0) {
+		if (*numWords == HUFFMAN_MAX_UINT64) {
+			return ERR_OVERFLOW;
+		}
+		(*numWords)++;
+		*dstId = word;
+	}
+	*dstVal = *dstVal + 1;
+
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the largest size a frequency table may grow to.
+ *
+ * @param[in] wordSize Word size used for compression.
+ *
+ * @return Maximum number of entries.
+ */
+static inline uint64_t get_max_table_size(uint8_t wordSize) {
+	// Max size range 16 to 16 * 2^59 bytes
+	// NOTE: fails if wordSize = 60 and 2^60 unique words found
+	return (wordSize < 59) ? ((uint64_t)1) << wordSize : ((uint64_t)1) << 59;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the initial size of a frequency table.
+ *
+ * @param[in] wordSize  Word size used for compression.
+ * @param[in] wordCount Number of words to be counted.
+ *
+ * @return Initial number of entries.
+ */
+static inline uint64_t get_initial_table_size(uint8_t wordSize,
+											  uint64_t wordCount) {
+	// Table initially 1/256th to all of max size, depending on word size, but
+	// no larger than needed to hold every word in source
+	uint64_t size = ((uint64_t)1) << (wordSize - wordSize / 4);
+	return (size > wordCount + 1) ? wordCount + 1 : size;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the size of the {@link HuffmanHashTable} a narrower frequency
+ * table is converted into once counting is done. This is the size
+ * {@link add_to_table} would have grown a single table to, kept between 1/32
+ * and 1/3 empty so that entries are placed with short probe sequences.
+ *
+ * @param[in] size     Size of table counted in, doubled from the initial
+ *                     size or capped at the maximum size.
+ * @param[in] numWords Number of words in table.
+ *
+ * @return Number of entries.
+ */
+static inline uint64_t get_expanded_table_size(uint64_t size,
+											   uint64_t numWords) {
+	uint64_t expanded = size;
+	while (expanded % 2 == 0 && expanded / 2 > numWords) {
+		expanded /= 2;
+	}
+	if (expanded < numWords + numWords / 32 + 2) {
+		expanded = numWords + numWords / 32 + 2;
+	}
+	if (expanded > numWords + numWords / 2 + 2) {
+		expanded = numWords + numWords / 2 + 2;
+	}
+	return expanded;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Largest word size counted by {@link generate_table} in a
+ * {@link HuffmanCompactTable}.
+ */
+#define HUFFMAN_COMPACT_MAX_WORD_SIZE 32
+
+/**
+ * @ingroup HuffmanHelpers
+ * Number of words {@link generate_table} reads and prefetches the entries of
+ * before counting them. At most 64.
+ */
+#define HUFFMAN_PREFETCH_WINDOW 16
+
+/**
+ * @ingroup HuffmanHelpers
+ * Initial number of entries of the overflow table of a
+ * {@link HuffmanCompactTable}.
+ */
+#define HUFFMAN_COMPACT_OVERFLOW_SIZE 16
+
+/**
+ * @ingroup HuffmanHelpers
+ * Hash table of word frequencies with 32-bit counts and ids, half the size of
+ * a {@link HuffmanHashTable} with the same number of entries. Used by
+ * {@link generate_table} for word sizes up to
+ * {@link HUFFMAN_COMPACT_MAX_WORD_SIZE}. A count passing UINT32_MAX wraps back
+ * to 1, and the number of wraps of the word is kept in an overflow table.
+ */
+typedef struct HuffmanCompactTable_struct {
+	/**
+	 * Entries of interleaved count and id.
+	 */
+	uint32_t* table;
+	/**
+	 * Number of entries in table.
+	 */
+	uint64_t size;
+	/**
+	 * Number of times each word's count wrapped, each worth UINT32_MAX.
+	 * Null until a count first wraps.
+	 */
+	HuffmanHashTable overflow;
+	/**
+	 * Number of words in overflow table.
+	 */
+	uint64_t numOverflow;
+} HuffmanCompactTable;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocates a zeroed compact table with an empty overflow table.
+ *
+ * @param[out]    table Table to be allocated.
+ * @param[in]     size  Number of entries in table.
+ * @param[in,out] ctx   Context to allocate from, or null to use the default
+ *                      allocator.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if allocation failed.
+ */
+static HuffmanError compact_alloc(HuffmanCompactTable* table,
+								  uint64_t size,
+								  HuffmanContext* ctx) {
+	table->size = size;
+	table->overflow.table = NULL;
+	table->overflow.size = 0;
+	table->numOverflow = 0;
+	table->table = (uint32_t*) context_alloc(ctx, 2 * sizeof(uint32_t) * size);
+	if (!table->table) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	memset(table->table, 0x00, 2 * sizeof(uint32_t) * size);
+	INSTRUMENT_ADD(ctx, tableBytes, 2 * sizeof(uint32_t) * size);
+	INSTRUMENT_MAX(ctx, peakTableBytes, ctx->instrumentation->tableBytes);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Releases a table allocated by {@link compact_alloc}, and its overflow table.
+ *
+ * @param[in,out] table Table to be released.
+ * @param[in,out] ctx   Context table was allocated from, or null.
+ */
+static void compact_free(HuffmanCompactTable* table,
+						 HuffmanContext* ctx) {
+	if (table->overflow.table) {
+		table_free(ctx, table->overflow.table, table->overflow.size);
+		table->overflow.table = NULL;
+	}
+	context_free(ctx, table->table, 2 * sizeof(uint32_t) * table->size);
+	if (table->table) {
+		INSTRUMENT_ADD(ctx, tableBytes, -(2 * sizeof(uint32_t) * table->size));
+	}
+	table->table = NULL;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Searches compact table for entry that is empty or matches desired id, as
+ * {@link search_table} does.
+ *
+ * @param[out] dstIdx        Matching or unoccupied index.
+ * @param[in]  table         Table to be searched.
+ * @param[in]  searchId      Desired id.
+ * @param[in]  assumeNoMatch If true, table is assumed not to contain id.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *		   {@link ERR_INSUFFICIENT_SPACE} if table is full and no entry with
+ *				matching value was found.
+ */
+static HuffmanError compact_search(uint64_t* dstIdx,
+								   const HuffmanCompactTable* table,
+								   uint32_t searchId,
+								   bool assumeNoMatch) {
+	uint64_t curr = get_hash(searchId, table->size);
+	uint64_t last = (curr + (table->size - 1)) % table->size;
+
+	while (curr != last) {
+		if (table->table[2 * curr] == 0 ||
+				(!assumeNoMatch && table->table[2 * curr + 1] == searchId)) {
+			*dstIdx = curr;
+			return ERR_NO_ERR;
+		}
+		curr = (curr + 1) % table->size;
+	}
+	return ERR_INSUFFICIENT_SPACE;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Prefetches the entry of a compact table at which the search for a word
+ * starts.
+ *
+ * @param[in] table Table to be searched.
+ * @param[in] word  Word to be searched for.
+ */
+static inline void compact_prefetch(const HuffmanCompactTable* table,
+									uint32_t word) {
+	__builtin_prefetch(&table->table[2 * get_hash(word, table->size)], 1);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Attempts to resize a compact table to a new, larger size, as
+ * {@link resize_table} does.
+ *
+ * @param[in,out] table   Table to be resized.
+ * @param[in]     newSize Number of entries in resized table.
+ * @param[in,out] ctx     Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *		   {@link ERR_INSUFFICIENT_SPACE} if unable to allocate new table.
+ */
+static HuffmanError compact_resize(HuffmanCompactTable* table,
+								   uint64_t newSize,
+								   HuffmanContext* ctx) {
+	INSTRUMENT_START(ctx, start);
+	INSTRUMENT_ADD(ctx, resizeCalls, 1);
+
+	HuffmanCompactTable newTable;
+	uint64_t currIdx, dstIdx = 0;
+	HuffmanError err;
+
+	THROW_ERR(compact_alloc(&newTable, newSize, ctx))
+	for (currIdx = 0; currIdx < table->size; currIdx++) {
+		if (table->table[2 * currIdx]) {
+			// Cannot fail, new table is larger
+			compact_search(&dstIdx, &newTable, table->table[2 * currIdx + 1], true);
+			newTable.table[2 * dstIdx] = table->table[2 * currIdx];
+			newTable.table[2 * dstIdx + 1] = table->table[2 * currIdx + 1];
+		}
+	}
+
+	// Release old table and move new one down over it, keeping overflow table
+	HuffmanRepack blocks[3] = {
+		{(void**) &table->table, 2 * sizeof(uint32_t) * table->size, 0},
+		{(void**) &newTable.table, 2 * sizeof(uint32_t) * newSize, 2 * sizeof(uint32_t) * newSize},
+		{(void**) &table->overflow.table, 2 * sizeof(uint64_t) * table->overflow.size,
+				2 * sizeof(uint64_t) * table->overflow.size}
+	};
+	context_repack(ctx, blocks, table->overflow.table ? 3 : 2);
+	INSTRUMENT_ADD(ctx, tableBytes, -(2 * sizeof(uint32_t) * table->size));
+	newTable.overflow = table->overflow;
+	newTable.numOverflow = table->numOverflow;
+	*table = newTable;
+	INSTRUMENT_STOP(ctx, start, resizeNs);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds a word to a compact table, or increments if already in table, as
+ * {@link add_to_table} does, except that the table is doubled once 3/4 full
+ * rather than once full, and that a whole run of the word is counted at once.
+ *
+ * @param[in,out] table    Table to be updated.
+ * @param[in,out] numWords Number of words in table.
+ * @param[in]     word     Word to be added/incremented.
+ * @param[in]     count    Number of occurrences of word, at least 1.
+ * @param[in]     maxSize  Maximum size of table.
+ * @param[in,out] ctx      Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate
+ *      		sufficient memory for table.\n
+ *         {@link ERR_OVERFLOW} if more than {@link HUFFMAN_MAX_UINT64}
+ *      		of the same word are found.
+ */
+static HuffmanError compact_add(HuffmanCompactTable* table,
+								uint64_t* numWords,
+								uint32_t word,
+								uint64_t count,
+								uint64_t maxSize,
+								HuffmanContext* ctx) {
+	HuffmanError err;
+	uint64_t idx, slot, low, carry;
+
+	// Keep probe sequences short enough for prefetching their start to pay off
+	if (*numWords >= table->size - table->size / 4 && table->size < maxSize) {
+		THROW_ERR(compact_resize(table, (table->size * 2 <= maxSize) ? table->size * 2 : maxSize, ctx))
+	}
+
+	err = compact_search(&idx, table, word, false);
+	if (err == ERR_INSUFFICIENT_SPACE) {
+		INSTRUMENT_ADD(ctx, totalProbes, table->size - 1);
+		if (table->size >= maxSize) {
+			return ERR_INSUFFICIENT_SPACE;
+		}
+		THROW_ERR(compact_resize(table, (table->size * 2 <= maxSize) ? table->size * 2 : maxSize, ctx))
+		THROW_ERR(compact_search(&idx, table, word, false))
+	}
+
+#ifdef HUFFMAN_INSTRUMENT
+	uint64_t probes = (idx + table->size - get_hash(word, table->size)) % table->size + 1;
+	INSTRUMENT_ADD(ctx, totalProbes, probes);
+	INSTRUMENT_MAX(ctx, maxProbes, probes);
+#endif
+
+	low = table->table[2 * idx];
+	if (low == 0) {
+		(*numWords)++;
+		table->table[2 * idx + 1] = word;
+	}
+	if (count <= UINT32_MAX - low) {
+		table->table[2 * idx] = (uint32_t) (low + count);
+		return ERR_NO_ERR;
+	}
+
+	// Carry whole multiples of UINT32_MAX into overflow table, keeping entry
+	// in 1..UINT32_MAX. Total count is at most HUFFMAN_MAX_UINT64.
+	carry = count / UINT32_MAX;
+	low += count % UINT32_MAX;
+	if (low > UINT32_MAX) {
+		low -= UINT32_MAX;
+		carry++;
+	} else if (low == 0) {
+		low = UINT32_MAX;
+		carry--;
+	}
+	if (!table->overflow.table) {
+		table->overflow.size = HUFFMAN_COMPACT_OVERFLOW_SIZE;
+		table->overflow.table = table_alloc(ctx, table->overflow.size);
+		if (!table->overflow.table) {
+			return ERR_INSUFFICIENT_SPACE;
+		}
+	}
+	err = search_table(&slot, &table->overflow, word, false);
+	if (carry > HUFFMAN_MAX_UINT64 / UINT32_MAX - 1 -
+			(err ? 0 : *get_table_value(table->overflow.table, slot))) {
+		return ERR_OVERFLOW;
+	}
+	THROW_ERR(add_to_table(&table->overflow, &table->numOverflow, word, maxSize, ctx))
+	THROW_ERR(search_table(&slot, &table->overflow, word, false))
+	*get_table_value(table->overflow.table, slot) += carry - 1;
+	table->table[2 * idx] = (uint32_t) low;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Converts a compact table into a {@link HuffmanHashTable} with room for at
+ * least one more word if the compact table had room, and releases the compact
+ * table. Entries are widened within the allocation of the compact table,
+ * which is resized rather than copied, so both are never held at once.
+ *
+ * @param[out]    dst      Converted table.
+ * @param[in,out] table    Table to be converted.
+ * @param[in]     numWords Number of words in table.
+ * @param[in,out] ctx      Context tables are allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate table.
+ */
+static HuffmanError compact_expand(HuffmanHashTable* dst,
+								   HuffmanCompactTable* table,
+								   uint64_t numWords,
+								   HuffmanContext* ctx) {
+	uint64_t currIdx, slot, numEntries;
+	uint64_t count, id;
+	uint64_t* entries;
+
+	// Shrink if a single table would have been smaller, or to leave no more
+	// slack than needed. Otherwise keep every entry in place.
+	dst->size = get_expanded_table_size(table->size, numWords);
+	bool rehash = dst->size < table->size;
+	if (!rehash) {
+		dst->size = table->size;
+	}
+
+	// Gather entries at front, so that only they need to survive resizing
+	numEntries = table->size;
+	if (rehash) {
+		numEntries = 0;
+		for (currIdx = 0; currIdx < table->size; currIdx++) {
+			if (table->table[2 * currIdx]) {
+				table->table[2 * numEntries] = table->table[2 * currIdx];
+				table->table[2 * numEntries + 1] = table->table[2 * currIdx + 1];
+				numEntries++;
+			}
+		}
+	}
+	HuffmanRepack block = {(void**) &table->table, 2 * sizeof(uint32_t) * table->size,
+			2 * sizeof(uint64_t) * dst->size};
+	if (context_repack(ctx, &block, 1)) {
+		compact_free(table, ctx);
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	INSTRUMENT_ADD(ctx, tableBytes, 2 * sizeof(uint64_t) * dst->size -
+			2 * sizeof(uint32_t) * table->size);
+	INSTRUMENT_MAX(ctx, peakTableBytes, ctx->instrumentation->tableBytes);
+
+	// Widen from the back, so no entry is overwritten before it is read
+	entries = (uint64_t*) table->table;
+	for (currIdx = numEntries; currIdx-- > 0;) {
+		count = table->table[2 * currIdx];
+		id = table->table[2 * currIdx + 1];
+		if (count && table->overflow.table &&
+				search_table(&slot, &table->overflow, id, false) == ERR_NO_ERR) {
+			count += *get_table_value(table->overflow.table, slot) * UINT32_MAX;
+		}
+		*get_table_value(entries, currIdx) = count;
+		*get_table_id(entries, currIdx) = rehash ? id | HUFFMAN_UNPLACED : id;
+	}
+	memset(&entries[2 * numEntries], 0x00, 2 * sizeof(uint64_t) * (dst->size - numEntries));
+	if (table->overflow.table) {
+		table_free(ctx, table->overflow.table, table->overflow.size);
+		table->overflow.table = NULL;
+	}
+
+	dst->table = entries;
+	table->table = NULL;
+	if (rehash) {
+		place_entries(dst, numEntries);
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Two-tier frequency table used by {@link generate_table} for word sizes above
+ * {@link HUFFMAN_COMPACT_MAX_WORD_SIZE}. Words seen once are only recorded in
+ * a set of 8-byte entries, and are promoted to a {@link HuffmanHashTable} of
+ * 16-byte entries on their second occurrence. When most words occur once,
+ * this nearly halves the memory touched while counting. Both tiers share one
+ * allocation, the set followed by the count table, so that either grows in
+ * place and the table is converted within it.
+ */
+typedef struct HuffmanTieredTable_struct {
+	/**
+	 * Set of words seen, stored as word + 1 so that 0 marks an empty entry.
+	 * Promoted words are not removed. Start of the allocation of both tiers.
+	 */
+	uint64_t* seen;
+	/**
+	 * Number of entries in seen.
+	 */
+	uint64_t seenSize;
+	/**
+	 * Number of entries seen grows to at most.
+	 */
+	uint64_t maxSeen;
+	/**
+	 * Number of words in seen.
+	 */
+	uint64_t numSeen;
+	/**
+	 * Counts of words seen at least twice, following seen.
+	 */
+	HuffmanHashTable counts;
+	/**
+	 * Number of words in counts.
+	 */
+	uint64_t numCounts;
+} HuffmanTieredTable;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the size of the allocation of a two-tier table.
+ *
+ * @param[in] seenSize   Number of entries in set of words seen.
+ * @param[in] countsSize Number of entries in count table.
+ *
+ * @return Size of allocation in bytes.
+ */
+static inline uint64_t tiered_bytes(uint64_t seenSize,
+									uint64_t countsSize) {
+	return sizeof(uint64_t) * seenSize + 2 * sizeof(uint64_t) * countsSize;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocates an empty two-tier table. The count table starts at a quarter of
+ * the size of the set.
+ *
+ * @param[out]    table   Table to be allocated.
+ * @param[in]     size    Number of entries in set of words seen.
+ * @param[in]     maxSeen Number of entries set grows to at most, at least
+ *                        size.
+ * @param[in,out] ctx     Context to allocate from, or null to use the default
+ *                        allocator.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if allocation failed.
+ */
+static HuffmanError tiered_alloc(HuffmanTieredTable* table,
+								 uint64_t size,
+								 uint64_t maxSeen,
+								 HuffmanContext* ctx) {
+	table->seenSize = size;
+	table->maxSeen = maxSeen;
+	table->numSeen = 0;
+	table->numCounts = 0;
+	table->counts.size = size / 4 + 2;
+	table->seen = (uint64_t*) context_alloc(ctx, tiered_bytes(size, table->counts.size));
+	if (!table->seen) {
+		table->counts.table = NULL;
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	memset(table->seen, 0x00, tiered_bytes(size, table->counts.size));
+	table->counts.table = &table->seen[size];
+	INSTRUMENT_ADD(ctx, tableBytes, tiered_bytes(size, table->counts.size));
+	INSTRUMENT_MAX(ctx, peakTableBytes, ctx->instrumentation->tableBytes);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Releases a table allocated by {@link tiered_alloc}.
+ *
+ * @param[in,out] table Table to be released.
+ * @param[in,out] ctx   Context table was allocated from, or null.
+ */
+static void tiered_free(HuffmanTieredTable* table,
+						HuffmanContext* ctx) {
+	context_free(ctx, table->seen, tiered_bytes(table->seenSize, table->counts.size));
+	if (table->seen) {
+		INSTRUMENT_ADD(ctx, tableBytes, -tiered_bytes(table->seenSize, table->counts.size));
+	}
+	table->seen = NULL;
+	table->counts.table = NULL;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Searches set of words seen for entry that is empty or holds a word, as
+ * {@link search_table} does.
+ *
+ * @param[out] dstIdx Matching or unoccupied index.
+ * @param[in]  seen   Set to be searched.
+ * @param[in]  size   Number of entries in set.
+ * @param[in]  entry  Word + 1.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *		   {@link ERR_INSUFFICIENT_SPACE} if set is full and word was not found.
+ */
+static HuffmanError tiered_search_seen(uint64_t* dstIdx,
+									   const uint64_t* seen,
+									   uint64_t size,
+									   uint64_t entry) {
+	uint64_t curr = get_hash(entry, size);
+	uint64_t last = (curr + (size - 1)) % size;
+
+	while (curr != last) {
+		if (seen[curr] == 0 || seen[curr] == entry) {
+			*dstIdx = curr;
+			return ERR_NO_ERR;
+		}
+		curr = (curr + 1) % size;
+	}
+	return ERR_INSUFFICIENT_SPACE;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Moves entries of a set of words seen to their slots, as
+ * {@link place_entries} does for a table.
+ *
+ * @param[in,out] seen Set to be updated. Must have an empty entry.
+ * @param[in]     size Number of entries in set.
+ * @param[in]     end  Number of leading entries that may be marked.
+ */
+static void tiered_place_seen(uint64_t* seen,
+							  uint64_t size,
+							  uint64_t end) {
+	uint64_t currIdx, dstIdx, entry, next;
+
+	for (currIdx = 0; currIdx < end; currIdx++) {
+		entry = seen[currIdx];
+		if (!(entry & HUFFMAN_UNPLACED)) {
+			continue;
+		}
+		seen[currIdx] = 0;
+		while (entry) {
+			entry &= ~HUFFMAN_UNPLACED;
+			dstIdx = get_hash(entry, size);
+			while (seen[dstIdx] && !(seen[dstIdx] & HUFFMAN_UNPLACED)) {
+				dstIdx = (dstIdx + 1) % size;
+			}
+			next = seen[dstIdx];
+			seen[dstIdx] = entry;
+			entry = next;
+		}
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Prefetches the entries of both tiers at which the searches for a word
+ * start.
+ *
+ * @param[in] table Table to be searched.
+ * @param[in] word  Word to be searched for.
+ */
+static inline void tiered_prefetch(const HuffmanTieredTable* table,
+								   uint64_t word) {
+	__builtin_prefetch(get_table_value(table->counts.table, get_hash(word, table->counts.size)), 1);
+	__builtin_prefetch(&table->seen[get_hash(word + 1, table->seenSize)], 1);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Grows the tiers of a two-tier table. Their allocation is resized, in place
+ * where possible, and the entries of a tier that grows are moved to their
+ * new slots within it.
+ *
+ * @param[in,out] table      Table to be resized.
+ * @param[in]     seenSize   Number of entries in set of words seen, at least
+ *                           its current size.
+ * @param[in]     countsSize Number of entries in count table, at least its
+ *                           current size.
+ * @param[in,out] ctx        Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to resize allocation, in
+ *              which case table is left as is.
+ */
+static HuffmanError tiered_resize(HuffmanTieredTable* table,
+								  uint64_t seenSize,
+								  uint64_t countsSize,
+								  HuffmanContext* ctx) {
+	HuffmanError err;
+	uint64_t oldSeenSize = table->seenSize;
+	uint64_t oldCountsSize = table->counts.size;
+	uint64_t* seen = table->seen;
+	uint64_t i;
+
+	INSTRUMENT_START(ctx, start);
+	INSTRUMENT_ADD(ctx, resizeCalls, 1);
+	HuffmanRepack block = {(void**) &seen, tiered_bytes(oldSeenSize, oldCountsSize),
+			tiered_bytes(seenSize, countsSize)};
+	THROW_ERR(context_repack(ctx, &block, 1))
+	INSTRUMENT_ADD(ctx, tableBytes, block.newBytes - block.bytes);
+	INSTRUMENT_MAX(ctx, peakTableBytes, ctx->instrumentation->tableBytes);
+
+	// Count table moves up as set grows
+	memmove(&seen[seenSize], &seen[oldSeenSize], 2 * sizeof(uint64_t) * oldCountsSize);
+	memset(&seen[oldSeenSize], 0x00, sizeof(uint64_t) * (seenSize - oldSeenSize));
+	memset(&seen[seenSize + 2 * oldCountsSize], 0x00,
+			2 * sizeof(uint64_t) * (countsSize - oldCountsSize));
+	table->seen = seen;
+	table->seenSize = seenSize;
+	table->counts.table = &seen[seenSize];
+	table->counts.size = countsSize;
+
+	if (seenSize != oldSeenSize) {
+		for (i = 0; i < oldSeenSize; i++) {
+			if (seen[i]) {
+				seen[i] |= HUFFMAN_UNPLACED;
+			}
+		}
+		tiered_place_seen(seen, seenSize, oldSeenSize);
+	}
+	if (countsSize != oldCountsSize) {
+		for (i = 0; i < oldCountsSize; i++) {
+			if (*get_table_value(table->counts.table, i)) {
+				*get_table_id(table->counts.table, i) |= HUFFMAN_UNPLACED;
+			}
+		}
+		place_entries(&table->counts, oldCountsSize);
+	}
+	INSTRUMENT_STOP(ctx, start, resizeNs);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Marks a word as seen, doubling the set once 3/4 full. Unlike
+ * {@link add_to_table}, the set is not filled completely, as probing a full
+ * set of mostly unique words is what makes high-cardinality counting slow.
+ * Once the set can grow no further it is filled to 15/16.
+ *
+ * @param[out]    found Set if word had already been seen.
+ * @param[in,out] table Table to be updated.
+ * @param[in]     word  Word seen.
+ * @param[in,out] ctx   Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if word was not seen and set is full
+ *              at its largest size or could not be resized.
+ */
+static HuffmanError tiered_mark_seen(bool* found,
+									 HuffmanTieredTable* table,
+									 uint64_t word,
+									 HuffmanContext* ctx) {
+	uint64_t entry = word + 1;
+	uint64_t idx = 0, newSize;
+
+	if (table->numSeen >= table->seenSize - table->seenSize / 4 &&
+			table->seenSize < table->maxSeen) {
+		newSize = (table->seenSize * 2 <= table->maxSeen) ? table->seenSize * 2 : table->maxSeen;
+		if (tiered_resize(table, newSize, table->counts.size, ctx) != ERR_NO_ERR) {
+			return ERR_INSUFFICIENT_SPACE;
+		}
+	}
+	if (tiered_search_seen(&idx, table->seen, table->seenSize, entry) != ERR_NO_ERR) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+
+	*found = table->seen[idx] != 0;
+	if (!*found) {
+		// Set full, word not seen before
+		if (table->numSeen >= table->seenSize - table->seenSize / 16) {
+			return ERR_INSUFFICIENT_SPACE;
+		}
+		table->seen[idx] = entry;
+		table->numSeen++;
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds a word to the count table of a two-tier table with {@link add_to_table},
+ * growing the count table within the allocation of both tiers first if it is
+ * about to fill, so that add_to_table never reallocates it.
+ *
+ * @param[in,out] table   Table to be updated.
+ * @param[in]     word    Word to be added/incremented.
+ * @param[in]     maxSize Maximum size of count table.
+ * @param[in,out] ctx     Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to grow count table.\n
+ *         Other errors as raised by {@link add_to_table}.
+ */
+static HuffmanError tiered_count(HuffmanTieredTable* table,
+								 uint64_t word,
+								 uint64_t maxSize,
+								 HuffmanContext* ctx) {
+	HuffmanError err;
+	uint64_t size = table->counts.size;
+	// Grow once 3/4 full, as probing a full table is slow
+	if (table->numCounts + 1 >= size - size / 4 && size < maxSize) {
+		THROW_ERR(tiered_resize(table, table->seenSize, (size * 2 <= maxSize) ? size * 2 : maxSize,
+				ctx))
+	}
+	return add_to_table(&table->counts, &table->numCounts, word, maxSize, ctx);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds a run of a word to a two-tier table, as {@link add_to_table} does for
+ * each occurrence. Words seen for the second time are promoted to the count
+ * table with their total count. Once the set of words seen is full, new
+ * words go straight to the count table.
+ *
+ * @param[in,out] table    Table to be updated.
+ * @param[in,out] numWords Number of unique words in table.
+ * @param[in]     word     Word to be added/incremented.
+ * @param[in]     count    Number of occurrences of word, at least 1.
+ * @param[in]     maxSize  Maximum size of either tier.
+ * @param[in,out] ctx      Context table was allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_OVERFLOW} if more than {@link HUFFMAN_MAX_UINT64}
+ *      		of the same word are found.\n
+ *         Other errors as raised by {@link add_to_table}.
+ */
+static HuffmanError tiered_add(HuffmanTieredTable* table,
+							   uint64_t* numWords,
+							   uint64_t word,
+							   uint64_t count,
+							   uint64_t maxSize,
+							   HuffmanContext* ctx) {
+	HuffmanError err;
+	uint64_t idx, numCounts;
+	uint64_t* val;
+	bool found;
+
+	// Already promoted
+	if (search_table(&idx, &table->counts, word, false) == ERR_NO_ERR) {
+		val = get_table_value(table->counts.table, idx);
+		if (*val != 0) {
+			if (count > HUFFMAN_MAX_UINT64 - *val) {
+				return ERR_OVERFLOW;
+			}
+			*val += count;
+			return ERR_NO_ERR;
+		}
+	}
+
+	// Set full at maxSize, count new word directly
+	err = tiered_mark_seen(&found, table, word, ctx);
+	if (err == ERR_INSUFFICIENT_SPACE) {
+		numCounts = table->numCounts;
+		THROW_ERR(tiered_count(table, word, maxSize, ctx))
+		*numWords += table->numCounts - numCounts;
+		count--;
+	} else if (err != ERR_NO_ERR) {
+		return err;
+	} else if (!found) {
+		(*numWords)++;
+		if (count == 1) {
+			return ERR_NO_ERR;
+		}
+		// Promote run of a new word straight away
+		THROW_ERR(tiered_count(table, word, maxSize, ctx))
+		count--;
+	} else {
+		// Promote on second occurrence
+		THROW_ERR(tiered_count(table, word, maxSize, ctx))
+	}
+	if (count == 0) {
+		return ERR_NO_ERR;
+	}
+	THROW_ERR(search_table(&idx, &table->counts, word, false))
+	val = get_table_value(table->counts.table, idx);
+	if (count > HUFFMAN_MAX_UINT64 - *val) {
+		return ERR_OVERFLOW;
+	}
+	*val += count;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Converts a two-tier table into a {@link HuffmanHashTable} with room for at
+ * least one more word, and releases the two-tier table. Words seen once and
+ * counted words are gathered at the front of the allocation of both tiers,
+ * which is then resized into the converted table, so no second table is held
+ * at once.
+ *
+ * @param[out]    dst      Converted table.
+ * @param[in,out] table    Table to be converted.
+ * @param[in]     numWords Number of words in table.
+ * @param[in,out] ctx      Context tables are allocated from, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate table.
+ */
+static HuffmanError tiered_expand(HuffmanHashTable* dst,
+								  HuffmanTieredTable* table,
+								  uint64_t numWords,
+								  HuffmanContext* ctx) {
+	uint64_t i, idx, word;
+	uint64_t numSingle = 0, numCounted = 0;
+	uint64_t* entries = table->seen;
+
+	// Words seen once at front, as bare words
+	for (i = 0; i < table->seenSize; i++) {
+		if (table->seen[i]) {
+			word = table->seen[i] - 1;
+			if (search_table(&idx, &table->counts, word, false) != ERR_NO_ERR ||
+					*get_table_value(table->counts.table, idx) == 0) {
+				entries[numSingle++] = word;
+			}
+		}
+	}
+	// Then counted words, never overtaking the entries read
+	for (i = 0; i < table->counts.size; i++) {
+		if (*get_table_value(table->counts.table, i)) {
+			entries[numSingle + 2 * numCounted] = *get_table_value(table->counts.table, i);
+			entries[numSingle + 2 * numCounted + 1] = *get_table_id(table->counts.table, i);
+			numCounted++;
+		}
+	}
+
+	dst->size = get_expanded_table_size(table->seenSize, numWords);
+	HuffmanRepack block = {(void**) &entries, tiered_bytes(table->seenSize, table->counts.size),
+			2 * sizeof(uint64_t) * dst->size};
+	if (context_repack(ctx, &block, 1)) {
+		tiered_free(table, ctx);
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	INSTRUMENT_ADD(ctx, tableBytes, block.newBytes - block.bytes);
+	INSTRUMENT_MAX(ctx, peakTableBytes, ctx->instrumentation->tableBytes);
+
+	// Counted words to their final index, then widen words seen once from the
+	// back, so no entry is overwritten before it is read
+	memmove(&entries[2 * numSingle], &entries[numSingle], 2 * sizeof(uint64_t) * numCounted);
+	for (i = 0; i < numCounted; i++) {
+		*get_table_id(entries, numSingle + i) |= HUFFMAN_UNPLACED;
+	}
+	for (i = numSingle; i-- > 0;) {
+		word = entries[i];
+		*get_table_value(entries, i) = 1;
+		*get_table_id(entries, i) = word | HUFFMAN_UNPLACED;
+	}
+	memset(&entries[2 * (numSingle + numCounted)], 0x00,
+			2 * sizeof(uint64_t) * (dst->size - numSingle - numCounted));
+	dst->table = entries;
+	table->seen = NULL;
+	table->counts.table = NULL;
+	place_entries(dst, numSingle + numCounted);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Runs of the same word coded by run escape, as tallied by
+ * {@link generate_run_table}.
+ */
+typedef struct HuffmanRunCount_struct {
+	/**
+	 * Number of runs of more than {@link HUFFMAN_MIN_RUN} words.
+	 */
+	uint64_t runs;
+	/**
+	 * Bytes of repeat counts following the run escapes, see
+	 * {@link get_varint_bytes}.
+	 */
+	uint64_t bytes;
+} HuffmanRunCount;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Counts a run of the same word in whichever table is in use. Long runs are
+ * tallied and counted once if runs are coded by run escape.
+ *
+ * @param[in,out] compact  Compact table, or null if tiered is used.
+ * @param[in,out] tiered   Two-tier table, used if compact is null.
+ * @param[in,out] numWords Number of unique words in table.
+ * @param[in]     word     Word repeated.
+ * @param[in]     length   Number of words in run, at least 1.
+ * @param[in,out] runs     Runs coded by run escape, or null.
+ * @param[in]     maxSize  Maximum size of table.
+ * @param[in,out] ctx      Context table was allocated from, or null.
+ *
+ * @return Errors as raised by {@link compact_add} and {@link tiered_add}.
+ */
+static inline HuffmanError add_run(HuffmanCompactTable* compact,
+								   HuffmanTieredTable* tiered,
+								   uint64_t* numWords,
+								   uint64_t word,
+								   uint64_t length,
+								   HuffmanRunCount* runs,
+								   uint64_t maxSize,
+								   HuffmanContext* ctx) {
+	if (runs && length > HUFFMAN_MIN_RUN) {
+		runs->runs++;
+		runs->bytes += get_varint_bytes(length - 1);
+		length = 1;
+	}
+	if (compact) {
+		return compact_add(compact, numWords, (uint32_t) word, length, maxSize, ctx);
+	}
+	return tiered_add(tiered, numWords, word, length, maxSize, ctx);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Generates and populates hash table of word frequencies, optionally giving
+ * up once the words seen so far are too varied to compress.
+ *
+ * Runs of the same word are counted with one increment of their length.
+ * When runs are to be coded by run escape, each run of more than
+ * {@link HUFFMAN_MIN_RUN} words counts as a single occurrence of its word
+ * instead, and is tallied in runs.
+ *
+ * The check runs each time the number of words seen reaches a power of two
+ * no less than {@link HUFFMAN_BAILOUT_WORDS}. Sending the value map of the
+ * words seen so far plus at least one bit per word must cost less than
+ * storing them.
+ *
+ * Word sizes up to {@link HUFFMAN_COMPACT_MAX_WORD_SIZE} are counted in a
+ * {@link HuffmanCompactTable}, larger ones in a {@link HuffmanTieredTable}.
+ * Either is converted once every complete word has been counted. Words are
+ * read {@link HUFFMAN_PREFETCH_WINDOW} at a time, and the table entries of
+ * all of them prefetched before any is counted, so that cache misses of the
+ * window overlap rather than stall counting one after another.
+ *
+ * @warning This allocates a table that must be freed later.
+ *
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[out]    dst      Pointer to table. Table data must be freed by calling
+ *                         function if ctx is null.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[out]    runs     Runs to be coded by run escape, or null to count
+ *                         every word.
+ * @param[out]    bailed   Set if table generation gave up, in which case no
+ *                         table is returned. Null to disable check.
+ * @param[in,out] ctx      Context to allocate table from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate
+ *      		sufficient memory for table.\n
+ *         {@link ERR_OVERFLOW} if more than {@link HUFFMAN_MAX_UINT64}
+ *      		of the same word are found.\n
+ *         Other errors as raised by {@link extract_bits}.
+ */
+static HuffmanError generate_run_table(HuffmanHeader* hdr,
+									   HuffmanHashTable* dst,
+									   uint8_t* src,
+									   uint64_t srcSize,
+									   uint8_t wordSize,
+									   HuffmanRunCount* runs,
+									   bool* bailed,
+									   HuffmanContext* ctx) {
+	if (hdr == NULL || dst == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	if (srcSize < 1 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+
+	HuffmanHashTable table;
+	HuffmanCompactTable compact;
+	HuffmanTieredTable tiered;
+	bool isCompact = wordSize <= HUFFMAN_COMPACT_MAX_WORD_SIZE;
+	uint8_t* currPtr = src;
+	uint8_t  currBit = 0;
+	uint64_t numWords = 0;
+	uint64_t numSeen = 0;
+	uint64_t checkpoint = HUFFMAN_BAILOUT_WORDS;
+	uint64_t currWord;
+	uint64_t window[HUFFMAN_PREFETCH_WINDOW];
+	uint64_t lengths[HUFFMAN_PREFETCH_WINDOW];
+	uint64_t numComplete, i, j, batch, numRuns, length;
+	uint64_t runWord = 0, runLength = 0;
+	HuffmanError err = ERR_NO_ERR;
+
+	if (bailed) {
+		*bailed = false;
+	}
+	if (runs) {
+		runs->runs = 0;
+		runs->bytes = 0;
+	}
+
+	// Determine how many bits in last word (complicated formula to avoid int overflow)
+	uint8_t finalBits = (uint8_t) ((uint64_t) 8 * (srcSize % (uint64_t) wordSize)
+			% (uint64_t) wordSize);
+	uint8_t padBits = wordSize - finalBits;
+
+	uint8_t unused;
+	uint64_t maxSize = get_max_table_size(wordSize);
+	uint64_t wordCount = get_word_count(&unused, srcSize, wordSize);
+	table.size = get_initial_table_size(wordSize, wordCount);
+
+	// Initialize table
+	if (isCompact) {
+		THROW_ERR(compact_alloc(&compact, table.size, ctx))
+	} else {
+		THROW_ERR(tiered_alloc(&tiered, table.size,
+				(maxSize < wordCount + 1) ? maxSize : wordCount + 1, ctx))
+	}
+
+	// Parse all complete words in file, a window at a time
+	numComplete = get_word_count(&unused, srcSize, wordSize) - (finalBits != 0);
+	for (i = 0; !err && !(bailed && *bailed) && i < numComplete; i += batch) {
+		batch = (numComplete - i < HUFFMAN_PREFETCH_WINDOW) ? numComplete - i : HUFFMAN_PREFETCH_WINDOW;
+
+		// Read window and split into runs, prefetching entries once per run
+		err = unpack_words(window, &currPtr, &currBit, src + srcSize, batch, wordSize);
+		numRuns = err ? 0 : kernels.splitRuns(window, lengths, batch);
+		for (j = 0; j < numRuns; j++) {
+			if (isCompact) {
+				compact_prefetch(&compact, (uint32_t) window[j]);
+			} else {
+				tiered_prefetch(&tiered, window[j]);
+			}
+		}
+
+		// Count window a run at a time. The last run may go on in the next
+		// window, so it is held back until then.
+		for (j = 0; !err && j < numRuns; j++) {
+			length = lengths[j];
+			if (runLength > 0 && window[j] == runWord) {
+				runLength += length;
+			} else {
+				if (runLength > 0) {
+					err = add_run(isCompact ? &compact : NULL, &tiered, &numWords, runWord,
+							runLength, runs, maxSize, ctx);
+				}
+				runWord = window[j];
+				runLength = length;
+			}
+			if (!err && j + 1 < numRuns) {
+				err = add_run(isCompact ? &compact : NULL, &tiered, &numWords, runWord,
+						runLength, runs, maxSize, ctx);
+				runLength = 0;
+			}
+
+			// Give up on data that looks incompressible so far
+			numSeen += length;
+			if (!err && bailed && numSeen >= checkpoint) {
+				if (numWords * wordSize + numSeen >= numSeen * wordSize) {
+					INSTRUMENT_ADD(ctx, wordsProcessed, numSeen);
+					*bailed = true;
+					break;
+				}
+				checkpoint <<= 1;
+			}
+		}
+	}
+	if (!err && !(bailed && *bailed) && runLength > 0) {
+		err = add_run(isCompact ? &compact : NULL, &tiered, &numWords, runWord, runLength, runs,
+				maxSize, ctx);
+	}
+	if (err || (bailed && *bailed)) {
+		if (isCompact) {
+			compact_free(&compact, ctx);
+		} else {
+			tiered_free(&tiered, ctx);
+		}
+		return err;
+	}
+
+	// Convert to full-width table for padding, sorting & lookups
+	if (isCompact) {
+		THROW_ERR(compact_expand(&table, &compact, numWords, ctx))
+	} else {
+		THROW_ERR(tiered_expand(&table, &tiered, numWords, ctx))
+	}
+
+	// Handle incomplete word & padding
+	if (finalBits != 0) {
+		uint64_t highIdx, lowIdx;
+		uint64_t *highVal, *lowVal;
+		uint64_t *id;
+		uint64_t highWord;
+		bool skipLow = false, skipHigh = false;
+
+		// Get next word
+		err = extract_bits(&currWord, &currPtr, &currBit, finalBits);
+		if (err != ERR_NO_ERR) {
+			table_free(ctx, table.table, table.size);
+			return err;
+		}
+		currWord = currWord << padBits;
+
+		// Find index if padding with 0's
+		err = search_table(&lowIdx, &table, currWord, false);
+		if (err) { // Full table & not in table
 			skipLow = true;
 		} else {
-			lowVal = get_table_value(table.table, lowIdx);
+			lowVal = get_table_value(table.table, lowIdx);
+		}
+
+		// Find index if padding with 1's
+		highWord = currWord | ((((uint64_t)1) << padBits) - 1);
+		err = search_table(&highIdx, &table, highWord, false);
+		if (err) { // Full table & not in table
+			skipHigh = true;
+		} else {
+			highVal = get_table_value(table.table, highIdx);
+		}
+
+		// Choose which padding to use:
+		// * If both possible, choose most common one (or lower in case of tie)
+		// * If one possible, choose that one
+		// * If none possible, choose lower (must resize table)
+		if (skipHigh || *lowVal >= *highVal) {
+			err = add_to_table(&table, &numWords, currWord, maxSize, ctx);
+		} else {
+			err = add_to_table(&table, &numWords, highWord, maxSize, ctx);
+		}
+
+		// Check for error
+		if (err) {
+			table_free(ctx, table.table, table.size);
+			return err;
+		}
+
+	}
+
+	// Update header
+	hdr->wordSize = wordSize;
+	hdr->padBits = padBits;
+	hdr->uniqueWords = numWords;
+	INSTRUMENT_ADD(ctx, wordsProcessed, get_word_count(&unused, srcSize, wordSize));
+	// Copy table metadata
+	dst->table = table.table;
+	dst->size = table.size;
+
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Generates and populates hash table of word frequencies, counting every
+ * word. See {@link generate_run_table}.
+ *
+ * @warning This allocates a table that must be freed later.
+ *
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[out]    dst      Pointer to table. Table data must be freed by calling
+ *                         function if ctx is null.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[out]    bailed   Set if table generation gave up, in which case no
+ *                         table is returned. Null to disable check.
+ * @param[in,out] ctx      Context to allocate table from, or null to use the heap.
+ *
+ * @return Errors as raised by {@link generate_run_table}.
+ */
+static HuffmanError generate_table(HuffmanHeader* hdr,
+								   HuffmanHashTable* dst,
+								   uint8_t* src,
+								   uint64_t srcSize,
+								   uint8_t wordSize,
+								   bool* bailed,
+								   HuffmanContext* ctx) {
+	return generate_run_table(hdr, dst, src, srcSize, wordSize, NULL, bailed, ctx);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Merges two sorted sub-arrays as part of {@link sort_table}.
+ *
+ * Merge operates under several key assumptions:
+ *	- sizeLeft >= sizeRight
+ *	- Left and right sub-arrays are located sequentially
+ *	  in memory to allow overlap.
+ *	- All non-zero values are at front of sub-arrays.
+ *
+ * @param[in,out] left      Left sub-array, also beginning of output array.
+ * @param[in,out] right     Right sub-array. State after merge is not guaranteed.
+ * 							Partially overwritten if number of non-zero elements
+ * 							in left and right arrays combined > sizeLeft.
+ * @param[in]     sizeLeft  Capacity of left sub-array.
+ * @param[in]     sizeRight Capacity of right sub-array.
+ *
+ * @return Total number of non-empty elements in merged array.
+ */
+static uint64_t merge_table(uint64_t* left,
+							uint64_t* right,
+							uint64_t sizeLeft,
+							uint64_t sizeRight) {
+	uint64_t lIdx = 0;
+	uint64_t rIdx = 0;
+	uint64_t lVal, rVal, lId;
+	uint64_t *lIdPtr;
+	uint64_t tempIdx = 0;
+
+	// merge two sub-arrays
+	while (lIdx < sizeLeft + sizeRight || rIdx < sizeRight) {
+		// get values if present
+		lVal = *get_table_value(left, lIdx);
+		rVal = (rIdx < sizeRight) ? *get_table_value(right, rIdx) : 0;
+
+		if (lVal > 0 && rVal > 0) { // both left and right not done
+			if (rVal > lVal) { // right needs to go left
+				tempIdx = lIdx;
+				// backtrace to correct position if needed (unlikely)
+				while (tempIdx > 0 && *get_table_value(left, tempIdx - 1) < rVal) {
+					tempIdx--;
+				}
+				lIdx = tempIdx;
+				// swap id
+				lIdPtr = get_table_id(left, lIdx);
+				lId = *lIdPtr;
+				*lIdPtr = *get_table_id(right, rIdx);
+				*get_table_id(right, rIdx) = lId;
+				// swap val
+				*get_table_value(right, rIdx) = *get_table_value(left, lIdx);
+				*get_table_value(left, lIdx) = rVal;
+			}
+			lIdx++;
+		} else if (lVal > 0) { // only left remains
+			// no action, already in correct place
+			lIdx++;
+		} else if (rVal > 0) { // only right remains
+			// move right to left
+			*get_table_id(left, lIdx) = *get_table_id(right, rIdx);
+			*get_table_value(left, lIdx) = rVal;
+			// mark right as empty
+			*get_table_value(right, rIdx) = 0;
+			rIdx++;
+		} else {
+			// both lVal & rVal 0, done with merge
+			break;
+		}
+		// ensure not looking at same item
+		if (lIdx >= sizeLeft + rIdx) {
+			rIdx = lIdx - sizeLeft + 1;
+		}
+	}
+	return lIdx;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Merges two sub-arrays using {@link merge_table}.
+ *
+ * @param[in,out] left      Left sub-array, also beginning of output array.
+ * @param[in,out] right     Right sub-array. State after merge is not guaranteed.
+ * 							Partially overwritten if number of non-zero elements
+ * 							in left and right arrays combined > sizeLeft.
+ * @param[in]     sizeLeft  Capacity of left sub-array.
+ * @param[in]     sizeRight Capacity of right sub-array.
+ *
+ * @return Total number of non-empty elements in merged array.
+ */
+static uint64_t merge_sort(uint64_t* left,
+						   uint64_t* right,
+						   uint64_t sizeLeft,
+						   uint64_t sizeRight) {
+	uint64_t mid, ret, retRight = sizeRight;
+	if (sizeLeft > 1) {
+		mid = (sizeLeft + 1) / 2;
+		merge_sort(left, get_table_value(left, mid), mid, sizeLeft - mid);
+	}
+	if (sizeRight > 1) {
+		mid = (sizeRight + 1) / 2;
+		retRight = merge_sort(right, get_table_value(right, mid), mid, sizeRight - mid);
+	}
+	// use retRight for early exit condition
+	ret = merge_table(left, right, sizeLeft, retRight);
+	return ret;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Sorts a hash table generated by {@link generate_table} by decreasing frequency.
+ * Sorting is implemented via modified merge sort.
+ *
+ * @param[in]     hdr Header containing metadata for table.
+ * @param[in,out] dst Pointer to table to be updated.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *		   {@link ERR_NULL_PTR} if a parameter is null.\n
+ *		   {@link ERR_INVALID_VALUE} if header contains invalid values.
+ */
+static HuffmanError sort_table(HuffmanHeader *hdr,
+							   HuffmanHashTable *dst) {
+	uint64_t mid = dst->size / 2;
+	uint64_t* left = dst->table;
+	uint64_t* right = get_table_value(dst->table, mid);
+	uint64_t size = merge_sort(left, right, mid, dst->size - mid);
+	if (size != hdr->uniqueWords) {
+		return ERR_INVALID_VALUE;
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Builds the frequency table for the source and sorts it by decreasing
+ * frequency. Steps 2 and 3 of compression.
+ *
+ * @warning This allocates a table that must be freed later.
+ *
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[out]    table    Pointer to table. Table data must be freed by calling
+ *                         function if ctx is null, and is released by this
+ *                         function on error.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[out]    bailed   Set if data was found incompressible, in which case
+ *                         no table is returned. Null to disable check.
+ * @param[in,out] ctx      Context to allocate table from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by {@link generate_table} and {@link sort_table}.
+ */
+static HuffmanError build_sorted_table(HuffmanHeader* hdr,
+									   HuffmanHashTable* table,
+									   uint8_t* src,
+									   uint64_t srcSize,
+									   uint8_t wordSize,
+									   bool* bailed,
+									   HuffmanContext* ctx) {
+	HuffmanError err;
+
+	table->size = 0;
+	table->table = NULL;
+
+	// Step 2: Build hash map
+	INSTRUMENT_START(ctx, histogramStart);
+	THROW_ERR(generate_table(hdr, table, src, srcSize, wordSize, bailed, ctx))
+	INSTRUMENT_STOP(ctx, histogramStart, histogramNs);
+	if (bailed && *bailed) {
+		table->size = 0;
+		table->table = NULL;
+		return ERR_NO_ERR;
+	}
+
+	// Step 3: Convert hash map to sorted array
+	INSTRUMENT_START(ctx, sortStart);
+	err = sort_table(hdr, table);
+	INSTRUMENT_STOP(ctx, sortStart, sortNs);
+	if (err) {
+		table_free(ctx, table->table, table->size);
+		table->table = NULL;
+		table->size = 0;
+	}
+	return err;
+}
+
+/**
+ * Populates the constants used by a mapping for one compression. The context
+ * is read-only afterwards, so one context may be shared by any number of
+ * threads and different compressions may use different contexts concurrently.
+ *
+ * @param[out] ctx         Context to be populated.
+ * @param[in]  compressor  Mapping the context is built for.
+ * @param[in]  uniqueWords Total number of unique words in frequency table.
+ * @param[in]  depth       Depth parameter of mapping.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if depth exceeds
+ *              {@link HuffmanCompressor#maxDepth}.\n
+ *         Other errors as raised by {@link HuffmanCompressor#initContext}.
+ */
+HuffmanError huffman_init_map_context(HuffmanMapContext* ctx,
+									  const HuffmanCompressor* compressor,
+									  uint64_t uniqueWords,
+									  uint8_t depth) {
+	if (ctx == NULL || compressor == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (depth > compressor->maxDepth || depth > 63) {
+		return ERR_INVALID_VALUE;
+	}
+	ctx->uniqueWords = uniqueWords;
+	ctx->depth = depth;
+	ctx->pow2 = ((uint64_t) 1) << depth;
+	ctx->mask = ctx->pow2 - 1;
+	ctx->user = NULL;
+	if (compressor->initContext != NULL) {
+		return compressor->initContext(ctx);
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * Parses a block of consecutive compressed values using a given mapping.
+ * Uses {@link HuffmanCompressor#parseIdxBulk} when available, otherwise
+ * parses one value at a time.
+ *
+ * @param[out]    dst        Destination for count parsed indices.
+ * @param[in]     count      Number of indices to parse.
+ * @param[in,out] src        Pointer to byte from which to read. Updated to first byte following block.
+ * @param[in,out] start      Bit from which to start. Updated to bit following block. Range 0-7.
+ * @param[in,out] srcSize    Number of bytes remaining in src. Updated on success.
+ * @param[in]     compressor Mapping used to code the values.
+ * @param[in]     ctx        Mapping constants from {@link huffman_init_map_context}.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null or mapping cannot parse.\n
+ *         Other errors as raised by the mapping's parse functions.
+ */
+HuffmanError huffman_parse_compressed_idx_block(uint64_t* dst,
+											   uint64_t count,
+											   uint8_t** src,
+											   uint8_t* start,
+											   uint64_t* srcSize,
+											   const HuffmanCompressor* compressor,
+											   const HuffmanMapContext* ctx) {
+	if (dst == NULL || src == NULL || start == NULL || srcSize == NULL ||
+			compressor == NULL || ctx == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (compressor->parseIdxBulk != NULL) {
+		return compressor->parseIdxBulk(dst, count, src, start, srcSize, ctx);
+	}
+	if (compressor->parseIdx == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	HuffmanError err;
+	uint8_t* tempPtr = *src;
+	uint8_t tempStart = *start;
+	uint64_t tempSize = *srcSize;
+	for (uint64_t i = 0; i < count; i++) {
+		THROW_ERR(compressor->parseIdx(&dst[i], &tempPtr, &tempStart, &tempSize, ctx))
+	}
+	*src = tempPtr;
+	*start = tempStart;
+	*srcSize = tempSize;
+	return ERR_NO_ERR;
+}
+
+/**
+ * Parses compressed values coded round-robin into interleaved streams using
+ * a given mapping, value i being read from stream i % numStreams. Uses
+ * {@link HuffmanCompressor#parseIdxStreams} when available, otherwise parses
+ * one value at a time.
+ *
+ * @param[out]    dst        Destination for count parsed indices.
+ * @param[in]     count      Number of indices to parse.
+ * @param[in]     numStreams Number of streams. Range 1 - {@link HUFFMAN_MAX_STREAMS}.
+ * @param[in,out] src        Position of each stream. Updated to first byte following parsed values.
+ * @param[in,out] start      Bit of each stream from which to start. Updated to bit following parsed values.
+ * @param[in,out] srcSize    Number of bytes remaining in each stream. Updated on success.
+ * @param[in]     compressor Mapping used to code the values.
+ * @param[in]     ctx        Mapping constants from {@link huffman_init_map_context}.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null or mapping cannot parse.\n
+ *         {@link ERR_INVALID_VALUE} if numStreams is out of accepted range.\n
+ *         Other errors as raised by the mapping's parse functions.
+ */
+HuffmanError huffman_parse_compressed_idx_streams(uint64_t* dst,
+												 uint64_t count,
+												 uint8_t numStreams,
+												 uint8_t** src,
+												 uint8_t* start,
+												 uint64_t* srcSize,
+												 const HuffmanCompressor* compressor,
+												 const HuffmanMapContext* ctx) {
+	if (dst == NULL || src == NULL || start == NULL || srcSize == NULL ||
+			compressor == NULL || ctx == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (numStreams == 0 || numStreams > HUFFMAN_MAX_STREAMS) {
+		return ERR_INVALID_VALUE;
+	}
+	if (compressor->parseIdxStreams != NULL) {
+		return compressor->parseIdxStreams(dst, count, numStreams, src, start, srcSize, ctx);
+	}
+	if (compressor->parseIdx == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	HuffmanError err;
+	uint8_t* tempPtr[HUFFMAN_MAX_STREAMS];
+	uint8_t tempStart[HUFFMAN_MAX_STREAMS];
+	uint64_t tempSize[HUFFMAN_MAX_STREAMS];
+	uint64_t i, s;
+	for (s = 0; s < numStreams; s++) {
+		tempPtr[s] = src[s];
+		tempStart[s] = start[s];
+		tempSize[s] = srcSize[s];
+	}
+	for (i = 0; i < count; i++) {
+		s = i % numStreams;
+		THROW_ERR(compressor->parseIdx(&dst[i], &tempPtr[s], &tempStart[s], &tempSize[s], ctx))
+	}
+	for (s = 0; s < numStreams; s++) {
+		src[s] = tempPtr[s];
+		start[s] = tempStart[s];
+		srcSize[s] = tempSize[s];
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Calculates compressed size of a sorted table using a given mapping.
+ * Step 4 of compression.
+ *
+ * Code lengths are requested in blocks of
+ * {@link HUFFMAN_CODE_LENGTH_BLOCK_SIZE} through
+ * {@link HuffmanCompressor#getSizes} when available, so each block reduces to
+ * a dot product of frequencies and lengths. Blocks the mapping cannot express
+ * as uint8_t lengths fall back to {@link HuffmanCompressor#getSize}.
+ *
+ * Entropy results are cleared; see {@link set_entropy_stats}.
+ *
+ * @param[out] dst        Destination for calculation results.
+ * @param[in]  hdr        Header containing metadata for table.
+ * @param[in]  table      Table sorted by {@link sort_table}.
+ * @param[in]  compressor Mapping used to calculate compressed size of a word.
+ * @param[in]  mapCtx     Mapping constants from {@link huffman_init_map_context}.
+ */
+static void calculate_stats(HuffmanStats* dst,
+							HuffmanHeader* hdr,
+							HuffmanHashTable* table,
+							const HuffmanCompressor* compressor,
+							const HuffmanMapContext* mapCtx) {
+	uint8_t lengths[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	uint64_t blockBits, sizeBits, sizeBytes, idx, blockSize, i, uniqueWords;
+	uint64_t* tablePtr;
+
+	uniqueWords = hdr->uniqueWords;
+	tablePtr = table->table;
+	sizeBits = sizeBytes = 0;
+	for (idx = 0; idx < uniqueWords; idx += blockSize) {
+		blockSize = uniqueWords - idx;
+		if (blockSize > HUFFMAN_CODE_LENGTH_BLOCK_SIZE) {
+			blockSize = HUFFMAN_CODE_LENGTH_BLOCK_SIZE;
+		}
+		blockBits = 0;
+		if (compressor->getSizes != NULL &&
+				compressor->getSizes(lengths, idx, blockSize, mapCtx) == ERR_NO_ERR) {
+			for (i = 0; i < blockSize; i++) {
+				blockBits += tablePtr[2 * (idx + i)] * lengths[i];
+			}
+		} else {
+			for (i = 0; i < blockSize; i++) {
+				blockBits += tablePtr[2 * (idx + i)] * compressor->getSize(idx + i, mapCtx);
+			}
+		}
+		sizeBits += blockBits % 8;
+		sizeBytes += blockBits / 8 + sizeBits / 8;
+		sizeBits = sizeBits % 8;
+	}
+	if (sizeBits) {
+		sizeBytes++;
+	}
+	dst->dataSizeBytes = sizeBytes;
+	dst->dataBitsInLastByte = sizeBits;
+	dst->compressor = compressor;
+	dst->depthParam = mapCtx->depth;
+	dst->entropy = 0.0;
+	dst->minSizeBits = 0;
+	dst->efficiency = 0.0;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the number of bits of data described by calculation results.
+ *
+ * @param[in] stats Results from {@link calculate_stats}.
+ *
+ * @return Size in bits.
+ */
+static inline uint64_t get_stats_bits(const HuffmanStats* stats) {
+	if (stats->dataBitsInLastByte == 0) {
+		return stats->dataSizeBytes * 8;
+	}
+	return (stats->dataSizeBytes - 1) * 8 + stats->dataBitsInLastByte;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Calculates the Shannon entropy of a sorted table from its counts. Step 4 of
+ * compression.
+ *
+ * @param[out] minBits Theoretical minimum size of data in bits (ceiling).
+ * @param[in]  hdr     Header containing metadata for table.
+ * @param[in]  table   Table sorted by {@link sort_table}.
+ *
+ * @return Entropy in bits per word.
+ */
+static double calculate_entropy(uint64_t* minBits,
+								HuffmanHeader* hdr,
+								HuffmanHashTable* table) {
+	uint64_t* tablePtr = table->table;
+	uint64_t total = 0;
+	double sum = 0.0;
+	double bits;
+	uint64_t i;
+
+	for (i = 0; i < hdr->uniqueWords; i++) {
+		total += tablePtr[2 * i];
+		sum += tablePtr[2 * i] * log2((double) tablePtr[2 * i]);
+	}
+	if (total == 0) {
+		*minBits = 0;
+		return 0.0;
+	}
+	// Sum of count * log2(total / count)
+	bits = total * log2((double) total) - sum;
+	if (bits < 0.0) {
+		bits = 0.0;
+	}
+	*minBits = (uint64_t) ceil(bits);
+	return bits / total;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Populates the entropy, theoretical minimum size and efficiency of
+ * calculation results.
+ *
+ * @param[in,out] dst     Results from {@link calculate_stats}.
+ * @param[in]     entropy Entropy from {@link calculate_entropy}.
+ * @param[in]     minBits Minimum size from {@link calculate_entropy}.
+ */
+static void set_entropy_stats(HuffmanStats* dst,
+							  double entropy,
+							  uint64_t minBits) {
+	uint64_t bits = get_stats_bits(dst);
+	dst->entropy = entropy;
+	dst->minSizeBits = minBits;
+	if (bits == 0) {
+		dst->efficiency = 1.0;
+	} else {
+		dst->efficiency = (double) minBits / (double) bits;
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines whether one calculation result is strictly smaller than another.
+ *
+ * @param[in] a First result.
+ * @param[in] b Second result.
+ *
+ * @return True if a requires fewer bits than b.
+ */
+static bool stats_less(const HuffmanStats* a,
+					   const HuffmanStats* b) {
+	if (a->dataSizeBytes != b->dataSizeBytes) {
+		return a->dataSizeBytes < b->dataSizeBytes;
+	}
+	// Same byte count; fewer bits in last byte is smaller (0 means full byte)
+	uint8_t aBits = a->dataBitsInLastByte ? a->dataBitsInLastByte : 8;
+	uint8_t bBits = b->dataBitsInLastByte ? b->dataBitsInLastByte : 8;
+	return aBits < bBits;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Inserts a result into a ranked array of at most capacity entries. Ties keep
+ * insertion order. Results ranked below the last entry of a full array are
+ * discarded.
+ *
+ * @param[in,out] ranked   Array sorted by increasing size.
+ * @param[in,out] count    Number of entries in ranked.
+ * @param[in]     capacity Maximum number of entries in ranked.
+ * @param[in]     stats    Result to be inserted.
+ */
+static void insert_ranked(HuffmanStats* ranked,
+						  uint64_t* count,
+						  uint64_t capacity,
+						  const HuffmanStats* stats) {
+	uint64_t idx = *count;
+	if (idx == capacity) {
+		if (capacity == 0 || !stats_less(stats, &ranked[capacity - 1])) {
+			return;
+		}
+		idx--;
+	} else {
+		(*count)++;
+	}
+	while (idx > 0 && stats_less(stats, &ranked[idx - 1])) {
+		ranked[idx] = ranked[idx - 1];
+		idx--;
+	}
+	ranked[idx] = *stats;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Mappings registered via {@link huffman_register_compressor}.
+ */
+static const HuffmanCompressor* customCompressors[HUFFMAN_MAX_CUSTOM_COMPRESSORS];
+
+/**
+ * @ingroup HuffmanHelpers
+ * Number of entries in {@link customCompressors}.
+ */
+static uint8_t numCustomCompressors = 0;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Built-in mappings. Position in this array identifies the mapping in
+ * compressed frames and serialized dictionaries.
+ */
+static const HuffmanCompressor* const builtinCompressors[] = {&OneHot, &FixDepthTree, &LogDepthTree};
+
+/**
+ * @ingroup HuffmanHelpers
+ * Number of entries in {@link builtinCompressors}.
+ */
+#define HUFFMAN_NUM_BUILTIN_COMPRESSORS ((uint8_t) (sizeof(builtinCompressors) / sizeof(builtinCompressors[0])))
+
+/**
+ * @ingroup HuffmanHelpers
+ * Calculates compressed size in bytes
+ *
+ * @warning This allocates a table that must be freed later.
+ *
+ * @param[out]	  dst		  Destination for calculation results.
+ * @param[in,out] hdr		  Header populated with metadata.
+ * @param[in,out] table		  Pointer to table. Table data must be freed by calling function.
+ * @param[in]	  src		  Data to be converted.
+ * @param[in]	  srcSize	  Size of data in bytes.
+ * @param[in]	  wordSize	  Word size used for compression.
+ * @param[in]	  compressor  Mapping used to calculate compressed size of a word.
+ * @param[in]	  depthParam  Depth parameter passed into mapping functions.
+ * @param[in,out] ctx		  Context to allocate table from, or null to use the heap.
+ */
+static HuffmanError calculate_compressed_size(HuffmanStats* dst,
+											  HuffmanHeader* hdr,
+											  HuffmanHashTable* table,
+											  uint8_t* src,
+											  uint64_t srcSize,
+											  uint8_t wordSize,
+											  const HuffmanCompressor* compressor,
+											  uint8_t depthParam,
+											  HuffmanContext* ctx) {
+	if (dst == NULL || hdr == NULL || src == NULL || table == NULL ||
+			compressor == NULL || compressor->getSize == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+
+	HuffmanError err;
+	HuffmanMapContext mapCtx;
+	uint64_t minBits;
+	double entropy;
+
+	// Validate mapping parameters before doing any work
+	THROW_ERR(huffman_init_map_context(&mapCtx, compressor, 0, depthParam))
+
+	// todo add step 1
+
+	// Steps 2 & 3: Build hash map, convert to sorted array
+	THROW_ERR(build_sorted_table(hdr, table, src, srcSize, wordSize, NULL, ctx))
+
+	// Step 4: Calculate size
+	err = huffman_init_map_context(&mapCtx, compressor, hdr->uniqueWords, depthParam);
+	if (err) {
+		table_free(ctx, table->table, table->size);
+		table->table = NULL;
+		return err;
+	}
+	INSTRUMENT_START(ctx, sizeStart);
+	calculate_stats(dst, hdr, table, compressor, &mapCtx);
+	entropy = calculate_entropy(&minBits, hdr, table);
+	set_entropy_stats(dst, entropy, minBits);
+	INSTRUMENT_STOP(ctx, sizeStart, sizeNs);
+
+	return ERR_NO_ERR;
+}
+
+/**
+ * Initializes an empty context. No memory is allocated until the context is
+ * first used.
+ *
+ * @param[out] ctx Context to be initialized.
+ */
+void huffman_context_init(HuffmanContext* ctx) {
+	if (ctx == NULL) {
+		return;
+	}
+	memset(ctx, 0x00, sizeof(HuffmanContext));
+	ctx->allocator = defaultAllocator;
+}
+
+/**
+ * Initializes an empty context that performs all of its allocations through
+ * the provided callbacks, for example to place tables in a preallocated slab
+ * or huge-page pool.
+ *
+ * @param[out] ctx       Context to be initialized.
+ * @param[in]  allocator Callbacks to be copied into context, or null to use
+ *                       malloc and free.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if ctx is null or allocator is missing its
+ *              allocate or release callback.
+ */
+HuffmanError huffman_context_init_allocator(HuffmanContext* ctx,
+											const HuffmanAllocator* allocator) {
+	if (ctx == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (allocator != NULL && (allocator->allocate == NULL || allocator->release == NULL)) {
+		return ERR_NULL_PTR;
+	}
+	huffman_context_init(ctx);
+	if (allocator != NULL) {
+		ctx->allocator = *allocator;
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * Releases all allocations held by a context except its arena, which is grown
+ * to the largest demand seen so far. Usage statistics are cleared, so
+ * {@link HuffmanContext#numAllocs} counts only allocations made afterwards.
+ *
+ * @param[in,out] ctx Context to be reset.
+ */
+void huffman_context_reset(HuffmanContext* ctx) {
+	if (ctx == NULL) {
+		return;
+	}
+	HuffmanContextMark mark;
+	mark.arenaUsed = 0;
+	mark.padOffset = 0;
+	mark.numAllocs = 0;
+	context_leave(ctx, &mark);
+	ctx->arenaPeak = ctx->arenaSize;
+	ctx->numAllocs = 0;
+}
+
+/**
+ * Releases all memory held by a context. The context may be reused after
+ * calling {@link huffman_context_init}.
+ *
+ * @param[in,out] ctx Context to be released.
+ */
+void huffman_context_free(HuffmanContext* ctx) {
+	if (ctx == NULL) {
+		return;
+	}
+	huffman_context_reset(ctx);
+	if (ctx->arena != NULL) {
+		const HuffmanAllocator* allocator = context_allocator(ctx);
+		allocator->release(ctx->arena, ctx->arenaSize, allocator->user);
+	}
+	memset(ctx, 0x00, sizeof(HuffmanContext));
+}
+
+/**
+ * Calculates the compressed size of the source using a single mapping,
+ * allocating the frequency table from a reusable context.
+ *
+ * @param[out]	  dst		  Destination for calculation results.
+ * @param[in,out] hdr		  Header populated with metadata.
+ * @param[in]	  src		  Data to be converted.
+ * @param[in]	  srcSize	  Size of data in bytes.
+ * @param[in]	  wordSize	  Word size used for compression.
+ * @param[in]	  compressor  Mapping used to calculate compressed size of a word.
+ * @param[in]	  depthParam  Depth parameter passed into mapping functions.
+ * @param[in,out] ctx		  Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
+ *         Other errors as raised by {@link calculate_compressed_size}.
+ */
+HuffmanError huffman_calculate_compressed_size_ctx(HuffmanStats* dst,
+												   HuffmanHeader* hdr,
+												   uint8_t* src,
+												   uint64_t srcSize,
+												   uint8_t wordSize,
+												   const HuffmanCompressor* compressor,
+												   uint8_t depthParam,
+												   HuffmanContext* ctx) {
+	HuffmanError err;
+	if (hdr == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+
+	HuffmanHashTable table;
+	HuffmanContextMark mark;
+
+	context_enter(&mark, ctx);
+	err = calculate_compressed_size(dst, hdr, &table, src, srcSize, wordSize,
+			compressor, depthParam, ctx);
+
+	// Step 5: Cleanup
+	if (!err) {
+		table_free(ctx, table.table, table.size);
+	}
+	context_leave(ctx, &mark);
+
+	return err;
+}
+
+/**
+ * @todo document this
+ *
+ * @param[out]	  dst		  Destination for calculation results.
+ * @param[in,out] hdr		  Header populated with metadata.
+ * @param[in]	  src		  Data to be converted.
+ * @param[in]	  srcSize	  Size of data in bytes.
+ * @param[in]	  wordSize	  Word size used for compression.
+ * @param[in]	  compressor  Mapping used to calculate compressed size of a word.
+ * @param[in]	  depthParam  Depth parameter passed into mapping functions.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
+ *         Other errors as raised by {@link calculate_compressed_size}.
+ */
+HuffmanError huffman_calculate_compressed_size(HuffmanStats* dst,
+											   HuffmanHeader* hdr,
+											   uint8_t* src,
+											   uint64_t srcSize,
+											   uint8_t wordSize,
+											   const HuffmanCompressor* compressor,
+											   uint8_t depthParam) {
+	return huffman_calculate_compressed_size_ctx(dst, hdr, src, srcSize, wordSize,
+			compressor, depthParam, NULL);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Marks an index entry of a {@link HuffmanSketch} whose word has been evicted
+ * from the heap, the other bits keeping its occurrences. The entry stays so
+ * that probe sequences remain intact and a returning word resumes its count.
+ */
+#define HUFFMAN_SKETCH_EVICTED (((uint64_t)1) << 63)
+
+/**
+ * @ingroup HuffmanHelpers
+ * Fixed-size summary of word frequencies: a count-min sketch with
+ * conservative update, registers estimating the number of unique words
+ * (HyperLogLog), and a min-heap of the words with the highest estimated
+ * counts.
+ */
+typedef struct HuffmanSketch_struct {
+	/**
+	 * {@link HUFFMAN_SKETCH_DEPTH} rows of width counters.
+	 */
+	uint64_t* counters;
+	/**
+	 * Number of counters per row, a power of 2.
+	 */
+	uint64_t width;
+	/**
+	 * {@link HUFFMAN_SKETCH_REGISTERS} registers, each the largest rank of a
+	 * hash falling into it.
+	 */
+	uint8_t* registers;
+	/**
+	 * Min-heap of {estimated count, word, index slot, occurrences since
+	 * entering heap} entries, least frequent first.
+	 */
+	uint64_t* heap;
+	/**
+	 * Number of entries in heap.
+	 */
+	uint64_t numHeavy;
+	/**
+	 * Capacity of heap.
+	 */
+	uint64_t maxHeavy;
+	/**
+	 * Table from word to heap position + 1, or to occurrences marked with
+	 * {@link HUFFMAN_SKETCH_EVICTED}.
+	 */
+	HuffmanHashTable index;
+	/**
+	 * Number of used index entries, including evicted ones.
+	 */
+	uint64_t numIndexed;
+	/**
+	 * Whether any word has been evicted from the heap.
+	 */
+	bool evicted;
+} HuffmanSketch;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Hashes a word for one row of a {@link HuffmanSketch}, mixing all bits
+ * (splitmix64 finalizer).
+ *
+ * @param[in] word Word to be hashed.
+ * @param[in] seed Row of hash.
+ *
+ * @return Hash of word.
+ */
+static inline uint64_t sketch_hash(uint64_t word,
+								   uint64_t seed) {
+	uint64_t h = word + (seed + 1) * 0x9E3779B97F4A7C15ull;
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+	return h ^ (h >> 31);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocates an empty sketch within a memory budget. The registers take
+ * {@link HUFFMAN_SKETCH_REGISTERS} bytes, the rest is split evenly between
+ * the counters and the heap with its index.
+ *
+ * @param[out]    sketch Sketch to be allocated.
+ * @param[in]     budget Bytes available, at least {@link HUFFMAN_MIN_BUDGET}.
+ * @param[in,out] ctx    Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if allocation failed.
+ */
+static HuffmanError sketch_alloc(HuffmanSketch* sketch,
+								 uint64_t budget,
+								 HuffmanContext* ctx) {
+	uint64_t half = (budget - HUFFMAN_SKETCH_REGISTERS) / 2;
+
+	sketch->width = 1;
+	while (sketch->width * 2 * HUFFMAN_SKETCH_DEPTH * sizeof(uint64_t) <= half) {
+		sketch->width <<= 1;
+	}
+	// Heap entry of 4 values and 2 index entries of 2 values per word, plus
+	// 2 spare index entries
+	sketch->maxHeavy = (half - 2 * 2 * sizeof(uint64_t)) / (8 * sizeof(uint64_t));
+	sketch->numHeavy = 0;
+	sketch->numIndexed = 0;
+	sketch->evicted = false;
+	sketch->index.size = 2 * sketch->maxHeavy + 2;
+
+	sketch->counters = table_alloc(ctx, sketch->width * HUFFMAN_SKETCH_DEPTH / 2);
+	sketch->registers = (uint8_t*) table_alloc(ctx, HUFFMAN_SKETCH_REGISTERS / (2 * sizeof(uint64_t)));
+	sketch->heap = table_alloc(ctx, 2 * sketch->maxHeavy);
+	sketch->index.table = table_alloc(ctx, sketch->index.size);
+	if (!sketch->counters || !sketch->registers || !sketch->heap || !sketch->index.table) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Releases a sketch allocated by {@link sketch_alloc}, including after a
+ * failed allocation.
+ *
+ * @param[in,out] sketch Sketch to be released.
+ * @param[in,out] ctx    Context sketch was allocated from, or null.
+ */
+static void sketch_free(HuffmanSketch* sketch,
+						HuffmanContext* ctx) {
+	if (sketch->index.table) {
+		table_free(ctx, sketch->index.table, sketch->index.size);
+	}
+	if (sketch->heap) {
+		table_free(ctx, sketch->heap, 2 * sketch->maxHeavy);
+	}
+	if (sketch->registers) {
+		table_free(ctx, (uint64_t*) sketch->registers,
+				HUFFMAN_SKETCH_REGISTERS / (2 * sizeof(uint64_t)));
+	}
+	if (sketch->counters) {
+		table_free(ctx, sketch->counters, sketch->width * HUFFMAN_SKETCH_DEPTH / 2);
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Swaps two heap entries of a sketch, keeping the index pointing at them.
+ *
+ * @param[in,out] sketch Sketch to be updated.
+ * @param[in]     a      Position of first entry.
+ * @param[in]     b      Position of second entry.
+ */
+static inline void sketch_swap(HuffmanSketch* sketch,
+							   uint64_t a,
+							   uint64_t b) {
+	uint64_t* heap = sketch->heap;
+	uint64_t i, temp;
+	for (i = 0; i < 4; i++) {
+		temp = heap[4 * a + i];
+		heap[4 * a + i] = heap[4 * b + i];
+		heap[4 * b + i] = temp;
+	}
+	*get_table_value(sketch->index.table, heap[4 * a + 2]) = a + 1;
+	*get_table_value(sketch->index.table, heap[4 * b + 2]) = b + 1;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Moves a heap entry of a sketch down until no child has a lower count.
+ *
+ * @param[in,out] sketch Sketch to be updated.
+ * @param[in]     pos    Position of entry.
+ * @param[in]     size   Number of heap entries considered.
+ */
+static void sketch_sift_down(HuffmanSketch* sketch,
+							 uint64_t pos,
+							 uint64_t size) {
+	uint64_t* heap = sketch->heap;
+	uint64_t child;
+	while ((child = 2 * pos + 1) < size) {
+		if (child + 1 < size && heap[4 * (child + 1)] < heap[4 * child]) {
+			child++;
+		}
+		if (heap[4 * pos] <= heap[4 * child]) {
+			break;
+		}
+		sketch_swap(sketch, pos, child);
+		pos = child;
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Moves a heap entry of a sketch up until its parent does not have a higher
+ * count.
+ *
+ * @param[in,out] sketch Sketch to be updated.
+ * @param[in]     pos    Position of entry.
+ */
+static void sketch_sift_up(HuffmanSketch* sketch,
+						   uint64_t pos) {
+	uint64_t* heap = sketch->heap;
+	while (pos > 0 && heap[4 * ((pos - 1) / 2)] > heap[4 * pos]) {
+		sketch_swap(sketch, pos, (pos - 1) / 2);
+		pos = (pos - 1) / 2;
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Rebuilds the index of a sketch from its heap, dropping evicted entries.
+ *
+ * @param[in,out] sketch Sketch to be updated.
+ */
+static void sketch_reindex(HuffmanSketch* sketch) {
+	uint64_t pos, slot;
+	memset(sketch->index.table, 0x00, 2 * sizeof(uint64_t) * sketch->index.size);
+	for (pos = 0; pos < sketch->numHeavy; pos++) {
+		// Cannot fail, index at most half full
+		search_table(&slot, &sketch->index, sketch->heap[4 * pos + 1], true);
+		*get_table_value(sketch->index.table, slot) = pos + 1;
+		*get_table_id(sketch->index.table, slot) = sketch->heap[4 * pos + 1];
+		sketch->heap[4 * pos + 2] = slot;
+	}
+	sketch->numIndexed = sketch->numHeavy;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds a word to a sketch. The word's estimated count is the least of its
+ * counters after raising only those below it (conservative update). The
+ * word enters the heap if the heap has room or the estimate beats the least
+ * frequent word in it, which is evicted. Words in the heap also count their
+ * own occurrences, which collisions do not inflate.
+ *
+ * @param[in,out] sketch Sketch to be updated.
+ * @param[in]     word   Word to be added.
+ */
+static void sketch_add(HuffmanSketch* sketch,
+					   uint64_t word) {
+	uint64_t cols[HUFFMAN_SKETCH_DEPTH];
+	uint64_t est = HUFFMAN_MAX_UINT64;
+	uint64_t row, hash, slot, pos, hits;
+	uint64_t* val;
+	uint8_t bits = log2_ceil_u64(HUFFMAN_SKETCH_REGISTERS);
+	uint8_t rank;
+
+	// Count-min sketch
+	for (row = 0; row < HUFFMAN_SKETCH_DEPTH; row++) {
+		cols[row] = row * sketch->width + (sketch_hash(word, row) & (sketch->width - 1));
+		if (sketch->counters[cols[row]] < est) {
+			est = sketch->counters[cols[row]];
+		}
+	}
+	est++;
+	for (row = 0; row < HUFFMAN_SKETCH_DEPTH; row++) {
+		if (sketch->counters[cols[row]] < est) {
+			sketch->counters[cols[row]] = est;
+		}
+	}
+
+	// Register of hash keeps largest position of first set bit
+	hash = sketch_hash(word, HUFFMAN_SKETCH_DEPTH);
+	rank = (uint8_t) __builtin_clzll((hash << bits) | (((uint64_t) 1) << (bits - 1))) + 1;
+	if (sketch->registers[hash >> (64 - bits)] < rank) {
+		sketch->registers[hash >> (64 - bits)] = rank;
+	}
+
+	// Heavy hitters, index at most 3/4 full so search cannot fail
+	search_table(&slot, &sketch->index, word, false);
+	val = get_table_value(sketch->index.table, slot);
+	if (*val != 0 && !(*val & HUFFMAN_SKETCH_EVICTED)) {
+		pos = *val - 1;
+		sketch->heap[4 * pos] = est;
+		sketch->heap[4 * pos + 3]++;
+		sketch_sift_down(sketch, pos, sketch->numHeavy);
+		return;
+	}
+	if (sketch->numHeavy < sketch->maxHeavy) {
+		pos = sketch->numHeavy++;
+	} else if (sketch->numHeavy > 0 && est > sketch->heap[0]) {
+		pos = 0;
+		*get_table_value(sketch->index.table, sketch->heap[2]) =
+				sketch->heap[3] | HUFFMAN_SKETCH_EVICTED;
+		sketch->evicted = true;
+	} else {
+		return;
+	}
+	hits = (*val & ~HUFFMAN_SKETCH_EVICTED) + 1;
+	if (*val == 0) {
+		sketch->numIndexed++;
+	}
+	*val = pos + 1;
+	*get_table_id(sketch->index.table, slot) = word;
+	sketch->heap[4 * pos] = est;
+	sketch->heap[4 * pos + 1] = word;
+	sketch->heap[4 * pos + 2] = slot;
+	sketch->heap[4 * pos + 3] = hits;
+	if (pos == 0) {
+		sketch_sift_down(sketch, pos, sketch->numHeavy);
+	} else {
+		sketch_sift_up(sketch, pos);
+	}
+	if (sketch->numIndexed >= sketch->index.size - sketch->index.size / 4) {
+		sketch_reindex(sketch);
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Estimates the number of unique words added to a sketch from its registers
+ * (HyperLogLog), using linear counting while registers are left empty and
+ * the estimate is small.
+ *
+ * @param[in] sketch Sketch to be read.
+ *
+ * @return Estimated number of unique words.
+ */
+static uint64_t sketch_unique(const HuffmanSketch* sketch) {
+	const double m = (double) HUFFMAN_SKETCH_REGISTERS;
+	double sum = 0.0, est;
+	uint64_t i, zeros = 0;
+	for (i = 0; i < HUFFMAN_SKETCH_REGISTERS; i++) {
+		sum += ldexp(1.0, -sketch->registers[i]);
+		zeros += sketch->registers[i] == 0;
+	}
+	est = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+	if (est <= 2.5 * m && zeros > 0) {
+		est = m * log(m / (double) zeros);
+	}
+	return (uint64_t) (est + 0.5);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Estimated frequencies of words by decreasing frequency: the heavy hitters
+ * of a sketch, and the other words sharing the remaining count evenly, placed
+ * among the heavy hitters by count.
+ */
+typedef struct HuffmanProfile_struct {
+	/**
+	 * Heavy hitter entries of a sketch, most frequent first.
+	 */
+	const uint64_t* heavy;
+	/**
+	 * Number of heavy hitters.
+	 */
+	uint64_t numHeavy;
+	/**
+	 * Number of heavy hitters ranked ahead of the other words.
+	 */
+	uint64_t split;
+	/**
+	 * Number of other words.
+	 */
+	uint64_t tailWords;
+	/**
+	 * Count of each other word.
+	 */
+	uint64_t tailCount;
+	/**
+	 * Number of other words counted once more than tailCount, ranked first.
+	 */
+	uint64_t tailExtra;
+} HuffmanProfile;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Finds the estimated count of the word at a rank of a profile.
+ *
+ * @param[in] profile Profile to be read.
+ * @param[in] rank    Rank of word.
+ *
+ * @return Estimated count.
+ */
+static inline uint64_t profile_count(const HuffmanProfile* profile,
+									 uint64_t rank) {
+	if (rank < profile->split) {
+		return profile->heavy[4 * rank];
+	}
+	rank -= profile->split;
+	if (rank < profile->tailWords) {
+		return profile->tailCount + (rank < profile->tailExtra);
+	}
+	return profile->heavy[4 * (profile->split + rank - profile->tailWords)];
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Builds the profile of a sketch. The heap is sorted in place and no longer
+ * usable as a heap.
+ *
+ * @param[out]    profile  Profile to be built.
+ * @param[out]    est      Error bounds of profile.
+ * @param[in,out] sketch   Sketch to be read.
+ * @param[in]     numWords Number of words added to sketch.
+ * @param[in]     wordSize Word size used for compression.
+ *
+ * @return Estimated number of unique words.
+ */
+static uint64_t build_profile(HuffmanProfile* profile,
+							  HuffmanEstimate* est,
+							  HuffmanSketch* sketch,
+							  uint64_t numWords,
+							  uint8_t wordSize) {
+	uint64_t i, rest, uniqueWords, tailMax;
+
+	// Heavy hitters count occurrences since entering heap, exact for words
+	// tracked from their first occurrence rather than inflated by collisions.
+	// Min-heap of these sorts into decreasing order.
+	for (i = 0; i < sketch->numHeavy; i++) {
+		sketch->heap[4 * i] = sketch->heap[4 * i + 3];
+	}
+	for (i = sketch->numHeavy / 2; i > 0; i--) {
+		sketch_sift_down(sketch, i - 1, sketch->numHeavy);
+	}
+	for (i = sketch->numHeavy; i > 1; i--) {
+		sketch_swap(sketch, 0, i - 1);
+		sketch_sift_down(sketch, 0, i - 1);
+	}
+	profile->heavy = sketch->heap;
+	profile->numHeavy = sketch->numHeavy;
+
+	est->numWords = numWords;
+	est->heavyWords = sketch->numHeavy;
+	est->heavyCount = 0;
+	for (i = 0; i < sketch->numHeavy; i++) {
+		est->heavyCount += sketch->heap[4 * i];
+	}
+	est->countError = (uint64_t) ceil(exp(1.0) * (double) numWords / (double) sketch->width);
+	est->confidence = 1.0 - exp(-(double) HUFFMAN_SKETCH_DEPTH);
+	est->uniqueError = 0.0;
+
+	// Every word is in the heap unless one was evicted
+	uniqueWords = sketch->numHeavy;
+	if (sketch->evicted) {
+		est->uniqueError = 1.04 / sqrt((double) HUFFMAN_SKETCH_REGISTERS);
+		uniqueWords = sketch_unique(sketch);
+		if (uniqueWords > get_max_table_size(wordSize)) {
+			uniqueWords = get_max_table_size(wordSize);
+		}
+		if (uniqueWords > numWords) {
+			uniqueWords = numWords;
+		}
+		if (uniqueWords < sketch->numHeavy) {
+			uniqueWords = sketch->numHeavy;
+		}
+	}
+
+	// Other words share what heavy hitters leave, at least 1 each
+	profile->tailWords = uniqueWords - sketch->numHeavy;
+	profile->tailCount = 1;
+	profile->tailExtra = 0;
+	rest = (numWords > est->heavyCount) ? numWords - est->heavyCount : 0;
+	if (profile->tailWords > 0 && rest > profile->tailWords) {
+		profile->tailCount = rest / profile->tailWords;
+		profile->tailExtra = rest % profile->tailWords;
+	}
+	tailMax = profile->tailCount + (profile->tailExtra > 0);
+	for (profile->split = 0; profile->split < sketch->numHeavy &&
+			sketch->heap[4 * profile->split] >= tailMax; profile->split++);
+	return uniqueWords;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Calculates statistics for a mapping from a profile, as
+ * {@link calculate_stats} and {@link calculate_entropy} do from a table.
+ *
+ * @param[out] dst         Destination for calculation results.
+ * @param[in]  profile     Estimated word frequencies.
+ * @param[in]  uniqueWords Number of words in profile.
+ * @param[in]  compressor  Mapping used for calculation.
+ * @param[in]  mapCtx      Mapping constants.
+ */
+static void calculate_profile_stats(HuffmanStats* dst,
+									const HuffmanProfile* profile,
+									uint64_t uniqueWords,
+									const HuffmanCompressor* compressor,
+									const HuffmanMapContext* mapCtx) {
+	uint8_t lengths[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	uint64_t idx, i, blockSize, count;
+	uint64_t bits = 0, total = 0;
+	double sum = 0.0, minBits;
+	bool bulk;
+
+	for (idx = 0; idx < uniqueWords; idx += blockSize) {
+		blockSize = uniqueWords - idx;
+		if (blockSize > HUFFMAN_CODE_LENGTH_BLOCK_SIZE) {
+			blockSize = HUFFMAN_CODE_LENGTH_BLOCK_SIZE;
+		}
+		bulk = compressor->getSizes != NULL &&
+				compressor->getSizes(lengths, idx, blockSize, mapCtx) == ERR_NO_ERR;
+		for (i = 0; i < blockSize; i++) {
+			count = profile_count(profile, idx + i);
+			bits += count * (bulk ? lengths[i] : compressor->getSize(idx + i, mapCtx));
+			total += count;
+			sum += count * log2((double) count);
+		}
+	}
+	dst->dataSizeBytes = (bits + 7) / 8;
+	dst->dataBitsInLastByte = bits % 8;
+	dst->compressor = compressor;
+	dst->depthParam = mapCtx->depth;
+
+	// Sum of count * log2(total / count)
+	minBits = (total > 0) ? total * log2((double) total) - sum : 0.0;
+	if (minBits < 0.0) {
+		minBits = 0.0;
+	}
+	set_entropy_stats(dst, (total > 0) ? minBits / total : 0.0, (uint64_t) ceil(minBits));
+}
+
+/**
+ * Estimates the compressed size of data under a mapping in fixed memory,
+ * reading the data once. Rather than counting every word exactly as
+ * {@link huffman_calculate_compressed_size_ctx} does, words are summarized in
+ * a count-min sketch with conservative update, which tracks the most
+ * frequent words in a heap, and registers estimating the number of unique
+ * words (HyperLogLog). The estimated frequency profile is the most frequent
+ * words by estimated count, with all other words sharing the remaining count
+ * evenly. This suits large word sizes with many unique words, where an exact
+ * table would not fit.
+ *
+ * @param[out]    dst        Destination for estimated results.
+ * @param[out]    est        Error bounds of estimate.
+ * @param[out]    hdr        Header populated with metadata, uniqueWords
+ *                           being estimated.
+ * @param[in]     src        Data to be converted.
+ * @param[in]     srcSize    Size of data in bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     compressor Mapping used to calculate compressed size of a word.
+ * @param[in]     depthParam Depth parameter passed into mapping functions.
+ * @param[in]     budget     Bytes available for the sketch.
+ * @param[in,out] ctx        Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted
+ *              range, or budget is less than {@link HUFFMAN_MIN_BUDGET}.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate sketch.\n
+ *         Other errors as raised by {@link huffman_init_map_context} and
+ *         {@link extract_bits}.
+ */
+HuffmanError huffman_estimate_compressed_size(HuffmanStats* dst,
+											  HuffmanEstimate* est,
+											  HuffmanHeader* hdr,
+											  uint8_t* src,
+											  uint64_t srcSize,
+											  uint8_t wordSize,
+											  const HuffmanCompressor* compressor,
+											  uint8_t depthParam,
+											  uint64_t budget,
+											  HuffmanContext* ctx) {
+	if (dst == NULL || est == NULL || hdr == NULL || src == NULL ||
+			compressor == NULL || compressor->getSize == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE ||
+			budget < HUFFMAN_MIN_BUDGET) {
+		return ERR_INVALID_VALUE;
+	}
+
+	HuffmanError err;
+	HuffmanContextMark mark;
+	HuffmanMapContext mapCtx;
+	HuffmanSketch sketch;
+	HuffmanProfile profile;
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, srcSize, wordSize);
+	uint64_t i, word, uniqueWords;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+
+	// Validate mapping parameters before doing any work
+	THROW_ERR(huffman_init_map_context(&mapCtx, compressor, 0, depthParam))
+
+	context_enter(&mark, ctx);
+	err = sketch_alloc(&sketch, budget, ctx);
+
+	// Summarize words, padding incomplete last word with 0's
+	INSTRUMENT_START(ctx, histogramStart);
+	for (i = 0; !err && i < numWords; i++) {
+		if (i == numWords - 1 && finalBits != 0) {
+			err = extract_bits(&word, &currPtr, &currBit, finalBits);
+			word <<= wordSize - finalBits;
+		} else {
+			err = extract_bits(&word, &currPtr, &currBit, wordSize);
+		}
+		if (!err) {
+			sketch_add(&sketch, word);
+		}
+	}
+	INSTRUMENT_ADD(ctx, wordsProcessed, numWords);
+	INSTRUMENT_STOP(ctx, histogramStart, histogramNs);
+
+	// Estimate size from profile
+	if (!err) {
+		INSTRUMENT_START(ctx, sizeStart);
+		uniqueWords = build_profile(&profile, est, &sketch, numWords, wordSize);
+		hdr->wordSize = wordSize;
+		hdr->padBits = wordSize - finalBits;
+		hdr->uniqueWords = uniqueWords;
+		err = huffman_init_map_context(&mapCtx, compressor, uniqueWords, depthParam);
+		if (!err) {
+			calculate_profile_stats(dst, &profile, uniqueWords, compressor, &mapCtx);
+		}
+		INSTRUMENT_STOP(ctx, sizeStart, sizeNs);
+	}
+
+	sketch_free(&sketch, ctx);
+	context_leave(ctx, &mark);
+	return err;
+}
+
+/**
+ * Registers a custom mapping to be evaluated by
+ * {@link huffman_compare_compressors} alongside the built-in mappings.
+ *
+ * @warning Registration is not thread-safe; register mappings before
+ *          comparing from multiple threads.
+ *
+ * @param[in] compressor Mapping to be registered. Must remain valid until
+ *                       {@link huffman_clear_compressors} is called.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if compressor or its size function are null.\n
+ *         {@link ERR_INVALID_VALUE} if compressor is already registered.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if
+ *              {@link HUFFMAN_MAX_CUSTOM_COMPRESSORS} mappings are registered.
+ */
+HuffmanError huffman_register_compressor(const HuffmanCompressor* compressor) {
+	if (compressor == NULL || compressor->getSize == NULL) {
+		return ERR_NULL_PTR;
+	}
+	for (uint8_t i = 0; i < numCustomCompressors; i++) {
+		if (customCompressors[i] == compressor) {
+			return ERR_INVALID_VALUE;
+		}
+	}
+	if (numCustomCompressors == HUFFMAN_MAX_CUSTOM_COMPRESSORS) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	customCompressors[numCustomCompressors++] = compressor;
+	return ERR_NO_ERR;
+}
+
+/**
+ * Removes all mappings registered via {@link huffman_register_compressor}.
+ */
+void huffman_clear_compressors(void) {
+	numCustomCompressors = 0;
+}
+
+/**
+ * Evaluates every mapping against the same sorted frequency table. The table
+ * is built once, then {@link OneHot}, {@link FixDepthTree} at every depth
+ * from 0 to ceil(log2(uniqueWords)), {@link LogDepthTree} and all registered
+ * mappings are evaluated against it.
+ *
+ * @param[out]    dst      Destination for results, sorted by increasing
+ *                         compressed size. Ties keep evaluation order.
+ * @param[in,out] dstCount Capacity of dst. Updated to number of results
+ *                         written; only the best results are kept if more
+ *                         candidates were evaluated than fit in dst.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
+ *         Other errors as raised by {@link build_sorted_table} and
+ *         {@link huffman_init_map_context}.
+ */
+HuffmanError huffman_compare_compressors(HuffmanStats* dst,
+										 uint64_t* dstCount,
+										 HuffmanHeader* hdr,
+										 uint8_t* src,
+										 uint64_t srcSize,
+										 uint8_t wordSize) {
+	return huffman_compare_compressors_ctx(dst, dstCount, hdr, src, srcSize, wordSize, NULL);
+}
+
+/**
+ * Evaluates every mapping against the same sorted frequency table, allocating
+ * the table from a reusable context.
+ *
+ * @see huffman_compare_compressors
+ *
+ * @param[out]    dst      Destination for results, sorted by increasing
+ *                         compressed size.
+ * @param[in,out] dstCount Capacity of dst. Updated to number of results written.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return Errors as raised by {@link huffman_compare_compressors}.
+ */
+HuffmanError huffman_compare_compressors_ctx(HuffmanStats* dst,
+											 uint64_t* dstCount,
+											 HuffmanHeader* hdr,
+											 uint8_t* src,
+											 uint64_t srcSize,
+											 uint8_t wordSize,
+											 HuffmanContext* ctx) {
+	HuffmanError err;
+	if (dst == NULL || dstCount == NULL || hdr == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+
+	const uint8_t numBuiltins = HUFFMAN_NUM_BUILTIN_COMPRESSORS;
+	const HuffmanCompressor* compressor;
+	HuffmanHashTable table;
+	HuffmanMapContext mapCtx;
+	HuffmanContextMark mark;
+	HuffmanStats stats;
+	uint64_t capacity = *dstCount;
+	uint64_t count = 0;
+	uint64_t minBits;
+	double entropy;
+	uint8_t maxDepth, depth, i;
+
+	context_enter(&mark, ctx);
+	err = build_sorted_table(hdr, &table, src, srcSize, wordSize, NULL, ctx);
+	if (err) {
+		context_leave(ctx, &mark);
+		return err;
+	}
+
+	// Deeper trees than this only add bits to every word
+	INSTRUMENT_START(ctx, sizeStart);
+	maxDepth = log2_ceil_u64(hdr->uniqueWords);
+	entropy = calculate_entropy(&minBits, hdr, &table);
+
+	for (i = 0; !err && i < numBuiltins + numCustomCompressors; i++) {
+		compressor = (i < numBuiltins) ? builtinCompressors[i] : customCompressors[i - numBuiltins];
+		for (depth = 0; depth <= compressor->maxDepth && depth <= maxDepth; depth++) {
+			err = huffman_init_map_context(&mapCtx, compressor, hdr->uniqueWords, depth);
+			if (err) {
+				break;
+			}
+			calculate_stats(&stats, hdr, &table, compressor, &mapCtx);
+			set_entropy_stats(&stats, entropy, minBits);
+			insert_ranked(dst, &count, capacity, &stats);
+		}
+	}
+	INSTRUMENT_STOP(ctx, sizeStart, sizeNs);
+
+	table_free(ctx, table.table, table.size);
+	context_leave(ctx, &mark);
+	if (err) {
+		return err;
+	}
+	*dstCount = count;
+
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Selects the built-in mapping and depth giving the smallest compressed size
+ * for a sorted table. Only built-in mappings are considered, since frames and
+ * dictionaries identify their mapping by position in
+ * {@link builtinCompressors}.
+ *
+ * @param[out] best        Results of best mapping.
+ * @param[in]  hdr         Header containing metadata for table.
+ * @param[in]  table       Table sorted by {@link sort_table}.
+ * @param[in]  extraIdx    Number of indices reserved after the table's words,
+ *                         e.g. for an escape code.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by {@link huffman_init_map_context}.
+ */
+static HuffmanError select_builtin(HuffmanStats* best,
+								   HuffmanHeader* hdr,
+								   HuffmanHashTable* table,
+								   uint64_t extraIdx) {
+	HuffmanError err;
+	HuffmanMapContext mapCtx;
+	HuffmanStats stats;
+	uint64_t count = 0;
+	uint8_t maxDepth = log2_ceil_u64(hdr->uniqueWords + extraIdx);
+	uint8_t depth, i;
+
+	for (i = 0; i < HUFFMAN_NUM_BUILTIN_COMPRESSORS; i++) {
+		const HuffmanCompressor* compressor = builtinCompressors[i];
+		for (depth = 0; depth <= compressor->maxDepth && depth <= maxDepth; depth++) {
+			THROW_ERR(huffman_init_map_context(&mapCtx, compressor, hdr->uniqueWords + extraIdx, depth))
+			calculate_stats(&stats, hdr, table, compressor, &mapCtx);
+			insert_ranked(best, &count, 1, &stats);
+		}
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Obtains the position of a mapping in {@link builtinCompressors}.
+ *
+ * @param[in] compressor Mapping to be found.
+ *
+ * @return Position of mapping, or {@link HUFFMAN_NUM_BUILTIN_COMPRESSORS} if
+ *         mapping is not built in.
+ */
+static uint8_t get_builtin_id(const HuffmanCompressor* compressor) {
+	uint8_t i;
+	for (i = 0; i < HUFFMAN_NUM_BUILTIN_COMPRESSORS; i++) {
+		if (builtinCompressors[i] == compressor) {
+			break;
+		}
+	}
+	return i;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the number of entries of a lookup table built by
+ * {@link build_rank_lookup}. Tables are kept at most half full.
+ *
+ * @param[in] uniqueWords Number of words in table.
+ *
+ * @return Number of entries.
+ */
+static inline uint64_t get_lookup_size(uint64_t uniqueWords) {
+	return ((uint64_t) 1) << (log2_ceil_u64(uniqueWords) + 1);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Populates a zeroed hash table mapping each word to its rank + 1.
+ *
+ * @param[in,out] lookup      Table of {@link get_lookup_size} entries.
+ * @param[in]     words       Words by decreasing frequency.
+ * @param[in]     stride      Distance between consecutive words in words.
+ * @param[in]     uniqueWords Number of ranks in words.
+ * @param[in]     escapeIdx   Rank reserved for escape, whose entry in words is
+ *                            skipped, or {@link HUFFMAN_MAX_UINT64}.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by {@link search_table}.
+ */
+static HuffmanError build_rank_lookup(HuffmanHashTable* lookup,
+									  const uint64_t* words,
+									  uint64_t stride,
+									  uint64_t uniqueWords,
+									  uint64_t escapeIdx) {
+	HuffmanError err;
+	uint64_t rank, slot;
+	for (rank = 0; rank < uniqueWords; rank++) {
+		if (rank == escapeIdx) {
+			continue;
+		}
+		THROW_ERR(search_table(&slot, lookup, words[rank * stride], false))
+		if (*get_table_value(lookup->table, slot) == 0) {
+			*get_table_value(lookup->table, slot) = rank + 1;
+			*get_table_id(lookup->table, slot) = words[rank * stride];
+		}
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Finds the rank of a word in a table built by {@link build_rank_lookup}.
+ *
+ * @param[out] rank   Rank of word, if found.
+ * @param[in]  lookup Table to be searched.
+ * @param[in]  word   Word to be found.
+ *
+ * @return True if word was found.
+ */
+static inline bool lookup_rank(uint64_t* rank,
+							   const HuffmanHashTable* lookup,
+							   uint64_t word) {
+	uint64_t slot;
+	if (search_table(&slot, (HuffmanHashTable*) lookup, word, false) != ERR_NO_ERR ||
+			*get_table_value(lookup->table, slot) == 0) {
+		return false;
+	}
+	*rank = *get_table_value(lookup->table, slot) - 1;
+	return true;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Finds the rank of an incomplete last word, padded with 0's or, if not
+ * found, with 1's.
+ *
+ * @param[out] rank    Rank of padded word, if found.
+ * @param[in]  lookup  Table to be searched.
+ * @param[in]  word    Data bits of word, in the low bits.
+ * @param[in]  padBits Number of padding bits.
+ *
+ * @return True if either padded word was found.
+ */
+static inline bool lookup_last_rank(uint64_t* rank,
+									const HuffmanHashTable* lookup,
+									uint64_t word,
+									uint8_t padBits) {
+	word <<= padBits;
+	return lookup_rank(rank, lookup, word) ||
+			lookup_rank(rank, lookup, word | ((((uint64_t) 1) << padBits) - 1));
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Frequency table gathered word by word while coding a block.
+ */
+typedef struct HuffmanHistogram_struct {
+	/**
+	 * Table of word frequencies.
+	 */
+	HuffmanHashTable table;
+	/**
+	 * Number of unique words in table.
+	 */
+	uint64_t numWords;
+	/**
+	 * Maximum size of table.
+	 */
+	uint64_t maxSize;
+	/**
+	 * Context table is allocated from.
+	 */
+	HuffmanContext* ctx;
+} HuffmanHistogram;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Allocates an empty histogram sized as {@link generate_table} would for the
+ * same number of words, so that counting the same words in the same order
+ * always produces the same table.
+ *
+ * @param[out]    hist      Histogram to be initialized.
+ * @param[in]     wordSize  Word size used for compression.
+ * @param[in]     wordCount Number of words to be counted.
+ * @param[in,out] ctx       Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if allocation failed.
+ */
+static HuffmanError histogram_init(HuffmanHistogram* hist,
+								   uint8_t wordSize,
+								   uint64_t wordCount,
+								   HuffmanContext* ctx) {
+	hist->numWords = 0;
+	hist->maxSize = get_max_table_size(wordSize);
+	hist->ctx = ctx;
+	hist->table.size = get_initial_table_size(wordSize, wordCount);
+	hist->table.table = table_alloc(ctx, hist->table.size);
+	return hist->table.table ? ERR_NO_ERR : ERR_INSUFFICIENT_SPACE;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Codes every word of the source. The incomplete last word, if any, is padded
+ * with 0's or 1's, whichever is found in the lookup.
+ *
+ * @param[in,out] dst      Pointer to first byte in which to set data. Updated to first byte of following section.
+ * @param[in,out] start    Bit from which to start. Updated to first bit of following section. Range 0-7.
+ * @param[in,out] dstSize  Number of bytes free in dst. Updated to remaining number of bytes.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in]     lookup   Table from word to rank + 1.
+ * @param[in]     compressor Mapping used to code ranks.
+ * @param[in]     mapCtx   Mapping constants.
+ * @param[in]     escapeIdx Index coding words missing from lookup, followed
+ *                         by the word, or {@link HUFFMAN_MAX_UINT64} if every
+ *                         word must be found.
+ * @param[in,out] hist     Histogram to which every complete word is added,
+ *                         or null.
+ * @param[in,out] crc      CRC32C to which the source is added a block at a
+ *                         time as it is read, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INVALID_DATA} if a word is missing and there is no escape.\n
+ *         Other errors as raised by {@link put_bits}.
+ */
+static HuffmanError encode_words(uint8_t** dst,
+								 uint8_t* start,
+								 uint64_t* dstSize,
+								 uint8_t* src,
+								 uint64_t srcSize,
+								 uint8_t wordSize,
+								 const HuffmanHashTable* lookup,
+								 const HuffmanCompressor* compressor,
+								 const HuffmanMapContext* mapCtx,
+								 uint64_t escapeIdx,
+								 HuffmanHistogram* hist,
+								 uint32_t* crc) {
+	HuffmanError err;
+	uint64_t block[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, srcSize, wordSize);
+	uint8_t padBits = (wordSize - finalBits) % wordSize;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+	const uint8_t* crcPtr = src;
+	uint64_t i, j, count, full, word, rank;
+	bool found;
+
+	for (i = 0; i < numWords; i += count) {
+		// Read a block of words, the incomplete last word by itself
+		count = (numWords - i < HUFFMAN_CODE_LENGTH_BLOCK_SIZE) ?
+				numWords - i : HUFFMAN_CODE_LENGTH_BLOCK_SIZE;
+		full = (i + count == numWords && finalBits != 0) ? count - 1 : count;
+		THROW_ERR(unpack_words(block, &currPtr, &currBit, src + srcSize, full, wordSize))
+		if (full < count) {
+			THROW_ERR(extract_bits(&block[full], &currPtr, &currBit, finalBits))
+		}
+		update_crc(crc, &crcPtr, currPtr);
+
+		for (j = 0; j < count; j++) {
+			word = block[j];
+			if (j == full) {
+				found = lookup_last_rank(&rank, lookup, word, padBits);
+				word <<= padBits;
+			} else {
+				found = lookup_rank(&rank, lookup, word);
+				if (hist) {
+					THROW_ERR(add_to_table(&hist->table, &hist->numWords, word, hist->maxSize, hist->ctx))
+				}
+			}
+
+			if (!found) {
+				if (escapeIdx == HUFFMAN_MAX_UINT64) {
+					return ERR_INVALID_DATA;
+				}
+				rank = escapeIdx;
+			}
+			THROW_ERR(put_code(dst, start, dstSize,
+					compressor->getVal(rank, mapCtx), compressor->getSize(rank, mapCtx)))
+			if (!found) {
+				THROW_ERR(put_bits(dst, start, dstSize, word, wordSize))
+			}
+		}
+	}
+	update_crc(crc, &crcPtr, src + srcSize);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Decodes words coded by {@link encode_words}. Only the data bits of the
+ * last word are written.
+ *
+ * @param[out]    dst        Destination for decoded data.
+ * @param[in]     dstSize    Size of decoded data in bytes.
+ * @param[in,out] src        Pointer to byte from which to read. Updated to first byte following codes.
+ * @param[in,out] start      Bit from which to start. Updated to bit following codes. Range 0-7.
+ * @param[in,out] srcSize    Number of bytes remaining in src. Updated to remaining number of bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     words      Words by rank.
+ * @param[in]     compressor Mapping used to code ranks.
+ * @param[in]     mapCtx     Mapping constants.
+ * @param[in]     escapeIdx  Index followed by a word missing from words, or
+ *                           {@link HUFFMAN_MAX_UINT64} if there is none.
+ * @param[in,out] hist       Histogram to which every complete word is added,
+ *                           or null.
+ * @param[in,out] crc        CRC32C to which decoded data is added as it is
+ *                           written, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by the mapping's parse functions and
+ *         {@link read_bits}.
+ */
+static HuffmanError decode_words(uint8_t* dst,
+								 uint64_t dstSize,
+								 uint8_t** src,
+								 uint8_t* start,
+								 uint64_t* srcSize,
+								 uint8_t wordSize,
+								 const uint64_t* words,
+								 const HuffmanCompressor* compressor,
+								 const HuffmanMapContext* mapCtx,
+								 uint64_t escapeIdx,
+								 HuffmanHistogram* hist,
+								 uint32_t* crc) {
+	HuffmanError err;
+	uint64_t idx[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, dstSize, wordSize);
+	uint8_t padBits = (wordSize - finalBits) % wordSize;
+	uint8_t* outPtr = dst;
+	uint8_t outBit = 0;
+	uint64_t outSize = dstSize;
+	const uint8_t* crcPtr = dst;
+	uint64_t i, j, count, full;
+
+	for (i = 0; i < numWords; i += count) {
+		// Replace ranks by words
+		if (escapeIdx != HUFFMAN_MAX_UINT64) {
+			// Escapes interleave raw words, so parse one index at a time
+			count = 1;
+			THROW_ERR(compressor->parseIdx(idx, src, start, srcSize, mapCtx))
+			if (idx[0] == escapeIdx) {
+				THROW_ERR(read_bits(&idx[0], src, start, srcSize, wordSize))
+			} else {
+				idx[0] = words[idx[0]];
+			}
+		} else {
+			count = (numWords - i < HUFFMAN_CODE_LENGTH_BLOCK_SIZE) ?
+					numWords - i : HUFFMAN_CODE_LENGTH_BLOCK_SIZE;
+			THROW_ERR(huffman_parse_compressed_idx_block(idx, count, src, start, srcSize,
+					compressor, mapCtx))
+			kernels.gather(idx, words, idx, count);
+		}
+
+		// Write block of words, the incomplete last word by itself
+		full = (i + count == numWords && finalBits != 0) ? count - 1 : count;
+		THROW_ERR(pack_words(&outPtr, &outBit, &outSize, idx, full, wordSize))
+		if (full < count) {
+			THROW_ERR(put_bits(&outPtr, &outBit, &outSize, idx[full] >> padBits, finalBits))
+		}
+		for (j = 0; hist && j < full; j++) {
+			THROW_ERR(add_to_table(&hist->table, &hist->numWords, idx[j], hist->maxSize, hist->ctx))
+		}
+		// Complete bytes only, escapes writing a word at a time
+		if (outPtr - crcPtr >= HUFFMAN_CODE_LENGTH_BLOCK_SIZE) {
+			update_crc(crc, &crcPtr, outPtr);
+		}
+	}
+	update_crc(crc, &crcPtr, dst + dstSize);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Codes every word of the source into interleaved streams, word i going to
+ * stream i % numStreams. The size of each stream but the last is written
+ * first, then the streams, each starting on a byte boundary. Words are read
+ * twice: once to size the streams, once to code them.
+ *
+ * @param[in,out] dst        Pointer to first byte in which to set data. Updated to first byte following streams.
+ * @param[in,out] start      Bit from which to start. Updated to 0.
+ * @param[in,out] dstSize    Number of bytes free in dst. Updated to remaining number of bytes.
+ * @param[in]     src        Data to be converted.
+ * @param[in]     srcSize    Size of data in bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     lookup     Table from word to rank + 1.
+ * @param[in]     compressor Mapping used to code ranks.
+ * @param[in]     mapCtx     Mapping constants.
+ * @param[in]     numStreams Number of streams. Range 1 - {@link HUFFMAN_MAX_STREAMS}.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INVALID_DATA} if a word is missing from lookup.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if streams do not fit in dst.\n
+ *         Other errors as raised by {@link put_code} and {@link put_varint}.
+ */
+static HuffmanError encode_streams(uint8_t** dst,
+								   uint8_t* start,
+								   uint64_t* dstSize,
+								   uint8_t* src,
+								   uint64_t srcSize,
+								   uint8_t wordSize,
+								   const HuffmanHashTable* lookup,
+								   const HuffmanCompressor* compressor,
+								   const HuffmanMapContext* mapCtx,
+								   uint8_t numStreams) {
+	HuffmanError err;
+	uint64_t block[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	uint64_t bits[HUFFMAN_MAX_STREAMS] = {0};
+	uint64_t sizes[HUFFMAN_MAX_STREAMS];
+	uint8_t* ptrs[HUFFMAN_MAX_STREAMS];
+	uint8_t starts[HUFFMAN_MAX_STREAMS];
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, srcSize, wordSize);
+	uint8_t padBits = (wordSize - finalBits) % wordSize;
+	uint8_t* currPtr;
+	uint8_t currBit;
+	uint64_t i, j, s, count, full, rank;
+	uint64_t total = 0;
+	int pass;
+
+	// Pass 0 sizes each stream, pass 1 codes words
+	for (pass = 0; pass < 2; pass++) {
+		currPtr = src;
+		currBit = 0;
+		for (i = 0; i < numWords; i += count) {
+			count = (numWords - i < HUFFMAN_CODE_LENGTH_BLOCK_SIZE) ?
+					numWords - i : HUFFMAN_CODE_LENGTH_BLOCK_SIZE;
+			full = (i + count == numWords && finalBits != 0) ? count - 1 : count;
+			THROW_ERR(unpack_words(block, &currPtr, &currBit, src + srcSize, full, wordSize))
+			if (full < count) {
+				THROW_ERR(extract_bits(&block[full], &currPtr, &currBit, finalBits))
+			}
+			for (j = 0; j < count; j++) {
+				if (!(j == full ? lookup_last_rank(&rank, lookup, block[j], padBits) :
+						lookup_rank(&rank, lookup, block[j]))) {
+					return ERR_INVALID_DATA;
+				}
+				s = (i + j) % numStreams;
+				if (pass == 0) {
+					bits[s] += compressor->getSize(rank, mapCtx);
+				} else {
+					THROW_ERR(put_code(&ptrs[s], &starts[s], &sizes[s],
+							compressor->getVal(rank, mapCtx), compressor->getSize(rank, mapCtx)))
+				}
+			}
+		}
+		if (pass == 1) {
+			break;
+		}
+
+		// Jump table, then streams from next byte
+		for (s = 0; s + 1 < numStreams; s++) {
+			THROW_ERR(put_varint(dst, start, dstSize, (bits[s] + 7) / 8))
+		}
+		if (*start > 0) {
+			(*dst)++;
+			(*dstSize)--;
+			*start = 0;
+		}
+		for (s = 0; s < numStreams; s++) {
+			sizes[s] = (bits[s] + 7) / 8;
+			if (sizes[s] > *dstSize - total) {
+				return ERR_INSUFFICIENT_SPACE;
+			}
+			ptrs[s] = *dst + total;
+			starts[s] = 0;
+			total += sizes[s];
+		}
+	}
+	*dst += total;
+	*dstSize -= total;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Decodes words coded by {@link encode_streams}, a block at a time. Each
+ * block takes the same number of words from every stream, which are decoded
+ * in turn. Only the data bits of the last word are written.
+ *
+ * @param[out]    dst        Destination for decoded data.
+ * @param[in]     dstSize    Size of decoded data in bytes.
+ * @param[in,out] src        Pointer to byte from which to read. Updated to first byte following streams.
+ * @param[in,out] start      Bit from which to start. Updated to 0.
+ * @param[in,out] srcSize    Number of bytes remaining in src, the last
+ *                           stream ending with src. Updated to 0.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     words      Words by rank.
+ * @param[in]     compressor Mapping used to code ranks.
+ * @param[in]     mapCtx     Mapping constants.
+ * @param[in]     numStreams Number of streams. Range 1 - {@link HUFFMAN_MAX_STREAMS}.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if a stream is truncated.\n
+ *         Other errors as raised by {@link huffman_parse_compressed_idx_streams}
+ *         and {@link read_varint}.
+ */
+static HuffmanError decode_streams(uint8_t* dst,
+								   uint64_t dstSize,
+								   uint8_t** src,
+								   uint8_t* start,
+								   uint64_t* srcSize,
+								   uint8_t wordSize,
+								   const uint64_t* words,
+								   const HuffmanCompressor* compressor,
+								   const HuffmanMapContext* mapCtx,
+								   uint8_t numStreams) {
+	HuffmanError err;
+	uint64_t idx[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	uint64_t sizes[HUFFMAN_MAX_STREAMS];
+	uint8_t* ptrs[HUFFMAN_MAX_STREAMS];
+	uint8_t starts[HUFFMAN_MAX_STREAMS];
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, dstSize, wordSize);
+	uint8_t padBits = (wordSize - finalBits) % wordSize;
+	uint64_t blockSize = HUFFMAN_CODE_LENGTH_BLOCK_SIZE - HUFFMAN_CODE_LENGTH_BLOCK_SIZE % numStreams;
+	uint8_t* outPtr = dst;
+	uint8_t outBit = 0;
+	uint64_t outSize = dstSize;
+	uint64_t i, s, count, full, total;
+
+	// Jump table, then streams from next byte
+	for (s = 0; s + 1 < numStreams; s++) {
+		THROW_ERR(read_varint(&sizes[s], src, start, srcSize))
+	}
+	if (*start > 0) {
+		(*src)++;
+		(*srcSize)--;
+		*start = 0;
+	}
+	total = 0;
+	for (s = 0; s < numStreams; s++) {
+		if (s + 1 == numStreams) {
+			sizes[s] = *srcSize - total;
+		} else if (sizes[s] > *srcSize - total) {
+			return ERR_INSUFFICIENT_SPACE;
+		}
+		ptrs[s] = *src + total;
+		starts[s] = 0;
+		total += sizes[s];
+	}
+
+	for (i = 0; i < numWords; i += count) {
+		count = (numWords - i < blockSize) ? numWords - i : blockSize;
+		THROW_ERR(huffman_parse_compressed_idx_streams(idx, count, numStreams, ptrs, starts, sizes,
+				compressor, mapCtx))
+		kernels.gather(idx, words, idx, count);
+
+		// Write block of words, the incomplete last word by itself
+		full = (i + count == numWords && finalBits != 0) ? count - 1 : count;
+		THROW_ERR(pack_words(&outPtr, &outBit, &outSize, idx, full, wordSize))
+		if (full < count) {
+			THROW_ERR(put_bits(&outPtr, &outBit, &outSize, idx[full] >> padBits, finalBits))
+		}
+	}
+	*src += *srcSize;
+	*srcSize = 0;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Codes a run of the same word as counted by {@link generate_run_table}: the
+ * word once, then either a run escape and the number of repeats, or the word
+ * again for each repeat.
+ *
+ * @param[in,out] dst        Pointer to first byte in which to set data. Updated to first byte of following section.
+ * @param[in,out] start      Bit from which to start. Updated to first bit of following section. Range 0-7.
+ * @param[in,out] dstSize    Number of bytes free in dst. Updated to remaining number of bytes.
+ * @param[in]     rank       Rank of word.
+ * @param[in]     length     Number of words in run, at least 1.
+ * @param[in]     compressor Mapping used to code ranks.
+ * @param[in]     mapCtx     Mapping constants.
+ * @param[in]     runIdx     Rank of run escape.
+ *
+ * @return Errors as raised by {@link put_code} and {@link put_varint}.
+ */
+static HuffmanError put_run(uint8_t** dst,
+							uint8_t* start,
+							uint64_t* dstSize,
+							uint64_t rank,
+							uint64_t length,
+							const HuffmanCompressor* compressor,
+							const HuffmanMapContext* mapCtx,
+							uint64_t runIdx) {
+	HuffmanError err;
+	uint64_t i;
+	uint64_t code = compressor->getVal(rank, mapCtx);
+	uint8_t size = compressor->getSize(rank, mapCtx);
+
+	if (length > HUFFMAN_MIN_RUN) {
+		THROW_ERR(put_code(dst, start, dstSize, code, size))
+		THROW_ERR(put_code(dst, start, dstSize,
+				compressor->getVal(runIdx, mapCtx), compressor->getSize(runIdx, mapCtx)))
+		return put_varint(dst, start, dstSize, length - 1);
+	}
+	for (i = 0; i < length; i++) {
+		THROW_ERR(put_code(dst, start, dstSize, code, size))
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Codes every word of the source as {@link encode_words} does, except that
+ * runs of more than {@link HUFFMAN_MIN_RUN} complete words are coded once,
+ * followed by the run escape and the number of repeats as written by
+ * {@link put_varint}.
+ *
+ * @param[in,out] dst        Pointer to first byte in which to set data. Updated to first byte of following section.
+ * @param[in,out] start      Bit from which to start. Updated to first bit of following section. Range 0-7.
+ * @param[in,out] dstSize    Number of bytes free in dst. Updated to remaining number of bytes.
+ * @param[in]     src        Data to be converted.
+ * @param[in]     srcSize    Size of data in bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     lookup     Table from word to rank + 1.
+ * @param[in]     compressor Mapping used to code ranks.
+ * @param[in]     mapCtx     Mapping constants.
+ * @param[in]     runIdx     Rank of run escape.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INVALID_DATA} if a word is missing from lookup.\n
+ *         Other errors as raised by {@link put_run}.
+ */
+static HuffmanError encode_runs(uint8_t** dst,
+								uint8_t* start,
+								uint64_t* dstSize,
+								uint8_t* src,
+								uint64_t srcSize,
+								uint8_t wordSize,
+								const HuffmanHashTable* lookup,
+								const HuffmanCompressor* compressor,
+								const HuffmanMapContext* mapCtx,
+								uint64_t runIdx) {
+	HuffmanError err;
+	uint8_t finalBits;
+	uint64_t numComplete = get_word_count(&finalBits, srcSize, wordSize) - (finalBits != 0);
+	uint8_t padBits = (wordSize - finalBits) % wordSize;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+	uint64_t i, rank, word = 0;
+	uint64_t runWord = 0, runLength = 0;
+
+	// Code each run once the word following it differs
+	for (i = 0; i <= numComplete; i++) {
+		if (i < numComplete) {
+			THROW_ERR(extract_bits(&word, &currPtr, &currBit, wordSize))
+			if (runLength > 0 && word == runWord) {
+				runLength++;
+				continue;
+			}
+		}
+		if (runLength > 0) {
+			if (!lookup_rank(&rank, lookup, runWord)) {
+				return ERR_INVALID_DATA;
+			}
+			THROW_ERR(put_run(dst, start, dstSize, rank, runLength, compressor, mapCtx, runIdx))
+		}
+		runWord = word;
+		runLength = 1;
+	}
+
+	// Incomplete last word is never part of a run
+	if (finalBits != 0) {
+		THROW_ERR(extract_bits(&word, &currPtr, &currBit, finalBits))
+		word <<= padBits;
+		if (!lookup_rank(&rank, lookup, word) &&
+				!lookup_rank(&rank, lookup, word | ((((uint64_t) 1) << padBits) - 1))) {
+			return ERR_INVALID_DATA;
+		}
+		THROW_ERR(put_run(dst, start, dstSize, rank, 1, compressor, mapCtx, runIdx))
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Decodes words coded by {@link encode_runs}. Only the data bits of the last
+ * word are written.
+ *
+ * @param[out]    dst        Destination for decoded data.
+ * @param[in]     dstSize    Size of decoded data in bytes.
+ * @param[in,out] src        Pointer to byte from which to read. Updated to first byte following codes.
+ * @param[in,out] start      Bit from which to start. Updated to bit following codes. Range 0-7.
+ * @param[in,out] srcSize    Number of bytes remaining in src. Updated to remaining number of bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     words      Words by rank.
+ * @param[in]     compressor Mapping used to code ranks.
+ * @param[in]     mapCtx     Mapping constants.
+ * @param[in]     runIdx     Rank of run escape.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INVALID_DATA} if a run escape does not follow a complete
+ *              word, or repeats past the last complete word.\n
+ *         Other errors as raised by the mapping's parse functions,
+ *         {@link read_varint} and {@link read_bits}.
+ */
+static HuffmanError decode_runs(uint8_t* dst,
+								uint64_t dstSize,
+								uint8_t** src,
+								uint8_t* start,
+								uint64_t* srcSize,
+								uint8_t wordSize,
+								const uint64_t* words,
+								const HuffmanCompressor* compressor,
+								const HuffmanMapContext* mapCtx,
+								uint64_t runIdx) {
+	HuffmanError err;
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, dstSize, wordSize);
+	uint64_t numComplete = numWords - (finalBits != 0);
+	uint8_t padBits = (wordSize - finalBits) % wordSize;
+	uint8_t* outPtr = dst;
+	uint8_t outBit = 0;
+	uint64_t outSize = dstSize;
+	uint64_t i = 0, j, idx, repeats, word = 0;
+
+	while (i < numWords) {
+		THROW_ERR(compressor->parseIdx(&idx, src, start, srcSize, mapCtx))
+		if (idx == runIdx) {
+			THROW_ERR(read_varint(&repeats, src, start, srcSize))
+			if (i == 0 || repeats > numComplete - i) {
+				return ERR_INVALID_DATA;
+			}
+			for (j = 0; j < repeats; j++) {
+				THROW_ERR(put_bits(&outPtr, &outBit, &outSize, word, wordSize))
+			}
+			i += repeats;
+			continue;
+		}
+		word = words[idx];
+		if (i == numWords - 1 && finalBits != 0) {
+			THROW_ERR(put_bits(&outPtr, &outBit, &outSize, word >> padBits, finalBits))
+		} else {
+			THROW_ERR(put_bits(&outPtr, &outBit, &outSize, word, wordSize))
+		}
+		i++;
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Estimates from an evenly spaced sample of words whether data is
+ * incompressible. Data is considered incompressible if the entropy of the
+ * sample, with Miller-Madow bias correction, is within 1/64th of wordSize, or
+ * if the sample is too varied for its value map to pay for itself.
+ *
+ * @param[out]    incompressible Set if data appears incompressible.
+ * @param[in]     src            Data to be sampled.
+ * @param[in]     srcSize        Size of data in bytes.
+ * @param[in]     wordSize       Word size used for compression.
+ * @param[in,out] ctx            Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by {@link histogram_init} and {@link add_to_table}.
+ */
+static HuffmanError sample_incompressible(bool* incompressible,
+										  uint8_t* src,
+										  uint64_t srcSize,
+										  uint8_t wordSize,
+										  HuffmanContext* ctx) {
+	HuffmanError err = ERR_NO_ERR;
+	HuffmanHistogram hist;
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, srcSize, wordSize);
+	uint64_t stride, bit, word, i;
+	uint8_t* currPtr;
+	uint8_t currBit;
+	double sum = 0.0, entropy;
+
+	*incompressible = false;
+	if (finalBits != 0) {
+		numWords--;
+	}
+	if (numWords < 2 * HUFFMAN_SAMPLE_WORDS) {
+		return ERR_NO_ERR;
+	}
+
+	THROW_ERR(histogram_init(&hist, wordSize, HUFFMAN_SAMPLE_WORDS, ctx))
+	stride = numWords / HUFFMAN_SAMPLE_WORDS;
+	for (i = 0; !err && i < HUFFMAN_SAMPLE_WORDS; i++) {
+		bit = i * stride * wordSize;
+		currPtr = &src[bit / 8];
+		currBit = (uint8_t) (bit % 8);
+		err = extract_bits(&word, &currPtr, &currBit, wordSize);
+		if (!err) {
+			err = add_to_table(&hist.table, &hist.numWords, word, hist.maxSize, ctx);
+		}
+	}
+	if (!err) {
+		for (i = 0; i < hist.table.size; i++) {
+			if (*get_table_value(hist.table.table, i) != 0) {
+				sum += *get_table_value(hist.table.table, i) *
+						log2((double) *get_table_value(hist.table.table, i));
+			}
+		}
+		entropy = log2((double) HUFFMAN_SAMPLE_WORDS) - sum / HUFFMAN_SAMPLE_WORDS +
+				(double) (hist.numWords - 1) / (2.0 * HUFFMAN_SAMPLE_WORDS * log(2.0));
+		*incompressible = entropy >= wordSize - wordSize / 64.0 ||
+				hist.numWords * wordSize + HUFFMAN_SAMPLE_WORDS >=
+						(uint64_t) HUFFMAN_SAMPLE_WORDS * wordSize;
+	}
+	table_free(ctx, hist.table.table, hist.table.size);
+	return err;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Copies data, adding each piece to a CRC32C while it is still in cache.
+ *
+ * @param[out]    dst  Destination for data.
+ * @param[in]     src  Data to be copied.
+ * @param[in]     size Size of data in bytes.
+ * @param[in,out] crc  CRC32C to which data is added, or null.
+ */
+static void copy_crc(uint8_t* dst,
+					 const uint8_t* src,
+					 uint64_t size,
+					 uint32_t* crc) {
+	const uint64_t piece = 4096;
+	uint64_t i, n;
+	if (!crc) {
+		memcpy(dst, src, size);
+		return;
+	}
+	for (i = 0; i < size; i += n) {
+		n = (size - i < piece) ? size - i : piece;
+		memcpy(dst + i, src + i, n);
+		*crc = huffman_crc32c(*crc, dst + i, n);
+	}
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Writes data uncompressed as a frame consisting of:
+ *	- {@link HUFFMAN_FRAME_STORED} (8 bits), with
+ *	  {@link HUFFMAN_FRAME_CHECKSUM} if checksummed
+ *	- Size of data in bytes (7 bits per byte, as many bytes as needed)
+ *	- Data, byte aligned
+ *	- If checksummed, CRC32C of data as written by {@link put_checksum}
+ *
+ * @param[out]    dst      Destination for frame.
+ * @param[in,out] dstSize  Capacity of dst in bytes. Updated to size of frame
+ *                         on success.
+ * @param[out]    hdr      Header populated with metadata. No words are mapped.
+ * @param[in]     src      Data to be stored.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in]     checksum Whether to end the frame with a checksum.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if frame does not fit in dst.
+ */
+static HuffmanError put_stored(uint8_t* dst,
+							   uint64_t* dstSize,
+							   HuffmanHeader* hdr,
+							   uint8_t* src,
+							   uint64_t srcSize,
+							   uint8_t wordSize,
+							   bool checksum) {
+	HuffmanError err;
+	uint8_t* currPtr = dst;
+	uint8_t currBit = 0;
+	uint64_t remaining = *dstSize;
+	uint8_t finalBits;
+	uint32_t crc = 0;
+
+	THROW_ERR(put_bits(&currPtr, &currBit, &remaining,
+			HUFFMAN_FRAME_STORED | (checksum ? HUFFMAN_FRAME_CHECKSUM : 0), 8))
+	THROW_ERR(put_varint(&currPtr, &currBit, &remaining, srcSize))
+	if (remaining < srcSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	copy_crc(currPtr, src, srcSize, checksum ? &crc : NULL);
+	currPtr += srcSize;
+	remaining -= srcSize;
+	if (checksum) {
+		THROW_ERR(put_checksum(&currPtr, &currBit, &remaining, crc))
+	}
+
+	get_word_count(&finalBits, srcSize, wordSize);
+	hdr->wordSize = wordSize;
+	hdr->padBits = wordSize - finalBits;
+	hdr->uniqueWords = 0;
+	*dstSize = (uint64_t) (currPtr - dst);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Reads data from a frame written by {@link put_stored}.
+ *
+ * @param[out]    dst     Destination for data.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of data
+ *                        on success.
+ * @param[in]     src     Stored frame.
+ * @param[in]     srcSize Size of frame in bytes, without any checksum.
+ * @param[in,out] crc     CRC32C to which data is added, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if frame is truncated or data does
+ *              not fit in dst.
+ */
+static HuffmanError get_stored(uint8_t* dst,
+							   uint64_t* dstSize,
+							   uint8_t* src,
+							   uint64_t srcSize,
+							   uint32_t* crc) {
+	HuffmanError err;
+	uint8_t* currPtr = &src[1];
+	uint8_t currBit = 0;
+	uint64_t remaining = srcSize - 1;
+	uint64_t dataSize;
+
+	THROW_ERR(read_varint(&dataSize, &currPtr, &currBit, &remaining))
+	if (dataSize > remaining || dataSize > *dstSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	copy_crc(dst, currPtr, dataSize, crc);
+	*dstSize = dataSize;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Removes at least half of the words from a table generated under a memory
+ * budget. Words are bucketed by the floor of log2 of their count, and whole
+ * buckets are dropped from the least frequent up. Survivors are rehashed
+ * into a spare table of the same size, which then replaces the table.
+ *
+ * @param[in,out] table    Table to be pruned.
+ * @param[in,out] spare    Table of the same size, contents discarded. Holds
+ *                         the previous table afterwards.
+ * @param[in,out] numWords Number of words in table. Updated to number kept.
+ */
+static void prune_table(HuffmanHashTable* table,
+						HuffmanHashTable* spare,
+						uint64_t* numWords) {
+	uint64_t buckets[64] = {0};
+	uint64_t removed = 0, kept = 0, threshold, val, slot, i;
+	uint64_t* swap;
+	uint8_t b;
+
+	for (i = 0; i < table->size; i++) {
+		val = *get_table_value(table->table, i);
+		if (val) {
+			for (b = 0; b < 63 && (val >> (b + 1)) != 0; b++);
+			buckets[b]++;
+		}
+	}
+	for (b = 0; b < 63 && removed < (*numWords + 1) / 2; b++) {
+		removed += buckets[b];
+	}
+	threshold = ((uint64_t) 1) << b;
+
+	memset(spare->table, 0x00, 2 * sizeof(uint64_t) * spare->size);
+	for (i = 0; i < table->size; i++) {
+		val = *get_table_value(table->table, i);
+		if (val >= threshold) {
+			// Cannot fail, spare holds fewer words than table
+			search_table(&slot, spare, *get_table_id(table->table, i), true);
+			*get_table_value(spare->table, slot) = val;
+			*get_table_id(spare->table, slot) = *get_table_id(table->table, i);
+			kept++;
+		}
+	}
+
+	swap = table->table;
+	table->table = spare->table;
+	spare->table = swap;
+	*numWords = kept;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Inserts an escape entry with id 0 into a sorted table, at the rank of its
+ * count. The table must have an empty entry past its last word.
+ *
+ * @param[in,out] table    Sorted table.
+ * @param[in]     numWords Number of words in table.
+ * @param[in]     count    Count of escape.
+ *
+ * @return Rank of escape.
+ */
+static uint64_t insert_escape(HuffmanHashTable* table,
+							  uint64_t numWords,
+							  uint64_t count) {
+	uint64_t rank;
+	for (rank = 0; rank < numWords && *get_table_value(table->table, rank) > count; rank++);
+	memmove(get_table_value(table->table, rank + 1), get_table_value(table->table, rank),
+			2 * sizeof(uint64_t) * (numWords - rank));
+	*get_table_value(table->table, rank) = count;
+	*get_table_id(table->table, rank) = 0;
+	return rank;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Builds a frequency table sorted by decreasing frequency, as
+ * {@link build_sorted_table} does, in a fixed amount of memory. Counting
+ * uses two tables of budget / 32 entries. Whenever the table is 3/4 full it
+ * is pruned with {@link prune_table}, so the counts of words seen often are
+ * kept while rare words are forgotten. The incomplete last word, if any, is
+ * counted padded with 0's.
+ *
+ * At most half the entries of one counting table are kept, so that the
+ * lookup built from them fits in the memory released by the other. All
+ * occurrences not accounted for by the kept words are represented by an
+ * escape entry with id 0, ranked by its count among the kept words.
+ *
+ * @warning This allocates a table that must be freed later.
+ *
+ * @param[out]    hdr       Header populated with metadata. The escape entry
+ *                          is included in uniqueWords.
+ * @param[out]    table     Pointer to sorted table, released by this function
+ *                          on error.
+ * @param[out]    escapeIdx Rank of escape entry, or {@link HUFFMAN_MAX_UINT64}
+ *                          if every word was kept.
+ * @param[out]    escapes   Number of words to be coded by escape.
+ * @param[in]     src       Data to be converted.
+ * @param[in]     srcSize   Size of data in bytes.
+ * @param[in]     wordSize  Word size used for compression.
+ * @param[in]     budget    Bytes available for counting. At least
+ *                          {@link HUFFMAN_MIN_BUDGET}.
+ * @param[in,out] ctx       Context to allocate table from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if unable to allocate tables.\n
+ *         Other errors as raised by {@link add_to_table} and {@link sort_table}.
+ */
+static HuffmanError build_budget_table(HuffmanHeader* hdr,
+									   HuffmanHashTable* table,
+									   uint64_t* escapeIdx,
+									   uint64_t* escapes,
+									   uint8_t* src,
+									   uint64_t srcSize,
+									   uint8_t wordSize,
+									   uint64_t budget,
+									   HuffmanContext* ctx) {
+	HuffmanError err = ERR_NO_ERR;
+	HuffmanHashTable spare;
+	uint8_t finalBits;
+	uint64_t wordCount = get_word_count(&finalBits, srcSize, wordSize);
+	uint64_t size = budget / (4 * sizeof(uint64_t));
+	uint64_t maxRanks = 1;
+	uint64_t numWords = 0;
+	uint64_t i, word, rank, limit;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+
+	// Largest lookup fitting in one counting table, see get_lookup_size
+	while (maxRanks * 4 <= size) {
+		maxRanks <<= 1;
+	}
+	// No larger than needed to count every word without pruning
+	if (size > 2 * wordCount + 2) {
+		size = 2 * wordCount + 2;
+	}
+	limit = size - size / 4;
+
+	table->size = spare.size = size;
+	table->table = table_alloc(ctx, size);
+	spare.table = table_alloc(ctx, size);
+	if (!table->table || !spare.table) {
+		err = ERR_INSUFFICIENT_SPACE;
+	}
+
+	// Count words, pruning rare ones to stay within budget
+	INSTRUMENT_START(ctx, histogramStart);
+	for (i = 0; !err && i < wordCount; i++) {
+		if (i == wordCount - 1 && finalBits != 0) {
+			err = extract_bits(&word, &currPtr, &currBit, finalBits);
+			word <<= wordSize - finalBits;
+		} else {
+			err = extract_bits(&word, &currPtr, &currBit, wordSize);
+		}
+		if (!err && numWords >= limit) {
+			prune_table(table, &spare, &numWords);
+		}
+		if (!err) {
+			err = add_to_table(table, &numWords, word, size, ctx);
+		}
+	}
+	INSTRUMENT_ADD(ctx, wordsProcessed, wordCount);
+	INSTRUMENT_STOP(ctx, histogramStart, histogramNs);
+	if (spare.table) {
+		table_free(ctx, spare.table, spare.size);
+	}
+
+	hdr->wordSize = wordSize;
+	hdr->padBits = wordSize - finalBits;
+	hdr->uniqueWords = numWords;
+	if (!err) {
+		INSTRUMENT_START(ctx, sortStart);
+		err = sort_table(hdr, table);
+		INSTRUMENT_STOP(ctx, sortStart, sortNs);
+	}
+	if (err) {
+		if (table->table) {
+			table_free(ctx, table->table, table->size);
+		}
+		table->table = NULL;
+		table->size = 0;
+		return err;
+	}
+
+	// Keep most frequent words, leaving a rank for the escape
+	if (numWords >= maxRanks) {
+		numWords = maxRanks - 1;
+	}
+	*escapes = wordCount;
+	for (rank = 0; rank < numWords; rank++) {
+		*escapes -= *get_table_value(table->table, rank);
+	}
+
+	*escapeIdx = HUFFMAN_MAX_UINT64;
+	if (*escapes > 0) {
+		*escapeIdx = insert_escape(table, numWords, *escapes);
+		numWords++;
+	}
+	hdr->uniqueWords = numWords;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Generates a sorted frequency table in which long runs of the same word are
+ * counted once, see {@link generate_run_table}. If any run is to be coded by
+ * run escape, the run escape is represented by an entry with id 0, ranked by
+ * the number of runs among the words.
+ *
+ * @warning This allocates a table that must be freed later.
+ *
+ * @param[out]    hdr      Header populated with metadata. The run escape is
+ *                         included in uniqueWords.
+ * @param[out]    table    Pointer to sorted table, released by this function
+ *                         on error.
+ * @param[out]    runIdx   Rank of run escape, or {@link HUFFMAN_MAX_UINT64} if
+ *                         no run is long enough, or every possible word is
+ *                         found.
+ * @param[out]    runs     Runs to be coded by run escape.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[out]    bailed   Set if data was found incompressible, in which case
+ *                         no table is returned. Null to disable check.
+ * @param[in,out] ctx      Context to allocate table from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by {@link generate_run_table} and {@link sort_table}.
+ */
+static HuffmanError build_run_table(HuffmanHeader* hdr,
+									HuffmanHashTable* table,
+									uint64_t* runIdx,
+									HuffmanRunCount* runs,
+									uint8_t* src,
+									uint64_t srcSize,
+									uint8_t wordSize,
+									bool* bailed,
+									HuffmanContext* ctx) {
+	HuffmanError err;
+
+	table->size = 0;
+	table->table = NULL;
+	*runIdx = HUFFMAN_MAX_UINT64;
+
+	INSTRUMENT_START(ctx, histogramStart);
+	THROW_ERR(generate_run_table(hdr, table, src, srcSize, wordSize, runs, bailed, ctx))
+	if (bailed && *bailed) {
+		INSTRUMENT_STOP(ctx, histogramStart, histogramNs);
+		table->size = 0;
+		table->table = NULL;
+		return ERR_NO_ERR;
+	}
+	// Header cannot count a run escape on top of every possible word, so
+	// count word by word then
+	if (runs->runs > 0 && hdr->uniqueWords == ((uint64_t) 1) << wordSize) {
+		table_free(ctx, table->table, table->size);
+		table->size = 0;
+		table->table = NULL;
+		THROW_ERR(generate_run_table(hdr, table, src, srcSize, wordSize, NULL, NULL, ctx))
+		runs->runs = 0;
+		runs->bytes = 0;
+	}
+	INSTRUMENT_STOP(ctx, histogramStart, histogramNs);
+
+	INSTRUMENT_START(ctx, sortStart);
+	err = sort_table(hdr, table);
+	INSTRUMENT_STOP(ctx, sortStart, sortNs);
+	if (err) {
+		table_free(ctx, table->table, table->size);
+		table->table = NULL;
+		table->size = 0;
+		return err;
+	}
+
+	if (runs->runs > 0) {
+		*runIdx = insert_escape(table, hdr->uniqueWords, runs->runs);
+		hdr->uniqueWords++;
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Scratch file holding one partition of the words counted by
+ * {@link build_spill_table}.
+ */
+typedef struct HuffmanSpillRun_struct {
+	/**
+	 * Scratch file, or null if not yet created.
+	 */
+	FILE* file;
+	/**
+	 * Number of values in file: words while partitioning, then count and
+	 * word pairs once counted.
+	 */
+	uint64_t count;
+	/**
+	 * Values waiting to be written, or read from file.
+	 */
+	uint64_t* buffer;
+	/**
+	 * Number of values in buffer.
+	 */
+	uint64_t filled;
+	/**
+	 * Position of next value to be read from buffer.
+	 */
+	uint64_t next;
+} HuffmanSpillRun;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Creates an anonymous scratch file in a directory. The file is removed once
+ * closed. Where the platform cannot place files in a given directory, the
+ * default temporary directory is used.
+ *
+ * @param[out]    file Scratch file.
+ * @param[in]     dir  Directory in which to create file.
+ * @param[in,out] ctx  Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if allocation failed.\n
+ *         {@link ERR_IO} if file could not be created.
+ */
+static HuffmanError spill_open(FILE** file,
+							   const char* dir,
+							   HuffmanContext* ctx) {
+#if defined(__unix__) || defined(__APPLE__)
+	static const char name[] = "/huffmanXXXXXX";
+	uint64_t size = strlen(dir) + sizeof(name);
+	char* path = (char*) context_alloc(ctx, size);
+	int fd;
+
+	if (!path) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	strcpy(path, dir);
+	strcat(path, name);
+	fd = mkstemp(path);
+	if (fd >= 0) {
+		unlink(path);
+		*file = fdopen(fd, "w+b");
+		if (!*file) {
+			close(fd);
+		}
+	} else {
+		*file = NULL;
+	}
+	context_free(ctx, path, size);
+#else
+	(void) dir;
+	(void) ctx;
+	*file = tmpfile();
+#endif
+	return *file ? ERR_NO_ERR : ERR_IO;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Writes the values buffered in a run to its scratch file.
+ *
+ * @param[in,out] run Run to be flushed.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_IO} if write failed.
+ */
+static HuffmanError spill_flush(HuffmanSpillRun* run) {
+	if (run->filled > 0 &&
+			fwrite(run->buffer, sizeof(uint64_t), run->filled, run->file) != run->filled) {
+		return ERR_IO;
+	}
+	run->count += run->filled;
+	run->filled = 0;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Refills the buffer of a run from its scratch file once every buffered value
+ * has been read.
+ *
+ * @param[in,out] run       Run to be read.
+ * @param[in,out] remaining Number of values left in file. Updated to number
+ *                          left after refilling.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_IO} if read failed.
+ */
+static HuffmanError spill_refill(HuffmanSpillRun* run,
+								 uint64_t* remaining) {
+	if (run->next < run->filled || *remaining == 0) {
+		return ERR_NO_ERR;
+	}
+	run->filled = (*remaining < HUFFMAN_SPILL_BUFFER_WORDS) ? *remaining : HUFFMAN_SPILL_BUFFER_WORDS;
+	run->next = 0;
+	if (fread(run->buffer, sizeof(uint64_t), run->filled, run->file) != run->filled) {
+		return ERR_IO;
+	}
+	*remaining -= run->filled;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Replaces the words in a run's scratch file with their counts, sorted by
+ * decreasing frequency as by {@link sort_table}.
+ *
+ * @param[in,out] run      Run to be counted. Count updated to number of values
+ *                         in file.
+ * @param[out]    unique   Number of unique words in run.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_IO} if scratch file could not be read or written.\n
+ *         Other errors as raised by {@link add_to_table} and {@link sort_table}.
+ */
+static HuffmanError spill_count(HuffmanSpillRun* run,
+								uint64_t* unique,
+								uint8_t wordSize,
+								HuffmanContext* ctx) {
+	HuffmanError err = ERR_NO_ERR;
+	HuffmanHashTable table;
+	HuffmanHeader hdr;
+	uint64_t remaining = run->count;
+	uint64_t maxSize = get_max_table_size(wordSize);
+	uint64_t numWords = 0;
+
+	table.size = get_initial_table_size(wordSize, run->count);
+	table.table = table_alloc(ctx, table.size);
+	if (!table.table) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+
+	rewind(run->file);
+	run->filled = run->next = 0;
+	while (!err && (run->next < run->filled || remaining > 0)) {
+		err = spill_refill(run, &remaining);
+		if (!err) {
+			err = add_to_table(&table, &numWords, run->buffer[run->next++], maxSize, ctx);
+		}
+	}
+
+	if (!err) {
+		hdr.uniqueWords = numWords;
+		err = sort_table(&hdr, &table);
+	}
+	if (!err) {
+		rewind(run->file);
+		if (fwrite(table.table, 2 * sizeof(uint64_t), numWords, run->file) != numWords ||
+				fflush(run->file) != 0) {
+			err = ERR_IO;
+		}
+	}
+	table_free(ctx, table.table, table.size);
+	run->count = 2 * numWords;
+	*unique = numWords;
+	return err;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Restores heap order of runs below a position during the merge in
+ * {@link build_spill_table}. Runs with larger next counts come first.
+ *
+ * @param[in,out] heap    Indices of runs with values left.
+ * @param[in]     size    Number of indices in heap.
+ * @param[in]     pos     Position of index to be moved down.
+ * @param[in]     runs    Runs being merged.
+ */
+static void spill_sift(uint64_t* heap,
+					   uint64_t size,
+					   uint64_t pos,
+					   const HuffmanSpillRun* runs) {
+	uint64_t child, top = heap[pos];
+	uint64_t count = runs[top].buffer[runs[top].next];
+
+	while ((child = 2 * pos + 1) < size) {
+		if (child + 1 < size && runs[heap[child + 1]].buffer[runs[heap[child + 1]].next] >
+				runs[heap[child]].buffer[runs[heap[child]].next]) {
+			child++;
+		}
+		if (runs[heap[child]].buffer[runs[heap[child]].next] <= count) {
+			break;
+		}
+		heap[pos] = heap[child];
+		pos = child;
+	}
+	heap[pos] = top;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Builds the frequency table for the source and sorts it by decreasing
+ * frequency, as {@link build_sorted_table} does, counting one partition of
+ * the words at a time through scratch files. Words with equal counts may be
+ * ordered differently.
+ *
+ * Words are hash-partitioned into one scratch file per partition, using as
+ * many partitions as needed for a partition's words to fit in budget bytes of
+ * table, up to {@link HUFFMAN_SPILL_PARTITIONS}. Each partition is then
+ * counted in memory, its sorted counts written back in place of its words,
+ * and the partitions merged into the sorted table. Scratch files are only
+ * written and read sequentially. Data small enough for a single partition is
+ * counted in memory by {@link build_sorted_table}.
+ *
+ * Only counting is bounded by budget. The sorted table still holds every
+ * unique word.
+ *
+ * The incomplete last word, if any, is counted padded with 0's.
+ *
+ * @warning This allocates a table that must be freed later.
+ *
+ * @param[out]    hdr        Header populated with metadata.
+ * @param[out]    table      Pointer to sorted table, released by this function
+ *                           on error.
+ * @param[in]     src        Data to be converted.
+ * @param[in]     srcSize    Size of data in bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     scratchDir Directory in which to create scratch files.
+ * @param[in]     budget     Bytes of table each partition should fit in.
+ * @param[in,out] ctx        Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if allocation failed.\n
+ *         {@link ERR_IO} if scratch files could not be created, read or written.\n
+ *         Other errors as raised by {@link spill_count} and
+ *         {@link build_sorted_table}.
+ */
+static HuffmanError build_spill_table(HuffmanHeader* hdr,
+									  HuffmanHashTable* table,
+									  uint8_t* src,
+									  uint64_t srcSize,
+									  uint8_t wordSize,
+									  const char* scratchDir,
+									  uint64_t budget,
+									  HuffmanContext* ctx) {
+	HuffmanError err = ERR_NO_ERR;
+	HuffmanSpillRun* runs, *run;
+	uint8_t finalBits;
+	uint64_t wordCount = get_word_count(&finalBits, srcSize, wordSize);
+	uint64_t wordsPerPart = budget / (4 * sizeof(uint64_t));
+	uint64_t numParts = 1, numUnique = 0, opened = 0;
+	uint64_t* buffers, *heap;
+	uint64_t i, word, size;
+	uint64_t unique = 0;
+	uint8_t shift = 64;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+
+	// Enough partitions for each to hold words of one budget, assuming all unique
+	while (numParts < HUFFMAN_SPILL_PARTITIONS && wordCount / numParts > wordsPerPart) {
+		numParts <<= 1;
+		shift--;
+	}
+	if (numParts == 1) {
+		return build_sorted_table(hdr, table, src, srcSize, wordSize, NULL, ctx);
+	}
+
+	table->table = NULL;
+	table->size = 0;
+	runs = (HuffmanSpillRun*) context_alloc(ctx, numParts * sizeof(HuffmanSpillRun));
+	buffers = (uint64_t*) context_alloc(ctx, numParts * HUFFMAN_SPILL_BUFFER_WORDS * sizeof(uint64_t));
+	heap = (uint64_t*) context_alloc(ctx, numParts * sizeof(uint64_t));
+	if (!runs || !buffers || !heap) {
+		err = ERR_INSUFFICIENT_SPACE;
+	}
+	for (i = 0; !err && i < numParts; i++) {
+		runs[i].count = runs[i].filled = runs[i].next = 0;
+		runs[i].buffer = &buffers[i * HUFFMAN_SPILL_BUFFER_WORDS];
+		err = spill_open(&runs[i].file, scratchDir, ctx);
+		if (!err) {
+			opened++;
+		}
+	}
+
+	// Step 2a: Partition words into scratch files by hash
+	INSTRUMENT_START(ctx, histogramStart);
+	for (i = 0; !err && i < wordCount; i++) {
+		if (i == wordCount - 1 && finalBits != 0) {
+			err = extract_bits(&word, &currPtr, &currBit, finalBits);
+			word <<= wordSize - finalBits;
+		} else {
+			err = extract_bits(&word, &currPtr, &currBit, wordSize);
+		}
+		if (!err) {
+			// Fibonacci hashing, independent of get_hash within a partition
+			run = &runs[(word * (uint64_t) 0x9E3779B97F4A7C15) >> shift];
+			run->buffer[run->filled++] = word;
+			if (run->filled == HUFFMAN_SPILL_BUFFER_WORDS) {
+				err = spill_flush(run);
+			}
+		}
+	}
+	for (i = 0; !err && i < numParts; i++) {
+		err = spill_flush(&runs[i]);
+	}
+
+	// Step 2b: Count each partition
+	for (i = 0; !err && i < numParts; i++) {
+		err = spill_count(&runs[i], &unique, wordSize, ctx);
+		numUnique += unique;
+	}
+	INSTRUMENT_ADD(ctx, wordsProcessed, wordCount);
+	INSTRUMENT_STOP(ctx, histogramStart, histogramNs);
+
+	// Step 3: Merge partitions by decreasing frequency
+	INSTRUMENT_START(ctx, sortStart);
+	if (!err) {
+		table->size = numUnique + 1;
+		table->table = table_alloc(ctx, table->size);
+		err = table->table ? ERR_NO_ERR : ERR_INSUFFICIENT_SPACE;
+	}
+	size = 0;
+	for (i = 0; !err && i < numParts; i++) {
+		rewind(runs[i].file);
+		runs[i].filled = runs[i].next = 0;
+		err = spill_refill(&runs[i], &runs[i].count);
+		if (!err && runs[i].filled > 0) {
+			heap[size++] = i;
+		}
+	}
+	for (i = size; !err && i > 0; i--) {
+		spill_sift(heap, size, i - 1, runs);
+	}
+	for (i = 0; !err && size > 0; i++) {
+		run = &runs[heap[0]];
+		*get_table_value(table->table, i) = run->buffer[run->next];
+		*get_table_id(table->table, i) = run->buffer[run->next + 1];
+		run->next += 2;
+		err = spill_refill(run, &run->count);
+		if (!err && run->next == run->filled) {
+			heap[0] = heap[--size];
+		}
+		if (!err && size > 0) {
+			spill_sift(heap, size, 0, runs);
+		}
+	}
+	INSTRUMENT_STOP(ctx, sortStart, sortNs);
+
+	// Cleanup
+	for (i = 0; i < opened; i++) {
+		fclose(runs[i].file);
+	}
+	context_free(ctx, heap, numParts * sizeof(uint64_t));
+	context_free(ctx, buffers, numParts * HUFFMAN_SPILL_BUFFER_WORDS * sizeof(uint64_t));
+	context_free(ctx, runs, numParts * sizeof(HuffmanSpillRun));
+
+	if (err) {
+		if (table->table) {
+			table_free(ctx, table->table, table->size);
+		}
+		table->table = NULL;
+		table->size = 0;
+		return err;
+	}
+	hdr->wordSize = wordSize;
+	hdr->padBits = wordSize - finalBits;
+	hdr->uniqueWords = numUnique;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Compresses data into a self-contained frame, counting words either exactly,
+ * within a memory budget, through scratch files or with long runs coded by
+ * run escape, and coding words into one stream or several interleaved ones.
+ *
+ * @see huffman_compress_ctx
+ * @see huffman_compress_budget
+ * @see huffman_compress_spill
+ * @see huffman_compress_runs
+ * @see huffman_compress_interleaved
+ *
+ * @param[out]    dst      Destination for compressed data.
+ * @param[in,out] dstSize  Capacity of dst in bytes. Updated to size of
+ *                         compressed data on success.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in]     scratchDir Directory for scratch files when counting through
+ *                         them, or null.
+ * @param[in]     budget   Bytes available for counting, or 0 to count exactly.
+ *                         With scratchDir, bytes of table per partition.
+ * @param[in]     runs     Whether to code long runs by run escape. Only used
+ *                         when counting exactly.
+ * @param[in]     numStreams Number of interleaved streams to code words into.
+ *                         Only used when counting exactly without runs.
+ * @param[in]     checksum Whether to end the frame with a CRC32C of the data.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return Errors as raised by {@link huffman_compress_ctx}.
+ */
+static HuffmanError compress_frame(uint8_t* dst,
+								   uint64_t* dstSize,
+								   HuffmanHeader* hdr,
+								   uint8_t* src,
+								   uint64_t srcSize,
+								   uint8_t wordSize,
+								   const char* scratchDir,
+								   uint64_t budget,
+								   bool runs,
+								   uint8_t numStreams,
+								   bool checksum,
+								   HuffmanContext* ctx) {
+	HuffmanError err;
+	HuffmanHashTable table, lookup;
+	HuffmanContextMark mark;
+	HuffmanMapContext mapCtx;
+	HuffmanHeader frameHdr;
+	HuffmanStats best;
+	uint8_t* currPtr = dst;
+	uint8_t currBit = 0;
+	uint64_t remaining = *dstSize;
+	uint64_t escapeIdx = HUFFMAN_MAX_UINT64;
+	uint64_t escapes = 0;
+	uint64_t runIdx = HUFFMAN_MAX_UINT64;
+	HuffmanRunCount runCount = {0, 0};
+	uint64_t i, mapBits, skipIdx;
+	uint32_t crc = 0;
+	bool stored;
+	bool interleaved = numStreams > 1 && !scratchDir && !budget && !runs;
+
+	context_enter(&mark, ctx);
+	lookup.table = NULL;
+
+	// Step 1: Skip counting if a sample looks incompressible. Samples are
+	// blind to runs, so always count when coding them.
+	stored = false;
+	err = runs ? ERR_NO_ERR : sample_incompressible(&stored, src, srcSize, wordSize, ctx);
+
+	// Steps 2 & 3: Build hash map, convert to sorted array
+	if (!err && !stored) {
+		if (scratchDir) {
+			err = build_spill_table(hdr, &table, src, srcSize, wordSize, scratchDir, budget, ctx);
+		} else if (budget) {
+			err = build_budget_table(hdr, &table, &escapeIdx, &escapes, src, srcSize, wordSize,
+					budget, ctx);
+		} else if (runs) {
+			err = build_run_table(hdr, &table, &runIdx, &runCount, src, srcSize, wordSize,
+					&stored, ctx);
+		} else {
+			err = build_sorted_table(hdr, &table, src, srcSize, wordSize, &stored, ctx);
+		}
+	}
+	// Rank left out of value map and lookup, if any
+	skipIdx = (runIdx != HUFFMAN_MAX_UINT64) ? runIdx : escapeIdx;
+	if (err || stored) {
+		context_leave(ctx, &mark);
+		return err ? err : put_stored(dst, dstSize, hdr, src, srcSize, wordSize, checksum);
+	}
+
+	// Step 4: Choose mapping, store instead if value map, codes, escaped
+	// words, repeat counts and stream sizes are larger
+	INSTRUMENT_START(ctx, sizeStart);
+	err = select_builtin(&best, hdr, &table, 0);
+	if (!err) {
+		mapBits = (hdr->uniqueWords - (skipIdx != HUFFMAN_MAX_UINT64) + escapes) * wordSize +
+				runCount.bytes * 8 + checksum * HUFFMAN_CHECKSUM_BYTES * 8;
+		if (interleaved) {
+			mapBits += numStreams * (get_varint_bytes(srcSize) + 1) * 8;
+		}
+		if (best.dataSizeBytes + (mapBits + 7) / 8 >= srcSize) {
+			table_free(ctx, table.table, table.size);
+			context_leave(ctx, &mark);
+			return put_stored(dst, dstSize, hdr, src, srcSize, wordSize, checksum);
+		}
+	}
+	if (!err) {
+		err = huffman_init_map_context(&mapCtx, best.compressor, hdr->uniqueWords, best.depthParam);
+	}
+
+	// Step 5: Build word lookup
+	if (!err) {
+		lookup.size = get_lookup_size(hdr->uniqueWords);
+		lookup.table = table_alloc(ctx, lookup.size);
+		err = lookup.table ? build_rank_lookup(&lookup, &table.table[1], 2, hdr->uniqueWords,
+				skipIdx) :
+				ERR_INSUFFICIENT_SPACE;
+	}
+
+	// Step 6: Write frame
+	frameHdr = *hdr;
+	frameHdr.padBits %= wordSize;
+	if (!err && remaining == 0) {
+		err = ERR_INSUFFICIENT_SPACE;
+	}
+	if (!err) {
+		*currPtr++ = (escapes > 0) ? HUFFMAN_FRAME_ESCAPED :
+				(runIdx != HUFFMAN_MAX_UINT64) ? HUFFMAN_FRAME_RUNS :
+				interleaved ? HUFFMAN_FRAME_INTERLEAVED : HUFFMAN_FRAME_TABLE;
+		currPtr[-1] |= checksum ? HUFFMAN_FRAME_CHECKSUM : 0;
+		remaining--;
+		err = build_header(&currPtr, &currBit, &remaining, &frameHdr);
+	}
+	if (!err) {
+		err = put_bits(&currPtr, &currBit, &remaining, get_builtin_id(best.compressor), 8);
+	}
+	if (!err) {
+		err = put_bits(&currPtr, &currBit, &remaining, best.depthParam, 8);
+	}
+	if (!err) {
+		err = put_varint(&currPtr, &currBit, &remaining, srcSize);
+	}
+	if (!err && interleaved) {
+		err = put_bits(&currPtr, &currBit, &remaining, numStreams, 8);
+	}
+	if (!err && skipIdx != HUFFMAN_MAX_UINT64) {
+		err = put_varint(&currPtr, &currBit, &remaining, skipIdx);
+	}
+	for (i = 0; !err && i < hdr->uniqueWords; i++) {
+		if (i != skipIdx) {
+			err = put_bits(&currPtr, &currBit, &remaining, *get_table_id(table.table, i), wordSize);
+		}
+	}
+	if (!err && runIdx != HUFFMAN_MAX_UINT64) {
+		err = encode_runs(&currPtr, &currBit, &remaining, src, srcSize, wordSize,
+				&lookup, best.compressor, &mapCtx, runIdx);
+		crc = checksum ? huffman_crc32c(0, src, srcSize) : 0;
+	} else if (!err && interleaved) {
+		err = encode_streams(&currPtr, &currBit, &remaining, src, srcSize, wordSize,
+				&lookup, best.compressor, &mapCtx, numStreams);
+		crc = checksum ? huffman_crc32c(0, src, srcSize) : 0;
+	} else if (!err) {
+		err = encode_words(&currPtr, &currBit, &remaining, src, srcSize, wordSize,
+				&lookup, best.compressor, &mapCtx, escapeIdx, NULL, checksum ? &crc : NULL);
+	}
+	if (!err && checksum) {
+		err = put_checksum(&currPtr, &currBit, &remaining, crc);
+	}
+	INSTRUMENT_STOP(ctx, sizeStart, sizeNs);
+
+	// Step 7: Cleanup
+	if (lookup.table) {
+		table_free(ctx, lookup.table, lookup.size);
+	}
+	table_free(ctx, table.table, table.size);
+	context_leave(ctx, &mark);
+
+	if (err) {
+		return err;
+	}
+	*dstSize = (uint64_t) (currPtr - dst) + (currBit > 0);
+	return ERR_NO_ERR;
+}
+
+/**
+ * Compresses data into a self-contained frame, allocating tables from a
+ * reusable context. The frame consists of:
+ *	- {@link HUFFMAN_FRAME_TABLE} (8 bits)
+ *	- Header as written by {@link build_header}
+ *	- Mapping position in built-in mappings (8 bits) and depth (8 bits)
+ *	- Size of uncompressed data in bytes (7 bits per byte, as many bytes as
+ *	  needed)
+ *	- Value map: uniqueWords words of wordSize bits, most frequent first
+ *	- Code of each word
+ *
+ * The built-in mapping and depth giving the smallest output are used.
+ *
+ * Data that is estimated to be incompressible, either from a sample before
+ * counting, partway through counting, or from the size estimate of the best
+ * mapping, is written with {@link put_stored} instead. The header then maps
+ * no words.
+ *
+ * @param[out]    dst      Destination for compressed data.
+ * @param[in,out] dstSize  Capacity of dst in bytes. Updated to size of
+ *                         compressed data on success.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if compressed data does not fit in dst.\n
+ *         Other errors as raised by {@link build_sorted_table}.
+ */
+HuffmanError huffman_compress_ctx(uint8_t* dst,
+								  uint64_t* dstSize,
+								  HuffmanHeader* hdr,
+								  uint8_t* src,
+								  uint64_t srcSize,
+								  uint8_t wordSize,
+								  HuffmanContext* ctx) {
+	if (dst == NULL || dstSize == NULL || hdr == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+	return compress_frame(dst, dstSize, hdr, src, srcSize, wordSize, NULL, 0, false, 1, false, ctx);
+}
+
+/**
+ * Compresses data into a self-contained frame as {@link huffman_compress_ctx}
+ * does, using a fixed amount of memory for counting regardless of the number
+ * of unique words. Only the most frequent words are counted exactly, see
+ * {@link build_budget_table}. If any word is left out of the value map, the
+ * frame consists of:
+ *	- {@link HUFFMAN_FRAME_ESCAPED} (8 bits)
+ *	- Header as written by {@link build_header}, uniqueWords including the
+ *	  escape
+ *	- Mapping position in built-in mappings (8 bits) and depth (8 bits)
+ *	- Size of uncompressed data in bytes (7 bits per byte, as many bytes as
+ *	  needed)
+ *	- Rank of escape (7 bits per byte, as many bytes as needed)
+ *	- Value map: uniqueWords - 1 words of wordSize bits, most frequent first,
+ *	  skipping the escape
+ *	- Code of each word, followed by the word itself if coded by escape
+ *
+ * Otherwise a {@link HUFFMAN_FRAME_TABLE} or {@link HUFFMAN_FRAME_STORED}
+ * frame is written as by {@link huffman_compress_ctx}.
+ *
+ * Counting tables take at most budget bytes, and the word lookup used for
+ * coding at most half of that once counting is done. The sample taken by
+ * {@link sample_incompressible} beforehand is not included.
+ *
+ * @param[out]    dst      Destination for compressed data.
+ * @param[in,out] dstSize  Capacity of dst in bytes. Updated to size of
+ *                         compressed data on success.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in]     budget   Bytes available for counting.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted
+ *              range, or budget is less than {@link HUFFMAN_MIN_BUDGET}.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if compressed data does not fit in dst.\n
+ *         Other errors as raised by {@link build_budget_table}.
+ */
+HuffmanError huffman_compress_budget(uint8_t* dst,
+									 uint64_t* dstSize,
+									 HuffmanHeader* hdr,
+									 uint8_t* src,
+									 uint64_t srcSize,
+									 uint8_t wordSize,
+									 uint64_t budget,
+									 HuffmanContext* ctx) {
+	if (dst == NULL || dstSize == NULL || hdr == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE ||
+			budget < HUFFMAN_MIN_BUDGET) {
+		return ERR_INVALID_VALUE;
+	}
+	return compress_frame(dst, dstSize, hdr, src, srcSize, wordSize, NULL, budget, false, 1,
+			false, ctx);
+}
+
+/**
+ * Compresses data into a self-contained frame as {@link huffman_compress_ctx}
+ * does, counting words exactly through scratch files so that no partition of
+ * words counted in memory needs more than budget bytes of hash table. See
+ * {@link build_spill_table}. Output is the same size as that of
+ * {@link huffman_compress_ctx}, unless the incomplete last word is padded
+ * differently.
+ *
+ * Only counting is bounded by budget. Encoding holds the sorted frequency
+ * table and the word lookup built from it, both sized by the number of unique
+ * words, as {@link huffman_compress_ctx} does.
+ *
+ * @param[out]    dst        Destination for compressed data.
+ * @param[in,out] dstSize    Capacity of dst in bytes. Updated to size of
+ *                           compressed data on success.
+ * @param[out]    hdr        Header populated with metadata.
+ * @param[in]     src        Data to be converted.
+ * @param[in]     srcSize    Size of data in bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     scratchDir Directory in which to create scratch files.
+ * @param[in]     budget     Bytes of table each partition of words should fit
+ *                           in while counting.
+ * @param[in,out] ctx        Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted
+ *              range, or budget is less than {@link HUFFMAN_MIN_BUDGET}.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if compressed data does not fit in dst.\n
+ *         {@link ERR_IO} if scratch files could not be created, read or written.\n
+ *         Other errors as raised by {@link build_spill_table}.
+ */
+HuffmanError huffman_compress_spill(uint8_t* dst,
+									uint64_t* dstSize,
+									HuffmanHeader* hdr,
+									uint8_t* src,
+									uint64_t srcSize,
+									uint8_t wordSize,
+									const char* scratchDir,
+									uint64_t budget,
+									HuffmanContext* ctx) {
+	if (dst == NULL || dstSize == NULL || hdr == NULL || src == NULL || scratchDir == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE ||
+			budget < HUFFMAN_MIN_BUDGET) {
+		return ERR_INVALID_VALUE;
+	}
+	return compress_frame(dst, dstSize, hdr, src, srcSize, wordSize, scratchDir, budget, false,
+			1, false, ctx);
+}
+
+/**
+ * Compresses data into a self-contained frame as {@link huffman_compress_ctx}
+ * does, coding each run of more than {@link HUFFMAN_MIN_RUN} complete words
+ * as the word followed by a run escape and the number of repeats. Runs are
+ * counted once when building the value map, so the word's code reflects how
+ * often the word starts a run rather than how often it repeats. If any run
+ * is that long, the frame consists of:
+ *	- {@link HUFFMAN_FRAME_RUNS} (8 bits)
+ *	- Header as written by {@link build_header}, uniqueWords including the
+ *	  run escape
+ *	- Mapping position in built-in mappings (8 bits) and depth (8 bits)
+ *	- Size of uncompressed data in bytes (7 bits per byte, as many bytes as
+ *	  needed)
+ *	- Rank of run escape (7 bits per byte, as many bytes as needed)
+ *	- Value map: uniqueWords - 1 words of wordSize bits, most frequent first,
+ *	  skipping the run escape
+ *	- Code of each word, a long run being followed by the code of the run
+ *	  escape and the number of repeats (7 bits per byte, as many bytes as
+ *	  needed)
+ *
+ * Otherwise a {@link HUFFMAN_FRAME_TABLE} or {@link HUFFMAN_FRAME_STORED}
+ * frame is written as by {@link huffman_compress_ctx}.
+ *
+ * @param[out]    dst      Destination for compressed data.
+ * @param[in,out] dstSize  Capacity of dst in bytes. Updated to size of
+ *                         compressed data on success.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if compressed data does not fit in dst.\n
+ *         Other errors as raised by {@link build_run_table}.
+ */
+HuffmanError huffman_compress_runs(uint8_t* dst,
+								   uint64_t* dstSize,
+								   HuffmanHeader* hdr,
+								   uint8_t* src,
+								   uint64_t srcSize,
+								   uint8_t wordSize,
+								   HuffmanContext* ctx) {
+	if (dst == NULL || dstSize == NULL || hdr == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+	return compress_frame(dst, dstSize, hdr, src, srcSize, wordSize, NULL, 0, true, 1, false, ctx);
+}
+
+/**
+ * Compresses data into a self-contained frame as {@link huffman_compress_ctx}
+ * does, coding word i into stream i % numStreams so that a decoder can
+ * follow all streams at once rather than waiting on the length of every
+ * code in turn. The frame consists of:
+ *	- {@link HUFFMAN_FRAME_INTERLEAVED} (8 bits)
+ *	- Header as written by {@link build_header}
+ *	- Mapping position in built-in mappings (8 bits) and depth (8 bits)
+ *	- Size of uncompressed data in bytes (7 bits per byte, as many bytes as
+ *	  needed)
+ *	- Number of streams (8 bits)
+ *	- Value map: uniqueWords words of wordSize bits, most frequent first
+ *	- Size in bytes of each stream but the last (7 bits per byte, as many
+ *	  bytes as needed), padded to a byte boundary
+ *	- Codes of each stream, each stream padded to a byte boundary, the last
+ *	  stream ending the frame
+ *
+ * Data that is estimated to be incompressible is written with
+ * {@link put_stored} instead.
+ *
+ * @param[out]    dst        Destination for compressed data.
+ * @param[in,out] dstSize    Capacity of dst in bytes. Updated to size of
+ *                           compressed data on success.
+ * @param[out]    hdr        Header populated with metadata.
+ * @param[in]     src        Data to be converted.
+ * @param[in]     srcSize    Size of data in bytes.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     numStreams Number of streams. Range 2 - {@link HUFFMAN_MAX_STREAMS}.
+ * @param[in,out] ctx        Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize, wordSize or numStreams are out
+ *              of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if compressed data does not fit in dst.\n
+ *         Other errors as raised by {@link build_sorted_table}.
+ */
+HuffmanError huffman_compress_interleaved(uint8_t* dst,
+										  uint64_t* dstSize,
+										  HuffmanHeader* hdr,
+										  uint8_t* src,
+										  uint64_t srcSize,
+										  uint8_t wordSize,
+										  uint8_t numStreams,
+										  HuffmanContext* ctx) {
+	if (dst == NULL || dstSize == NULL || hdr == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE ||
+			numStreams < 2 ||
+			numStreams > HUFFMAN_MAX_STREAMS) {
+		return ERR_INVALID_VALUE;
+	}
+	return compress_frame(dst, dstSize, hdr, src, srcSize, wordSize, NULL, 0, false, numStreams,
+			false, ctx);
+}
+
+/**
+ * Compresses data into a self-contained frame as {@link huffman_compress_ctx}
+ * does, ending it with a CRC32C of the data so that
+ * {@link huffman_decompress_ctx} detects corruption. The frame type carries
+ * {@link HUFFMAN_FRAME_CHECKSUM}. Words are hashed a block at a time as they
+ * are coded, while still in cache, rather than in a pass of their own.
+ *
+ * @param[out]    dst      Destination for compressed data.
+ * @param[in,out] dstSize  Capacity of dst in bytes. Updated to size of
+ *                         compressed data on success.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return Errors as raised by {@link huffman_compress_ctx}.
+ */
+HuffmanError huffman_compress_checksum(uint8_t* dst,
+									   uint64_t* dstSize,
+									   HuffmanHeader* hdr,
+									   uint8_t* src,
+									   uint64_t srcSize,
+									   uint8_t wordSize,
+									   HuffmanContext* ctx) {
+	if (dst == NULL || dstSize == NULL || hdr == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+	return compress_frame(dst, dstSize, hdr, src, srcSize, wordSize, NULL, 0, false, 1, true, ctx);
+}
+
+/**
+ * Compresses data into a self-contained frame.
+ *
+ * @see huffman_compress_ctx
+ *
+ * @param[out]    dst      Destination for compressed data.
+ * @param[in,out] dstSize  Capacity of dst in bytes. Updated to size of
+ *                         compressed data on success.
+ * @param[out]    hdr      Header populated with metadata.
+ * @param[in]     src      Data to be converted.
+ * @param[in]     srcSize  Size of data in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ *
+ * @return Errors as raised by {@link huffman_compress_ctx}.
+ */
+HuffmanError huffman_compress(uint8_t* dst,
+							  uint64_t* dstSize,
+							  HuffmanHeader* hdr,
+							  uint8_t* src,
+							  uint64_t srcSize,
+							  uint8_t wordSize) {
+	return huffman_compress_ctx(dst, dstSize, hdr, src, srcSize, wordSize, NULL);
+}
+
+/**
+ * Decompresses a frame written by {@link huffman_compress}, allocating the
+ * value map from a reusable context. Table, escaped, run, interleaved and
+ * stored frames are accepted, with or without a checksum. A checksum is
+ * verified against the decompressed data, which is hashed as it is decoded
+ * where the frame is coded as a single stream.
+ *
+ * @param[out]    dst     Destination for decompressed data.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of
+ *                        decompressed data on success.
+ * @param[in]     src     Compressed frame.
+ * @param[in]     srcSize Size of frame in bytes.
+ * @param[in,out] ctx     Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize is 0.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if frame is truncated or decompressed
+ *              data does not fit in dst.\n
+ *         {@link ERR_INVALID_DATA} if frame is not a valid table, escaped, run,
+ *              interleaved or stored frame, or its checksum does not match.\n
+ *         Other errors as raised by {@link parse_header}.
+ */
+HuffmanError huffman_decompress_ctx(uint8_t* dst,
+									uint64_t* dstSize,
+									uint8_t* src,
+									uint64_t srcSize,
+									HuffmanContext* ctx) {
+	HuffmanError err;
+	uint8_t type;
+	uint32_t expected = 0, crc = 0;
+	uint32_t* crcPtr = NULL;
+	if (dst == NULL || dstSize == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0) {
+		return ERR_INVALID_VALUE;
+	}
+	type = src[0] & (uint8_t) ~HUFFMAN_FRAME_CHECKSUM;
+	if (type != HUFFMAN_FRAME_TABLE && type != HUFFMAN_FRAME_ESCAPED &&
+			type != HUFFMAN_FRAME_RUNS && type != HUFFMAN_FRAME_INTERLEAVED &&
+			type != HUFFMAN_FRAME_STORED) {
+		return ERR_INVALID_DATA;
+	}
+	// Checksum takes the last bytes, left out of the rest of the frame
+	if (src[0] & HUFFMAN_FRAME_CHECKSUM) {
+		if (srcSize < 1 + HUFFMAN_CHECKSUM_BYTES) {
+			return ERR_INSUFFICIENT_SPACE;
+		}
+		srcSize -= HUFFMAN_CHECKSUM_BYTES;
+		expected = get_checksum(&src[srcSize]);
+		crcPtr = &crc;
+	}
+	if (type == HUFFMAN_FRAME_STORED) {
+		THROW_ERR(get_stored(dst, dstSize, src, srcSize, crcPtr))
+		return (crc == expected) ? ERR_NO_ERR : ERR_INVALID_DATA;
+	}
+
+	HuffmanContextMark mark;
+	HuffmanMapContext mapCtx;
+	HuffmanHeader hdr;
+	uint8_t* currPtr = &src[1];
+	uint8_t currBit = 0;
+	uint64_t remaining = srcSize - 1;
+	uint64_t mapping, depth, dataSize, i;
+	uint64_t escapeIdx = HUFFMAN_MAX_UINT64;
+	uint64_t numStreams = 1;
+	uint64_t* words;
+
+	THROW_ERR(parse_header(&hdr, &currPtr, &currBit, &remaining))
+	THROW_ERR(read_bits(&mapping, &currPtr, &currBit, &remaining, 8))
+	THROW_ERR(read_bits(&depth, &currPtr, &currBit, &remaining, 8))
+	THROW_ERR(read_varint(&dataSize, &currPtr, &currBit, &remaining))
+	if (type == HUFFMAN_FRAME_INTERLEAVED) {
+		THROW_ERR(read_bits(&numStreams, &currPtr, &currBit, &remaining, 8))
+		if (numStreams == 0 || numStreams > HUFFMAN_MAX_STREAMS) {
+			return ERR_INVALID_DATA;
+		}
+	}
+	// Rank of escape or run escape, left out of value map
+	if (type == HUFFMAN_FRAME_ESCAPED || type == HUFFMAN_FRAME_RUNS) {
+		THROW_ERR(read_varint(&escapeIdx, &currPtr, &currBit, &remaining))
+		if (escapeIdx >= hdr.uniqueWords) {
+			return ERR_INVALID_DATA;
+		}
+	}
+	if (mapping >= HUFFMAN_NUM_BUILTIN_COMPRESSORS ||
+			huffman_init_map_context(&mapCtx, builtinCompressors[mapping],
+					hdr.uniqueWords, (uint8_t) depth) != ERR_NO_ERR) {
+		return ERR_INVALID_DATA;
+	}
+	// Value map must be present before allocating for it
+	if (hdr.uniqueWords - (escapeIdx != HUFFMAN_MAX_UINT64) >
+			(remaining * 8 - currBit) / hdr.wordSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	if (dataSize > *dstSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	if (dataSize == 0) {
+		return ERR_INVALID_DATA;
+	}
+
+	context_enter(&mark, ctx);
+	words = (uint64_t*) context_alloc(ctx, hdr.uniqueWords * sizeof(uint64_t));
+	err = words ? ERR_NO_ERR : ERR_INSUFFICIENT_SPACE;
+	for (i = 0; !err && i < hdr.uniqueWords; i++) {
+		if (i == escapeIdx) {
+			words[i] = 0;
+		} else {
+			err = read_bits(&words[i], &currPtr, &currBit, &remaining, hdr.wordSize);
 		}
+	}
+	if (!err && type == HUFFMAN_FRAME_RUNS) {
+		err = decode_runs(dst, dataSize, &currPtr, &currBit, &remaining, hdr.wordSize,
+				words, builtinCompressors[mapping], &mapCtx, escapeIdx);
+		crc = (!err && crcPtr) ? huffman_crc32c(0, dst, dataSize) : 0;
+	} else if (!err && type == HUFFMAN_FRAME_INTERLEAVED) {
+		err = decode_streams(dst, dataSize, &currPtr, &currBit, &remaining, hdr.wordSize,
+				words, builtinCompressors[mapping], &mapCtx, (uint8_t) numStreams);
+		crc = (!err && crcPtr) ? huffman_crc32c(0, dst, dataSize) : 0;
+	} else if (!err) {
+		err = decode_words(dst, dataSize, &currPtr, &currBit, &remaining, hdr.wordSize,
+				words, builtinCompressors[mapping], &mapCtx, escapeIdx, NULL, crcPtr);
+	}
+	if (words) {
+		context_free(ctx, words, hdr.uniqueWords * sizeof(uint64_t));
+	}
+	context_leave(ctx, &mark);
+
+	if (err) {
+		return err;
+	}
+	if (crc != expected) {
+		return ERR_INVALID_DATA;
+	}
+	*dstSize = dataSize;
+	return ERR_NO_ERR;
+}
+
+/**
+ * Decompresses a frame written by {@link huffman_compress}.
+ *
+ * @see huffman_decompress_ctx
+ *
+ * @param[out]    dst     Destination for decompressed data.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of
+ *                        decompressed data on success.
+ * @param[in]     src     Compressed frame.
+ * @param[in]     srcSize Size of frame in bytes.
+ *
+ * @return Errors as raised by {@link huffman_decompress_ctx}.
+ */
+HuffmanError huffman_decompress(uint8_t* dst,
+								uint64_t* dstSize,
+								uint8_t* src,
+								uint64_t srcSize) {
+	return huffman_decompress_ctx(dst, dstSize, src, srcSize, NULL);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the size of the word array of a dictionary.
+ *
+ * @param[in] uniqueWords Number of words in dictionary.
+ *
+ * @return Size in bytes.
+ */
+static inline uint64_t get_dictionary_bytes(uint64_t uniqueWords) {
+	return ((uniqueWords > 0) ? uniqueWords : 1) * sizeof(uint64_t);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Populates a dictionary from ranked words. Memory is taken from the
+ * allocator of ctx, not its arena, since the dictionary outlives the call.
+ *
+ * @param[out]    dict        Dictionary to be populated.
+ * @param[in]     id          Dictionary identifier.
+ * @param[in]     wordSize    Word size used for compression.
+ * @param[in]     words       Words by decreasing frequency.
+ * @param[in]     stride      Distance between consecutive words in words.
+ * @param[in]     uniqueWords Number of words.
+ * @param[in]     compressor  Built-in mapping used to code indices.
+ * @param[in]     depth       Depth parameter of mapping.
+ * @param[in]     ctx         Context whose allocator is used, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if allocation failed.\n
+ *         Other errors as raised by {@link huffman_init_map_context}.
+ */
+static HuffmanError build_dictionary(HuffmanDictionary* dict,
+									 uint32_t id,
+									 uint8_t wordSize,
+									 const uint64_t* words,
+									 uint64_t stride,
+									 uint64_t uniqueWords,
+									 const HuffmanCompressor* compressor,
+									 uint8_t depth,
+									 HuffmanContext* ctx) {
+	HuffmanError err;
+	uint64_t i;
+
+	memset(dict, 0x00, sizeof(HuffmanDictionary));
+	dict->allocator = (ctx != NULL) ? *context_allocator(ctx) : defaultAllocator;
+	THROW_ERR(huffman_init_map_context(&dict->mapCtx, compressor, uniqueWords + 1, depth))
+	dict->id = id;
+	dict->wordSize = wordSize;
+	dict->uniqueWords = uniqueWords;
+	dict->compressor = compressor;
+	dict->depthParam = depth;
+
+	// Allocate at least one word so empty dictionaries are distinguishable
+	dict->words = (uint64_t*) dict->allocator.allocate(get_dictionary_bytes(uniqueWords),
+			HUFFMAN_ARENA_ALIGN, dict->allocator.user);
+	dict->lookup.size = get_lookup_size(uniqueWords);
+	dict->lookup.table = (uint64_t*) dict->allocator.allocate(
+			2 * sizeof(uint64_t) * dict->lookup.size,
+			alloc_align(2 * sizeof(uint64_t) * dict->lookup.size), dict->allocator.user);
+	if (!dict->words || !dict->lookup.table) {
+		huffman_dictionary_free(dict);
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	memset(dict->lookup.table, 0x00, 2 * sizeof(uint64_t) * dict->lookup.size);
+	for (i = 0; i < uniqueWords; i++) {
+		dict->words[i] = words[i * stride];
+	}
+	err = build_rank_lookup(&dict->lookup, dict->words, 1, uniqueWords, HUFFMAN_MAX_UINT64);
+	if (err) {
+		huffman_dictionary_free(dict);
+	}
+	return err;
+}
+
+/**
+ * Trains a dictionary from a corpus of representative data. The frequency
+ * table is built and sorted once, and the built-in mapping and depth giving
+ * the smallest compressed corpus are kept.
+ *
+ * @param[out]    dict     Dictionary to be trained. Must be released with
+ *                         {@link huffman_dictionary_free}.
+ * @param[in]     id       Identifier written to each frame.
+ * @param[in]     src      Training corpus.
+ * @param[in]     srcSize  Size of corpus in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
+ *         Other errors as raised by {@link build_sorted_table}.
+ */
+HuffmanError huffman_dictionary_train(HuffmanDictionary* dict,
+									  uint32_t id,
+									  uint8_t* src,
+									  uint64_t srcSize,
+									  uint8_t wordSize,
+									  HuffmanContext* ctx) {
+	HuffmanError err;
+	if (dict == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 ||
+			wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+
+	HuffmanHashTable table;
+	HuffmanContextMark mark;
+	HuffmanHeader hdr;
+	HuffmanStats best;
+
+	context_enter(&mark, ctx);
+	err = build_sorted_table(&hdr, &table, src, srcSize, wordSize, NULL, ctx);
+	if (err) {
+		context_leave(ctx, &mark);
+		return err;
+	}
+
+	// Reserve one index for escape code
+	err = select_builtin(&best, &hdr, &table, 1);
+	if (!err) {
+		err = build_dictionary(dict, id, wordSize, &table.table[1], 2, hdr.uniqueWords,
+				best.compressor, best.depthParam, ctx);
+	}
+
+	table_free(ctx, table.table, table.size);
+	context_leave(ctx, &mark);
+	return err;
+}
+
+/**
+ * Serializes a dictionary so it can be loaded by
+ * {@link huffman_dictionary_load}. The format consists of:
+ *	- Header as written by {@link build_header}, with padBits of 0
+ *	- Dictionary identifier (32 bits)
+ *	- Mapping position in built-in mappings (8 bits) and depth (8 bits)
+ *	- Words of wordSize bits, most frequent first
+ *
+ * @param[out]    dst     Destination for serialized dictionary.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of
+ *                        serialized dictionary on success.
+ * @param[in]     dict    Dictionary to be serialized.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         Other errors as raised by {@link build_header} and {@link put_bits}.
+ */
+HuffmanError huffman_dictionary_serialize(uint8_t* dst,
+										  uint64_t* dstSize,
+										  const HuffmanDictionary* dict) {
+	HuffmanError err;
+	if (dst == NULL || dstSize == NULL || dict == NULL || dict->words == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	HuffmanHeader hdr;
+	uint8_t* currPtr = dst;
+	uint8_t currBit = 0;
+	uint64_t remaining = *dstSize;
+	uint64_t i;
+
+	hdr.wordSize = dict->wordSize;
+	hdr.padBits = 0;
+	hdr.uniqueWords = dict->uniqueWords;
+	THROW_ERR(build_header(&currPtr, &currBit, &remaining, &hdr))
+	THROW_ERR(put_bits(&currPtr, &currBit, &remaining, dict->id, 32))
+	THROW_ERR(put_bits(&currPtr, &currBit, &remaining, get_builtin_id(dict->compressor), 8))
+	THROW_ERR(put_bits(&currPtr, &currBit, &remaining, dict->depthParam, 8))
+	for (i = 0; i < dict->uniqueWords; i++) {
+		THROW_ERR(put_bits(&currPtr, &currBit, &remaining, dict->words[i], dict->wordSize))
+	}
+
+	*dstSize = (uint64_t) (currPtr - dst) + (currBit > 0);
+	return ERR_NO_ERR;
+}
+
+/**
+ * Loads a dictionary written by {@link huffman_dictionary_serialize}.
+ *
+ * @param[out] dict    Dictionary to be loaded. Must be released with
+ *                     {@link huffman_dictionary_free}.
+ * @param[in]  src     Serialized dictionary.
+ * @param[in]  srcSize Size of serialized dictionary in bytes.
+ * @param[in]  ctx     Context whose allocator is used, or null to use the heap.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if src is truncated or allocation failed.\n
+ *         {@link ERR_INVALID_DATA} if src is not a valid dictionary.\n
+ *         Other errors as raised by {@link parse_header}.
+ */
+HuffmanError huffman_dictionary_load(HuffmanDictionary* dict,
+									 uint8_t* src,
+									 uint64_t srcSize,
+									 HuffmanContext* ctx) {
+	HuffmanError err;
+	if (dict == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	HuffmanContextMark mark;
+	HuffmanHeader hdr;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+	uint64_t remaining = srcSize;
+	uint64_t id, mapping, depth, i;
+	uint64_t* words;
+
+	THROW_ERR(parse_header(&hdr, &currPtr, &currBit, &remaining))
+	THROW_ERR(read_bits(&id, &currPtr, &currBit, &remaining, 32))
+	THROW_ERR(read_bits(&mapping, &currPtr, &currBit, &remaining, 8))
+	THROW_ERR(read_bits(&depth, &currPtr, &currBit, &remaining, 8))
+	if (mapping >= HUFFMAN_NUM_BUILTIN_COMPRESSORS ||
+			depth > builtinCompressors[mapping]->maxDepth) {
+		return ERR_INVALID_DATA;
+	}
+	if (hdr.uniqueWords > (remaining * 8 - currBit) / hdr.wordSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+
+	context_enter(&mark, ctx);
+	words = (uint64_t*) context_alloc(ctx, hdr.uniqueWords * sizeof(uint64_t));
+	err = words ? ERR_NO_ERR : ERR_INSUFFICIENT_SPACE;
+	for (i = 0; !err && i < hdr.uniqueWords; i++) {
+		err = read_bits(&words[i], &currPtr, &currBit, &remaining, hdr.wordSize);
+	}
+	if (!err) {
+		err = build_dictionary(dict, (uint32_t) id, hdr.wordSize, words, 1, hdr.uniqueWords,
+				builtinCompressors[mapping], (uint8_t) depth, ctx);
+	}
+	if (words) {
+		context_free(ctx, words, hdr.uniqueWords * sizeof(uint64_t));
+	}
+	context_leave(ctx, &mark);
+	return err;
+}
+
+/**
+ * Releases memory held by a dictionary.
+ *
+ * @param[in,out] dict Dictionary to be released.
+ */
+void huffman_dictionary_free(HuffmanDictionary* dict) {
+	if (dict == NULL) {
+		return;
+	}
+	const HuffmanAllocator* allocator = (dict->allocator.allocate != NULL) ?
+			&dict->allocator : &defaultAllocator;
+	if (dict->words != NULL) {
+		allocator->release(dict->words, get_dictionary_bytes(dict->uniqueWords), allocator->user);
+	}
+	if (dict->lookup.table != NULL) {
+		allocator->release(dict->lookup.table, 2 * sizeof(uint64_t) * dict->lookup.size,
+				allocator->user);
+	}
+	memset(dict, 0x00, sizeof(HuffmanDictionary));
+}
+
+/**
+ * Obtains the dictionary identifier of a frame written by
+ * {@link huffman_dictionary_compress}, so the receiver can select the
+ * dictionary to decompress it with.
+ *
+ * @param[out] id      Destination for identifier.
+ * @param[in]  src     Compressed frame.
+ * @param[in]  srcSize Size of frame in bytes.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if frame is truncated.\n
+ *         {@link ERR_INVALID_DATA} if frame does not reference a dictionary.
+ */
+HuffmanError huffman_get_dictionary_id(uint32_t* id,
+									   uint8_t* src,
+									   uint64_t srcSize) {
+	HuffmanError err;
+	if (id == NULL || src == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize < 5) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	if (src[0] != HUFFMAN_FRAME_DICTIONARY) {
+		return ERR_INVALID_DATA;
+	}
+	uint8_t* currPtr = &src[1];
+	uint8_t currBit = 0;
+	uint64_t remaining = srcSize - 1;
+	uint64_t temp;
+	THROW_ERR(read_bits(&temp, &currPtr, &currBit, &remaining, 32))
+	*id = (uint32_t) temp;
+	return ERR_NO_ERR;
+}
+
+/**
+ * Compresses a message against a trained dictionary. No frequency table is
+ * built or sorted. The frame consists of:
+ *	- {@link HUFFMAN_FRAME_DICTIONARY} (8 bits)
+ *	- Dictionary identifier (32 bits)
+ *	- Size of uncompressed data in bytes (7 bits per byte, as many bytes as
+ *	  needed)
+ *	- Code of each word, with words missing from the dictionary escaped
+ *
+ * @param[out]    dst     Destination for compressed data.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of
+ *                        compressed data on success.
+ * @param[in]     src     Data to be converted.
+ * @param[in]     srcSize Size of data in bytes.
+ * @param[in]     dict    Dictionary to compress against.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize is 0.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if compressed data does not fit in dst.
+ */
+HuffmanError huffman_dictionary_compress(uint8_t* dst,
+										 uint64_t* dstSize,
+										 uint8_t* src,
+										 uint64_t srcSize,
+										 const HuffmanDictionary* dict) {
+	HuffmanError err;
+	if (dst == NULL || dstSize == NULL || src == NULL || dict == NULL ||
+			dict->lookup.table == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0) {
+		return ERR_INVALID_VALUE;
+	}
+
+	uint8_t* currPtr = dst;
+	uint8_t currBit = 0;
+	uint64_t remaining = *dstSize;
+
+	THROW_ERR(put_bits(&currPtr, &currBit, &remaining, HUFFMAN_FRAME_DICTIONARY, 8))
+	THROW_ERR(put_bits(&currPtr, &currBit, &remaining, dict->id, 32))
+	THROW_ERR(put_varint(&currPtr, &currBit, &remaining, srcSize))
+	THROW_ERR(encode_words(&currPtr, &currBit, &remaining, src, srcSize, dict->wordSize,
+			&dict->lookup, dict->compressor, &dict->mapCtx, dict->uniqueWords, NULL, NULL))
+
+	*dstSize = (uint64_t) (currPtr - dst) + (currBit > 0);
+	return ERR_NO_ERR;
+}
+
+/**
+ * Decompresses a frame written by {@link huffman_dictionary_compress}.
+ *
+ * @param[out]    dst     Destination for decompressed data.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of
+ *                        decompressed data on success.
+ * @param[in]     src     Compressed frame.
+ * @param[in]     srcSize Size of frame in bytes.
+ * @param[in]     dict    Dictionary frame was compressed against.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if frame is truncated or decompressed
+ *              data does not fit in dst.\n
+ *         {@link ERR_INVALID_DATA} if frame references a different
+ *              dictionary or contains invalid codes.
+ */
+HuffmanError huffman_dictionary_decompress(uint8_t* dst,
+										   uint64_t* dstSize,
+										   uint8_t* src,
+										   uint64_t srcSize,
+										   const HuffmanDictionary* dict) {
+	HuffmanError err;
+	if (dst == NULL || dstSize == NULL || src == NULL || dict == NULL ||
+			dict->words == NULL) {
+		return ERR_NULL_PTR;
+	}
+
+	uint32_t id;
+	uint8_t* currPtr;
+	uint8_t currBit = 0;
+	uint64_t remaining;
+	uint64_t dataSize;
+
+	THROW_ERR(huffman_get_dictionary_id(&id, src, srcSize))
+	if (id != dict->id) {
+		return ERR_INVALID_DATA;
+	}
+	currPtr = &src[5];
+	remaining = srcSize - 5;
+	THROW_ERR(read_varint(&dataSize, &currPtr, &currBit, &remaining))
+	if (dataSize == 0) {
+		return ERR_INVALID_DATA;
+	}
+	if (dataSize > *dstSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	THROW_ERR(decode_words(dst, dataSize, &currPtr, &currBit, &remaining, dict->wordSize,
+			dict->words, dict->compressor, &dict->mapCtx, dict->uniqueWords, NULL, NULL))
+
+	*dstSize = dataSize;
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Adds every complete word of a block to a histogram without coding it.
+ *
+ * @param[in,out] hist     Histogram to be updated.
+ * @param[in]     src      Block to be counted.
+ * @param[in]     srcSize  Size of block in bytes.
+ * @param[in]     wordSize Word size used for compression.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by {@link add_to_table}.
+ */
+static HuffmanError histogram_count(HuffmanHistogram* hist,
+									uint8_t* src,
+									uint64_t srcSize,
+									uint8_t wordSize) {
+	HuffmanError err;
+	uint8_t finalBits;
+	uint64_t numWords = get_word_count(&finalBits, srcSize, wordSize);
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+	uint64_t i, word;
+
+	if (finalBits != 0) {
+		numWords--;
+	}
+	for (i = 0; i < numWords; i++) {
+		THROW_ERR(extract_bits(&word, &currPtr, &currBit, wordSize))
+		THROW_ERR(add_to_table(&hist->table, &hist->numWords, word, hist->maxSize, hist->ctx))
+	}
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Builds the code for the next block of a stream from the histogram of the
+ * current block. The histogram is sorted in place.
+ *
+ * @param[out]    code     Code to be built. Must be released with
+ *                         {@link huffman_dictionary_free}.
+ * @param[out]    best     Estimated size of current block coded with code.
+ * @param[in,out] hist     Histogram of current block.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context whose allocator is used, or null.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         Other errors as raised by {@link sort_table},
+ *         {@link select_builtin} and {@link build_dictionary}.
+ */
+static HuffmanError build_stream_code(HuffmanDictionary* code,
+									  HuffmanStats* best,
+									  HuffmanHistogram* hist,
+									  uint8_t wordSize,
+									  HuffmanContext* ctx) {
+	HuffmanError err;
+	HuffmanHeader hdr;
+
+	hdr.wordSize = wordSize;
+	hdr.padBits = 0;
+	hdr.uniqueWords = hist->numWords;
+	THROW_ERR(sort_table(&hdr, &hist->table))
+	// Reserve one index for escape code
+	THROW_ERR(select_builtin(best, &hdr, &hist->table, 1))
+	return build_dictionary(code, 0, wordSize, &hist->table.table[1], 2, hdr.uniqueWords,
+			best->compressor, best->depthParam, ctx);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Writes the fields common to every block of a stream.
+ *
+ * @param[in,out] dst       Pointer to first byte in which to set data. Updated to first byte of following section.
+ * @param[in,out] start     Bit from which to start. Updated to first bit of following section. Range 0-7.
+ * @param[in,out] dstSize   Number of bytes free in dst. Updated to remaining number of bytes.
+ * @param[in]     wordSize  Word size used for compression.
+ * @param[in]     fresh     Whether block carries its own table.
+ * @param[in]     last      Whether block ends the stream.
+ * @param[in]     blockSize Size of uncompressed block in bytes.
+ * @param[in]     checksum  Whether block ends with a checksum.
+ *
+ * @return Errors as raised by {@link put_bits}.
+ */
+static HuffmanError put_block_header(uint8_t** dst,
+									 uint8_t* start,
+									 uint64_t* dstSize,
+									 uint8_t wordSize,
+									 bool fresh,
+									 bool last,
+									 uint64_t blockSize,
+									 bool checksum) {
+	HuffmanError err;
+	THROW_ERR(put_bits(dst, start, dstSize,
+			HUFFMAN_FRAME_BLOCK | (checksum ? HUFFMAN_FRAME_CHECKSUM : 0), 8))
+	THROW_ERR(put_bits(dst, start, dstSize, wordSize, HUFFMAN_WORD_SIZE_NUM_BITS))
+	THROW_ERR(put_bits(dst, start, dstSize, fresh, 1))
+	THROW_ERR(put_bits(dst, start, dstSize, last, 1))
+	return put_varint(dst, start, dstSize, blockSize);
+}
+
+/**
+ * Initializes a stream for compression or decompression.
+ *
+ * @param[out]    stream   Stream to be initialized. Must be released with
+ *                         {@link huffman_stream_free}.
+ * @param[in]     wordSize Word size used for compression.
+ * @param[in,out] ctx      Context to allocate from, or null to use the heap.
+ *                         Must remain valid until stream is released.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if stream is null.\n
+ *         {@link ERR_INVALID_VALUE} if wordSize is out of accepted range.
+ */
+HuffmanError huffman_stream_init(HuffmanStream* stream,
+								 uint8_t wordSize,
+								 HuffmanContext* ctx) {
+	if (stream == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (wordSize < HUFFMAN_MIN_WORD_SIZE || wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
+	memset(stream, 0x00, sizeof(HuffmanStream));
+	stream->wordSize = wordSize;
+	stream->ctx = ctx;
+	return ERR_NO_ERR;
+}
+
+/**
+ * Releases memory held by a stream.
+ *
+ * @param[in,out] stream Stream to be released.
+ */
+void huffman_stream_free(HuffmanStream* stream) {
+	if (stream == NULL) {
+		return;
+	}
+	huffman_dictionary_free(&stream->code);
+	memset(stream, 0x00, sizeof(HuffmanStream));
+}
+
+/**
+ * Compresses the next block of a stream. The block is coded in a single pass
+ * with the code built from the previous block while its histogram is
+ * gathered. If coding the block with a table built from that histogram is
+ * estimated to be smaller, including the cost of the table, the block is
+ * coded again with the fresh table. The first block always uses a fresh
+ * table. Either way, the histogram becomes the code of the next block.
+ *
+ * Each block is written as a frame consisting of:
+ *	- {@link HUFFMAN_FRAME_BLOCK} (8 bits)
+ *	- Word size ({@link HUFFMAN_WORD_SIZE_NUM_BITS} bits)
+ *	- Whether block carries a fresh table (1 bit)
+ *	- Whether block ends the stream (1 bit)
+ *	- Size of uncompressed block in bytes (7 bits per byte, as many bytes as
+ *	  needed)
+ *	- If fresh: number of words (7 bits per byte), mapping position in
+ *	  built-in mappings (8 bits), depth (8 bits) and words of wordSize bits
+ *	- Code of each word, with words missing from the code escaped
+ *	- If the stream is checksummed, CRC32C of the stream so far as written by
+ *	  {@link put_checksum}. It is gathered while the block is coded.
+ *
+ * @param[out]    dst     Destination for compressed block.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of
+ *                        compressed block on success.
+ * @param[in]     src     Block to be compressed.
+ * @param[in]     srcSize Size of block in bytes. Every block except the last
+ *                        must hold a whole number of words.
+ * @param[in]     last    Whether block ends the stream.
+ * @param[in,out] stream  Stream state.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if srcSize is 0 or not a whole number of
+ *              words for a block other than the last, or the stream has ended.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if compressed block does not fit in dst.\n
+ *         Other errors as raised by {@link add_to_table}.
+ */
+HuffmanError huffman_stream_compress_block(uint8_t* dst,
+										   uint64_t* dstSize,
+										   uint8_t* src,
+										   uint64_t srcSize,
+										   uint8_t last,
+										   HuffmanStream* stream) {
+	HuffmanError err;
+	if (dst == NULL || dstSize == NULL || src == NULL || stream == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (srcSize == 0 || stream->finished ||
+			stream->wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			stream->wordSize > HUFFMAN_MAX_WORD_SIZE) {
+		return ERR_INVALID_VALUE;
+	}
 
-		// Find index if padding with 1's
-		highWord = currWord | (1 << padBits) - 1;
-		err = search_table(&highIdx, &table, highWord, false);
-		if (err) { // Full table & not in table
-			skipHigh = true;
-		} else {
-			highVal = get_table_value(table.table, highIdx);
-		}
+	const uint8_t wordSize = stream->wordSize;
+	HuffmanContext* ctx = stream->ctx;
+	HuffmanContextMark mark;
+	HuffmanHistogram hist;
+	HuffmanDictionary next;
+	HuffmanStats best;
+	uint8_t finalBits;
+	uint64_t wordCount = get_word_count(&finalBits, srcSize, wordSize);
+	uint64_t reuseBits = HUFFMAN_MAX_UINT64;
+	uint64_t freshBits, i;
+	uint8_t* currPtr = dst;
+	uint8_t currBit = 0;
+	uint64_t remaining = *dstSize;
+	uint32_t crc = stream->crc;
+	uint32_t* crcPtr = stream->checksum ? &crc : NULL;
+	bool fresh = false;
 
-		// Choose which padding to use:
-		// * If both possible, choose most common one (or lower in case of tie)
-		// * If one possible, choose that one
-		// * If none possible, choose lower (must resize table)
-		if (skipHigh || *lowVal >= *highVal) {
-			err = add_to_table(&table, &numWords, currWord, maxSize);
-		} else {
-			err = add_to_table(&table, &numWords, highWord, maxSize);
+	if (finalBits != 0 && !last) {
+		return ERR_INVALID_VALUE;
+	}
+
+	memset(&next, 0x00, sizeof(HuffmanDictionary));
+	context_enter(&mark, ctx);
+	err = histogram_init(&hist, wordSize, wordCount, ctx);
+
+	// Single pass with previous block's code
+	if (!err && stream->code.words != NULL) {
+		err = put_block_header(&currPtr, &currBit, &remaining, wordSize, false, last, srcSize,
+				stream->checksum);
+		if (!err) {
+			err = encode_words(&currPtr, &currBit, &remaining, src, srcSize, wordSize,
+					&stream->code.lookup, stream->code.compressor, &stream->code.mapCtx,
+					stream->code.uniqueWords, &hist, crcPtr);
 		}
+		if (!err) {
+			reuseBits = (uint64_t) (currPtr - dst) * 8 + currBit;
+		} else if (err == ERR_INSUFFICIENT_SPACE) {
+			// Histogram and checksum are incomplete, a fresh table may still fit
+			crc = stream->crc;
+			table_free(ctx, hist.table.table, hist.table.size);
+			err = histogram_init(&hist, wordSize, wordCount, ctx);
+			if (!err) {
+				err = histogram_count(&hist, src, srcSize, wordSize);
+			}
+		}
+	} else if (!err) {
+		err = histogram_count(&hist, src, srcSize, wordSize);
+	}
 
-		// Check for error
-		if (err) {
-			free(table.table);
-			return err;
+	// Estimate cost of fresh table and recode if smaller
+	if (!err) {
+		err = build_stream_code(&next, &best, &hist, wordSize, ctx);
+	}
+	if (!err) {
+		freshBits = 8 * (1 + 1 + get_varint_bytes(srcSize) + get_varint_bytes(next.uniqueWords) + 2) +
+				next.uniqueWords * wordSize + get_stats_bits(&best);
+		if (freshBits < reuseBits) {
+			fresh = true;
+			currPtr = dst;
+			currBit = 0;
+			remaining = *dstSize;
+			err = put_block_header(&currPtr, &currBit, &remaining, wordSize, true, last, srcSize,
+					stream->checksum);
+			if (!err) {
+				err = put_varint(&currPtr, &currBit, &remaining, next.uniqueWords);
+			}
+			if (!err) {
+				err = put_bits(&currPtr, &currBit, &remaining, get_builtin_id(next.compressor), 8);
+			}
+			if (!err) {
+				err = put_bits(&currPtr, &currBit, &remaining, next.depthParam, 8);
+			}
+			for (i = 0; !err && i < next.uniqueWords; i++) {
+				err = put_bits(&currPtr, &currBit, &remaining, next.words[i], wordSize);
+			}
+			// Checksum is only gathered again if the single pass did not finish
+			if (!err) {
+				err = encode_words(&currPtr, &currBit, &remaining, src, srcSize, wordSize,
+						&next.lookup, next.compressor, &next.mapCtx, next.uniqueWords, NULL,
+						(reuseBits == HUFFMAN_MAX_UINT64) ? crcPtr : NULL);
+			}
 		}
+	}
+	if (!err && crcPtr) {
+		err = put_checksum(&currPtr, &currBit, &remaining, crc);
+	}
 
+	if (hist.table.table) {
+		table_free(ctx, hist.table.table, hist.table.size);
+	}
+	context_leave(ctx, &mark);
+	if (err) {
+		huffman_dictionary_free(&next);
+		return err;
 	}
 
-	// Update header
-	hdr->wordSize = wordSize;
-	hdr->padBits = padBits;
-	hdr->uniqueWords = numWords;
-	// Copy table metadata
-	dst->table = table.table;
-	dst->size = table.size;
+	// Histogram of this block codes the next one
+	huffman_dictionary_free(&stream->code);
+	stream->code = next;
+	stream->finished = last;
+	stream->crc = crc;
+	if (fresh) {
+		stream->freshBlocks++;
+	} else {
+		stream->reusedBlocks++;
+	}
+	*dstSize = (uint64_t) (currPtr - dst) + (currBit > 0);
+	return ERR_NO_ERR;
+}
+
+/**
+ * Decompresses the next block of a stream written by
+ * {@link huffman_stream_compress_block}. Blocks must be decompressed in the
+ * order they were compressed.
+ *
+ * @param[out]    dst     Destination for decompressed block.
+ * @param[in,out] dstSize Capacity of dst in bytes. Updated to size of
+ *                        decompressed block on success.
+ * @param[in]     src     Compressed data beginning with a block.
+ * @param[in,out] srcSize Number of bytes available in src. Updated to size of
+ *                        compressed block on success.
+ * @param[in,out] stream  Stream state.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if the stream has ended.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if block is truncated or
+ *              decompressed block does not fit in dst.\n
+ *         {@link ERR_INVALID_DATA} if src is not a valid block of this stream,
+ *              or its checksum does not match.
+ */
+HuffmanError huffman_stream_decompress_block(uint8_t* dst,
+											 uint64_t* dstSize,
+											 uint8_t* src,
+											 uint64_t* srcSize,
+											 HuffmanStream* stream) {
+	HuffmanError err;
+	if (dst == NULL || dstSize == NULL || src == NULL || srcSize == NULL || stream == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (stream->finished) {
+		return ERR_INVALID_VALUE;
+	}
+
+	const uint8_t wordSize = stream->wordSize;
+	HuffmanContext* ctx = stream->ctx;
+	HuffmanContextMark mark;
+	HuffmanHistogram hist;
+	HuffmanDictionary next;
+	HuffmanStats best;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+	uint64_t remaining = *srcSize;
+	uint64_t temp, fresh, last, blockSize, numWords, mapping, depth, wordCount, i;
+	uint64_t* words = NULL;
+	uint8_t finalBits;
+	uint32_t crc = stream->crc;
+	uint32_t* crcPtr = stream->checksum ? &crc : NULL;
+	uint32_t expected;
+
+	THROW_ERR(read_bits(&temp, &currPtr, &currBit, &remaining, 8))
+	if (temp != (HUFFMAN_FRAME_BLOCK | (stream->checksum ? HUFFMAN_FRAME_CHECKSUM : 0))) {
+		return ERR_INVALID_DATA;
+	}
+	THROW_ERR(read_bits(&temp, &currPtr, &currBit, &remaining, HUFFMAN_WORD_SIZE_NUM_BITS))
+	if (temp != wordSize) {
+		return ERR_INVALID_DATA;
+	}
+	THROW_ERR(read_bits(&fresh, &currPtr, &currBit, &remaining, 1))
+	THROW_ERR(read_bits(&last, &currPtr, &currBit, &remaining, 1))
+	THROW_ERR(read_varint(&blockSize, &currPtr, &currBit, &remaining))
+	wordCount = get_word_count(&finalBits, blockSize, wordSize);
+	if (blockSize == 0 || (finalBits != 0 && !last)) {
+		return ERR_INVALID_DATA;
+	}
+	if (blockSize > *dstSize) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	if (!fresh && stream->code.words == NULL) {
+		return ERR_INVALID_DATA;
+	}
+
+	memset(&next, 0x00, sizeof(HuffmanDictionary));
+	hist.table.table = NULL;
+	context_enter(&mark, ctx);
+
+	if (fresh) {
+		err = read_varint(&numWords, &currPtr, &currBit, &remaining);
+		if (!err) {
+			err = read_bits(&mapping, &currPtr, &currBit, &remaining, 8);
+		}
+		if (!err) {
+			err = read_bits(&depth, &currPtr, &currBit, &remaining, 8);
+		}
+		if (!err && (mapping >= HUFFMAN_NUM_BUILTIN_COMPRESSORS ||
+				depth > builtinCompressors[mapping]->maxDepth)) {
+			err = ERR_INVALID_DATA;
+		}
+		if (!err && numWords > (remaining * 8 - currBit) / wordSize) {
+			err = ERR_INSUFFICIENT_SPACE;
+		}
+		if (!err) {
+			words = (uint64_t*) context_alloc(ctx, get_dictionary_bytes(numWords));
+			err = words ? ERR_NO_ERR : ERR_INSUFFICIENT_SPACE;
+		}
+		for (i = 0; !err && i < numWords; i++) {
+			err = read_bits(&words[i], &currPtr, &currBit, &remaining, wordSize);
+		}
+		if (!err) {
+			err = build_dictionary(&next, 0, wordSize, words, 1, numWords,
+					builtinCompressors[mapping], (uint8_t) depth, ctx);
+		}
+		if (!err) {
+			err = decode_words(dst, blockSize, &currPtr, &currBit, &remaining, wordSize,
+					next.words, next.compressor, &next.mapCtx, next.uniqueWords, NULL, crcPtr);
+		}
+	} else {
+		// Gather histogram while decoding to rebuild encoder's next code
+		err = histogram_init(&hist, wordSize, wordCount, ctx);
+		if (!err) {
+			err = decode_words(dst, blockSize, &currPtr, &currBit, &remaining, wordSize,
+					stream->code.words, stream->code.compressor, &stream->code.mapCtx,
+					stream->code.uniqueWords, &hist, crcPtr);
+		}
+		if (!err && !last) {
+			err = build_stream_code(&next, &best, &hist, wordSize, ctx);
+		}
+	}
+	if (!err && crcPtr) {
+		err = read_checksum(&expected, &currPtr, &currBit, &remaining);
+		if (!err && expected != crc) {
+			err = ERR_INVALID_DATA;
+		}
+	}
+
+	if (hist.table.table) {
+		table_free(ctx, hist.table.table, hist.table.size);
+	}
+	if (words) {
+		context_free(ctx, words, get_dictionary_bytes(numWords));
+	}
+	context_leave(ctx, &mark);
+	if (err) {
+		huffman_dictionary_free(&next);
+		return err;
+	}
 
+	huffman_dictionary_free(&stream->code);
+	stream->code = next;
+	stream->finished = last;
+	stream->crc = crc;
+	if (fresh) {
+		stream->freshBlocks++;
+	} else {
+		stream->reusedBlocks++;
+	}
+	*dstSize = blockSize;
+	*srcSize = (uint64_t) (currPtr - src) + (currBit > 0);
 	return ERR_NO_ERR;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Merges two sorted sub-arrays as part of {@link sort_table}.
+ * Stages a block goes through in a pipelined file compression, in order.
+ */
+typedef enum HuffmanSlotState_enum {
+	/**Slot may be filled by the reader.*/
+	HUFFMAN_SLOT_FREE,
+	/**Block has been read and waits for a worker.*/
+	HUFFMAN_SLOT_READ,
+	/**Block is being processed by a worker.*/
+	HUFFMAN_SLOT_BUSY,
+	/**Block has been processed and waits for the writer.*/
+	HUFFMAN_SLOT_DONE
+} HuffmanSlotState;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Buffers of one block in flight through a pipelined file compression.
+ */
+typedef struct HuffmanPipelineSlot_struct {
+	/**
+	 * Block as read.
+	 */
+	uint8_t* in;
+	/**
+	 * Number of bytes in in.
+	 */
+	uint64_t inSize;
+	/**
+	 * Block as processed.
+	 */
+	uint8_t* out;
+	/**
+	 * Number of bytes in out.
+	 */
+	uint64_t outSize;
+	/**
+	 * CRC32C of uncompressed block, if the file is checksummed.
+	 */
+	uint32_t crc;
+	/**
+	 * Stage of block.
+	 */
+	HuffmanSlotState state;
+} HuffmanPipelineSlot;
+
+/**
+ * @ingroup HuffmanHelpers
+ * State shared by the stages of a pipelined file compression. Block i uses
+ * slot i % numSlots, so slots form a bounded ring between the reader, the
+ * workers and the writer: the reader waits for the writer to free a slot,
+ * workers take read blocks in order and the writer takes processed blocks in
+ * order. Slot states and counters are guarded by lock.
+ */
+typedef struct HuffmanPipeline_struct {
+	/**
+	 * File read from.
+	 */
+	FILE* src;
+	/**
+	 * File written to.
+	 */
+	FILE* dst;
+	/**
+	 * Whether blocks are decompressed rather than compressed.
+	 */
+	bool decompress;
+	/**
+	 * Word size used for compression.
+	 */
+	uint8_t wordSize;
+	/**
+	 * Whether frames and the file end with checksums.
+	 */
+	bool checksum;
+	/**
+	 * CRC32C of the uncompressed blocks written so far, combined by the
+	 * writer from the CRC32C of each block.
+	 */
+	uint32_t crc;
+	/**
+	 * CRC32C of the whole file read from its end when decompressing.
+	 */
+	uint32_t expected;
+	/**
+	 * Set once the reader reaches the checksum ending a file.
+	 */
+	bool trailer;
+	/**
+	 * Size of uncompressed blocks in bytes.
+	 */
+	uint64_t blockSize;
+	/**
+	 * Capacity of each slot's buffers in bytes.
+	 */
+	uint64_t slotSize;
+	/**
+	 * Ring of blocks in flight.
+	 */
+	HuffmanPipelineSlot* slots;
+	/**
+	 * Number of slots.
+	 */
+	uint64_t numSlots;
+	/**
+	 * Number of blocks read.
+	 */
+	uint64_t numRead;
+	/**
+	 * Number of blocks taken by workers.
+	 */
+	uint64_t numTaken;
+	/**
+	 * Number of blocks written.
+	 */
+	uint64_t numWritten;
+	/**
+	 * Set once the reader reaches the end of src.
+	 */
+	bool eof;
+	/**
+	 * First error raised by any stage. Stops every stage.
+	 */
+	HuffmanError err;
+#ifdef HUFFMAN_THREADS
+	/**
+	 * Guards slot states, counters and err.
+	 */
+	pthread_mutex_t lock;
+	/**
+	 * Signalled whenever a slot changes state or the pipeline stops.
+	 */
+	pthread_cond_t changed;
+#endif
+} HuffmanPipeline;
+
+/**
+ * @ingroup HuffmanHelpers
+ * Determines the size of a {@link HUFFMAN_FRAME_STORED} frame, which bounds
+ * the size of every frame written by {@link pipeline_process}.
  *
- * Merge operates under several key assumptions:
- *	- sizeLeft >= sizeRight
- *	- Left and right sub-arrays are located sequentially
- *	  in memory to allow overlap.
- *	- All non-zero values are at front of sub-arrays.
+ * @param[in] srcSize  Size of data in bytes.
+ * @param[in] checksum Whether frame ends with a checksum.
  *
- * @param[in,out] left      Left sub-array, also beginning of output array.
- * @param[in,out] right     Right sub-array. State after merge is not guaranteed.
- * 							Partially overwritten if number of non-zero elements
- * 							in left and right arrays combined > sizeLeft.
- * @param[in]     sizeLeft  Capacity of left sub-array.
- * @param[in]     sizeRight Capacity of right sub-array.
+ * @return Size of stored frame in bytes.
+ */
+static inline uint64_t get_stored_size(uint64_t srcSize,
+									   bool checksum) {
+	return 1 + get_varint_bytes(srcSize) + srcSize + checksum * HUFFMAN_CHECKSUM_BYTES;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Writes a value to a file 7 bits per byte as {@link put_varint} does.
  *
- * @return Total number of non-empty elements in merged array.
+ * @param[in] file File to write to.
+ * @param[in] val  Value to be written.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_IO} if write failed.
  */
-static uint64_t merge_table(uint64_t* left,
-							uint64_t* right,
-							uint64_t sizeLeft,
-							uint64_t sizeRight) {
-	uint64_t lIdx = 0;
-	uint64_t rIdx = 0;
-	uint64_t lVal, rVal, lId;
-	uint64_t *lIdPtr;
-	uint64_t tempIdx = 0;
+static HuffmanError file_put_varint(FILE* file,
+									uint64_t val) {
+	HuffmanError err;
+	uint8_t buf[10];
+	uint8_t* currPtr = buf;
+	uint8_t currBit = 0;
+	uint64_t remaining = sizeof(buf);
 
-	// merge two sub-arrays
-	while (lIdx < sizeLeft + sizeRight || rIdx < sizeRight) {
-		// get values if present
-		lVal = *get_table_value(left, lIdx);
-		rVal = (rIdx < sizeRight) ? *get_table_value(right, rIdx) : 0;
+	THROW_ERR(put_varint(&currPtr, &currBit, &remaining, val))
+	if (fwrite(buf, 1, (size_t) (currPtr - buf), file) != (size_t) (currPtr - buf)) {
+		return ERR_IO;
+	}
+	return ERR_NO_ERR;
+}
 
-		if (lVal > 0 && rVal > 0) { // both left and right not done
-			if (rVal > lVal) { // right needs to go left
-				tempIdx = lIdx;
-				// backtrace to correct position if needed (unlikely)
-				while (tempIdx > 0 && *get_table_value(left, tempIdx - 1) < rVal) {
-					tempIdx--;
-				}
-				lIdx = tempIdx;
-				// swap id
-				lIdPtr = get_table_id(left, lIdx);
-				lId = *lIdPtr;
-				*lIdPtr = *get_table_id(right, rIdx);
-				*get_table_id(right, rIdx) = lId;
-				// swap val
-				*get_table_value(right, rIdx) = *get_table_value(left, lIdx);
-				*get_table_value(left, lIdx) = rVal;
+/**
+ * @ingroup HuffmanHelpers
+ * Reads a value written by {@link file_put_varint}.
+ *
+ * @param[out] dst  Value read.
+ * @param[out] eof  Whether file ended before the first byte of the value.
+ * @param[in]  file File to read from.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred or file ended before value.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if file ended within value.\n
+ *         {@link ERR_INVALID_DATA} if value does not fit in 64 bits.\n
+ *         {@link ERR_IO} if read failed.
+ */
+static HuffmanError file_read_varint(uint64_t* dst,
+									 bool* eof,
+									 FILE* file) {
+	uint8_t shift = 0;
+	int c;
+
+	*dst = 0;
+	*eof = false;
+	do {
+		c = fgetc(file);
+		if (c == EOF) {
+			if (ferror(file)) {
+				return ERR_IO;
 			}
-			lIdx++;
-		} else if (lVal > 0) { // only left remains
-			// no action, already in correct place
-			lIdx++;
-		} else if (rVal > 0) { // only right remains
-			// move right to left
-			*get_table_id(left, lIdx) = *get_table_id(right, rIdx);
-			*get_table_value(left, lIdx) = rVal;
-			// mark right as empty
-			*get_table_value(right, rIdx) = 0;
-			rIdx++;
-		} else {
-			// both lVal & rVal 0, done with merge
-			break;
+			*eof = (shift == 0);
+			return *eof ? ERR_NO_ERR : ERR_INSUFFICIENT_SPACE;
 		}
-		// ensure not looking at same item
-		if (lIdx >= sizeLeft + rIdx) {
-			rIdx = lIdx - sizeLeft + 1;
+		if (shift > 63 || (shift == 63 && (c & 0x7E) != 0)) {
+			return ERR_INVALID_DATA;
+		}
+		*dst |= ((uint64_t) (c & 0x7F)) << shift;
+		shift += 7;
+	} while (c & 0x80);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Reads the next block of a pipeline into a slot: blockSize bytes when
+ * compressing, a frame preceded by its size when decompressing. A checksummed
+ * file ends with a frame size of 0 followed by the checksum of the file, read
+ * into the pipeline.
+ *
+ * @param[in,out] slot Slot to be filled.
+ * @param[out]    eof  Whether src ended before the block.
+ * @param[in,out] pipe Pipeline state.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if a frame or checksum is truncated.\n
+ *         {@link ERR_INVALID_DATA} if a frame is larger than any block.\n
+ *         {@link ERR_IO} if read failed.
+ */
+static HuffmanError pipeline_read(HuffmanPipelineSlot* slot,
+								  bool* eof,
+								  HuffmanPipeline* pipe) {
+	HuffmanError err;
+	uint64_t size = pipe->blockSize;
+	uint8_t buf[HUFFMAN_CHECKSUM_BYTES];
+
+	if (pipe->decompress) {
+		THROW_ERR(file_read_varint(&size, eof, pipe->src))
+		if (*eof) {
+			return ERR_NO_ERR;
+		}
+		if (size == 0 && pipe->checksum) {
+			if (fread(buf, 1, sizeof(buf), pipe->src) != sizeof(buf)) {
+				return ferror(pipe->src) ? ERR_IO : ERR_INSUFFICIENT_SPACE;
+			}
+			pipe->expected = get_checksum(buf);
+			pipe->trailer = true;
+			*eof = true;
+			return ERR_NO_ERR;
+		}
+		if (size == 0 || size > pipe->slotSize) {
+			return ERR_INVALID_DATA;
+		}
+	}
+	slot->inSize = fread(slot->in, 1, (size_t) size, pipe->src);
+	if (ferror(pipe->src)) {
+		return ERR_IO;
+	}
+	if (pipe->decompress) {
+		return (slot->inSize == size) ? ERR_NO_ERR : ERR_INSUFFICIENT_SPACE;
+	}
+	*eof = (slot->inSize == 0);
+	return ERR_NO_ERR;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Compresses or decompresses the block in a slot. Blocks that do not
+ * compress into a stored frame's size are stored. In a checksummed file,
+ * every frame carries the checksum of its block, which is kept in the slot
+ * once the frame is written or verified.
+ *
+ * @param[in,out] slot Slot holding block.
+ * @param[in]     pipe Pipeline state.
+ * @param[in,out] ctx  Context of the calling stage.
+ *
+ * @return {@link ERR_INVALID_DATA} if a frame of a checksummed file has no
+ *              checksum.\n
+ *         Other errors as raised by {@link huffman_compress_ctx} and
+ *         {@link huffman_decompress_ctx}.
+ */
+static HuffmanError pipeline_process(HuffmanPipelineSlot* slot,
+									 HuffmanPipeline* pipe,
+									 HuffmanContext* ctx) {
+	HuffmanError err;
+	HuffmanHeader hdr;
+
+	slot->outSize = pipe->slotSize;
+	if (pipe->decompress) {
+		if (pipe->checksum && !(slot->in[0] & HUFFMAN_FRAME_CHECKSUM)) {
+			return ERR_INVALID_DATA;
+		}
+		THROW_ERR(huffman_decompress_ctx(slot->out, &slot->outSize, slot->in, slot->inSize, ctx))
+		slot->crc = pipe->checksum ?
+				get_checksum(slot->in + slot->inSize - HUFFMAN_CHECKSUM_BYTES) : 0;
+		return ERR_NO_ERR;
+	}
+	err = compress_frame(slot->out, &slot->outSize, &hdr, slot->in, slot->inSize,
+			pipe->wordSize, NULL, 0, false, 1, pipe->checksum, ctx);
+	if (err == ERR_INSUFFICIENT_SPACE) {
+		slot->outSize = pipe->slotSize;
+		err = put_stored(slot->out, &slot->outSize, &hdr, slot->in, slot->inSize, pipe->wordSize,
+				pipe->checksum);
+	}
+	if (!err) {
+		slot->crc = pipe->checksum ?
+				get_checksum(slot->out + slot->outSize - HUFFMAN_CHECKSUM_BYTES) : 0;
+	}
+	return err;
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Writes the processed block in a slot: a frame preceded by its size when
+ * compressing, the data itself when decompressing. The checksum of the block
+ * is added to that of the file.
+ *
+ * @param[in]     slot Slot holding processed block.
+ * @param[in,out] pipe Pipeline state.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_IO} if write failed.
+ */
+static HuffmanError pipeline_write(const HuffmanPipelineSlot* slot,
+								   HuffmanPipeline* pipe) {
+	HuffmanError err;
+	if (!pipe->decompress) {
+		THROW_ERR(file_put_varint(pipe->dst, slot->outSize))
+	}
+	if (pipe->checksum) {
+		pipe->crc = crc32c_combine(pipe->crc, slot->crc,
+				pipe->decompress ? slot->outSize : slot->inSize);
+	}
+	if (fwrite(slot->out, 1, (size_t) slot->outSize, pipe->dst) != slot->outSize) {
+		return ERR_IO;
+	}
+	return ERR_NO_ERR;
+}
+
+#ifdef HUFFMAN_THREADS
+/**
+ * @ingroup HuffmanHelpers
+ * Records the first error of any stage and wakes every stage so that it
+ * stops. Must be called with the pipeline locked.
+ *
+ * @param[in,out] pipe Pipeline state.
+ * @param[in]     err  Error raised by a stage.
+ */
+static void pipeline_fail(HuffmanPipeline* pipe,
+						  HuffmanError err) {
+	if (!pipe->err) {
+		pipe->err = err;
+	}
+	pthread_cond_broadcast(&pipe->changed);
+}
+
+/**
+ * @ingroup HuffmanHelpers
+ * Reader stage. Fills slots in order, waiting while every slot is in flight.
+ *
+ * @param[in,out] arg Pipeline state.
+ *
+ * @return Null.
+ */
+static void* pipeline_reader(void* arg) {
+	HuffmanPipeline* pipe = (HuffmanPipeline*) arg;
+	HuffmanPipelineSlot* slot;
+	HuffmanError err;
+	bool eof;
+
+	pthread_mutex_lock(&pipe->lock);
+	while (!pipe->err) {
+		slot = &pipe->slots[pipe->numRead % pipe->numSlots];
+		if (slot->state != HUFFMAN_SLOT_FREE) {
+			pthread_cond_wait(&pipe->changed, &pipe->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&pipe->lock);
+		err = pipeline_read(slot, &eof, pipe);
+		pthread_mutex_lock(&pipe->lock);
+		if (err) {
+			pipeline_fail(pipe, err);
+		} else if (eof) {
+			pipe->eof = true;
+			pthread_cond_broadcast(&pipe->changed);
+			break;
+		} else {
+			slot->state = HUFFMAN_SLOT_READ;
+			pipe->numRead++;
+			pthread_cond_broadcast(&pipe->changed);
 		}
 	}
-	return lIdx;
+	pthread_mutex_unlock(&pipe->lock);
+	return NULL;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Merges two sub-arrays using {@link merge_table}.
+ * Worker stage. Takes read blocks in order and processes them with a context
+ * of its own, until every block has been taken.
  *
- * @param[in,out] left      Left sub-array, also beginning of output array.
- * @param[in,out] right     Right sub-array. State after merge is not guaranteed.
- * 							Partially overwritten if number of non-zero elements
- * 							in left and right arrays combined > sizeLeft.
- * @param[in]     sizeLeft  Capacity of left sub-array.
- * @param[in]     sizeRight Capacity of right sub-array.
+ * @param[in,out] arg Pipeline state.
  *
- * @return Total number of non-empty elements in merged array.
+ * @return Null.
  */
-static uint64_t merge_sort(uint64_t* left,
-						   uint64_t* right,
-						   uint64_t sizeLeft,
-						   uint64_t sizeRight) {
-	uint64_t mid, ret, retRight = sizeRight;
-	if (sizeLeft > 1) {
-		mid = (sizeLeft + 1) / 2;
-		merge_sort(left, get_table_value(left, mid), mid, sizeLeft - mid);
-	}
-	if (sizeRight > 1) {
-		mid = (sizeRight + 1) / 2;
-		retRight = merge_sort(right, get_table_value(right, mid), mid, sizeRight - mid);
+static void* pipeline_worker(void* arg) {
+	HuffmanPipeline* pipe = (HuffmanPipeline*) arg;
+	HuffmanPipelineSlot* slot;
+	HuffmanContext ctx;
+	HuffmanError err;
+
+	huffman_context_init(&ctx);
+	pthread_mutex_lock(&pipe->lock);
+	while (!pipe->err && !(pipe->eof && pipe->numTaken == pipe->numRead)) {
+		slot = &pipe->slots[pipe->numTaken % pipe->numSlots];
+		if (pipe->numTaken == pipe->numRead || slot->state != HUFFMAN_SLOT_READ) {
+			pthread_cond_wait(&pipe->changed, &pipe->lock);
+			continue;
+		}
+		slot->state = HUFFMAN_SLOT_BUSY;
+		pipe->numTaken++;
+		pthread_mutex_unlock(&pipe->lock);
+		err = pipeline_process(slot, pipe, &ctx);
+		pthread_mutex_lock(&pipe->lock);
+		if (err) {
+			pipeline_fail(pipe, err);
+		} else {
+			slot->state = HUFFMAN_SLOT_DONE;
+			pthread_cond_broadcast(&pipe->changed);
+		}
 	}
-	// use retRight for early exit condition
-	ret = merge_table(left, right, sizeLeft, retRight);
-	return ret;
+	pthread_mutex_unlock(&pipe->lock);
+	huffman_context_free(&ctx);
+	return NULL;
 }
 
 /**
  * @ingroup HuffmanHelpers
- * Sorts a hash table generated by {@link generate_table} by decreasing frequency.
- * Sorting is implemented via modified merge sort.
+ * Runs a pipeline with a reader thread and numThreads worker threads, the
+ * calling thread writing processed blocks in order and freeing their slots.
  *
- * @param[in]     hdr Header containing metadata for table.
- * @param[in,out] dst Pointer to table to be updated.
+ * @param[in,out] pipe       Pipeline state.
+ * @param[in]     numThreads Number of worker threads.
  *
- * @return {@link ERR_NO_ERR} if no error occurred.\n
- *		   {@link ERR_NULL_PTR} if a parameter is null.\n
- *		   {@link ERR_INVALID_VALUE} if header contains invalid values.
+ * @return First error raised by any stage.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if a thread could not be started.
  */
-static HuffmanError sort_table(HuffmanHeader *hdr,
-							   HuffmanHashTable *dst) {
-	uint64_t mid = dst->size / 2;
-	uint64_t* left = dst->table;
-	uint64_t* right = get_table_value(dst->table, mid);
-	uint64_t size = merge_sort(left, right, mid, dst->size - mid);
-	if (size != hdr->uniqueWords) {
-		return ERR_INVALID_VALUE;
+static HuffmanError pipeline_run_threads(HuffmanPipeline* pipe,
+										 uint8_t numThreads) {
+	pthread_t threads[HUFFMAN_MAX_THREADS + 1];
+	HuffmanPipelineSlot* slot;
+	HuffmanError err;
+	uint64_t started, i;
+
+	pthread_mutex_init(&pipe->lock, NULL);
+	pthread_cond_init(&pipe->changed, NULL);
+	started = 0;
+	if (pthread_create(&threads[started], NULL, pipeline_reader, pipe) == 0) {
+		started++;
 	}
-	return ERR_NO_ERR;
+	for (i = 0; started == i + 1 && i < numThreads; i++) {
+		if (pthread_create(&threads[started], NULL, pipeline_worker, pipe) == 0) {
+			started++;
+		}
+	}
+
+	pthread_mutex_lock(&pipe->lock);
+	if (started < (uint64_t) numThreads + 1) {
+		pipeline_fail(pipe, ERR_INSUFFICIENT_SPACE);
+	}
+	while (!pipe->err && !(pipe->eof && pipe->numWritten == pipe->numRead)) {
+		slot = &pipe->slots[pipe->numWritten % pipe->numSlots];
+		if (pipe->numWritten == pipe->numRead || slot->state != HUFFMAN_SLOT_DONE) {
+			pthread_cond_wait(&pipe->changed, &pipe->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&pipe->lock);
+		err = pipeline_write(slot, pipe);
+		pthread_mutex_lock(&pipe->lock);
+		if (err) {
+			pipeline_fail(pipe, err);
+		} else {
+			slot->state = HUFFMAN_SLOT_FREE;
+			pipe->numWritten++;
+			pthread_cond_broadcast(&pipe->changed);
+		}
+	}
+	pthread_mutex_unlock(&pipe->lock);
+
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_cond_destroy(&pipe->changed);
+	pthread_mutex_destroy(&pipe->lock);
+	return pipe->err;
 }
+#endif
 
 /**
  * @ingroup HuffmanHelpers
- * Calculates compressed size in bytes
+ * Compresses or decompresses a file in blocks, overlapping reads, processing
+ * and writes when threads are available. Slots are allocated from the heap
+ * since they are shared between threads.
  *
- * @warning This allocates a table that must be freed later.
+ * @param[in,out] pipe       Pipeline state, with files, direction, word size
+ *                           and block size set.
+ * @param[in]     numThreads Number of worker threads, or 0 to run every stage
+ *                           in the calling thread.
+ * @param[in]     queueDepth Number of blocks in flight.
  *
- * @param[out]	  dst		  Destination for calculation results.
- * @param[in,out] hdr		  Header populated with metadata.
- * @param[in,out] table		  Pointer to table. Table data must be freed by calling function.
- * @param[in]	  src		  Data to be converted.
- * @param[in]	  srcSize	  Size of data in bytes.
- * @param[in]	  wordSize	  Word size used for compression.
- * @param[in]	  compSizeFcn Function that calculates compressed size of a word.
- * @param[in]	  depthParam  Depth parameter passed into compressed size function.
+ * @return Errors as raised by the stages.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if slots could not be allocated.
  */
-static HuffmanError calculate_compressed_size(HuffmanStats* dst,
-											  HuffmanHeader* hdr,
-											  HuffmanHashTable* table,
-											  uint8_t* src,
-											  uint64_t srcSize,
-											  uint8_t wordSize,
-											  get_compressed_size_fcn compressedSize,
-											  uint8_t depthParam) {
-	if (hdr == NULL || src == NULL || table == NULL) {
-		return ERR_NULL_PTR;
+static HuffmanError run_pipeline(HuffmanPipeline* pipe,
+								 uint8_t numThreads,
+								 uint64_t queueDepth) {
+	HuffmanContext ctx;
+	HuffmanPipelineSlot* slot;
+	uint64_t i;
+	bool eof = false;
+
+	pipe->slotSize = get_stored_size(pipe->blockSize, pipe->checksum);
+	pipe->numSlots = queueDepth;
+	pipe->numRead = pipe->numTaken = pipe->numWritten = 0;
+	pipe->crc = pipe->expected = 0;
+	pipe->trailer = false;
+	pipe->eof = false;
+	pipe->err = ERR_NO_ERR;
+	if (pipe->slotSize < pipe->blockSize ||
+			queueDepth > HUFFMAN_MAX_UINT64 / sizeof(HuffmanPipelineSlot)) {
+		return ERR_INSUFFICIENT_SPACE;
 	}
-	if (srcSize == 0 ||
-			wordSize < HUFFMAN_MIN_WORD_SIZE ||
-			wordSize > HUFFMAN_MAX_WORD_SIZE) {
-		return ERR_INVALID_VALUE;
+	pipe->slots = (HuffmanPipelineSlot*) context_alloc(NULL, queueDepth * sizeof(HuffmanPipelineSlot));
+	if (!pipe->slots) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	memset(pipe->slots, 0x00, queueDepth * sizeof(HuffmanPipelineSlot));
+	for (i = 0; !pipe->err && i < queueDepth; i++) {
+		pipe->slots[i].in = (uint8_t*) context_alloc(NULL, pipe->slotSize);
+		pipe->slots[i].out = (uint8_t*) context_alloc(NULL, pipe->slotSize);
+		if (!pipe->slots[i].in || !pipe->slots[i].out) {
+			pipe->err = ERR_INSUFFICIENT_SPACE;
+		}
 	}
 
-	table->size = 0;
-	table->table = NULL;
-
-	HuffmanError err;
-	uint64_t sizeBits, sizeBytes, idx, uniqueWords;
-	uint64_t* tablePtr;
-
-	// todo add step 1
-
-	// Step 2: Build hash map
-	THROW_ERR(generate_table(hdr, table, src, srcSize, wordSize))
+#ifdef HUFFMAN_THREADS
+	if (!pipe->err && numThreads > 0) {
+		pipe->err = pipeline_run_threads(pipe, numThreads);
+	}
+#else
+	numThreads = 0;
+#endif
+	if (!pipe->err && numThreads == 0) {
+		// Every stage in turn, through the first slot
+		slot = &pipe->slots[0];
+		huffman_context_init(&ctx);
+		while (!pipe->err && !eof) {
+			pipe->err = pipeline_read(slot, &eof, pipe);
+			if (!pipe->err && !eof) {
+				pipe->err = pipeline_process(slot, pipe, &ctx);
+			}
+			if (!pipe->err && !eof) {
+				pipe->err = pipeline_write(slot, pipe);
+			}
+		}
+		huffman_context_free(&ctx);
+	}
 
-	// Step 3: Convert hash map to sorted array
-	THROW_ERR(sort_table(hdr, table))
+	for (i = 0; i < queueDepth; i++) {
+		if (pipe->slots[i].in) {
+			context_free(NULL, pipe->slots[i].in, pipe->slotSize);
+		}
+		if (pipe->slots[i].out) {
+			context_free(NULL, pipe->slots[i].out, pipe->slotSize);
+		}
+	}
+	context_free(NULL, pipe->slots, queueDepth * sizeof(HuffmanPipelineSlot));
+	return pipe->err;
+}
 
-	// Step 4: Calculate size
-	uniqueWords = hdr->uniqueWords;
-	tablePtr = table->table;
-	sizeBits = sizeBytes = 0;
-	for (idx = 0; idx < uniqueWords; idx++) {
-		sizeBits += (*get_table_value(tablePtr, idx)) * compressedSize(idx, uniqueWords, depthParam);
-		sizeBytes += sizeBits / 8;
-		sizeBits = sizeBits % 8;
+/**
+ * Compresses a file in independent blocks, overlapping disk reads,
+ * compression and writes. A reader thread reads blocks of blockSize bytes,
+ * worker threads compress them with {@link huffman_compress_ctx} and the
+ * calling thread writes the frames in order. At most queueDepth blocks are in
+ * flight, so the reader waits when workers or the writer fall behind and
+ * memory stays bounded at about 2 * queueDepth * blockSize bytes. The output
+ * consists of:
+ *	- Block size in bytes (7 bits per byte, as many bytes as needed)
+ *	- Flags (8 bits), {@link HUFFMAN_FRAME_CHECKSUM} if checksummed
+ *	- For each block, the size of its frame in bytes (7 bits per byte, as
+ *	  many bytes as needed) followed by the frame
+ *	- If checksummed, a frame size of 0 followed by the CRC32C of the whole
+ *	  file, 4 bytes little-endian
+ *
+ * Blocks that do not compress are stored. Every block except the last holds
+ * blockSize bytes. When checksummed, every frame carries the checksum of its
+ * block, gathered while it is coded, and the writer combines them into the
+ * checksum of the file without reading the data again.
+ *
+ * @param[in,out] dst        File to write compressed data to.
+ * @param[in,out] src        File to read from, up to its end.
+ * @param[in]     wordSize   Word size used for compression.
+ * @param[in]     blockSize  Size of uncompressed blocks in bytes.
+ * @param[in]     checksum   Whether to write checksums.
+ * @param[in]     numThreads Number of worker threads. Range 0 -
+ *                           {@link HUFFMAN_MAX_THREADS}. 0 runs every stage in
+ *                           turn in the calling thread, as do platforms
+ *                           without threads.
+ * @param[in]     queueDepth Number of blocks in flight. At least 1.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if a parameter is out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if buffers or threads could not be
+ *              allocated.\n
+ *         {@link ERR_IO} if a read or write failed.\n
+ *         Other errors as raised by {@link huffman_compress_ctx}.
+ */
+HuffmanError huffman_compress_file(FILE* dst,
+								   FILE* src,
+								   uint8_t wordSize,
+								   uint64_t blockSize,
+								   uint8_t checksum,
+								   uint8_t numThreads,
+								   uint64_t queueDepth) {
+	HuffmanError err;
+	HuffmanPipeline pipe;
+	uint8_t buf[HUFFMAN_CHECKSUM_BYTES];
+	if (dst == NULL || src == NULL) {
+		return ERR_NULL_PTR;
 	}
-	if (sizeBits) {
-		sizeBytes++;
+	if (wordSize < HUFFMAN_MIN_WORD_SIZE ||
+			wordSize > HUFFMAN_MAX_WORD_SIZE ||
+			blockSize == 0 ||
+			numThreads > HUFFMAN_MAX_THREADS ||
+			queueDepth == 0) {
+		return ERR_INVALID_VALUE;
+	}
+	THROW_ERR(file_put_varint(dst, blockSize))
+	if (fputc(checksum ? HUFFMAN_FRAME_CHECKSUM : 0, dst) == EOF) {
+		return ERR_IO;
 	}
-	dst->dataSizeBytes = sizeBytes;
-	dst->dataBitsInLastByte = sizeBits;
 
+	pipe.src = src;
+	pipe.dst = dst;
+	pipe.decompress = false;
+	pipe.wordSize = wordSize;
+	pipe.checksum = checksum;
+	pipe.blockSize = blockSize;
+	THROW_ERR(run_pipeline(&pipe, numThreads, queueDepth))
+	if (checksum) {
+		THROW_ERR(file_put_varint(dst, 0))
+		for (uint8_t i = 0; i < HUFFMAN_CHECKSUM_BYTES; i++) {
+			buf[i] = (uint8_t) (pipe.crc >> (8 * i));
+		}
+		if (fwrite(buf, 1, sizeof(buf), dst) != sizeof(buf)) {
+			return ERR_IO;
+		}
+	}
 	return ERR_NO_ERR;
 }
 
 /**
- * @todo document this
+ * Decompresses a file written by {@link huffman_compress_file}, overlapping
+ * disk reads, decompression and writes as it does. If the file is
+ * checksummed, every frame and the whole file are verified.
  *
- * @param[out]	  dst		  Destination for calculation results.
- * @param[in,out] hdr		  Header populated with metadata.
- * @param[in]	  src		  Data to be converted.
- * @param[in]	  srcSize	  Size of data in bytes.
- * @param[in]	  wordSize	  Word size used for compression.
- * @param[in]	  compSizeFcn Function that calculates compressed size of a word.
- * @param[in]	  depthParam  Depth parameter passed into compressed size function.
+ * @param[in,out] dst        File to write decompressed data to.
+ * @param[in,out] src        File to read compressed data from, up to its end.
+ * @param[in]     numThreads Number of worker threads. Range 0 -
+ *                           {@link HUFFMAN_MAX_THREADS}.
+ * @param[in]     queueDepth Number of blocks in flight. At least 1.
  *
  * @return {@link ERR_NO_ERR} if no error occurred.\n
  *         {@link ERR_NULL_PTR} if a parameter is null.\n
- *         {@link ERR_INVALID_VALUE} if srcSize or wordSize are out of accepted range.\n
- *         Other errors as raised by {@link calculate_compressed_size}.
+ *         {@link ERR_INVALID_VALUE} if a parameter is out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if src is truncated or buffers or
+ *              threads could not be allocated.\n
+ *         {@link ERR_INVALID_DATA} if src was not written by
+ *              {@link huffman_compress_file} or a checksum does not match.\n
+ *         {@link ERR_IO} if a read or write failed.\n
+ *         Other errors as raised by {@link huffman_decompress_ctx}.
  */
-HuffmanError huffman_calculate_compressed_size(HuffmanStats* dst,
-											   HuffmanHeader* hdr,
-											   uint8_t* src,
-											   uint64_t srcSize,
-											   uint8_t wordSize,
-											   get_compressed_size_fcn fcn,
-											   uint8_t depthParam) {
+HuffmanError huffman_decompress_file(FILE* dst,
+									 FILE* src,
+									 uint8_t numThreads,
+									 uint64_t queueDepth) {
 	HuffmanError err;
-	if (hdr == NULL || src == NULL) {
+	HuffmanPipeline pipe;
+	bool eof;
+	int flags;
+	if (dst == NULL || src == NULL) {
 		return ERR_NULL_PTR;
 	}
-	if (srcSize == 0 ||
-			wordSize < HUFFMAN_MIN_WORD_SIZE ||
-			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+	if (numThreads > HUFFMAN_MAX_THREADS || queueDepth == 0) {
 		return ERR_INVALID_VALUE;
 	}
+	THROW_ERR(file_read_varint(&pipe.blockSize, &eof, src))
+	if (eof) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	if (pipe.blockSize == 0) {
+		return ERR_INVALID_DATA;
+	}
+	flags = fgetc(src);
+	if (flags == EOF) {
+		return ferror(src) ? ERR_IO : ERR_INSUFFICIENT_SPACE;
+	}
+	if (flags & ~HUFFMAN_FRAME_CHECKSUM) {
+		return ERR_INVALID_DATA;
+	}
 
-	HuffmanHashTable table;
+	pipe.src = src;
+	pipe.dst = dst;
+	pipe.decompress = true;
+	pipe.wordSize = 0;
+	pipe.checksum = (flags != 0);
+	THROW_ERR(run_pipeline(&pipe, numThreads, queueDepth))
+	if (pipe.checksum && !pipe.trailer) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	return (pipe.crc == pipe.expected) ? ERR_NO_ERR : ERR_INVALID_DATA;
+}
 
-	THROW_ERR(calculate_compressed_size(dst, hdr, &table, src, srcSize, wordSize, fcn, depthParam));
+/**
+ * @ingroup HuffmanHelpers
+ * Stages of a {@link HuffmanJob}. Zeroed jobs are idle.
+ */
+typedef enum HuffmanJobState_enum {
+	/**Job has not been submitted.*/
+	HUFFMAN_JOB_IDLE,
+	/**Job waits in a pool's queue.*/
+	HUFFMAN_JOB_QUEUED,
+	/**Job is being run by a worker.*/
+	HUFFMAN_JOB_RUNNING,
+	/**Job's results are set.*/
+	HUFFMAN_JOB_FINISHED
+} HuffmanJobState;
 
-	// Step 5: Cleanup
-	free(table.table);
+struct HuffmanJobPool_struct {
+	/**
+	 * Number of worker threads.
+	 */
+	uint8_t numThreads;
+#ifdef HUFFMAN_THREADS
+	/**
+	 * Worker threads.
+	 */
+	pthread_t threads[HUFFMAN_MAX_THREADS];
+	/**
+	 * First waiting job of each priority, taken first.
+	 */
+	HuffmanJob* head[HUFFMAN_NUM_PRIORITIES];
+	/**
+	 * Last waiting job of each priority.
+	 */
+	HuffmanJob* tail[HUFFMAN_NUM_PRIORITIES];
+	/**
+	 * Set once the pool is being destroyed. Workers exit when no job is left.
+	 */
+	bool stopping;
+	/**
+	 * Guards queues, stopping and job states.
+	 */
+	pthread_mutex_t lock;
+	/**
+	 * Signalled when a job is queued or the pool is stopping.
+	 */
+	pthread_cond_t queued;
+	/**
+	 * Signalled when a job finishes.
+	 */
+	pthread_cond_t finished;
+#endif
+};
 
-	return ERR_NO_ERR;
+/**
+ * @ingroup HuffmanHelpers
+ * Runs a job, setting its results. The caller reports it finished and then
+ * calls its completion callback.
+ *
+ * @param[in,out] job Job to be run.
+ * @param[in,out] ctx Context of the calling worker.
+ */
+static void run_job(HuffmanJob* job,
+					HuffmanContext* ctx) {
+	if (job->type == HUFFMAN_JOB_COMPRESS) {
+		job->err = huffman_compress_ctx(job->dst, &job->dstSize, &job->hdr, job->src, job->srcSize,
+				job->wordSize, ctx);
+	} else {
+		job->err = huffman_calculate_compressed_size_ctx(&job->stats, &job->hdr, job->src,
+				job->srcSize, job->wordSize, job->compressor, job->depthParam, ctx);
+	}
 }
 
+#ifdef HUFFMAN_THREADS
 /**
- * @todo document this
+ * @ingroup HuffmanHelpers
+ * Worker thread of a pool. Runs waiting jobs, latency-sensitive ones first
+ * and each priority in submission order, until the pool stops with no job
+ * left.
+ *
+ * @param[in,out] arg Pool.
+ *
+ * @return Null.
  */
-HuffmanError huffman_compress(HuffmanHeader* hdr,
-							  uint8_t* src,
-							  uint64_t srcSize,
-							  uint8_t wordSize) {
-	HuffmanError err;
-	if (hdr == NULL || src == NULL) {
+static void* pool_worker(void* arg) {
+	HuffmanJobPool* pool = (HuffmanJobPool*) arg;
+	HuffmanContext ctx;
+	HuffmanJob* job;
+	job_done_fcn done;
+	int p;
+
+	huffman_context_init(&ctx);
+	pthread_mutex_lock(&pool->lock);
+	while (true) {
+		job = NULL;
+		for (p = HUFFMAN_NUM_PRIORITIES - 1; p >= 0 && !job; p--) {
+			job = pool->head[p];
+			if (job) {
+				pool->head[p] = job->next;
+				if (!pool->head[p]) {
+					pool->tail[p] = NULL;
+				}
+			}
+		}
+		if (!job) {
+			if (pool->stopping) {
+				break;
+			}
+			pthread_cond_wait(&pool->queued, &pool->lock);
+			continue;
+		}
+		job->state = HUFFMAN_JOB_RUNNING;
+		pthread_mutex_unlock(&pool->lock);
+		run_job(job, &ctx);
+		// job may be reused or freed as soon as it is reported finished
+		done = job->done;
+		pthread_mutex_lock(&pool->lock);
+		job->state = HUFFMAN_JOB_FINISHED;
+		pthread_cond_broadcast(&pool->finished);
+		if (done) {
+			pthread_mutex_unlock(&pool->lock);
+			done(job);
+			pthread_mutex_lock(&pool->lock);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	huffman_context_free(&ctx);
+	return NULL;
+}
+#endif
+
+/**
+ * Starts a pool of worker threads to run jobs submitted with
+ * {@link huffman_pool_submit}. Each worker allocates from a context of its
+ * own, so tables are reused from one job to the next. On platforms without
+ * threads, jobs are run as they are submitted.
+ *
+ * @param[out] pool       Pool created. Must be released with
+ *                        {@link huffman_pool_destroy}.
+ * @param[in]  numThreads Number of worker threads. Range 1 -
+ *                        {@link HUFFMAN_MAX_THREADS}.
+ *
+ * @return {@link ERR_NO_ERR} if no error occurred.\n
+ *         {@link ERR_NULL_PTR} if pool is null.\n
+ *         {@link ERR_INVALID_VALUE} if numThreads is out of accepted range.\n
+ *         {@link ERR_INSUFFICIENT_SPACE} if the pool or a thread could not be
+ *              allocated.
+ */
+HuffmanError huffman_pool_create(HuffmanJobPool** pool,
+								 uint8_t numThreads) {
+	if (pool == NULL) {
 		return ERR_NULL_PTR;
 	}
-	if (srcSize == 0 ||
-			wordSize < HUFFMAN_MIN_WORD_SIZE ||
-			wordSize > HUFFMAN_MAX_WORD_SIZE) {
+	if (numThreads == 0 || numThreads > HUFFMAN_MAX_THREADS) {
 		return ERR_INVALID_VALUE;
 	}
+	*pool = (HuffmanJobPool*) context_alloc(NULL, sizeof(HuffmanJobPool));
+	if (*pool == NULL) {
+		return ERR_INSUFFICIENT_SPACE;
+	}
+	memset(*pool, 0x00, sizeof(HuffmanJobPool));
 
-	HuffmanStats dst;
-	HuffmanHashTable table;
+#ifdef HUFFMAN_THREADS
+	pthread_mutex_init(&(*pool)->lock, NULL);
+	pthread_cond_init(&(*pool)->queued, NULL);
+	pthread_cond_init(&(*pool)->finished, NULL);
+	for (uint8_t i = 0; i < numThreads; i++) {
+		if (pthread_create(&(*pool)->threads[i], NULL, pool_worker, *pool) != 0) {
+			huffman_pool_destroy(*pool);
+			*pool = NULL;
+			return ERR_INSUFFICIENT_SPACE;
+		}
+		(*pool)->numThreads++;
+	}
+#else
+	(*pool)->numThreads = numThreads;
+#endif
+	return ERR_NO_ERR;
+}
 
-	table.size = 0;
-	table.table = NULL;
+/**
+ * Waits for every submitted job to finish, then stops the workers of a pool
+ * and releases it.
+ *
+ * @param[in,out] pool Pool to be released, or null.
+ */
+void huffman_pool_destroy(HuffmanJobPool* pool) {
+	if (pool == NULL) {
+		return;
+	}
+#ifdef HUFFMAN_THREADS
+	pthread_mutex_lock(&pool->lock);
+	pool->stopping = true;
+	pthread_cond_broadcast(&pool->queued);
+	pthread_mutex_unlock(&pool->lock);
+	for (uint8_t i = 0; i < pool->numThreads; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->finished);
+	pthread_cond_destroy(&pool->queued);
+	pthread_mutex_destroy(&pool->lock);
+#endif
+	context_free(NULL, pool, sizeof(HuffmanJobPool));
+}
 
-	uint64_t sizeBits, sizeBytes, idx, uniqueWords;
-	uint64_t* tablePtr;
+/**
+ * Queues a job to be run by the next free worker of a pool without waiting
+ * for it. Latency-sensitive jobs run ahead of every waiting bulk job; jobs of
+ * the same priority run in submission order. The job is its own handle for
+ * {@link huffman_job_poll} and {@link huffman_job_wait}, and may be submitted
+ * again once finished.
+ *
+ * Errors in the job's parameters are reported in its err once it finishes.
+ *
+ * @param[in,out] pool Pool to run job.
+ * @param[in,out] job  Job to be run.
+ *
+ * @return {@link ERR_NO_ERR} if job was queued.\n
+ *         {@link ERR_NULL_PTR} if a parameter is null.\n
+ *         {@link ERR_INVALID_VALUE} if the job's type or priority is out of
+ *              accepted range, the job is already queued or running, or the
+ *              pool is being destroyed.
+ */
+HuffmanError huffman_pool_submit(HuffmanJobPool* pool,
+								 HuffmanJob* job) {
+	if (pool == NULL || job == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if ((job->type != HUFFMAN_JOB_COMPRESS && job->type != HUFFMAN_JOB_SIZE) ||
+			job->priority >= HUFFMAN_NUM_PRIORITIES) {
+		return ERR_INVALID_VALUE;
+	}
 
-	// Step 2: Build hash map
-	THROW_ERR(generate_table(hdr, &table, src, srcSize, wordSize))
+#ifdef HUFFMAN_THREADS
+	pthread_mutex_lock(&pool->lock);
+	if (pool->stopping ||
+			(job->pool != NULL &&
+			(job->state == HUFFMAN_JOB_QUEUED || job->state == HUFFMAN_JOB_RUNNING))) {
+		pthread_mutex_unlock(&pool->lock);
+		return ERR_INVALID_VALUE;
+	}
+	job->pool = pool;
+	job->state = HUFFMAN_JOB_QUEUED;
+	job->next = NULL;
+	if (pool->tail[job->priority]) {
+		pool->tail[job->priority]->next = job;
+	} else {
+		pool->head[job->priority] = job;
+	}
+	pool->tail[job->priority] = job;
+	pthread_cond_signal(&pool->queued);
+	pthread_mutex_unlock(&pool->lock);
+#else
+	HuffmanContext ctx;
+	job_done_fcn done = job->done;
+	job->pool = pool;
+	job->state = HUFFMAN_JOB_RUNNING;
+	huffman_context_init(&ctx);
+	run_job(job, &ctx);
+	huffman_context_free(&ctx);
+	job->state = HUFFMAN_JOB_FINISHED;
+	if (done) {
+		done(job);
+	}
+#endif
+	return ERR_NO_ERR;
+}
 
-	// Step 3: Convert hash map to sorted array
-	THROW_ERR(sort_table(hdr, &table))
+/**
+ * Checks whether a submitted job has finished, without waiting.
+ *
+ * @param[in] job Job to be checked.
+ *
+ * @return 1 if job has finished or was never submitted, 0 if it is queued or
+ *         running.
+ */
+uint8_t huffman_job_poll(HuffmanJob* job) {
+	uint8_t state;
+	if (job == NULL || job->pool == NULL) {
+		return 1;
+	}
+#ifdef HUFFMAN_THREADS
+	pthread_mutex_lock(&job->pool->lock);
+	state = job->state;
+	pthread_mutex_unlock(&job->pool->lock);
+#else
+	state = job->state;
+#endif
+	return state != HUFFMAN_JOB_QUEUED && state != HUFFMAN_JOB_RUNNING;
+}
 
-	return ERR_NO_ERR;
+/**
+ * Waits for a submitted job to finish. Must not be called from the job's
+ * own completion callback.
+ *
+ * @param[in,out] job Job to be waited on.
+ *
+ * @return Result of job as set in its err.\n
+ *         {@link ERR_NULL_PTR} if job is null.\n
+ *         {@link ERR_INVALID_VALUE} if job was never submitted.
+ */
+HuffmanError huffman_job_wait(HuffmanJob* job) {
+	if (job == NULL) {
+		return ERR_NULL_PTR;
+	}
+	if (job->pool == NULL) {
+		return ERR_INVALID_VALUE;
+	}
+#ifdef HUFFMAN_THREADS
+	HuffmanJobPool* pool = job->pool;
+	pthread_mutex_lock(&pool->lock);
+	while (job->state == HUFFMAN_JOB_QUEUED || job->state == HUFFMAN_JOB_RUNNING) {
+		pthread_cond_wait(&pool->finished, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+#endif
+	return job->err;
 }
 
 #ifdef __cplusplus
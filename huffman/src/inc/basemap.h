@@ -18,20 +18,36 @@ extern "C" {
 
 #include <stdint.h>
 
+#include "huffman.h"
+
+// Built-in mappings
+extern HuffmanCompressor OneHot;
+extern HuffmanCompressor FixDepthTree;
+extern HuffmanCompressor LogDepthTree;
+
 // One-hot model
-uint64_t one_hot_get_compressed_size(uint64_t, uint64_t, uint8_t);
-uint64_t one_hot_get_compressed_val(uint64_t, uint64_t, uint8_t);
-HuffmanError one_hot_parse_compressed_idx(uint64_t*, uint8_t**, uint8_t*, uint8_t, uint64_t, uint8_t);
+uint64_t one_hot_get_compressed_size(uint64_t, const HuffmanMapContext*);
+HuffmanError one_hot_get_compressed_sizes(uint8_t*, uint64_t, uint64_t, const HuffmanMapContext*);
+uint64_t one_hot_get_compressed_val(uint64_t, const HuffmanMapContext*);
+HuffmanError one_hot_parse_compressed_idx(uint64_t*, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
+HuffmanError one_hot_parse_compressed_idx_bulk(uint64_t*, uint64_t, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
+HuffmanError one_hot_parse_compressed_idx_streams(uint64_t*, uint64_t, uint8_t, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
 
 // Fixed-depth tree model
-uint64_t fix_depth_tree_get_compressed_size(uint64_t, uint64_t, uint8_t);
-uint64_t fix_depth_tree_get_compressed_val(uint64_t, uint64_t, uint8_t);
-HuffmanError fix_depth_tree_parse_compressed_idx(uint64_t*, uint8_t**, uint8_t*, uint8_t, uint64_t, uint8_t);
+uint64_t fix_depth_tree_get_compressed_size(uint64_t, const HuffmanMapContext*);
+HuffmanError fix_depth_tree_get_compressed_sizes(uint8_t*, uint64_t, uint64_t, const HuffmanMapContext*);
+uint64_t fix_depth_tree_get_compressed_val(uint64_t, const HuffmanMapContext*);
+HuffmanError fix_depth_tree_parse_compressed_idx(uint64_t*, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
+HuffmanError fix_depth_tree_parse_compressed_idx_bulk(uint64_t*, uint64_t, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
+HuffmanError fix_depth_tree_parse_compressed_idx_streams(uint64_t*, uint64_t, uint8_t, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
 
 // Log-depth tree model
-uint64_t log_depth_tree_get_compressed_size(uint64_t, uint64_t, uint8_t);
-uint64_t log_depth_tree_get_compressed_val(uint64_t, uint64_t, uint8_t);
-HuffmanError log_depth_tree_parse_compressed_idx(uint64_t*, uint8_t**, uint8_t*, uint8_t, uint64_t, uint8_t);
+uint64_t log_depth_tree_get_compressed_size(uint64_t, const HuffmanMapContext*);
+HuffmanError log_depth_tree_get_compressed_sizes(uint8_t*, uint64_t, uint64_t, const HuffmanMapContext*);
+uint64_t log_depth_tree_get_compressed_val(uint64_t, const HuffmanMapContext*);
+HuffmanError log_depth_tree_parse_compressed_idx(uint64_t*, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
+HuffmanError log_depth_tree_parse_compressed_idx_bulk(uint64_t*, uint64_t, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
+HuffmanError log_depth_tree_parse_compressed_idx_streams(uint64_t*, uint64_t, uint8_t, uint8_t**, uint8_t*, uint64_t*, const HuffmanMapContext*);
 
 #endif // __BASEMAP_H_
 
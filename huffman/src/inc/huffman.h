@@ -17,6 +17,7 @@ extern "C" {
 
 // Includes
 #include <stdint.h>
+#include <stdio.h>
 
 ////////////////////////////////////////////////////////////////
 ///
@@ -49,6 +50,248 @@ extern "C" {
  */
 #define HUFFMAN_MAX_UINT64 ((uint64_t)0xFFFFFFFFFFFFFFFF)
 
+/**
+ * @ingroup HuffmanConstants
+ * Number of code lengths requested per call to a
+ * {@link get_compressed_sizes_fcn} during size calculation.
+ */
+#define HUFFMAN_CODE_LENGTH_BLOCK_SIZE 256
+
+/**
+ * @ingroup HuffmanConstants
+ * Tables of at least this many bytes are requested aligned to this many
+ * bytes, allowing transparent huge pages to back them.
+ */
+#define HUFFMAN_HUGE_PAGE_SIZE ((uint64_t)1 << 21)
+
+/**
+ * @ingroup HuffmanConstants
+ * Frame type of compressed data carrying its own value map.
+ *
+ * @see huffman_compress
+ */
+#define HUFFMAN_FRAME_TABLE 0
+
+/**
+ * @ingroup HuffmanConstants
+ * Frame type of compressed data referencing a {@link HuffmanDictionary}.
+ *
+ * @see huffman_dictionary_compress
+ */
+#define HUFFMAN_FRAME_DICTIONARY 1
+
+/**
+ * @ingroup HuffmanConstants
+ * Frame type of a block of a stream.
+ *
+ * @see huffman_stream_compress_block
+ */
+#define HUFFMAN_FRAME_BLOCK 2
+
+/**
+ * @ingroup HuffmanConstants
+ * Frame type of data stored uncompressed because it was found to be
+ * incompressible.
+ *
+ * @see huffman_compress
+ */
+#define HUFFMAN_FRAME_STORED 3
+
+/**
+ * @ingroup HuffmanConstants
+ * Frame type of compressed data whose value map holds only the most frequent
+ * words, all others being coded by an escape followed by the word itself.
+ *
+ * @see huffman_compress_budget
+ */
+#define HUFFMAN_FRAME_ESCAPED 4
+
+/**
+ * @ingroup HuffmanConstants
+ * Frame type of compressed data in which long runs of the same word are
+ * coded once, followed by a run escape and the number of repeats.
+ *
+ * @see huffman_compress_runs
+ */
+#define HUFFMAN_FRAME_RUNS 5
+
+/**
+ * @ingroup HuffmanConstants
+ * Frame type of compressed data whose codes are split into interleaved
+ * streams, word i being coded in stream i % numStreams, so that the streams
+ * can be decoded in parallel.
+ *
+ * @see huffman_compress_interleaved
+ */
+#define HUFFMAN_FRAME_INTERLEAVED 6
+
+/**
+ * @ingroup HuffmanConstants
+ * Flag set in the frame type of a frame that ends with a CRC32C of its
+ * uncompressed data, {@link HUFFMAN_CHECKSUM_BYTES} bytes least significant
+ * first from a byte boundary. Table, escaped, run, interleaved and stored
+ * frames may carry it. Blocks of a checksummed {@link HuffmanStream} carry it
+ * with a CRC32C of the stream so far.
+ *
+ * @see huffman_compress_checksum
+ * @see huffman_crc32c
+ */
+#define HUFFMAN_FRAME_CHECKSUM 0x80
+
+/**
+ * @ingroup HuffmanConstants
+ * Size in bytes of a frame checksum.
+ */
+#define HUFFMAN_CHECKSUM_BYTES 4
+
+/**
+ * @ingroup HuffmanConstants
+ * CRC32C (Castagnoli) polynomial in reflected bit order.
+ */
+#define HUFFMAN_CRC32C_POLY 0x82F63B78u
+
+/**
+ * @ingroup HuffmanConstants
+ * Largest number of interleaved streams in a
+ * {@link HUFFMAN_FRAME_INTERLEAVED} frame.
+ */
+#define HUFFMAN_MAX_STREAMS 8
+
+/**
+ * @ingroup HuffmanConstants
+ * Smallest number of repeats of a word coded by a run escape rather than
+ * word by word.
+ */
+#define HUFFMAN_MIN_RUN 8
+
+/**
+ * @ingroup HuffmanConstants
+ * Smallest memory budget in bytes accepted by {@link huffman_compress_budget}.
+ */
+#define HUFFMAN_MIN_BUDGET ((uint64_t)2048)
+
+/**
+ * @ingroup HuffmanConstants
+ * Largest number of worker threads accepted by
+ * {@link huffman_compress_file}, {@link huffman_decompress_file} and
+ * {@link huffman_pool_create}.
+ */
+#define HUFFMAN_MAX_THREADS 64
+
+/**
+ * @ingroup HuffmanConstants
+ * Job type compressing src into dst with {@link huffman_compress_ctx}.
+ */
+#define HUFFMAN_JOB_COMPRESS 0
+
+/**
+ * @ingroup HuffmanConstants
+ * Job type calculating the compressed size of src with
+ * {@link huffman_calculate_compressed_size_ctx}.
+ */
+#define HUFFMAN_JOB_SIZE 1
+
+/**
+ * @ingroup HuffmanConstants
+ * Priority of bulk jobs, run once no latency-sensitive job is waiting.
+ */
+#define HUFFMAN_PRIORITY_BULK 0
+
+/**
+ * @ingroup HuffmanConstants
+ * Priority of latency-sensitive jobs, run ahead of every waiting bulk job.
+ */
+#define HUFFMAN_PRIORITY_LATENCY 1
+
+/**
+ * @ingroup HuffmanConstants
+ * Number of job priorities.
+ */
+#define HUFFMAN_NUM_PRIORITIES 2
+
+/**
+ * @ingroup HuffmanConstants
+ * Number of rows of the count-min sketch used by
+ * {@link huffman_estimate_compressed_size}. Each count is within its error
+ * bound with probability 1 - e^-depth.
+ */
+#define HUFFMAN_SKETCH_DEPTH 4
+
+/**
+ * @ingroup HuffmanConstants
+ * Number of registers used to estimate the number of unique words in
+ * {@link huffman_estimate_compressed_size}. Must be a power of 2.
+ */
+#define HUFFMAN_SKETCH_REGISTERS 1024
+
+/**
+ * @ingroup HuffmanConstants
+ * Maximum number of partitions words are spilled to by
+ * {@link huffman_compress_spill}. Must be a power of 2.
+ */
+#define HUFFMAN_SPILL_PARTITIONS 256
+
+/**
+ * @ingroup HuffmanConstants
+ * Number of 64-bit values buffered per partition between reads or writes of
+ * its scratch file.
+ */
+#define HUFFMAN_SPILL_BUFFER_WORDS 512
+
+/**
+ * @ingroup HuffmanConstants
+ * Number of words sampled to estimate entropy of data before compressing.
+ * Data of fewer than twice as many words is not sampled.
+ */
+#define HUFFMAN_SAMPLE_WORDS 1024
+
+/**
+ * @ingroup HuffmanConstants
+ * Number of words counted before first checking whether data is too varied
+ * to compress.
+ */
+#define HUFFMAN_BAILOUT_WORDS 4096
+
+/**
+ * @ingroup HuffmanConstants
+ * CPU feature flag for SSE4.2 kernels.
+ *
+ * @see huffman_set_cpu_features
+ */
+#define HUFFMAN_CPU_SSE42 0x1
+
+/**
+ * @ingroup HuffmanConstants
+ * CPU feature flag for AVX2 kernels.
+ *
+ * @see huffman_set_cpu_features
+ */
+#define HUFFMAN_CPU_AVX2 0x2
+
+/**
+ * @ingroup HuffmanConstants
+ * CPU feature flag for AVX-512 kernels.
+ *
+ * @see huffman_set_cpu_features
+ */
+#define HUFFMAN_CPU_AVX512 0x4
+
+/**
+ * @ingroup HuffmanConstants
+ * CPU feature flag for BMI2 kernels.
+ *
+ * @see huffman_set_cpu_features
+ */
+#define HUFFMAN_CPU_BMI2 0x8
+
+/**
+ * @ingroup HuffmanConstants
+ * Environment variable read at startup to limit the CPU features used, for
+ * testing. Holds a comma-separated list of sse4.2, avx2, avx512 and bmi2, or
+ * portable to use none.
+ */
+#define HUFFMAN_CPU_ENV "HUFFMAN_CPU"
+
 /**
  * @ingroup HuffmanConstants
  * @enum HuffmanError
@@ -69,9 +312,49 @@ typedef enum HuffmanError_enum {
 	 * Counter overflowed.
 	 * This can occur if source contains too many copies of a given word.
 	 */
-	ERR_OVERFLOW
+	ERR_OVERFLOW,
+	/**Creating, reading or writing a scratch or user file failed.*/
+	ERR_IO
 } HuffmanError;
 
+/**
+ * @struct HuffmanMapContext
+ * Constants used by a mapping for a single compression. Built once per
+ * compression by {@link huffman_init_map_context} and passed read-only to
+ * every mapping function, so concurrent compressions with different
+ * parameters never share state.
+ */
+typedef struct HuffmanMapContext_struct {
+	/**
+	 * Total number of unique words in frequency table.
+	 */
+	uint64_t uniqueWords;
+	/**
+	 * Depth parameter of mapping. Range 0 - {@link HuffmanCompressor#maxDepth}.
+	 */
+	uint8_t depth;
+	/**
+	 * Precomputed 2^depth.
+	 */
+	uint64_t pow2;
+	/**
+	 * Precomputed 2^depth - 1.
+	 */
+	uint64_t mask;
+	/**
+	 * Mapping-specific data set by {@link HuffmanCompressor#initContext}.
+	 */
+	const void* user;
+} HuffmanMapContext;
+
+/**
+ * Standard interface to precompute mapping-specific constants. Called after
+ * the common members of the context are populated.
+ *
+ * @see huffman_init_map_context
+ */
+typedef HuffmanError (*init_map_context_fcn) (HuffmanMapContext* ctx);
+
 /**
  * Standard interface to get size of value in bits for index
  * using a given mapping.
@@ -79,8 +362,22 @@ typedef enum HuffmanError_enum {
  * @see basemap.c
  */
 typedef uint64_t (*get_compressed_size_fcn) (uint64_t idx,
-											 uint64_t maxIdx,
-											 uint8_t depth);
+											 const HuffmanMapContext* ctx);
+
+/**
+ * Standard interface to get sizes of values in bits for a contiguous range of
+ * indices using a given mapping. Optional; allows size calculations to run as
+ * a dot product of frequencies and code lengths instead of one call per index.
+ *
+ * Returns {@link ERR_INVALID_VALUE} if any size in the range does not fit in
+ * a uint8_t, in which case callers fall back to {@link get_compressed_size_fcn}.
+ *
+ * @see basemap.c
+ */
+typedef HuffmanError (*get_compressed_sizes_fcn) (uint8_t* dst,
+												  uint64_t startIdx,
+												  uint64_t count,
+												  const HuffmanMapContext* ctx);
 
 /**
  * Standard interface to get value for index using a given mapping.
@@ -88,21 +385,50 @@ typedef uint64_t (*get_compressed_size_fcn) (uint64_t idx,
  * @see basemap.c
  */
 typedef uint64_t (*get_compressed_val_fcn) (uint64_t idx,
-											uint64_t maxIdx,
-											uint8_t depth);
+											const HuffmanMapContext* ctx);
 
 /**
  * Standard interface to get index referenced by compressed value
- * using a given mapping. Also updates
+ * using a given mapping. Also updates src, start and srcSize to the
+ * following value.
  *
  * @see basemap.c
  */
 typedef HuffmanError (*parse_compressed_idx_fcn) (uint64_t* dst,
 												  uint8_t** src,
 												  uint8_t* start,
-												  uint8_t size,
-												  uint64_t maxIdx,
-												  uint8_t depth);
+												  uint64_t* srcSize,
+												  const HuffmanMapContext* ctx);
+
+/**
+ * Standard interface to get indices of a block of consecutive compressed
+ * values using a given mapping. Position is only updated if the whole block
+ * was parsed.
+ *
+ * @see basemap.c
+ */
+typedef HuffmanError (*parse_compressed_idx_bulk_fcn) (uint64_t* dst,
+													   uint64_t count,
+													   uint8_t** src,
+													   uint8_t* start,
+													   uint64_t* srcSize,
+													   const HuffmanMapContext* ctx);
+
+/**
+ * Standard interface to get indices of values coded in interleaved streams
+ * using a given mapping, index i coming from stream i % numStreams. src,
+ * start and srcSize hold the position of each stream, and are only updated
+ * if every index was parsed.
+ *
+ * @see basemap.c
+ */
+typedef HuffmanError (*parse_compressed_idx_streams_fcn) (uint64_t* dst,
+														  uint64_t count,
+														  uint8_t numStreams,
+														  uint8_t** src,
+														  uint8_t* start,
+														  uint64_t* srcSize,
+														  const HuffmanMapContext* ctx);
 
 /**
  * @struct HuffmanHeader
@@ -145,6 +471,45 @@ typedef struct HuffmanHashTable_struct {
 	uint64_t* table;
 } HuffmanHashTable;
 
+/**
+ * @struct HuffmanCompressor
+ * Function pointers for compression algorithms.
+ */
+typedef struct HuffmanCompressor_struct {
+	/**
+	 * Human-readable name of mapping, used when reporting results.
+	 */
+	const char*              name;
+	/**
+	 * Largest depth parameter accepted by mapping. Mappings which do not use
+	 * the depth parameter set this to 0.
+	 */
+	uint8_t                  maxDepth;
+	/**
+	 * Precomputes mapping-specific constants. May be null.
+	 */
+	init_map_context_fcn     initContext;
+	get_compressed_size_fcn  getSize;
+	/**
+	 * Bulk code length function. May be null.
+	 */
+	get_compressed_sizes_fcn getSizes;
+	get_compressed_val_fcn   getVal;
+	parse_compressed_idx_fcn parseIdx;
+	/**
+	 * Bulk parse function. May be null.
+	 */
+	parse_compressed_idx_bulk_fcn parseIdxBulk;
+	/**
+	 * Interleaved stream parse function. May be null.
+	 */
+	parse_compressed_idx_streams_fcn parseIdxStreams;
+} HuffmanCompressor;
+
+/**
+ * @struct HuffmanStats
+ * Results of compressed size calculation for a single mapping.
+ */
 typedef struct HuffmanStats_struct {
 	/**
 	 * Size of compressed data in bytes (ceiling).
@@ -154,19 +519,707 @@ typedef struct HuffmanStats_struct {
 	 * Number of bits in last byte of compressed data.
 	 */
 	uint8_t dataBitsInLastByte;
+	/**
+	 * Mapping used for calculation.
+	 */
+	const HuffmanCompressor* compressor;
+	/**
+	 * Depth parameter used for calculation.
+	 */
+	uint8_t depthParam;
+	/**
+	 * Shannon entropy of word frequencies in bits per word.
+	 */
+	double entropy;
+	/**
+	 * Theoretical minimum size of compressed data in bits (ceiling), i.e.
+	 * entropy times number of words. Excludes value map.
+	 */
+	uint64_t minSizeBits;
+	/**
+	 * Ratio of minSizeBits to size of compressed data using mapping, from 0
+	 * to 1. 1 if both are 0.
+	 */
+	double efficiency;
 } HuffmanStats;
 
 /**
- * @struct HuffmanCompressor
- * Function pointers for compression algorithms.
+ * @struct HuffmanEstimate
+ * Error bounds of a compressed size estimated from a sketch of word
+ * frequencies.
+ *
+ * @see huffman_estimate_compressed_size
  */
-typedef struct HuffmanCompressor_struct {
-	get_compressed_size_fcn  getSize;
-	get_compressed_val_fcn   getVal;
-	parse_compressed_idx_fcn parseIdx;
-} HuffmanCompressor;
+typedef struct HuffmanEstimate_struct {
+	/**
+	 * Number of words counted.
+	 */
+	uint64_t numWords;
+	/**
+	 * Number of most frequent words whose counts are estimated individually.
+	 * The remaining words are assumed equally frequent.
+	 */
+	uint64_t heavyWords;
+	/**
+	 * Sum of the counts of the most frequent words, as seen while they were
+	 * tracked individually.
+	 */
+	uint64_t heavyCount;
+	/**
+	 * Each count in the sketch exceeds the true count by at most this much,
+	 * with probability confidence.
+	 */
+	uint64_t countError;
+	/**
+	 * Probability that an estimated count is within countError.
+	 */
+	double confidence;
+	/**
+	 * Relative standard error of the number of unique words, 0 if exact.
+	 */
+	double uniqueError;
+} HuffmanEstimate;
+
+/**
+ * Standard interface to allocate memory for a {@link HuffmanContext}.
+ *
+ * @param[in] size  Number of bytes requested.
+ * @param[in] align Requested alignment in bytes, a power of two. May be
+ *                  treated as a hint, but memory must be at least 8-byte
+ *                  aligned.
+ * @param[in] user  {@link HuffmanAllocator#user} of allocator.
+ *
+ * @return Pointer to memory, or null if allocation failed.
+ */
+typedef void* (*alloc_fcn) (uint64_t size,
+							uint64_t align,
+							void* user);
+
+/**
+ * Standard interface to resize memory allocated by an {@link alloc_fcn}.
+ * Contents up to the smaller of the two sizes must be preserved.
+ *
+ * @param[in] ptr     Memory to be resized.
+ * @param[in] oldSize Size ptr was allocated with.
+ * @param[in] newSize Number of bytes requested.
+ * @param[in] align   Requested alignment in bytes.
+ * @param[in] user    {@link HuffmanAllocator#user} of allocator.
+ *
+ * @return Pointer to memory, or null if allocation failed. ptr remains valid
+ *         on failure.
+ */
+typedef void* (*realloc_fcn) (void* ptr,
+							  uint64_t oldSize,
+							  uint64_t newSize,
+							  uint64_t align,
+							  void* user);
+
+/**
+ * Standard interface to release memory allocated by an {@link alloc_fcn}.
+ *
+ * @param[in] ptr  Memory to be released.
+ * @param[in] size Size ptr was allocated with.
+ * @param[in] user {@link HuffmanAllocator#user} of allocator.
+ */
+typedef void (*free_fcn) (void* ptr,
+						  uint64_t size,
+						  void* user);
+
+/**
+ * @struct HuffmanAllocator
+ * Callbacks used by a {@link HuffmanContext} for all of its allocations.
+ *
+ * @see huffman_context_init_allocator
+ */
+typedef struct HuffmanAllocator_struct {
+	/**
+	 * Allocation function.
+	 */
+	alloc_fcn allocate;
+	/**
+	 * Resize function. Optional; if null, memory is resized by allocating,
+	 * copying and releasing.
+	 */
+	realloc_fcn reallocate;
+	/**
+	 * Release function.
+	 */
+	free_fcn release;
+	/**
+	 * User data passed to every callback.
+	 */
+	void* user;
+} HuffmanAllocator;
+
+/**
+ * @struct HuffmanInstrumentation
+ * Timings and counters accumulated by calls made with a
+ * {@link HuffmanContext} whose {@link HuffmanContext#instrumentation} points
+ * to this structure. Values are added to, so the structure must be zeroed
+ * before first use.
+ *
+ * Collection only takes place if {@link huffman.c} is built with
+ * HUFFMAN_INSTRUMENT defined. Otherwise it compiles out entirely and the
+ * structure is left untouched.
+ */
+typedef struct HuffmanInstrumentation_struct {
+	/**
+	 * Nanoseconds spent building frequency tables, including resizing.
+	 */
+	uint64_t histogramNs;
+	/**
+	 * Nanoseconds spent resizing frequency tables.
+	 */
+	uint64_t resizeNs;
+	/**
+	 * Nanoseconds spent sorting frequency tables.
+	 */
+	uint64_t sortNs;
+	/**
+	 * Nanoseconds spent calculating compressed sizes and encoding.
+	 */
+	uint64_t sizeNs;
+	/**
+	 * Number of times a frequency table was resized.
+	 */
+	uint64_t resizeCalls;
+	/**
+	 * Total number of entries probed when adding words to tables.
+	 */
+	uint64_t totalProbes;
+	/**
+	 * Largest number of entries probed to add a single word.
+	 */
+	uint64_t maxProbes;
+	/**
+	 * Number of table bytes currently allocated.
+	 */
+	uint64_t tableBytes;
+	/**
+	 * Largest number of table bytes allocated at once.
+	 */
+	uint64_t peakTableBytes;
+	/**
+	 * Number of words added to frequency tables.
+	 */
+	uint64_t wordsProcessed;
+} HuffmanInstrumentation;
+
+/**
+ * @struct HuffmanContext
+ * Memory reused across calls to the *_ctx functions in {@link huffman.c}.
+ * Hash tables are carved from an arena owned by the context instead of being
+ * allocated per call. Allocations that do not fit in the arena are made
+ * separately for that call, and the arena grows to the largest demand seen
+ * the next time it is empty, so repeated calls on similar data perform no
+ * allocations after warm-up.
+ *
+ * A context must not be used by more than one thread at a time.
+ *
+ * @see huffman_context_init
+ */
+typedef struct HuffmanContext_struct {
+	/**
+	 * Start of arena memory.
+	 */
+	uint8_t* arena;
+	/**
+	 * Capacity of arena in bytes.
+	 */
+	uint64_t arenaSize;
+	/**
+	 * Number of arena bytes currently allocated.
+	 */
+	uint64_t arenaUsed;
+	/**
+	 * Offset of the most recent arena allocation preceded by alignment
+	 * padding, or 0. The padding records the arena state to rewind to when
+	 * that allocation is released.
+	 */
+	uint64_t padOffset;
+	/**
+	 * Largest number of bytes requested at once since arena last grew,
+	 * including overflow allocations.
+	 */
+	uint64_t arenaPeak;
+	/**
+	 * Blocks allocated because arena was full. Released when the
+	 * call that allocated them returns.
+	 */
+	void* overflow;
+	/**
+	 * Total size of overflow blocks in bytes.
+	 */
+	uint64_t overflowBytes;
+	/**
+	 * Number of allocations performed by this context.
+	 */
+	uint64_t numAllocs;
+	/**
+	 * Callbacks used for all allocations of this context.
+	 */
+	HuffmanAllocator allocator;
+	/**
+	 * Destination for timings and counters of calls using this context, or
+	 * null. Set after {@link huffman_context_init}.
+	 */
+	HuffmanInstrumentation* instrumentation;
+} HuffmanContext;
+
+/**
+ * @struct HuffmanDictionary
+ * Value map and code trained once from a corpus and shared by many small
+ * messages, so that compressing a message neither builds nor sorts a
+ * frequency table and its frame only references {@link HuffmanDictionary#id}.
+ *
+ * Words missing from the dictionary are coded as an escape index of
+ * {@link HuffmanDictionary#uniqueWords} followed by the raw word.
+ *
+ * A dictionary is read-only after it is trained or loaded, so one dictionary
+ * may be shared by any number of threads.
+ *
+ * @see huffman_dictionary_train
+ */
+typedef struct HuffmanDictionary_struct {
+	/**
+	 * Identifier written to each frame compressed with this dictionary.
+	 */
+	uint32_t id;
+	/**
+	 * Word size used for compression.
+	 */
+	uint8_t wordSize;
+	/**
+	 * Number of words in dictionary, not including escape index.
+	 */
+	uint64_t uniqueWords;
+	/**
+	 * Built-in mapping used to code indices.
+	 */
+	const HuffmanCompressor* compressor;
+	/**
+	 * Depth parameter of mapping.
+	 */
+	uint8_t depthParam;
+	/**
+	 * Mapping constants, built for uniqueWords + 1 indices.
+	 */
+	HuffmanMapContext mapCtx;
+	/**
+	 * Words by decreasing training frequency.
+	 */
+	uint64_t* words;
+	/**
+	 * Hash table from word to index + 1.
+	 */
+	HuffmanHashTable lookup;
+	/**
+	 * Callbacks used to allocate words and lookup.
+	 */
+	HuffmanAllocator allocator;
+} HuffmanDictionary;
+
+/**
+ * @struct HuffmanStream
+ * State carried between the blocks of a stream. Each block is coded in a
+ * single pass with the code built from the previous block's histogram, while
+ * its own histogram is gathered. A block is instead coded with a fresh table
+ * built from its own histogram when that is estimated to be smaller,
+ * including the cost of sending the table.
+ *
+ * The same structure is used to compress and to decompress a stream; the
+ * decoder rebuilds each code from the words it decodes.
+ *
+ * If checksum is set after {@link huffman_stream_init}, on both ends, every
+ * block ends with a CRC32C of the stream so far, so the last block carries a
+ * checksum of the whole stream.
+ *
+ * @see huffman_stream_init
+ */
+typedef struct HuffmanStream_struct {
+	/**
+	 * Word size used for compression.
+	 */
+	uint8_t wordSize;
+	/**
+	 * Set once the last block of the stream has been processed.
+	 */
+	uint8_t finished;
+	/**
+	 * Whether blocks end with a checksum, see {@link HUFFMAN_FRAME_CHECKSUM}.
+	 */
+	uint8_t checksum;
+	/**
+	 * CRC32C of the data of every block processed so far.
+	 */
+	uint32_t crc;
+	/**
+	 * Code built from previous block. Empty before the first block.
+	 */
+	HuffmanDictionary code;
+	/**
+	 * Context histograms are allocated from, or null to use the heap.
+	 */
+	HuffmanContext* ctx;
+	/**
+	 * Number of blocks coded with a fresh table.
+	 */
+	uint64_t freshBlocks;
+	/**
+	 * Number of blocks coded with the previous block's code.
+	 */
+	uint64_t reusedBlocks;
+} HuffmanStream;
+
+/**
+ * @struct HuffmanJobPool
+ * Fixed pool of worker threads running jobs, each worker reusing a
+ * {@link HuffmanContext} of its own between jobs.
+ *
+ * @see huffman_pool_create
+ */
+typedef struct HuffmanJobPool_struct HuffmanJobPool;
+
+typedef struct HuffmanJob_struct HuffmanJob;
+
+/**
+ * Completion callback of a job, called on the worker thread once the job has
+ * been reported finished. The library no longer touches the job, so the
+ * callback may free or resubmit it. If another thread also waits on the job,
+ * that thread may have reclaimed it before the callback runs.
+ *
+ * @param[in,out] job Finished job.
+ */
+typedef void (*job_done_fcn) (HuffmanJob* job);
+
+/**
+ * @struct HuffmanJob
+ * Compression request run asynchronously by a {@link HuffmanJobPool}. The
+ * job serves as its own handle: it and its buffers must remain valid until
+ * {@link huffman_job_poll} reports it finished or {@link huffman_job_wait}
+ * returns. Must be zeroed before first use.
+ *
+ * @see huffman_pool_submit
+ */
+struct HuffmanJob_struct {
+	/**
+	 * {@link HUFFMAN_JOB_COMPRESS} or {@link HUFFMAN_JOB_SIZE}.
+	 */
+	uint8_t type;
+	/**
+	 * {@link HUFFMAN_PRIORITY_BULK} or {@link HUFFMAN_PRIORITY_LATENCY}.
+	 */
+	uint8_t priority;
+	/**
+	 * Destination for compressed data. Compression only.
+	 */
+	uint8_t* dst;
+	/**
+	 * Capacity of dst in bytes. Updated to size of compressed data on
+	 * success. Compression only.
+	 */
+	uint64_t dstSize;
+	/**
+	 * Data to be converted.
+	 */
+	uint8_t* src;
+	/**
+	 * Size of data in bytes.
+	 */
+	uint64_t srcSize;
+	/**
+	 * Word size used for compression.
+	 */
+	uint8_t wordSize;
+	/**
+	 * Mapping to calculate the size with. Size calculation only.
+	 */
+	const HuffmanCompressor* compressor;
+	/**
+	 * Depth parameter of mapping. Size calculation only.
+	 */
+	uint8_t depthParam;
+	/**
+	 * Called once job is done, or null.
+	 */
+	job_done_fcn done;
+	/**
+	 * Caller data for done. Unused by the library.
+	 */
+	void* user;
+	/**
+	 * Header populated with metadata.
+	 */
+	HuffmanHeader hdr;
+	/**
+	 * Calculation results. Size calculation only.
+	 */
+	HuffmanStats stats;
+	/**
+	 * Result of job once finished.
+	 */
+	HuffmanError err;
+	/**
+	 * Stage of job. Internal.
+	 */
+	uint8_t state;
+	/**
+	 * Next job of the same priority waiting in pool. Internal.
+	 */
+	HuffmanJob* next;
+	/**
+	 * Pool job was submitted to. Internal.
+	 */
+	HuffmanJobPool* pool;
+};
+
+/**
+ * @ingroup HuffmanConstants
+ * Maximum number of mappings that may be registered via
+ * {@link huffman_register_compressor}.
+ */
+#define HUFFMAN_MAX_CUSTOM_COMPRESSORS 8
+
+////////////////////////////////////////////////////////////////
+///
+/// @defgroup HuffmanInterface Huffman Interface
+/// Public functions of Huffman compression framework in {@link huffman.c}.
+///
+////////////////////////////////////////////////////////////////
+
+uint32_t huffman_get_cpu_features(void);
+
+uint32_t huffman_set_cpu_features(uint32_t features);
+
+uint32_t huffman_crc32c(uint32_t crc,
+						const uint8_t* src,
+						uint64_t srcSize);
+
+void huffman_context_init(HuffmanContext* ctx);
+
+HuffmanError huffman_context_init_allocator(HuffmanContext* ctx,
+											const HuffmanAllocator* allocator);
+
+void huffman_context_reset(HuffmanContext* ctx);
+
+void huffman_context_free(HuffmanContext* ctx);
+
+HuffmanError huffman_calculate_compressed_size_ctx(HuffmanStats* dst,
+												   HuffmanHeader* hdr,
+												   uint8_t* src,
+												   uint64_t srcSize,
+												   uint8_t wordSize,
+												   const HuffmanCompressor* compressor,
+												   uint8_t depthParam,
+												   HuffmanContext* ctx);
+
+HuffmanError huffman_calculate_compressed_size(HuffmanStats* dst,
+											   HuffmanHeader* hdr,
+											   uint8_t* src,
+											   uint64_t srcSize,
+											   uint8_t wordSize,
+											   const HuffmanCompressor* compressor,
+											   uint8_t depthParam);
+
+HuffmanError huffman_estimate_compressed_size(HuffmanStats* dst,
+											  HuffmanEstimate* est,
+											  HuffmanHeader* hdr,
+											  uint8_t* src,
+											  uint64_t srcSize,
+											  uint8_t wordSize,
+											  const HuffmanCompressor* compressor,
+											  uint8_t depthParam,
+											  uint64_t budget,
+											  HuffmanContext* ctx);
+
+HuffmanError huffman_init_map_context(HuffmanMapContext* ctx,
+									  const HuffmanCompressor* compressor,
+									  uint64_t uniqueWords,
+									  uint8_t depth);
+
+HuffmanError huffman_parse_compressed_idx_block(uint64_t* dst,
+											   uint64_t count,
+											   uint8_t** src,
+											   uint8_t* start,
+											   uint64_t* srcSize,
+											   const HuffmanCompressor* compressor,
+											   const HuffmanMapContext* ctx);
+
+HuffmanError huffman_parse_compressed_idx_streams(uint64_t* dst,
+												 uint64_t count,
+												 uint8_t numStreams,
+												 uint8_t** src,
+												 uint8_t* start,
+												 uint64_t* srcSize,
+												 const HuffmanCompressor* compressor,
+												 const HuffmanMapContext* ctx);
+
+HuffmanError huffman_register_compressor(const HuffmanCompressor* compressor);
+
+void huffman_clear_compressors(void);
+
+HuffmanError huffman_compare_compressors(HuffmanStats* dst,
+										 uint64_t* dstCount,
+										 HuffmanHeader* hdr,
+										 uint8_t* src,
+										 uint64_t srcSize,
+										 uint8_t wordSize);
+
+HuffmanError huffman_compare_compressors_ctx(HuffmanStats* dst,
+											 uint64_t* dstCount,
+											 HuffmanHeader* hdr,
+											 uint8_t* src,
+											 uint64_t srcSize,
+											 uint8_t wordSize,
+											 HuffmanContext* ctx);
+
+HuffmanError huffman_compress_ctx(uint8_t* dst,
+								  uint64_t* dstSize,
+								  HuffmanHeader* hdr,
+								  uint8_t* src,
+								  uint64_t srcSize,
+								  uint8_t wordSize,
+								  HuffmanContext* ctx);
+
+HuffmanError huffman_compress_checksum(uint8_t* dst,
+									   uint64_t* dstSize,
+									   HuffmanHeader* hdr,
+									   uint8_t* src,
+									   uint64_t srcSize,
+									   uint8_t wordSize,
+									   HuffmanContext* ctx);
+
+HuffmanError huffman_compress_interleaved(uint8_t* dst,
+										  uint64_t* dstSize,
+										  HuffmanHeader* hdr,
+										  uint8_t* src,
+										  uint64_t srcSize,
+										  uint8_t wordSize,
+										  uint8_t numStreams,
+										  HuffmanContext* ctx);
+
+HuffmanError huffman_compress(uint8_t* dst,
+							  uint64_t* dstSize,
+							  HuffmanHeader* hdr,
+							  uint8_t* src,
+							  uint64_t srcSize,
+							  uint8_t wordSize);
+
+HuffmanError huffman_compress_budget(uint8_t* dst,
+									 uint64_t* dstSize,
+									 HuffmanHeader* hdr,
+									 uint8_t* src,
+									 uint64_t srcSize,
+									 uint8_t wordSize,
+									 uint64_t budget,
+									 HuffmanContext* ctx);
+
+HuffmanError huffman_compress_spill(uint8_t* dst,
+									uint64_t* dstSize,
+									HuffmanHeader* hdr,
+									uint8_t* src,
+									uint64_t srcSize,
+									uint8_t wordSize,
+									const char* scratchDir,
+									uint64_t budget,
+									HuffmanContext* ctx);
+
+HuffmanError huffman_compress_runs(uint8_t* dst,
+								   uint64_t* dstSize,
+								   HuffmanHeader* hdr,
+								   uint8_t* src,
+								   uint64_t srcSize,
+								   uint8_t wordSize,
+								   HuffmanContext* ctx);
+
+HuffmanError huffman_decompress_ctx(uint8_t* dst,
+									uint64_t* dstSize,
+									uint8_t* src,
+									uint64_t srcSize,
+									HuffmanContext* ctx);
+
+HuffmanError huffman_decompress(uint8_t* dst,
+								uint64_t* dstSize,
+								uint8_t* src,
+								uint64_t srcSize);
+
+HuffmanError huffman_dictionary_train(HuffmanDictionary* dict,
+									  uint32_t id,
+									  uint8_t* src,
+									  uint64_t srcSize,
+									  uint8_t wordSize,
+									  HuffmanContext* ctx);
+
+HuffmanError huffman_dictionary_serialize(uint8_t* dst,
+										  uint64_t* dstSize,
+										  const HuffmanDictionary* dict);
+
+HuffmanError huffman_dictionary_load(HuffmanDictionary* dict,
+									 uint8_t* src,
+									 uint64_t srcSize,
+									 HuffmanContext* ctx);
+
+void huffman_dictionary_free(HuffmanDictionary* dict);
+
+HuffmanError huffman_get_dictionary_id(uint32_t* id,
+									   uint8_t* src,
+									   uint64_t srcSize);
+
+HuffmanError huffman_dictionary_compress(uint8_t* dst,
+										 uint64_t* dstSize,
+										 uint8_t* src,
+										 uint64_t srcSize,
+										 const HuffmanDictionary* dict);
+
+HuffmanError huffman_dictionary_decompress(uint8_t* dst,
+										   uint64_t* dstSize,
+										   uint8_t* src,
+										   uint64_t srcSize,
+										   const HuffmanDictionary* dict);
+
+HuffmanError huffman_stream_init(HuffmanStream* stream,
+								 uint8_t wordSize,
+								 HuffmanContext* ctx);
+
+void huffman_stream_free(HuffmanStream* stream);
+
+HuffmanError huffman_stream_compress_block(uint8_t* dst,
+										   uint64_t* dstSize,
+										   uint8_t* src,
+										   uint64_t srcSize,
+										   uint8_t last,
+										   HuffmanStream* stream);
+
+HuffmanError huffman_stream_decompress_block(uint8_t* dst,
+											 uint64_t* dstSize,
+											 uint8_t* src,
+											 uint64_t* srcSize,
+											 HuffmanStream* stream);
+
+HuffmanError huffman_compress_file(FILE* dst,
+								   FILE* src,
+								   uint8_t wordSize,
+								   uint64_t blockSize,
+								   uint8_t checksum,
+								   uint8_t numThreads,
+								   uint64_t queueDepth);
+
+HuffmanError huffman_decompress_file(FILE* dst,
+									 FILE* src,
+									 uint8_t numThreads,
+									 uint64_t queueDepth);
+
+HuffmanError huffman_pool_create(HuffmanJobPool** pool,
+								 uint8_t numThreads);
+
+void huffman_pool_destroy(HuffmanJobPool* pool);
+
+HuffmanError huffman_pool_submit(HuffmanJobPool* pool,
+								 HuffmanJob* job);
 
+uint8_t huffman_job_poll(HuffmanJob* job);
 
+HuffmanError huffman_job_wait(HuffmanJob* job);
 
 #endif // __HUFFMAN_H_
 
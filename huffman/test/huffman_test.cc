@@ -12,9 +12,12 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <thread>
+#include <atomic>
 
 #include "../src/inc/huffman.h"
 #include "../src/huffman.c"
+#include "../src/basemap.c"
 #include "gtest/gtest.h"
 
 /**
@@ -1071,6 +1074,121 @@ TEST_F(HuffmanTest, put_bits_case4) {
 	EXPECT_EQ(0, start);
 }
 
+/**
+ * Validates that every kernel bound by {@link huffman_set_cpu_features}
+ * matches the portable kernels.
+ */
+TEST_F(HuffmanTest, huffman_set_cpu_features) {
+	const uint32_t all = HUFFMAN_CPU_SSE42 | HUFFMAN_CPU_AVX2 | HUFFMAN_CPU_AVX512 |
+			HUFFMAN_CPU_BMI2;
+	const uint32_t featureSets[] = {0, HUFFMAN_CPU_SSE42, HUFFMAN_CPU_AVX2,
+			HUFFMAN_CPU_AVX512, HUFFMAN_CPU_BMI2, all};
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME;
+	const uint64_t count = 64;
+	uint32_t initial = huffman_get_cpu_features();
+	uint8_t src[HUFFMAN_TEST_SMALL_VOLUME], packed[HUFFMAN_TEST_SMALL_VOLUME];
+	uint8_t expectedPacked[HUFFMAN_TEST_SMALL_VOLUME];
+	uint64_t words[64], expected[64], lengths[64], expectedLengths[64], idx[64];
+	uint64_t i, f, runs, expectedRuns, dstSize, outSize;
+	uint8_t wordSize, start, dst[2 * HUFFMAN_TEST_SMALL_VOLUME + 64], out[HUFFMAN_TEST_SMALL_VOLUME];
+	HuffmanHeader header;
+
+	// Feature lists as read from environment
+	EXPECT_EQ(0u, parse_cpu_features("portable"));
+	EXPECT_EQ(0u, parse_cpu_features(""));
+	EXPECT_EQ((uint32_t) (HUFFMAN_CPU_AVX2 | HUFFMAN_CPU_BMI2), parse_cpu_features("avx2,bmi2"));
+	EXPECT_EQ(all, parse_cpu_features("sse4.2,avx512,avx2,bmi2,unknown"));
+	EXPECT_EQ(0u, huffman_set_cpu_features(0));
+	EXPECT_EQ(0u, huffman_get_cpu_features());
+
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) rand();
+	}
+	for (f = 0; f < sizeof(featureSets) / sizeof(featureSets[0]); f++) {
+		EXPECT_EQ(featureSets[f] & huffman_set_cpu_features(all), huffman_set_cpu_features(featureSets[f]));
+		for (wordSize = HUFFMAN_MIN_WORD_SIZE; wordSize <= HUFFMAN_MAX_WORD_SIZE; wordSize++) {
+			for (start = 0; start < 8; start++) {
+				// Unpack up to end of data
+				unpack_words_portable(expected, src, start, src + srcSize, count, wordSize);
+				kernels.unpack(words, src, start, src + (start + count * wordSize + 7) / 8, count, wordSize);
+				ASSERT_EQ(0, memcmp(expected, words, sizeof(words))) << (int)wordSize;
+
+				// Pack keeping preceding bits, up to end of space
+				memcpy(expectedPacked, src, srcSize);
+				memcpy(packed, src, srcSize);
+				pack_words_portable(expectedPacked, start, expectedPacked + srcSize, expected, count, wordSize);
+				kernels.pack(packed, start, packed + (start + count * wordSize + 7) / 8, expected, count,
+						wordSize);
+				ASSERT_EQ(0, memcmp(expectedPacked, packed, (start + count * wordSize + 7) / 8))
+						<< (int)wordSize;
+			}
+
+			// Runs of varied lengths
+			for (i = 0; i < count; i++) {
+				expected[i] = (i > 0 && rand() % 3 != 0) ? expected[i - 1] : (uint64_t) rand() % 4;
+				words[i] = expected[i];
+				idx[i] = (i * 7) % count;
+			}
+			expectedRuns = split_runs_portable(expected, expectedLengths, count - wordSize % 3);
+			runs = kernels.splitRuns(words, lengths, count - wordSize % 3);
+			ASSERT_EQ(expectedRuns, runs);
+			ASSERT_EQ(0, memcmp(expected, words, runs * sizeof(uint64_t)));
+			ASSERT_EQ(0, memcmp(expectedLengths, lengths, runs * sizeof(uint64_t)));
+
+			// Gather in place
+			gather_words_portable(expected, words, idx, count - wordSize % 5);
+			kernels.gather(idx, words, idx, count - wordSize % 5);
+			ASSERT_EQ(0, memcmp(expected, idx, (count - wordSize % 5) * sizeof(uint64_t)));
+		}
+
+		// Checksum from every alignment, lengths around the 8 byte stride
+		for (i = 0; i < count; i++) {
+			ASSERT_EQ(crc32c_portable(~0u, src + i % 8, i * 3),
+					kernels.crc32c(~0u, src + i % 8, i * 3)) << i;
+		}
+
+		// Round trip with incomplete last word
+		dstSize = sizeof(dst);
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, srcSize - 1, 12));
+		outSize = sizeof(out);
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize));
+		ASSERT_EQ(srcSize - 1, outSize);
+		ASSERT_EQ(0, memcmp(src, out, outSize));
+	}
+	huffman_set_cpu_features(initial);
+}
+
+/**
+ * Validates {@link huffman_crc32c} against known values, and
+ * {@link crc32c_combine} against checksums of whole data.
+ */
+TEST_F(HuffmanTest, huffman_crc32c) {
+	const uint8_t check[] = "123456789";
+	uint8_t src[HUFFMAN_TEST_SMALL_VOLUME];
+	uint64_t i, split;
+	uint32_t whole;
+
+	EXPECT_EQ(0u, huffman_crc32c(0, check, 0));
+	EXPECT_EQ(0xE3069283u, huffman_crc32c(0, check, 9));
+	EXPECT_EQ(0xE3069283u, huffman_crc32c(huffman_crc32c(0, check, 4), check + 4, 5));
+	memset(src, 0x00, 32);
+	EXPECT_EQ(0x8A9136AAu, huffman_crc32c(0, src, 32));
+	memset(src, 0xFF, 32);
+	EXPECT_EQ(0x62A8AB43u, huffman_crc32c(0, src, 32));
+
+	for (i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t) rand();
+	}
+	whole = huffman_crc32c(0, src, sizeof(src));
+	const uint64_t splits[] = {0, 1, 7, 64, 1000, sizeof(src)};
+	for (i = 0; i < sizeof(splits) / sizeof(splits[0]); i++) {
+		split = splits[i];
+		EXPECT_EQ(whole, crc32c_combine(huffman_crc32c(0, src, split),
+				huffman_crc32c(0, src + split, sizeof(src) - split), sizeof(src) - split))
+				<< "split " << split;
+	}
+}
+
 /**
  * Tests input validation for {@link build_header}.
  */
@@ -1450,16 +1568,16 @@ TEST_F(HuffmanTest, resize_table_errs) {
 	table.size = TEST_TABLE_SIZE;
 	table.table = NULL;
 
-	EXPECT_EQ(ERR_NULL_PTR, resize_table(NULL, 2 * TEST_TABLE_SIZE));
-	EXPECT_EQ(ERR_NULL_PTR, resize_table(&table, 2 * TEST_TABLE_SIZE));
+	EXPECT_EQ(ERR_NULL_PTR, resize_table(NULL, 2 * TEST_TABLE_SIZE, NULL));
+	EXPECT_EQ(ERR_NULL_PTR, resize_table(&table, 2 * TEST_TABLE_SIZE, NULL));
 
 	table.table = tableDat;
 	table.size = 0;
-	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, TEST_TABLE_SIZE));
+	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, TEST_TABLE_SIZE, NULL));
 	table.size = TEST_TABLE_SIZE;
-	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, (uint64_t)0));
-	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, TEST_TABLE_SIZE - 1));
-	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, TEST_TABLE_SIZE));
+	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, (uint64_t)0, NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, TEST_TABLE_SIZE - 1, NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, resize_table(&table, TEST_TABLE_SIZE, NULL));
 }
 
 /**
@@ -1486,7 +1604,7 @@ TEST_F(HuffmanTest, resize_table) {
 		*id = i * 10 / 3;
 	}
 
-	EXPECT_EQ(ERR_NO_ERR, resize_table(&table, TEST_TABLE_SIZE + 3));
+	EXPECT_EQ(ERR_NO_ERR, resize_table(&table, TEST_TABLE_SIZE + 3, NULL));
 	EXPECT_NE(oldTable, table.table);
 	EXPECT_EQ(TEST_TABLE_SIZE + 3, table.size);
 
@@ -1517,7 +1635,7 @@ TEST_F(HuffmanTest, resize_table) {
 		*id = i * 10 / 3 + 3;
 	}
 
-	EXPECT_EQ(ERR_NO_ERR, resize_table(&table, TEST_TABLE_SIZE + 3));
+	EXPECT_EQ(ERR_NO_ERR, resize_table(&table, TEST_TABLE_SIZE + 3, NULL));
 	EXPECT_NE(oldTable, table.table);
 	EXPECT_EQ(TEST_TABLE_SIZE + 3, table.size);
 
@@ -1552,17 +1670,17 @@ TEST_F(HuffmanTest, add_to_table_errs) {
 	table.table = NULL;
 	table.size = 4;
 	maxSize = 4;
-	EXPECT_EQ(ERR_NULL_PTR, add_to_table(NULL, &numWords, word, maxSize));
-	EXPECT_EQ(ERR_NULL_PTR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NULL_PTR, add_to_table(NULL, &numWords, word, maxSize, NULL));
+	EXPECT_EQ(ERR_NULL_PTR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	table.table = tableDat;
-	EXPECT_EQ(ERR_NULL_PTR, add_to_table(&table, NULL, word, maxSize));
+	EXPECT_EQ(ERR_NULL_PTR, add_to_table(&table, NULL, word, maxSize, NULL));
 
 	// Value checking
 	table.size = 0;
-	EXPECT_EQ(ERR_INVALID_VALUE, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_INVALID_VALUE, add_to_table(&table, &numWords, word, maxSize, NULL));
 	table.size = 4;
 	maxSize = 3;
-	EXPECT_EQ(ERR_INVALID_VALUE, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_INVALID_VALUE, add_to_table(&table, &numWords, word, maxSize, NULL));
 
 	// Insufficient space
 	for (i = 0; i < table.size; i++) {
@@ -1574,19 +1692,19 @@ TEST_F(HuffmanTest, add_to_table_errs) {
 	}
 	maxSize = 4;
 	word = i + 1;
-	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, add_to_table(&table, &numWords, word, maxSize, NULL));
 
 	// Overflow
 	word = (uint64_t) 1;
 	idx = get_hash(word, table.size);
 	dstVal = get_table_value(tableDat, idx);
 	*dstVal = HUFFMAN_MAX_UINT64;
-	EXPECT_EQ(ERR_OVERFLOW, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_OVERFLOW, add_to_table(&table, &numWords, word, maxSize, NULL));
 	*dstVal = (uint64_t) 0;
 	dstId = get_table_id(tableDat, idx);
 	*dstId = (uint64_t) 0;
 	numWords = HUFFMAN_MAX_UINT64;
-	EXPECT_EQ(ERR_OVERFLOW, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_OVERFLOW, add_to_table(&table, &numWords, word, maxSize, NULL));
 }
 
 /**
@@ -1607,7 +1725,7 @@ TEST_F(HuffmanTest, add_to_table) {
 	table.size = 4;
 	maxSize = 4;
 	word = 0x2;
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	EXPECT_EQ(1, numWords);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&idx, &table, word, false));
 	EXPECT_EQ(1, *get_table_value(table.table, idx));
@@ -1616,7 +1734,7 @@ TEST_F(HuffmanTest, add_to_table) {
 
 	// Case II: non-empty, new value (also test search function)
 	word = 0x6;
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	EXPECT_EQ(2, numWords);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&idx, &table, word, false));
 	EXPECT_EQ(1, *get_table_value(table.table, idx));
@@ -1624,7 +1742,7 @@ TEST_F(HuffmanTest, add_to_table) {
 	// table is currently: {2:1, 6:1}
 
 	// Case III: non-empty, increment
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	EXPECT_EQ(2, numWords);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&idx, &table, word, false));
 	EXPECT_EQ(2, *get_table_value(table.table, idx));
@@ -1633,11 +1751,11 @@ TEST_F(HuffmanTest, add_to_table) {
 
 	// Case IV: full, increment
 	word = 0x1;
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	word = 0x3;
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	// table is currently: {1:1, 2:1, 3:1, 6:2}
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	EXPECT_EQ(4, numWords);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&idx, &table, word, false));
 	EXPECT_EQ(2, *get_table_value(table.table, idx));
@@ -1647,7 +1765,7 @@ TEST_F(HuffmanTest, add_to_table) {
 	// Case V: full, new value (resize), newSize < maxSize
 	word = 0x9;
 	maxSize = 10;
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	EXPECT_EQ(5, numWords);
 	EXPECT_EQ(8, table.size);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&idx, &table, word, false));
@@ -1658,11 +1776,11 @@ TEST_F(HuffmanTest, add_to_table) {
 	// Case VI: full, new value (resize), newSize > maxSize
 	for (i = 0; numWords < table.size; i++) {
 		word = 0x10 + i;
-		EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+		EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	}
 	// table is currently: {x1:1, x2:1, x3:2, x6:2, x9:1, x10:1, x11:1, x12:1}
 	word = 0x20;
-	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize));
+	EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, maxSize, NULL));
 	EXPECT_EQ(9, numWords);
 	EXPECT_EQ(maxSize, table.size);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&idx, &table, word, false));
@@ -1670,6 +1788,314 @@ TEST_F(HuffmanTest, add_to_table) {
 	EXPECT_EQ(word, *get_table_id(table.table, idx));
 }
 
+/**
+ * Validates {@link compact_add} and {@link compact_expand}.
+ */
+TEST_F(HuffmanTest, compact_add) {
+	HuffmanCompactTable table;
+	HuffmanHashTable expanded;
+	uint64_t numWords = 0;
+	uint64_t i, idx, slot;
+	const uint64_t maxSize = 64;
+
+	// Resizes like add_to_table
+	ASSERT_EQ(ERR_NO_ERR, compact_alloc(&table, 2, NULL));
+	for (i = 0; i < 40; i++) {
+		EXPECT_EQ(ERR_NO_ERR, compact_add(&table, &numWords, (uint32_t) (i % 20 + 1), 1, maxSize, NULL));
+	}
+	EXPECT_EQ(20u, numWords);
+	EXPECT_EQ(32u, table.size);
+	ASSERT_EQ(ERR_NO_ERR, compact_search(&idx, &table, 7, false));
+	EXPECT_EQ(2u, table.table[2 * idx]);
+	EXPECT_EQ((uint64_t*)NULL, table.overflow.table);
+
+	// Counts carry past 32 bits
+	table.table[2 * idx] = UINT32_MAX;
+	EXPECT_EQ(ERR_NO_ERR, compact_add(&table, &numWords, 7, 1, maxSize, NULL));
+	EXPECT_EQ(1u, table.table[2 * idx]);
+	ASSERT_NE((uint64_t*)NULL, table.overflow.table);
+	ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &table.overflow, 7, false));
+	EXPECT_EQ(1u, *get_table_value(table.overflow.table, slot));
+	EXPECT_EQ(ERR_NO_ERR, compact_add(&table, &numWords, 7, 1, maxSize, NULL));
+	EXPECT_EQ(20u, numWords);
+
+	// Overflow once total would pass HUFFMAN_MAX_UINT64
+	*get_table_value(table.overflow.table, slot) = HUFFMAN_MAX_UINT64 / UINT32_MAX - 1;
+	table.table[2 * idx] = UINT32_MAX;
+	EXPECT_EQ(ERR_OVERFLOW, compact_add(&table, &numWords, 7, 1, maxSize, NULL));
+	*get_table_value(table.overflow.table, slot) = 1;
+	table.table[2 * idx] = 2;
+
+	// Runs carry several times at once
+	EXPECT_EQ(ERR_NO_ERR, compact_add(&table, &numWords, 20, (uint64_t) UINT32_MAX * 2 + 5, maxSize, NULL));
+	EXPECT_EQ(20u, numWords);
+
+	// Full-width table keeps totals
+	ASSERT_EQ(ERR_NO_ERR, compact_expand(&expanded, &table, numWords, NULL));
+	EXPECT_EQ((uint32_t*)NULL, table.table);
+	EXPECT_EQ(numWords + numWords / 2 + 2, expanded.size);
+	ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &expanded, 7, false));
+	EXPECT_EQ((uint64_t) UINT32_MAX + 2, *get_table_value(expanded.table, slot));
+	for (i = 1; i <= 20; i++) {
+		ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &expanded, i, false));
+		EXPECT_EQ(i, *get_table_id(expanded.table, slot));
+		if (i != 7) {
+			EXPECT_EQ((i == 20) ? (uint64_t) UINT32_MAX * 2 + 7 : 2u, *get_table_value(expanded.table, slot));
+		}
+	}
+	table_free(NULL, expanded.table, expanded.size);
+
+	// Full table
+	numWords = 0;
+	ASSERT_EQ(ERR_NO_ERR, compact_alloc(&table, 4, NULL));
+	for (i = 0; i < 3; i++) {
+		EXPECT_EQ(ERR_NO_ERR, compact_add(&table, &numWords, (uint32_t) i, 1, 4, NULL));
+	}
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, compact_add(&table, &numWords, 4, 1, 4, NULL));
+	compact_free(&table, NULL);
+}
+
+/**
+ * Counts every word of src in a single {@link HuffmanHashTable} grown by
+ * {@link add_to_table}, and returns the arena peak of a fresh context.
+ */
+static uint64_t single_table_peak(uint8_t* src,
+								  uint64_t srcSize,
+								  uint8_t wordSize) {
+	HuffmanContext ctx;
+	HuffmanContextMark mark;
+	HuffmanHashTable table;
+	uint8_t* currPtr = src;
+	uint8_t currBit = 0;
+	uint8_t unused;
+	uint64_t i, word, peak;
+	uint64_t numWords = 0;
+	uint64_t wordCount = get_word_count(&unused, srcSize, wordSize);
+
+	huffman_context_init(&ctx);
+	context_enter(&mark, &ctx);
+	table.size = get_initial_table_size(wordSize, wordCount);
+	table.table = table_alloc(&ctx, table.size);
+	for (i = 0; i < wordCount; i++) {
+		extract_bits(&word, &currPtr, &currBit, wordSize);
+		EXPECT_EQ(ERR_NO_ERR, add_to_table(&table, &numWords, word, get_max_table_size(wordSize), &ctx));
+	}
+	context_leave(&ctx, &mark);
+	peak = ctx.arenaPeak;
+	huffman_context_free(&ctx);
+	return peak;
+}
+
+/**
+ * Validates that {@link compact_expand} converts in place, so that peak memory
+ * of {@link generate_table} stays below counting in a single table.
+ */
+TEST_F(HuffmanTest, compact_expand_peak) {
+	HuffmanContext ctx;
+	HuffmanContextMark mark;
+	HuffmanHeader header;
+	HuffmanHashTable table;
+	uint8_t* src;
+	uint64_t i, word, srcSize;
+	// Few words grown through several sizes, and many that fit initial size
+	const uint8_t wordSizes[] = {16, 24};
+	const uint64_t wordCounts[] = {40000, 300000};
+	const uint64_t ranges[] = {9000, 150000};
+
+	for (int t = 0; t < 2; t++) {
+		srcSize = wordCounts[t] * wordSizes[t] / 8;
+		src = (uint8_t*) malloc(srcSize);
+		ASSERT_NE((uint8_t*)NULL, src);
+		for (i = 0; i < srcSize; i++) {
+			if (i % (wordSizes[t] / 8) == 0) {
+				word = (((uint64_t) rand() << 16) ^ (uint64_t) rand()) % ranges[t];
+			}
+			src[i] = (uint8_t) (word >> (8 * (i % (wordSizes[t] / 8))));
+		}
+
+		huffman_context_init(&ctx);
+		context_enter(&mark, &ctx);
+		ASSERT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSizes[t], NULL, &ctx));
+		EXPECT_GE(2 * sizeof(uint64_t) * table.size, ctx.arenaPeak);
+		EXPECT_GT(single_table_peak(src, srcSize, wordSizes[t]), ctx.arenaPeak);
+		context_leave(&ctx, &mark);
+		huffman_context_free(&ctx);
+		free(src);
+	}
+}
+
+/**
+ * Spreads i over a 41-bit word for {@link tiered_add} tests.
+ */
+static uint64_t tiered_word(uint64_t i) {
+	return (i << 40) | i;
+}
+
+/**
+ * Validates {@link tiered_add} and {@link tiered_expand}.
+ */
+TEST_F(HuffmanTest, tiered_add) {
+	HuffmanTieredTable table;
+	HuffmanHashTable expanded;
+	uint64_t numWords = 0;
+	uint64_t i, slot;
+	const uint64_t maxSize = 256;
+
+	// Singletons stay in set, repeats promoted with exact counts
+	ASSERT_EQ(ERR_NO_ERR, tiered_alloc(&table, 4, maxSize, NULL));
+	for (i = 0; i < 100; i++) {
+		EXPECT_EQ(ERR_NO_ERR, tiered_add(&table, &numWords, tiered_word(i), 1, maxSize, NULL));
+	}
+	for (i = 0; i < 10; i++) {
+		EXPECT_EQ(ERR_NO_ERR, tiered_add(&table, &numWords, 0, 1, maxSize, NULL));
+		EXPECT_EQ(ERR_NO_ERR, tiered_add(&table, &numWords, tiered_word(i % 2 + 1), 1, maxSize, NULL));
+	}
+	EXPECT_EQ(100u, numWords);
+	EXPECT_EQ(3u, table.numCounts);
+	EXPECT_EQ(256u, table.seenSize);
+	EXPECT_EQ(100u, table.numSeen);
+
+	// Run of a word seen once promoted with its total count
+	EXPECT_EQ(ERR_NO_ERR, tiered_add(&table, &numWords, tiered_word(3), 4, maxSize, NULL));
+	ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &table.counts, tiered_word(3), false));
+	EXPECT_EQ(5u, *get_table_value(table.counts.table, slot));
+	EXPECT_EQ(100u, numWords);
+	ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &table.counts, 0, false));
+	EXPECT_EQ(11u, *get_table_value(table.counts.table, slot));
+
+	// Set full at maxSize, new words counted directly
+	for (i = 100; i < 300; i++) {
+		EXPECT_EQ(ERR_NO_ERR, tiered_add(&table, &numWords, tiered_word(i), 1, maxSize, NULL));
+	}
+	EXPECT_EQ(300u, numWords);
+	EXPECT_EQ(maxSize, table.seenSize);
+	EXPECT_LT(3u, table.numCounts);
+
+	// Set full, words seen once still found in it and promoted
+	for (i = 4; i < 100; i++) {
+		EXPECT_EQ(ERR_NO_ERR, tiered_add(&table, &numWords, tiered_word(i), 1, maxSize, NULL));
+	}
+	EXPECT_EQ(300u, numWords);
+
+	// Overflow
+	*get_table_value(table.counts.table, slot) = HUFFMAN_MAX_UINT64;
+	EXPECT_EQ(ERR_OVERFLOW, tiered_add(&table, &numWords, 0, 1, maxSize, NULL));
+	*get_table_value(table.counts.table, slot) = 11;
+
+	// Merged table holds every word once with exact counts
+	ASSERT_EQ(ERR_NO_ERR, tiered_expand(&expanded, &table, numWords, NULL));
+	EXPECT_EQ((uint64_t*)NULL, table.seen);
+	EXPECT_EQ((uint64_t*)NULL, table.counts.table);
+	for (i = 0; i < 300; i++) {
+		ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &expanded, tiered_word(i), false));
+		ASSERT_EQ(tiered_word(i), *get_table_id(expanded.table, slot));
+		EXPECT_EQ((i == 0) ? 11u : (i <= 2) ? 6u : (i == 3) ? 5u : (i < 100) ? 2u : 1u,
+				*get_table_value(expanded.table, slot)) << i;
+	}
+	numWords = 0;
+	for (i = 0; i < expanded.size; i++) {
+		numWords += *get_table_value(expanded.table, i) > 0;
+	}
+	EXPECT_EQ(300u, numWords);
+	table_free(NULL, expanded.table, expanded.size);
+}
+
+/**
+ * Validates compression of wide words that repeat once the set of words seen
+ * of a two-tier table is full.
+ */
+TEST_F(HuffmanTest, tiered_repeat_full) {
+	const uint64_t srcSize = 40000;
+	uint8_t *src, *dst, *out;
+	uint64_t i, dstSize, outSize;
+	HuffmanHeader header;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	dst = (uint8_t*) malloc(2 * srcSize + 64);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	ASSERT_NE((uint8_t*)NULL, dst);
+
+	// 950 unique 40-bit words, then the first again
+	for (i = 0; i < 950 * 5; i++) {
+		src[i] = (uint8_t) rand();
+	}
+	memcpy(&src[950 * 5], src, 5);
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, 951 * 5, 40));
+	EXPECT_GE(950u, header.uniqueWords);
+	outSize = srcSize;
+	ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize));
+	EXPECT_EQ(951u * 5, outSize);
+	EXPECT_EQ(0, memcmp(src, out, 951 * 5));
+
+	// Few byte values, wide words repeating throughout
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) (rand() % 4);
+	}
+	const uint8_t wordSizes[] = {33, 60};
+	for (uint64_t w = 0; w < sizeof(wordSizes) / sizeof(wordSizes[0]); w++) {
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, srcSize,
+				wordSizes[w])) << (int)wordSizes[w];
+		outSize = srcSize;
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize));
+		EXPECT_EQ(0, memcmp(src, out, srcSize));
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_runs(dst, &dstSize, &header, src, srcSize,
+				wordSizes[w], NULL)) << (int)wordSizes[w];
+		outSize = srcSize;
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize));
+		EXPECT_EQ(0, memcmp(src, out, srcSize));
+	}
+
+	free(src);
+	free(out);
+	free(dst);
+}
+
+/**
+ * Validates that {@link tiered_add} and {@link tiered_expand} grow and convert
+ * within one allocation, so that peak memory of {@link generate_table} on
+ * mostly unique words stays within counting in a single table.
+ */
+TEST_F(HuffmanTest, tiered_expand_peak) {
+	HuffmanContext ctx;
+	HuffmanContextMark mark;
+	HuffmanHeader header;
+	HuffmanHashTable table;
+	uint8_t* src;
+	uint64_t i, word;
+	uint64_t* words;
+	const uint64_t wordCount = 100000;
+	const uint64_t srcSize = wordCount * 6;
+
+	// 48-bit words, 1 in 20 a repeat
+	src = (uint8_t*) malloc(srcSize);
+	words = (uint64_t*) malloc(sizeof(uint64_t) * wordCount);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint64_t*)NULL, words);
+	for (i = 0; i < wordCount; i++) {
+		word = (((uint64_t) rand() << 24) ^ (uint64_t) rand()) & 0xFFFFFFFFFFFF;
+		words[i] = (i > 0 && rand() % 20 == 0) ? words[rand() % i] : word;
+		for (int b = 0; b < 6; b++) {
+			src[6 * i + b] = (uint8_t) (words[i] >> (8 * b));
+		}
+	}
+
+	huffman_context_init(&ctx);
+	context_enter(&mark, &ctx);
+	ASSERT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, 48, NULL, &ctx));
+	EXPECT_LT(wordCount * 9 / 10, header.uniqueWords);
+	EXPECT_GE(2 * sizeof(uint64_t) * table.size, ctx.arenaPeak);
+	EXPECT_GE(single_table_peak(src, srcSize, 48), ctx.arenaPeak);
+	context_leave(&ctx, &mark);
+	huffman_context_free(&ctx);
+	free(words);
+	free(src);
+}
+
 /**
  * Validates error handling of {@link generate_table}.
  */
@@ -1685,22 +2111,100 @@ TEST_F(HuffmanTest, generate_table_errs) {
 	wordSize = 32;
 
 	// Null pointer
-	EXPECT_EQ(ERR_NULL_PTR, generate_table(NULL, &table, srcDummy, srcSize, wordSize));
-	EXPECT_EQ(ERR_NULL_PTR, generate_table(&header, NULL, srcDummy, srcSize, wordSize));
-	EXPECT_EQ(ERR_NULL_PTR, generate_table(&header, &table, NULL, srcSize, wordSize));
+	EXPECT_EQ(ERR_NULL_PTR, generate_table(NULL, &table, srcDummy, srcSize, wordSize, NULL, NULL));
+	EXPECT_EQ(ERR_NULL_PTR, generate_table(&header, NULL, srcDummy, srcSize, wordSize, NULL, NULL));
+	EXPECT_EQ(ERR_NULL_PTR, generate_table(&header, &table, NULL, srcSize, wordSize, NULL, NULL));
 
 	// Invalid parameters
 	wordSize = HUFFMAN_MIN_WORD_SIZE - 1;
-	EXPECT_EQ(ERR_INVALID_VALUE, generate_table(&header, &table, srcDummy, srcSize, wordSize));
+	EXPECT_EQ(ERR_INVALID_VALUE, generate_table(&header, &table, srcDummy, srcSize, wordSize, NULL, NULL));
 	wordSize = HUFFMAN_MAX_WORD_SIZE + 1;
-	EXPECT_EQ(ERR_INVALID_VALUE, generate_table(&header, &table, srcDummy, srcSize, wordSize));
+	EXPECT_EQ(ERR_INVALID_VALUE, generate_table(&header, &table, srcDummy, srcSize, wordSize, NULL, NULL));
 	wordSize = 32;
 	srcSize = 0;
-	EXPECT_EQ(ERR_INVALID_VALUE, generate_table(&header, &table, srcDummy, srcSize, wordSize));
+	EXPECT_EQ(ERR_INVALID_VALUE, generate_table(&header, &table, srcDummy, srcSize, wordSize, NULL, NULL));
 
 	// Cannot test overflow on most architectures due to space restrictions
 }
 
+/**
+ * Validates {@link generate_run_table} counts long runs once when coding them
+ * by run escape, and whole runs otherwise.
+ */
+TEST_F(HuffmanTest, generate_run_table) {
+	HuffmanHeader header;
+	HuffmanHashTable table;
+	HuffmanRunCount runs;
+	uint8_t src[2 * 33];
+	uint8_t* currPtr;
+	uint8_t currBit;
+	uint64_t i, slot, remaining;
+	const uint64_t words[] = {1, 2, 1, 3};
+	const uint64_t lengths[] = {20, 3, 9, 1};
+	const uint64_t escaped[] = {2, 3, 2, 1};
+	const uint64_t total[] = {29, 3, 29, 1};
+
+	currPtr = src;
+	currBit = 0;
+	remaining = sizeof(src);
+	for (i = 0; i < 4; i++) {
+		for (uint64_t j = 0; j < lengths[i]; j++) {
+			ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining, words[i], 16));
+		}
+	}
+
+	ASSERT_EQ(ERR_NO_ERR, generate_run_table(&header, &table, src, sizeof(src), 16, &runs, NULL, NULL));
+	EXPECT_EQ(3u, header.uniqueWords);
+	EXPECT_EQ(2u, runs.runs);
+	EXPECT_EQ(2u, runs.bytes);
+	for (i = 0; i < 4; i++) {
+		ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &table, words[i], false));
+		EXPECT_EQ(escaped[i], *get_table_value(table.table, slot));
+	}
+	free(table.table);
+
+	ASSERT_EQ(ERR_NO_ERR, generate_run_table(&header, &table, src, sizeof(src), 16, NULL, NULL, NULL));
+	for (i = 0; i < 4; i++) {
+		ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &table, words[i], false));
+		EXPECT_EQ(total[i], *get_table_value(table.table, slot));
+	}
+	free(table.table);
+}
+
+/**
+ * Validates {@link generate_table} counts words that do not fill the last
+ * prefetch window, for both compact and tiered tables.
+ */
+TEST_F(HuffmanTest, generate_table_window) {
+	HuffmanHeader header;
+	HuffmanHashTable table;
+	uint8_t* src, *temp;
+	uint8_t bit;
+	uint64_t i, slot, size, srcSize;
+	uint64_t numWords = 3 * HUFFMAN_PREFETCH_WINDOW + 5;
+	uint8_t wordSizes[] = {32, 48};
+
+	for (uint8_t w = 0; w < 2; w++) {
+		srcSize = numWords * wordSizes[w] / 8;
+		src = (uint8_t*) calloc(srcSize + 1, 1);
+		ASSERT_NE((uint8_t*)NULL, src);
+		temp = src;
+		bit = 0;
+		size = srcSize;
+		for (i = 0; i < numWords; i++) {
+			put_bits(&temp, &bit, &size, i % 7 + 1, wordSizes[w]);
+		}
+		table.table = NULL;
+		ASSERT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSizes[w], NULL, NULL));
+		for (i = 1; i <= 7; i++) {
+			ASSERT_EQ(ERR_NO_ERR, search_table(&slot, &table, i, false));
+			EXPECT_EQ(numWords / 7 + (i <= numWords % 7), *get_table_value(table.table, slot));
+		}
+		free(src);
+		free(table.table);
+	}
+}
+
 /**
  * Validates output of {@link generate_table} with even-ended word sizes (no padding).
  */
@@ -1721,7 +2225,7 @@ TEST_F(HuffmanTest, generate_table_evens) {
 	for (i = 0; i < srcSize; i++) {
 		src[i] = 0x1B; // [0, 1, 2, 3]
 	}
-	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 	ASSERT_NE((uint64_t*)NULL, table.table);
 	for (i = 0; i < 4; i++) {
 		EXPECT_EQ(ERR_NO_ERR, search_table(&dstIdx, &table, i, false));
@@ -1756,7 +2260,7 @@ TEST_F(HuffmanTest, generate_table_evens) {
 	}
 	EXPECT_EQ(0, size);
 	EXPECT_EQ(0, bit);
-	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 	EXPECT_EQ(4, header.uniqueWords);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&dstIdx, &table, 0x0, false));
 	EXPECT_EQ(srcSize * 2, *get_table_value(table.table, dstIdx));
@@ -1786,7 +2290,7 @@ TEST_F(HuffmanTest, generate_table_evens) {
 		EXPECT_EQ(ERR_NO_ERR, put_bits(&temp, &bit, &size, val, wordSize));
 		val = (val + 1) % ((uint64_t) 1 << 16);
 	}
-	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 	EXPECT_EQ(((uint64_t) 1 << 16) + 2, header.uniqueWords);
 	EXPECT_EQ(ERR_NO_ERR, search_table(&dstIdx, &table, 0xEEEEEE, false));
 	EXPECT_EQ((uint64_t) cut1 / 3, *get_table_value(table.table, dstIdx));
@@ -1804,7 +2308,7 @@ TEST_F(HuffmanTest, generate_table_evens) {
 //	bit = 0;
 //	size = srcSize;
 //	// generate
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 
 	// Test 7: word size 24 + 6 = 30, small volume, no padding
@@ -1815,7 +2319,7 @@ TEST_F(HuffmanTest, generate_table_evens) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 
 	// Test 10: word size 56 + 3 = 59, small volume, no padding
@@ -1826,7 +2330,7 @@ TEST_F(HuffmanTest, generate_table_evens) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 }
 
@@ -1859,7 +2363,7 @@ TEST_F(HuffmanTest, generate_table_odds) {
 	for (i = 0; i < 5; i++) {
 		EXPECT_EQ(ERR_NO_ERR, put_bits(&temp, &bit, &size, i, wordSize));
 	}
-	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 	EXPECT_EQ(wordSize, header.wordSize);
 	EXPECT_EQ(wordSize - (8 - bit), header.padBits);
 	EXPECT_EQ(8, header.uniqueWords);
@@ -1883,7 +2387,7 @@ TEST_F(HuffmanTest, generate_table_odds) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 
 	// Test 6: word size 16 + 7 = 23, medium volume, padding
@@ -1894,7 +2398,7 @@ TEST_F(HuffmanTest, generate_table_odds) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 
 	// Test 8: word size 32 + 4 = 36, small volume, padding
@@ -1905,7 +2409,7 @@ TEST_F(HuffmanTest, generate_table_odds) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 
 	// Test 9: word size 48, medium volume, padding
@@ -1916,7 +2420,7 @@ TEST_F(HuffmanTest, generate_table_odds) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 
 	// Test 11: word size 16 + 1, large volume, padding
@@ -1927,7 +2431,7 @@ TEST_F(HuffmanTest, generate_table_odds) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 
 	// Test 12: word size 60, large volume, padding
@@ -1938,7 +2442,7 @@ TEST_F(HuffmanTest, generate_table_odds) {
 //	for (i = 0; i < srcSize; i++) {
 //		src[i] = 0x0;
 //	}
-//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+//	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 //	free(src);
 }
 
@@ -2152,7 +2656,7 @@ TEST_F(HuffmanTest, sort_table) {
 	for (i = 0; i < srcSize; i++) {
 		*(temp++) = (uint8_t) (rand() % 0xFF);
 	}
-	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 	free(src);
 	EXPECT_EQ(ERR_NO_ERR, sort_table(&header, &table));
 	EXPECT_TRUE(is_sorted_descending(table.table, table.size));
@@ -2168,9 +2672,2573 @@ TEST_F(HuffmanTest, sort_table) {
 	for (i = 0; i < srcSize; i++) {
 		*(temp++) = (uint8_t) (rand() % 0xFF);
 	}
-	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize));
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, wordSize, NULL, NULL));
 	free(src);
 	EXPECT_EQ(ERR_NO_ERR, sort_table(&header, &table));
 	EXPECT_TRUE(is_sorted_descending(table.table, table.size));
 	free(table.table);
 }
+
+/**
+ * Custom mapping used to test {@link huffman_register_compressor}. Uses a
+ * fixed-length code of 64 bits for every word.
+ */
+static uint64_t test_fixed_64_size(uint64_t idx, const HuffmanMapContext* ctx) {
+	return 64;
+}
+
+/**
+ * Validates error handling of {@link huffman_register_compressor}.
+ */
+TEST_F(HuffmanTest, huffman_register_compressor_errs) {
+	HuffmanCompressor noSize = {NULL, 0, NULL, NULL, NULL, NULL, NULL, NULL};
+	HuffmanCompressor custom[HUFFMAN_MAX_CUSTOM_COMPRESSORS + 1];
+
+	huffman_clear_compressors();
+	EXPECT_EQ(ERR_NULL_PTR, huffman_register_compressor(NULL));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_register_compressor(&noSize));
+
+	for (int i = 0; i < HUFFMAN_MAX_CUSTOM_COMPRESSORS + 1; i++) {
+		custom[i] = noSize;
+		custom[i].getSize = test_fixed_64_size;
+	}
+	EXPECT_EQ(ERR_NO_ERR, huffman_register_compressor(&custom[0]));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_register_compressor(&custom[0]));
+	for (int i = 1; i < HUFFMAN_MAX_CUSTOM_COMPRESSORS; i++) {
+		EXPECT_EQ(ERR_NO_ERR, huffman_register_compressor(&custom[i]));
+	}
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE,
+			huffman_register_compressor(&custom[HUFFMAN_MAX_CUSTOM_COMPRESSORS]));
+	huffman_clear_compressors();
+	EXPECT_EQ(ERR_NO_ERR,
+			huffman_register_compressor(&custom[HUFFMAN_MAX_CUSTOM_COMPRESSORS]));
+	huffman_clear_compressors();
+}
+
+/**
+ * Validates error handling of {@link huffman_compare_compressors}.
+ */
+TEST_F(HuffmanTest, huffman_compare_compressors_errs) {
+	HuffmanStats stats[4];
+	HuffmanHeader header;
+	uint8_t srcDummy[1];
+	uint64_t count = 4;
+
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compare_compressors(NULL, &count, &header, srcDummy, 1, 8));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compare_compressors(stats, NULL, &header, srcDummy, 1, 8));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compare_compressors(stats, &count, NULL, srcDummy, 1, 8));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compare_compressors(stats, &count, &header, NULL, 1, 8));
+
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compare_compressors(stats, &count, &header, srcDummy, 0, 8));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compare_compressors(stats, &count, &header, srcDummy, 1,
+			HUFFMAN_MIN_WORD_SIZE - 1));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compare_compressors(stats, &count, &header, srcDummy, 1,
+			HUFFMAN_MAX_WORD_SIZE + 1));
+}
+
+/**
+ * Validates output of {@link huffman_compare_compressors}.
+ */
+TEST_F(HuffmanTest, huffman_compare_compressors) {
+	HuffmanStats stats[HUFFMAN_MAX_WORD_SIZE + 8];
+	HuffmanStats single, best[2];
+	HuffmanHeader header;
+	HuffmanCompressor custom = {"fixed_64", 0, NULL, test_fixed_64_size, NULL, NULL, NULL, NULL};
+	uint8_t* src;
+	uint64_t i, count, srcSize;
+	uint8_t wordSize;
+	bool foundCustom;
+
+	srcSize = HUFFMAN_TEST_SMALL_VOLUME;
+	wordSize = 8;
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	// Skewed distribution over 16 words
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) ((rand() % 4 == 0) ? rand() % 16 : rand() % 2);
+	}
+
+	// Built-in mappings only: one-hot, fix-depth 0 to 4, log-depth
+	huffman_clear_compressors();
+	count = sizeof(stats) / sizeof(stats[0]);
+	EXPECT_EQ(ERR_NO_ERR, huffman_compare_compressors(stats, &count, &header, src, srcSize, wordSize));
+	EXPECT_EQ(16, header.uniqueWords);
+	EXPECT_EQ(7, count);
+	for (i = 0; i < count; i++) {
+		ASSERT_NE((const HuffmanCompressor*)NULL, stats[i].compressor);
+		if (i > 0) {
+			EXPECT_FALSE(stats_less(&stats[i], &stats[i - 1]));
+		}
+		// Must match single-mapping calculation
+		EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&single, &header, src, srcSize,
+				wordSize, stats[i].compressor, stats[i].depthParam));
+		EXPECT_EQ(single.dataSizeBytes, stats[i].dataSizeBytes);
+		EXPECT_EQ(single.dataBitsInLastByte, stats[i].dataBitsInLastByte);
+		EXPECT_EQ(single.minSizeBits, stats[i].minSizeBits);
+		EXPECT_DOUBLE_EQ(single.efficiency, stats[i].efficiency);
+		// No mapping beats the entropy bound
+		EXPECT_GE(get_stats_bits(&stats[i]), stats[i].minSizeBits);
+		EXPECT_GT(stats[i].efficiency, 0.0);
+		EXPECT_LE(stats[i].efficiency, 1.0);
+	}
+
+	// Limited capacity keeps best results
+	count = 2;
+	EXPECT_EQ(ERR_NO_ERR, huffman_compare_compressors(best, &count, &header, src, srcSize, wordSize));
+	EXPECT_EQ(2, count);
+	EXPECT_EQ(stats[0].compressor, best[0].compressor);
+	EXPECT_EQ(stats[0].depthParam, best[0].depthParam);
+	EXPECT_EQ(stats[1].compressor, best[1].compressor);
+	EXPECT_EQ(stats[1].depthParam, best[1].depthParam);
+
+	// Registered mapping is evaluated and ranked
+	EXPECT_EQ(ERR_NO_ERR, huffman_register_compressor(&custom));
+	count = sizeof(stats) / sizeof(stats[0]);
+	EXPECT_EQ(ERR_NO_ERR, huffman_compare_compressors(stats, &count, &header, src, srcSize, wordSize));
+	EXPECT_EQ(8, count);
+	foundCustom = false;
+	for (i = 0; i < count; i++) {
+		if (stats[i].compressor == &custom) {
+			foundCustom = true;
+			EXPECT_EQ(srcSize * 8, stats[i].dataSizeBytes);
+			EXPECT_EQ(0, stats[i].dataBitsInLastByte);
+		}
+	}
+	EXPECT_TRUE(foundCustom);
+	huffman_clear_compressors();
+
+	free(src);
+}
+
+/**
+ * Validates {@link one_hot_get_compressed_sizes} against
+ * {@link one_hot_get_compressed_size}.
+ */
+TEST_F(HuffmanTest, one_hot_get_compressed_sizes) {
+	uint8_t lengths[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	HuffmanMapContext ctx;
+
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &OneHot, 1000, 0));
+	EXPECT_EQ(ERR_NO_ERR, one_hot_get_compressed_sizes(lengths, 0, 200, &ctx));
+	for (uint64_t i = 0; i < 200; i++) {
+		EXPECT_EQ(one_hot_get_compressed_size(i, &ctx), lengths[i]);
+	}
+	// Sizes exceeding 255 bits cannot be expressed
+	EXPECT_EQ(ERR_INVALID_VALUE, one_hot_get_compressed_sizes(lengths, 200, 56, &ctx));
+}
+
+/**
+ * Validates {@link fix_depth_tree_get_compressed_sizes} against
+ * {@link fix_depth_tree_get_compressed_size}.
+ */
+TEST_F(HuffmanTest, fix_depth_tree_get_compressed_sizes) {
+	uint8_t lengths[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	HuffmanMapContext ctx;
+	uint64_t start;
+	uint8_t depth;
+
+	for (depth = 0; depth < 12; depth++) {
+		start = (depth < 3) ? 0 : 1000;
+		EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &FixDepthTree, 100000, depth));
+		EXPECT_EQ(ERR_NO_ERR, fix_depth_tree_get_compressed_sizes(lengths, start,
+				HUFFMAN_CODE_LENGTH_BLOCK_SIZE / 2, &ctx));
+		for (uint64_t i = 0; i < HUFFMAN_CODE_LENGTH_BLOCK_SIZE / 2; i++) {
+			EXPECT_EQ(fix_depth_tree_get_compressed_size(start + i, &ctx), lengths[i]);
+		}
+	}
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &FixDepthTree, 100000, 0));
+	EXPECT_EQ(ERR_INVALID_VALUE, fix_depth_tree_get_compressed_sizes(lengths, 1000, 16, &ctx));
+}
+
+/**
+ * Validates that {@link calculate_stats} produces the same result with and
+ * without bulk code lengths.
+ */
+TEST_F(HuffmanTest, calculate_stats_bulk) {
+	HuffmanHeader header;
+	HuffmanHashTable table;
+	HuffmanStats bulk, scalar;
+	HuffmanCompressor noBulk;
+	HuffmanMapContext ctx;
+	uint8_t* src;
+	uint64_t i, srcSize;
+	uint8_t depth;
+
+	srcSize = HUFFMAN_TEST_MEDIUM_VOLUME;
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) (rand() % 0xFF);
+	}
+	EXPECT_EQ(ERR_NO_ERR, build_sorted_table(&header, &table, src, srcSize, 12, NULL, NULL));
+
+	for (depth = 0; depth < 12; depth++) {
+		noBulk = FixDepthTree;
+		noBulk.getSizes = NULL;
+		EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &FixDepthTree, header.uniqueWords, depth));
+		calculate_stats(&bulk, &header, &table, &FixDepthTree, &ctx);
+		calculate_stats(&scalar, &header, &table, &noBulk, &ctx);
+		EXPECT_EQ(scalar.dataSizeBytes, bulk.dataSizeBytes);
+		EXPECT_EQ(scalar.dataBitsInLastByte, bulk.dataBitsInLastByte);
+	}
+	// One-hot falls back to scalar sizes past 255 bits
+	noBulk = OneHot;
+	noBulk.getSizes = NULL;
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &OneHot, header.uniqueWords, 0));
+	calculate_stats(&bulk, &header, &table, &OneHot, &ctx);
+	calculate_stats(&scalar, &header, &table, &noBulk, &ctx);
+	EXPECT_EQ(scalar.dataSizeBytes, bulk.dataSizeBytes);
+	EXPECT_EQ(scalar.dataBitsInLastByte, bulk.dataBitsInLastByte);
+
+	free(table.table);
+	free(src);
+}
+
+/**
+ * Validates {@link calculate_entropy} and the entropy results of
+ * {@link huffman_calculate_compressed_size}.
+ */
+TEST_F(HuffmanTest, calculate_entropy) {
+	HuffmanStats stats;
+	HuffmanHeader header;
+	HuffmanHashTable table;
+	uint8_t src[1024];
+	uint64_t i, minBits;
+
+	// Four equally likely words need exactly two bits each
+	for (i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t) ('a' + i % 4);
+	}
+	EXPECT_EQ(ERR_NO_ERR, build_sorted_table(&header, &table, src, sizeof(src), 8, NULL, NULL));
+	EXPECT_DOUBLE_EQ(2.0, calculate_entropy(&minBits, &header, &table));
+	EXPECT_EQ(2 * sizeof(src), minBits);
+	free(table.table);
+
+	EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&stats, &header, src, sizeof(src), 8,
+			&FixDepthTree, 2));
+	EXPECT_DOUBLE_EQ(2.0, stats.entropy);
+	EXPECT_EQ(2 * sizeof(src), stats.minSizeBits);
+	EXPECT_DOUBLE_EQ((double) stats.minSizeBits / get_stats_bits(&stats), stats.efficiency);
+
+	// 3/4 and 1/4 split
+	for (i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t) ((i % 4 == 0) ? 'b' : 'a');
+	}
+	EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&stats, &header, src, sizeof(src), 8,
+			&OneHot, 0));
+	EXPECT_NEAR(0.811278, stats.entropy, 1e-6);
+	EXPECT_EQ(831u, stats.minSizeBits);
+	EXPECT_NEAR(831.0 / 1280.0, stats.efficiency, 1e-9);
+
+	// Single word carries no information
+	memset(src, 'a', sizeof(src));
+	EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&stats, &header, src, sizeof(src), 8,
+			&OneHot, 0));
+	EXPECT_DOUBLE_EQ(0.0, stats.entropy);
+	EXPECT_EQ(0u, stats.minSizeBits);
+	EXPECT_DOUBLE_EQ(0.0, stats.efficiency);
+}
+
+/**
+ * Validates {@link huffman_init_map_context}.
+ */
+TEST_F(HuffmanTest, huffman_init_map_context) {
+	HuffmanMapContext ctx;
+
+	EXPECT_EQ(ERR_NULL_PTR, huffman_init_map_context(NULL, &FixDepthTree, 10, 3));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_init_map_context(&ctx, NULL, 10, 3));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_init_map_context(&ctx, &OneHot, 10, 1));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_init_map_context(&ctx, &FixDepthTree, 10,
+			FixDepthTree.maxDepth + 1));
+
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &FixDepthTree, 10, 3));
+	EXPECT_EQ(10, ctx.uniqueWords);
+	EXPECT_EQ(3, ctx.depth);
+	EXPECT_EQ(8, ctx.pow2);
+	EXPECT_EQ(7, ctx.mask);
+}
+
+/**
+ * Validates {@link fix_depth_tree_get_compressed_size} and
+ * {@link fix_depth_tree_get_compressed_val} against the tree definition.
+ */
+TEST_F(HuffmanTest, fix_depth_tree_mapping) {
+	HuffmanMapContext ctx;
+	uint64_t idx, pow2, expSize, expVal;
+
+	for (uint8_t depth = 0; depth < 16; depth++) {
+		EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &FixDepthTree, 1 << 20, depth));
+		pow2 = (uint64_t)1 << depth;
+		EXPECT_EQ(1, fix_depth_tree_get_compressed_size(0, &ctx));
+		EXPECT_EQ(1, fix_depth_tree_get_compressed_val(0, &ctx));
+		for (idx = 1; idx < 5000; idx++) {
+			expSize = 1 + depth + (idx + pow2 - 1) / pow2;
+			expVal = (idx % pow2 == 0) ? pow2 : pow2 * 2 - (idx % pow2);
+			EXPECT_EQ(expSize, fix_depth_tree_get_compressed_size(idx, &ctx));
+			EXPECT_EQ(expVal, fix_depth_tree_get_compressed_val(idx, &ctx));
+		}
+	}
+}
+
+/**
+ * Validates that concurrent size calculations with different depths do not
+ * interfere with each other.
+ */
+TEST_F(HuffmanTest, fix_depth_tree_concurrent) {
+	const int numThreads = 4;
+	HuffmanStats serial[numThreads], parallel[numThreads];
+	HuffmanHeader headers[numThreads];
+	std::thread* threads[numThreads];
+	uint8_t* src;
+	uint64_t i, srcSize;
+
+	srcSize = HUFFMAN_TEST_MEDIUM_VOLUME;
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) ((rand() % 8 == 0) ? rand() % 0xFF : rand() % 4);
+	}
+
+	for (int t = 0; t < numThreads; t++) {
+		EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&serial[t], &headers[t], src, srcSize,
+				10, &FixDepthTree, (uint8_t)(2 * t + 1)));
+	}
+	for (int t = 0; t < numThreads; t++) {
+		threads[t] = new std::thread([&, t]() {
+			for (int rep = 0; rep < 4; rep++) {
+				huffman_calculate_compressed_size(&parallel[t], &headers[t], src, srcSize,
+						10, &FixDepthTree, (uint8_t)(2 * t + 1));
+			}
+		});
+	}
+	for (int t = 0; t < numThreads; t++) {
+		threads[t]->join();
+		delete threads[t];
+		EXPECT_EQ(serial[t].dataSizeBytes, parallel[t].dataSizeBytes);
+		EXPECT_EQ(serial[t].dataBitsInLastByte, parallel[t].dataBitsInLastByte);
+	}
+
+	free(src);
+}
+
+/**
+ * Validates {@link log_depth_tree_get_compressed_size},
+ * {@link log_depth_tree_get_compressed_sizes} and
+ * {@link log_depth_tree_get_compressed_val} against the Elias-gamma definition.
+ */
+TEST_F(HuffmanTest, log_depth_tree_mapping) {
+	uint8_t lengths[HUFFMAN_CODE_LENGTH_BLOCK_SIZE];
+	HuffmanMapContext ctx;
+	uint64_t idx, bits;
+
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &LogDepthTree, (uint64_t)1 << 60, 0));
+	EXPECT_EQ(1, log_depth_tree_get_compressed_size(0, &ctx));
+	EXPECT_EQ(3, log_depth_tree_get_compressed_size(1, &ctx));
+	EXPECT_EQ(3, log_depth_tree_get_compressed_size(2, &ctx));
+	EXPECT_EQ(5, log_depth_tree_get_compressed_size(3, &ctx));
+	EXPECT_EQ(119, log_depth_tree_get_compressed_size(((uint64_t)1 << 59) - 1, &ctx));
+	for (idx = 0; idx < 5000; idx++) {
+		bits = 0;
+		while (((idx + 1) >> bits) > 1) {
+			bits++;
+		}
+		EXPECT_EQ(2 * bits + 1, log_depth_tree_get_compressed_size(idx, &ctx));
+		EXPECT_EQ(idx + 1, log_depth_tree_get_compressed_val(idx, &ctx));
+	}
+
+	EXPECT_EQ(ERR_NO_ERR, log_depth_tree_get_compressed_sizes(lengths, 1000,
+			HUFFMAN_CODE_LENGTH_BLOCK_SIZE, &ctx));
+	for (idx = 0; idx < HUFFMAN_CODE_LENGTH_BLOCK_SIZE; idx++) {
+		EXPECT_EQ(log_depth_tree_get_compressed_size(1000 + idx, &ctx), lengths[idx]);
+	}
+}
+
+/**
+ * Writes a value using a mapping, splitting values wider than 64 bits into
+ * leading zeros and the value itself.
+ */
+static void put_mapped(uint8_t** dst, uint8_t* start, uint64_t* dstSize,
+		const HuffmanCompressor* compressor, uint64_t idx, const HuffmanMapContext* ctx) {
+	uint64_t size = compressor->getSize(idx, ctx);
+	uint64_t val = compressor->getVal(idx, ctx);
+	while (size > 64) {
+		uint8_t zeros = (size - 64 > 64) ? 64 : (uint8_t)(size - 64);
+		ASSERT_EQ(ERR_NO_ERR, put_bits(dst, start, dstSize, 0, zeros));
+		size -= zeros;
+	}
+	ASSERT_EQ(ERR_NO_ERR, put_bits(dst, start, dstSize, val, (uint8_t)size));
+}
+
+/**
+ * Validates {@link log_depth_tree_parse_compressed_idx}.
+ */
+TEST_F(HuffmanTest, log_depth_tree_parse_compressed_idx) {
+	uint8_t buf[4096];
+	uint8_t *wr, *rd;
+	uint8_t wrBit, rdBit;
+	uint64_t wrSize, rdSize, idx, i;
+	uint64_t indices[512];
+	HuffmanMapContext ctx;
+
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &LogDepthTree, (uint64_t)1 << 60, 0));
+
+	// Small indices, long indices (two-window path) and maximum index
+	for (i = 0; i < 256; i++) {
+		indices[i] = i;
+	}
+	for (; i < 511; i++) {
+		indices[i] = ((((uint64_t)rand() << 31) ^ (uint64_t)rand()) & (((uint64_t)1 << 60) - 1)) >> (rand() % 60);
+	}
+	indices[511] = ((uint64_t)1 << 60) - 1;
+
+	memset(buf, 0x00, sizeof(buf));
+	wr = buf;
+	wrBit = 0;
+	wrSize = sizeof(buf);
+	for (i = 0; i < 512; i++) {
+		put_mapped(&wr, &wrBit, &wrSize, &LogDepthTree, indices[i], &ctx);
+	}
+
+	rd = buf;
+	rdBit = 0;
+	rdSize = (uint64_t)(wr - buf) + (wrBit ? 1 : 0);
+	for (i = 0; i < 512; i++) {
+		ASSERT_EQ(ERR_NO_ERR, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, &ctx));
+		EXPECT_EQ(indices[i], idx);
+	}
+	EXPECT_EQ(wr, rd);
+	EXPECT_EQ(wrBit, rdBit);
+
+	// Errors
+	rd = buf;
+	rdBit = 8;
+	EXPECT_EQ(ERR_NULL_PTR, log_depth_tree_parse_compressed_idx(NULL, &rd, &rdBit, &rdSize, &ctx));
+	EXPECT_EQ(ERR_NULL_PTR, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, &ctx));
+
+	// Truncated value: 00000001 xxxxxxx with only 1 byte
+	buf[0] = 0x01;
+	rdBit = 4;
+	rdSize = 1;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, &ctx));
+	rdBit = 0;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, &ctx));
+
+	// Prefix longer than any valid index
+	memset(buf, 0x00, 16);
+	rdSize = 16;
+	EXPECT_EQ(ERR_INVALID_DATA, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, &ctx));
+
+	// Index beyond number of unique words
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &LogDepthTree, 2, 0));
+	buf[0] = 0x60; // 011 -> index 2
+	EXPECT_EQ(ERR_INVALID_DATA, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, &ctx));
+	buf[0] = 0x40; // 010 -> index 1
+	EXPECT_EQ(ERR_NO_ERR, log_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &rdSize, &ctx));
+	EXPECT_EQ(1, idx);
+	EXPECT_EQ(3, rdBit);
+}
+
+/**
+ * Encodes indices with a mapping and verifies that single and bulk parse
+ * functions recover them.
+ */
+static void check_mapping_round_trip(const HuffmanCompressor* compressor, uint8_t depth,
+		uint64_t uniqueWords, uint64_t* indices, uint64_t count) {
+	static uint8_t buf[1 << 16];
+	uint64_t parsed[1024];
+	uint8_t *wr, *rd;
+	uint8_t wrBit, rdBit;
+	uint64_t wrSize, rdSize, idx, i;
+	HuffmanMapContext ctx;
+
+	ASSERT_LE(count, 1024);
+	ASSERT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, compressor, uniqueWords, depth));
+	memset(buf, 0x00, sizeof(buf));
+	wr = buf;
+	wrBit = 0;
+	wrSize = sizeof(buf);
+	for (i = 0; i < count; i++) {
+		put_mapped(&wr, &wrBit, &wrSize, compressor, indices[i], &ctx);
+	}
+
+	// Single
+	rd = buf;
+	rdBit = 0;
+	rdSize = (uint64_t)(wr - buf) + (wrBit ? 1 : 0);
+	for (i = 0; i < count; i++) {
+		ASSERT_EQ(ERR_NO_ERR, compressor->parseIdx(&idx, &rd, &rdBit, &rdSize, &ctx));
+		EXPECT_EQ(indices[i], idx);
+	}
+	EXPECT_EQ(wr, rd);
+	EXPECT_EQ(wrBit, rdBit);
+
+	// Bulk
+	rd = buf;
+	rdBit = 0;
+	rdSize = (uint64_t)(wr - buf) + (wrBit ? 1 : 0);
+	ASSERT_EQ(ERR_NO_ERR, huffman_parse_compressed_idx_block(parsed, count, &rd, &rdBit, &rdSize,
+			compressor, &ctx));
+	for (i = 0; i < count; i++) {
+		EXPECT_EQ(indices[i], parsed[i]);
+	}
+	EXPECT_EQ(wr, rd);
+	EXPECT_EQ(wrBit, rdBit);
+
+	// Truncated block leaves position untouched
+	if ((uint64_t)(wr - buf) > 0) {
+		rd = buf;
+		rdBit = 0;
+		rdSize = (uint64_t)(wr - buf) - ((wrBit == 0) ? 1 : 0);
+		EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_parse_compressed_idx_block(parsed, count, &rd,
+				&rdBit, &rdSize, compressor, &ctx));
+		EXPECT_EQ(buf, rd);
+		EXPECT_EQ(0, rdBit);
+	}
+}
+
+/**
+ * Validates {@link one_hot_parse_compressed_idx} and
+ * {@link one_hot_parse_compressed_idx_bulk}.
+ */
+TEST_F(HuffmanTest, one_hot_parse_compressed_idx) {
+	uint64_t indices[1024];
+	uint64_t i, idx, size;
+	uint8_t buf[16];
+	uint8_t* rd;
+	uint8_t rdBit;
+	HuffmanMapContext ctx;
+
+	// Short codes
+	for (i = 0; i < 1024; i++) {
+		indices[i] = rand() % 64;
+	}
+	check_mapping_round_trip(&OneHot, 0, 64, indices, 1024);
+	// Codes longer than one window
+	for (i = 0; i < 64; i++) {
+		indices[i] = (i % 2) ? rand() % 200 : 64 + rand() % 136;
+	}
+	check_mapping_round_trip(&OneHot, 0, 200, indices, 64);
+
+	// Index beyond number of unique words
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &OneHot, 3, 0));
+	memset(buf, 0x00, sizeof(buf));
+	buf[0] = 0x10; // 0001 -> index 3
+	rd = buf;
+	rdBit = 0;
+	size = sizeof(buf);
+	EXPECT_EQ(ERR_INVALID_DATA, one_hot_parse_compressed_idx(&idx, &rd, &rdBit, &size, &ctx));
+	EXPECT_EQ(buf, rd);
+	buf[0] = 0x20; // 001 -> index 2
+	EXPECT_EQ(ERR_NO_ERR, one_hot_parse_compressed_idx(&idx, &rd, &rdBit, &size, &ctx));
+	EXPECT_EQ(2, idx);
+	EXPECT_EQ(3, rdBit);
+
+	// Errors
+	EXPECT_EQ(ERR_NULL_PTR, one_hot_parse_compressed_idx(NULL, &rd, &rdBit, &size, &ctx));
+	EXPECT_EQ(ERR_NULL_PTR, one_hot_parse_compressed_idx(&idx, &rd, &rdBit, &size, NULL));
+	rdBit = 8;
+	EXPECT_EQ(ERR_INVALID_VALUE, one_hot_parse_compressed_idx(&idx, &rd, &rdBit, &size, &ctx));
+}
+
+/**
+ * Validates {@link fix_depth_tree_parse_compressed_idx} and
+ * {@link fix_depth_tree_parse_compressed_idx_bulk}.
+ */
+TEST_F(HuffmanTest, fix_depth_tree_parse_compressed_idx) {
+	uint64_t indices[1024];
+	uint64_t i, idx, size, uniqueWords;
+	uint8_t buf[16];
+	uint8_t* rd;
+	uint8_t rdBit;
+	uint8_t depth;
+	HuffmanMapContext ctx;
+
+	for (depth = 0; depth <= 40; depth++) {
+		// Keep depth 0 (one-hot) codes short enough to fit the buffer
+		uniqueWords = (depth < 4) ? 100 : ((uint64_t)1 << (depth + 6));
+		for (i = 0; i < 1024; i++) {
+			indices[i] = (i < 8) ? i : (((uint64_t)rand() << 31) ^ (uint64_t)rand()) % uniqueWords;
+		}
+		indices[1023] = uniqueWords - 1;
+		check_mapping_round_trip(&FixDepthTree, depth, uniqueWords, indices, 1024);
+	}
+
+	// Index beyond number of unique words
+	EXPECT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, &FixDepthTree, 3, 1));
+	memset(buf, 0x00, sizeof(buf));
+	buf[0] = 0x4C; // 010 -> block 1, suffix 0 -> index 2; 011 -> index 1
+	rd = buf;
+	rdBit = 0;
+	size = sizeof(buf);
+	EXPECT_EQ(ERR_NO_ERR, fix_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &size, &ctx));
+	EXPECT_EQ(2, idx);
+	EXPECT_EQ(3, rdBit);
+	EXPECT_EQ(ERR_NO_ERR, fix_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &size, &ctx));
+	EXPECT_EQ(1, idx);
+	buf[0] = 0x10; // 001 0 -> block 2, suffix 0 -> index 4
+	rd = buf;
+	rdBit = 0;
+	EXPECT_EQ(ERR_INVALID_DATA, fix_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &size, &ctx));
+	EXPECT_EQ(buf, rd);
+	EXPECT_EQ(0, rdBit);
+
+	// Errors
+	EXPECT_EQ(ERR_NULL_PTR, fix_depth_tree_parse_compressed_idx(NULL, &rd, &rdBit, &size, &ctx));
+	rdBit = 8;
+	EXPECT_EQ(ERR_INVALID_VALUE, fix_depth_tree_parse_compressed_idx(&idx, &rd, &rdBit, &size, &ctx));
+}
+
+/**
+ * Validates {@link log_depth_tree_parse_compressed_idx_bulk}.
+ */
+TEST_F(HuffmanTest, log_depth_tree_parse_compressed_idx_bulk) {
+	uint64_t indices[1024];
+	for (uint64_t i = 0; i < 1024; i++) {
+		indices[i] = ((((uint64_t)rand() << 31) ^ (uint64_t)rand()) & (((uint64_t)1 << 60) - 1))
+				>> (rand() % 60);
+	}
+	check_mapping_round_trip(&LogDepthTree, 0, (uint64_t)1 << 60, indices, 1024);
+}
+/**
+ * Validates {@link huffman_parse_compressed_idx_streams}, with and without
+ * {@link HuffmanCompressor#parseIdxStreams}.
+ */
+TEST_F(HuffmanTest, huffman_parse_compressed_idx_streams) {
+	const uint64_t count = 1000;
+	const uint64_t uniqueWords = (uint64_t)1 << 12;
+	const HuffmanCompressor* mappings[] = {&OneHot, &FixDepthTree, &LogDepthTree};
+	const uint8_t depths[] = {0, 6, 0};
+	uint64_t indices[count], parsed[count];
+	uint8_t buf[HUFFMAN_MAX_STREAMS][4096];
+	uint8_t *ptrs[HUFFMAN_MAX_STREAMS], *rd[HUFFMAN_MAX_STREAMS];
+	uint8_t starts[HUFFMAN_MAX_STREAMS], rdBit[HUFFMAN_MAX_STREAMS];
+	uint64_t sizes[HUFFMAN_MAX_STREAMS];
+	uint64_t i, m, s;
+	HuffmanMapContext ctx;
+	HuffmanCompressor fallback;
+
+	for (m = 0; m < sizeof(mappings) / sizeof(mappings[0]); m++) {
+		ASSERT_EQ(ERR_NO_ERR, huffman_init_map_context(&ctx, mappings[m], uniqueWords, depths[m]));
+		for (i = 0; i < count; i++) {
+			indices[i] = (mappings[m] == &OneHot) ? rand() % 24 : rand() % (uniqueWords >> (rand() % 12));
+		}
+		fallback = *mappings[m];
+		fallback.parseIdxStreams = NULL;
+		for (uint8_t numStreams = 1; numStreams <= HUFFMAN_MAX_STREAMS; numStreams++) {
+			for (s = 0; s < numStreams; s++) {
+				ptrs[s] = buf[s];
+				starts[s] = 0;
+				sizes[s] = sizeof(buf[s]);
+			}
+			for (i = 0; i < count; i++) {
+				s = i % numStreams;
+				ASSERT_EQ(ERR_NO_ERR, put_code(&ptrs[s], &starts[s], &sizes[s],
+						mappings[m]->getVal(indices[i], &ctx), mappings[m]->getSize(indices[i], &ctx)));
+			}
+
+			for (int f = 0; f < 2; f++) {
+				for (s = 0; s < numStreams; s++) {
+					rd[s] = buf[s];
+					rdBit[s] = 0;
+					sizes[s] = (uint64_t) (ptrs[s] - buf[s]) + (starts[s] > 0);
+				}
+				memset(parsed, 0xFF, sizeof(parsed));
+				ASSERT_EQ(ERR_NO_ERR, huffman_parse_compressed_idx_streams(parsed, count, numStreams,
+						rd, rdBit, sizes, f ? &fallback : mappings[m], &ctx))
+						<< mappings[m]->name << " streams " << (int)numStreams;
+				EXPECT_EQ(0, memcmp(indices, parsed, sizeof(indices)))
+						<< mappings[m]->name << " streams " << (int)numStreams;
+				for (s = 0; s < numStreams; s++) {
+					EXPECT_EQ(ptrs[s], rd[s]);
+					EXPECT_EQ(starts[s], rdBit[s]);
+				}
+
+				// Truncated last stream leaves every position unchanged
+				for (s = 0; s < numStreams; s++) {
+					rd[s] = buf[s];
+					rdBit[s] = 0;
+					sizes[s] = (uint64_t) (ptrs[s] - buf[s]) + (starts[s] > 0);
+				}
+				sizes[numStreams - 1] /= 2;
+				EXPECT_NE(ERR_NO_ERR, huffman_parse_compressed_idx_streams(parsed, count, numStreams,
+						rd, rdBit, sizes, f ? &fallback : mappings[m], &ctx));
+				for (s = 0; s < numStreams; s++) {
+					EXPECT_EQ(buf[s], rd[s]);
+					EXPECT_EQ(0, rdBit[s]);
+				}
+			}
+		}
+	}
+
+	// Invalid parameters
+	EXPECT_EQ(ERR_NULL_PTR, huffman_parse_compressed_idx_streams(parsed, count, 4, NULL, rdBit,
+			sizes, &FixDepthTree, &ctx));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_parse_compressed_idx_streams(parsed, count, 4, rd, rdBit,
+			sizes, NULL, &ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_parse_compressed_idx_streams(parsed, count, 0, rd, rdBit,
+			sizes, &FixDepthTree, &ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_parse_compressed_idx_streams(parsed, count,
+			HUFFMAN_MAX_STREAMS + 1, rd, rdBit, sizes, &FixDepthTree, &ctx));
+}
+
+
+/**
+ * Validates {@link huffman_context_init}, {@link huffman_context_reset} and
+ * {@link huffman_context_free}.
+ */
+TEST_F(HuffmanTest, huffman_context) {
+	HuffmanContext ctx;
+	HuffmanContextMark mark;
+	uint64_t* table;
+
+	// Null contexts are ignored
+	huffman_context_init(NULL);
+	huffman_context_reset(NULL);
+	huffman_context_free(NULL);
+
+	huffman_context_init(&ctx);
+	EXPECT_EQ((uint8_t*)NULL, ctx.arena);
+	EXPECT_EQ(0u, ctx.arenaSize);
+	EXPECT_EQ(0u, ctx.numAllocs);
+
+	// Empty arena overflows to heap, then grows on leave
+	context_enter(&mark, &ctx);
+	table = table_alloc(&ctx, 100);
+	ASSERT_NE((uint64_t*)NULL, table);
+	EXPECT_EQ(0u, table[0]);
+	EXPECT_EQ(0u, table[199]);
+	EXPECT_EQ(1600u, ctx.overflowBytes);
+	EXPECT_EQ(1u, ctx.numAllocs);
+	context_leave(&ctx, &mark);
+	EXPECT_EQ((void*)NULL, ctx.overflow);
+	EXPECT_EQ(0u, ctx.overflowBytes);
+	EXPECT_EQ(1600u, ctx.arenaSize);
+	EXPECT_EQ(2u, ctx.numAllocs);
+
+	// Same demand now served from arena; last allocation rewinds on free
+	context_enter(&mark, &ctx);
+	table = table_alloc(&ctx, 60);
+	EXPECT_EQ((uint64_t*)ctx.arena, table);
+	EXPECT_EQ(960u, ctx.arenaUsed);
+	table_free(&ctx, table, 60);
+	EXPECT_EQ(0u, ctx.arenaUsed);
+	table = table_alloc(&ctx, 100);
+	EXPECT_EQ((uint64_t*)ctx.arena, table);
+	context_leave(&ctx, &mark);
+	EXPECT_EQ(0u, ctx.arenaUsed);
+	EXPECT_EQ(2u, ctx.numAllocs);
+
+	// Reset keeps arena but clears statistics
+	huffman_context_reset(&ctx);
+	EXPECT_EQ(1600u, ctx.arenaSize);
+	EXPECT_EQ(1600u, ctx.arenaPeak);
+	EXPECT_EQ(0u, ctx.numAllocs);
+
+	huffman_context_free(&ctx);
+	EXPECT_EQ((uint8_t*)NULL, ctx.arena);
+	EXPECT_EQ(0u, ctx.arenaSize);
+}
+
+/**
+ * Validates that repeated calls sharing a {@link HuffmanContext} match the
+ * heap-allocating calls and stop allocating after warm-up.
+ */
+TEST_F(HuffmanTest, huffman_context_reuse) {
+	HuffmanContext ctx;
+	HuffmanStats expected, actual;
+	HuffmanStats expectedRanked[8], actualRanked[8];
+	HuffmanHeader header;
+	uint64_t expectedCount, actualCount;
+	uint8_t *src, *dst;
+	uint64_t i, srcSize, dstSize, allocs;
+
+	srcSize = HUFFMAN_TEST_MEDIUM_VOLUME;
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	dst = (uint8_t*) malloc(2 * srcSize);
+	ASSERT_NE((uint8_t*)NULL, dst);
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) ((rand() % 8 == 0) ? rand() % 0xFF : rand() % 4);
+	}
+
+	huffman_context_init(&ctx);
+	EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&expected, &header, src, srcSize,
+			12, &FixDepthTree, 3));
+	expectedCount = 8;
+	EXPECT_EQ(ERR_NO_ERR, huffman_compare_compressors(expectedRanked, &expectedCount,
+			&header, src, srcSize, 12));
+
+	// Warm-up
+	EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size_ctx(&actual, &header, src, srcSize,
+			12, &FixDepthTree, 3, &ctx));
+	dstSize = 2 * srcSize;
+	EXPECT_EQ(ERR_NO_ERR, huffman_compress_ctx(dst, &dstSize, &header, src, srcSize, 12, &ctx));
+	EXPECT_LT(0u, ctx.numAllocs);
+	EXPECT_EQ(0u, ctx.arenaUsed);
+	allocs = ctx.numAllocs;
+
+	for (int rep = 0; rep < 4; rep++) {
+		EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size_ctx(&actual, &header, src, srcSize,
+				12, &FixDepthTree, 3, &ctx));
+		EXPECT_EQ(expected.dataSizeBytes, actual.dataSizeBytes);
+		EXPECT_EQ(expected.dataBitsInLastByte, actual.dataBitsInLastByte);
+
+		actualCount = 8;
+		EXPECT_EQ(ERR_NO_ERR, huffman_compare_compressors_ctx(actualRanked, &actualCount,
+				&header, src, srcSize, 12, &ctx));
+		ASSERT_EQ(expectedCount, actualCount);
+		for (i = 0; i < actualCount; i++) {
+			EXPECT_EQ(expectedRanked[i].dataSizeBytes, actualRanked[i].dataSizeBytes);
+			EXPECT_EQ(expectedRanked[i].depthParam, actualRanked[i].depthParam);
+		}
+
+		dstSize = 2 * srcSize;
+		EXPECT_EQ(ERR_NO_ERR, huffman_compress_ctx(dst, &dstSize, &header, src, srcSize, 12, &ctx));
+		EXPECT_EQ(allocs, ctx.numAllocs);
+		EXPECT_EQ(0u, ctx.arenaUsed);
+	}
+
+	// Errors release arena as well
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_calculate_compressed_size_ctx(&actual, &header, src, srcSize,
+			12, &OneHot, 1, &ctx));
+	EXPECT_EQ(0u, ctx.arenaUsed);
+
+	huffman_context_free(&ctx);
+	free(dst);
+	free(src);
+}
+
+/**
+ * Allocation statistics gathered by {@link counting_alloc}.
+ */
+typedef struct {
+	uint64_t allocs;
+	uint64_t reallocs;
+	uint64_t frees;
+	uint64_t liveBytes;
+	uint64_t maxAlign;
+} TestAllocStats;
+
+static void* counting_alloc(uint64_t size, uint64_t align, void* user) {
+	TestAllocStats* stats = (TestAllocStats*) user;
+	stats->allocs++;
+	stats->liveBytes += size;
+	stats->maxAlign = (align > stats->maxAlign) ? align : stats->maxAlign;
+	return default_alloc(size, align, NULL);
+}
+
+static void* counting_realloc(void* ptr, uint64_t oldSize, uint64_t newSize,
+		uint64_t align, void* user) {
+	TestAllocStats* stats = (TestAllocStats*) user;
+	stats->reallocs++;
+	stats->liveBytes += newSize - oldSize;
+	stats->maxAlign = (align > stats->maxAlign) ? align : stats->maxAlign;
+	return default_realloc(ptr, oldSize, newSize, align, NULL);
+}
+
+static void counting_free(void* ptr, uint64_t size, void* user) {
+	TestAllocStats* stats = (TestAllocStats*) user;
+	stats->frees++;
+	stats->liveBytes -= size;
+	default_free(ptr, size, NULL);
+}
+
+/**
+ * Validates {@link huffman_context_init_allocator} and that all context
+ * allocations are routed through the provided callbacks.
+ */
+TEST_F(HuffmanTest, huffman_context_init_allocator) {
+	TestAllocStats stats = {0, 0, 0, 0, 0};
+	HuffmanAllocator allocator = {counting_alloc, counting_realloc, counting_free, &stats};
+	HuffmanAllocator incomplete;
+	HuffmanContext ctx;
+	HuffmanContextMark mark;
+	HuffmanStats expected, actual;
+	HuffmanHeader header;
+	uint64_t* table;
+	uint8_t* src;
+	uint64_t i, srcSize;
+	const uint64_t hugeEntries = HUFFMAN_HUGE_PAGE_SIZE / (2 * sizeof(uint64_t));
+
+	// Invalid parameters
+	EXPECT_EQ(ERR_NULL_PTR, huffman_context_init_allocator(NULL, &allocator));
+	incomplete = allocator;
+	incomplete.allocate = NULL;
+	EXPECT_EQ(ERR_NULL_PTR, huffman_context_init_allocator(&ctx, &incomplete));
+	incomplete = allocator;
+	incomplete.release = NULL;
+	EXPECT_EQ(ERR_NULL_PTR, huffman_context_init_allocator(&ctx, &incomplete));
+
+	// Null allocator uses default
+	EXPECT_EQ(ERR_NO_ERR, huffman_context_init_allocator(&ctx, NULL));
+	EXPECT_TRUE(ctx.allocator.allocate == default_alloc);
+	huffman_context_free(&ctx);
+
+	// Large tables are huge-page aligned, both with and without context
+	table = table_alloc(NULL, hugeEntries);
+	ASSERT_NE((uint64_t*)NULL, table);
+	EXPECT_EQ(0u, (uintptr_t)table % HUFFMAN_HUGE_PAGE_SIZE);
+	table_free(NULL, table, hugeEntries);
+
+	EXPECT_EQ(ERR_NO_ERR, huffman_context_init_allocator(&ctx, &allocator));
+	context_enter(&mark, &ctx);
+	ASSERT_NE((uint64_t*)NULL, table_alloc(&ctx, 4));
+	table = table_alloc(&ctx, hugeEntries);
+	ASSERT_NE((uint64_t*)NULL, table);
+	EXPECT_EQ(0u, (uintptr_t)table % HUFFMAN_HUGE_PAGE_SIZE);
+	EXPECT_EQ(HUFFMAN_HUGE_PAGE_SIZE, stats.maxAlign);
+	EXPECT_EQ(2u, stats.allocs);
+	context_leave(&ctx, &mark);
+	EXPECT_EQ(2u, stats.frees);
+	EXPECT_EQ(0u, (uintptr_t)ctx.arena % HUFFMAN_HUGE_PAGE_SIZE);
+
+	// Same pattern now fits in arena, including alignment padding
+	context_enter(&mark, &ctx);
+	ASSERT_NE((uint64_t*)NULL, table_alloc(&ctx, 4));
+	table = table_alloc(&ctx, hugeEntries);
+	EXPECT_EQ(0u, (uintptr_t)table % HUFFMAN_HUGE_PAGE_SIZE);
+	EXPECT_TRUE((uint8_t*)table >= ctx.arena && (uint8_t*)table < ctx.arena + ctx.arenaSize);
+
+	// Releasing in reverse order rewinds the padding too
+	table_free(&ctx, table, hugeEntries);
+	EXPECT_EQ(4 * 2 * sizeof(uint64_t), ctx.arenaUsed);
+	EXPECT_EQ(0u, ctx.padOffset);
+	EXPECT_EQ(table, table_alloc(&ctx, hugeEntries));
+	table_free(&ctx, table, hugeEntries);
+	table_free(&ctx, (uint64_t*) ctx.arena, 4);
+	EXPECT_EQ(0u, ctx.arenaUsed);
+	context_leave(&ctx, &mark);
+	EXPECT_EQ(3u, stats.allocs);
+	huffman_context_free(&ctx);
+	EXPECT_EQ(0u, stats.liveBytes);
+
+	// Full calculation with custom allocator matches default
+	srcSize = HUFFMAN_TEST_SMALL_VOLUME;
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) rand();
+	}
+	EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&expected, &header, src, srcSize,
+			16, &LogDepthTree, 0));
+	EXPECT_EQ(ERR_NO_ERR, huffman_context_init_allocator(&ctx, &allocator));
+	for (int rep = 0; rep < 3; rep++) {
+		EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size_ctx(&actual, &header, src, srcSize,
+				16, &LogDepthTree, 0, &ctx));
+		EXPECT_EQ(expected.dataSizeBytes, actual.dataSizeBytes);
+		EXPECT_EQ(expected.dataBitsInLastByte, actual.dataBitsInLastByte);
+		if (rep == 0) {
+			EXPECT_LT(3u, stats.allocs + stats.reallocs);
+			i = stats.allocs + stats.reallocs;
+		}
+	}
+	EXPECT_EQ(i, stats.allocs + stats.reallocs);
+	huffman_context_free(&ctx);
+	EXPECT_EQ(0u, stats.liveBytes);
+
+	free(src);
+}
+
+/**
+ * Guard kept before every block from {@link misaligned_alloc}.
+ */
+#define TEST_ALLOC_CANARY (uint64_t) 0x5AFE5AFE5AFE5AFE
+
+/**
+ * Allocates memory only 8-byte aligned, ignoring the alignment requested, with
+ * {@link TEST_ALLOC_CANARY} in the 8 bytes before it.
+ */
+static void* misaligned_alloc(uint64_t size, uint64_t align, void* user) {
+	uint64_t* block = (uint64_t*) malloc(size + 3 * sizeof(uint64_t));
+	uint64_t* ptr = block;
+	if (!block) {
+		return NULL;
+	}
+	if ((uintptr_t) &ptr[2] % 16 == 0) {
+		ptr++;
+	}
+	ptr[0] = (uint64_t) (uintptr_t) block;
+	ptr[1] = TEST_ALLOC_CANARY;
+	return &ptr[2];
+}
+
+static void misaligned_free(void* ptr, uint64_t size, void* user) {
+	uint64_t* block = (uint64_t*) ptr;
+	EXPECT_EQ(TEST_ALLOC_CANARY, block[-1]);
+	free((void*) (uintptr_t) block[-2]);
+}
+
+/**
+ * Validates that {@link context_alloc} keeps its padding headers within the
+ * arena when the allocator treats alignment as a hint.
+ */
+TEST_F(HuffmanTest, context_alloc_misaligned) {
+	HuffmanAllocator allocator = {misaligned_alloc, NULL, misaligned_free, NULL};
+	HuffmanContext ctx;
+	HuffmanContextMark mark;
+	HuffmanStats actual;
+	HuffmanHeader header;
+	uint64_t *a, *b;
+	uint64_t i;
+	uint8_t src[HUFFMAN_TEST_SMALL_VOLUME];
+
+	// Grow arena until the pattern fits, padding included
+	EXPECT_EQ(ERR_NO_ERR, huffman_context_init_allocator(&ctx, &allocator));
+	for (int rep = 0; rep < 3; rep++) {
+		context_enter(&mark, &ctx);
+		ASSERT_NE((uint64_t*)NULL, table_alloc(&ctx, 4));
+		ASSERT_NE((uint64_t*)NULL, table_alloc(&ctx, 4));
+		context_leave(&ctx, &mark);
+	}
+	EXPECT_EQ(8u, (uintptr_t)ctx.arena % 16);
+
+	// Padding holds its header, and is rewound on release
+	context_enter(&mark, &ctx);
+	a = table_alloc(&ctx, 4);
+	ASSERT_NE((uint64_t*)NULL, a);
+	EXPECT_EQ(0u, (uintptr_t)a % 16);
+	EXPECT_TRUE((uint8_t*)a >= ctx.arena + 2 * sizeof(uint64_t));
+	EXPECT_NE(0u, ctx.padOffset);
+	for (i = 0; i < 8; i++) {
+		a[i] = i;
+	}
+	b = table_alloc(&ctx, 4);
+	ASSERT_NE((uint64_t*)NULL, b);
+	EXPECT_TRUE((uint8_t*)b >= ctx.arena && (uint8_t*)b < ctx.arena + ctx.arenaSize);
+	for (i = 0; i < 8; i++) {
+		EXPECT_EQ(i, a[i]);
+	}
+	table_free(&ctx, b, 4);
+	table_free(&ctx, a, 4);
+	EXPECT_EQ(0u, ctx.arenaUsed);
+	EXPECT_EQ(0u, ctx.padOffset);
+	context_leave(&ctx, &mark);
+
+	// Full calculation
+	for (i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t) rand();
+	}
+	for (int rep = 0; rep < 3; rep++) {
+		EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size_ctx(&actual, &header, src,
+				sizeof(src), 16, &LogDepthTree, 0, &ctx));
+	}
+	huffman_context_free(&ctx);
+}
+
+/**
+ * Validates that {@link context_free} releases overflow blocks immediately and
+ * that {@link context_repack} moves kept allocations down over released ones.
+ */
+TEST_F(HuffmanTest, context_repack) {
+	TestAllocStats stats = {0, 0, 0, 0, 0};
+	HuffmanAllocator allocator = {counting_alloc, counting_realloc, counting_free, &stats};
+	HuffmanContext ctx;
+	HuffmanContextMark mark;
+	uint64_t *a, *b, *c;
+	uint64_t i;
+
+	// Overflow blocks are released when freed, the rest on return
+	EXPECT_EQ(ERR_NO_ERR, huffman_context_init_allocator(&ctx, &allocator));
+	context_enter(&mark, &ctx);
+	a = table_alloc(&ctx, 16);
+	b = table_alloc(&ctx, 16);
+	ASSERT_NE((uint64_t*)NULL, a);
+	ASSERT_NE((uint64_t*)NULL, b);
+	EXPECT_EQ(2u, stats.allocs);
+	EXPECT_EQ(2 * 16 * 2 * sizeof(uint64_t), ctx.overflowBytes);
+	table_free(&ctx, a, 16);
+	EXPECT_EQ(1u, stats.frees);
+	EXPECT_EQ(16 * 2 * sizeof(uint64_t), ctx.overflowBytes);
+	context_leave(&ctx, &mark);
+	EXPECT_EQ(2u, stats.frees);
+	EXPECT_EQ(0u, ctx.overflowBytes);
+	EXPECT_EQ(2 * 16 * 2 * sizeof(uint64_t), ctx.arenaSize);
+
+	// Kept table moves down over released one with its contents
+	context_enter(&mark, &ctx);
+	a = table_alloc(&ctx, 16);
+	b = table_alloc(&ctx, 8);
+	for (i = 0; i < 2 * 8; i++) {
+		b[i] = i + 1;
+	}
+	HuffmanRepack blocks[2] = {
+		{(void**) &b, 8 * 2 * sizeof(uint64_t), 8 * 2 * sizeof(uint64_t)},
+		{(void**) &a, 16 * 2 * sizeof(uint64_t), 0}
+	};
+	EXPECT_EQ(ERR_NO_ERR, context_repack(&ctx, blocks, 2));
+	EXPECT_EQ((uint64_t*)NULL, a);
+	EXPECT_EQ((uint64_t*) ctx.arena, b);
+	EXPECT_EQ(8 * 2 * sizeof(uint64_t), ctx.arenaUsed);
+	for (i = 0; i < 2 * 8; i++) {
+		EXPECT_EQ(i + 1, b[i]);
+	}
+
+	// Most recent allocation grows in place
+	c = table_alloc(&ctx, 4);
+	for (i = 0; i < 2 * 4; i++) {
+		c[i] = i + 1;
+	}
+	a = c;
+	blocks[0].ptr = (void**) &c;
+	blocks[0].bytes = 4 * 2 * sizeof(uint64_t);
+	blocks[0].newBytes = 16 * 2 * sizeof(uint64_t);
+	EXPECT_EQ(ERR_NO_ERR, context_repack(&ctx, blocks, 1));
+	EXPECT_EQ(a, c);
+	EXPECT_EQ(24 * 2 * sizeof(uint64_t), ctx.arenaUsed);
+	for (i = 0; i < 2 * 4; i++) {
+		EXPECT_EQ(i + 1, c[i]);
+	}
+
+	// Allocation below the top cannot be released early
+	blocks[0].ptr = (void**) &b;
+	blocks[0].bytes = 8 * 2 * sizeof(uint64_t);
+	blocks[0].newBytes = 0;
+	EXPECT_EQ(ERR_NO_ERR, context_repack(&ctx, blocks, 1));
+	EXPECT_EQ((uint64_t*)NULL, b);
+	EXPECT_EQ(24 * 2 * sizeof(uint64_t), ctx.arenaUsed);
+
+	// Growing past the arena moves to an overflow block
+	blocks[0].ptr = (void**) &c;
+	blocks[0].bytes = 16 * 2 * sizeof(uint64_t);
+	blocks[0].newBytes = 64 * 2 * sizeof(uint64_t);
+	EXPECT_EQ(ERR_NO_ERR, context_repack(&ctx, blocks, 1));
+	EXPECT_FALSE((uint8_t*) c >= ctx.arena && (uint8_t*) c < ctx.arena + ctx.arenaSize);
+	EXPECT_EQ(8 * 2 * sizeof(uint64_t), ctx.arenaUsed);
+	for (i = 0; i < 2 * 4; i++) {
+		EXPECT_EQ(i + 1, c[i]);
+	}
+	context_leave(&ctx, &mark);
+	EXPECT_EQ(0u, ctx.arenaUsed);
+	EXPECT_EQ(0u, ctx.overflowBytes);
+
+	huffman_context_free(&ctx);
+	EXPECT_EQ(0u, stats.liveBytes);
+}
+
+/**
+ * Validates that {@link HuffmanInstrumentation} is populated only when built
+ * with HUFFMAN_INSTRUMENT.
+ */
+TEST_F(HuffmanTest, huffman_context_instrumentation) {
+	HuffmanInstrumentation instr;
+	HuffmanContext ctx;
+	HuffmanStats stats;
+	HuffmanHeader header;
+	uint8_t* src;
+	uint64_t i;
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 16;
+
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) rand();
+	}
+
+	memset(&instr, 0x00, sizeof(instr));
+	huffman_context_init(&ctx);
+	EXPECT_EQ((HuffmanInstrumentation*)NULL, ctx.instrumentation);
+	ctx.instrumentation = &instr;
+	// 16-bit words force resizing
+	EXPECT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size_ctx(&stats, &header, src, srcSize, 16,
+			&OneHot, 0, &ctx));
+
+#ifdef HUFFMAN_INSTRUMENT
+	EXPECT_EQ(srcSize / 2, instr.wordsProcessed);
+	EXPECT_LT(0u, instr.resizeCalls);
+	EXPECT_LE(instr.wordsProcessed, instr.totalProbes);
+	EXPECT_LE(1u, instr.maxProbes);
+	EXPECT_LE(2 * sizeof(uint64_t) * header.uniqueWords, instr.peakTableBytes);
+	EXPECT_EQ(0u, instr.tableBytes);
+	// Superseded tables are not left behind in the arena
+	EXPECT_GE(instr.peakTableBytes, ctx.arenaPeak);
+	EXPECT_LE(instr.resizeNs, instr.histogramNs);
+	EXPECT_LT(0u, instr.histogramNs);
+	EXPECT_LT(0u, instr.sortNs);
+	EXPECT_LT(0u, instr.sizeNs);
+#else
+	HuffmanInstrumentation zero;
+	memset(&zero, 0x00, sizeof(zero));
+	EXPECT_EQ(0, memcmp(&zero, &instr, sizeof(instr)));
+#endif
+
+	huffman_context_free(&ctx);
+	EXPECT_EQ((HuffmanInstrumentation*)NULL, ctx.instrumentation);
+	free(src);
+}
+
+/**
+ * Validates {@link put_varint} and {@link read_varint}.
+ */
+TEST_F(HuffmanTest, put_varint) {
+	uint8_t buf[32];
+	uint8_t *dst, *src;
+	uint8_t start;
+	uint64_t size, val;
+	const uint64_t vals[] = {0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 123456789, HUFFMAN_MAX_UINT64};
+	const uint64_t lens[] = {1, 1, 1, 2, 2, 3, 4, 10};
+
+	for (uint8_t offset = 0; offset < 8; offset += 3) {
+		for (uint64_t i = 0; i < sizeof(vals) / sizeof(vals[0]); i++) {
+			memset(buf, 0x00, sizeof(buf));
+			dst = buf;
+			start = offset;
+			size = sizeof(buf);
+			EXPECT_EQ(ERR_NO_ERR, put_varint(&dst, &start, &size, vals[i]));
+			EXPECT_EQ(lens[i], (uint64_t)(dst - buf));
+			EXPECT_EQ(offset, start);
+
+			src = buf;
+			start = offset;
+			size = lens[i] + (offset > 0);
+			EXPECT_EQ(ERR_NO_ERR, read_varint(&val, &src, &start, &size));
+			EXPECT_EQ(vals[i], val);
+			EXPECT_EQ(dst, src);
+
+			// Truncated
+			src = buf;
+			start = offset;
+			size = lens[i] - 1 + (offset > 0);
+			EXPECT_EQ(ERR_INSUFFICIENT_SPACE, read_varint(&val, &src, &start, &size));
+		}
+	}
+
+	// More than 64 bits
+	memset(buf, 0xFF, sizeof(buf));
+	src = buf;
+	start = 0;
+	size = sizeof(buf);
+	EXPECT_EQ(ERR_INVALID_DATA, read_varint(&val, &src, &start, &size));
+}
+
+/**
+ * Validates that {@link huffman_compress} output is restored by
+ * {@link huffman_decompress} for a range of word sizes and data sizes.
+ */
+TEST_F(HuffmanTest, huffman_compress) {
+	const uint8_t wordSizes[] = {2, 3, 8, 12, 13, 31, 60};
+	const uint64_t srcSizes[] = {1, 7, 15, 1000, HUFFMAN_TEST_SMALL_VOLUME * 16 + 3};
+	uint8_t *src, *dst, *out;
+	uint64_t i, srcSize, dstSize, outSize;
+	HuffmanHeader header;
+	HuffmanContext ctx;
+
+	huffman_context_init(&ctx);
+	for (uint64_t s = 0; s < sizeof(srcSizes) / sizeof(srcSizes[0]); s++) {
+		srcSize = srcSizes[s];
+		src = (uint8_t*) malloc(srcSize);
+		out = (uint8_t*) malloc(srcSize);
+		dst = (uint8_t*) malloc(4 * srcSize + 64);
+		ASSERT_NE((uint8_t*)NULL, src);
+		ASSERT_NE((uint8_t*)NULL, out);
+		ASSERT_NE((uint8_t*)NULL, dst);
+		for (i = 0; i < srcSize; i++) {
+			src[i] = (uint8_t) ((rand() % 8 == 0) ? rand() % 0xFF : rand() % 4);
+		}
+
+		for (uint64_t w = 0; w < sizeof(wordSizes) / sizeof(wordSizes[0]); w++) {
+			dstSize = 4 * srcSize + 64;
+			ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, srcSize,
+					wordSizes[w])) << "wordSize " << (int)wordSizes[w] << " srcSize " << srcSize;
+			if (dst[0] == HUFFMAN_FRAME_STORED) {
+				EXPECT_GE(srcSize + 11, dstSize);
+				EXPECT_EQ(0u, header.uniqueWords);
+			} else {
+				EXPECT_EQ(HUFFMAN_FRAME_TABLE, dst[0]);
+			}
+
+			memset(out, 0x00, srcSize);
+			outSize = srcSize;
+			ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize))
+					<< "wordSize " << (int)wordSizes[w] << " srcSize " << srcSize;
+			EXPECT_EQ(srcSize, outSize);
+			EXPECT_EQ(0, memcmp(src, out, srcSize));
+
+			// Context variants produce the same result
+			outSize = 4 * srcSize + 64;
+			uint8_t* dst2 = (uint8_t*) malloc(outSize);
+			ASSERT_EQ(ERR_NO_ERR, huffman_compress_ctx(dst2, &outSize, &header, src, srcSize,
+					wordSizes[w], &ctx));
+			EXPECT_EQ(dstSize, outSize);
+			EXPECT_EQ(0, memcmp(dst, dst2, dstSize));
+			free(dst2);
+			memset(out, 0x00, srcSize);
+			outSize = srcSize;
+			ASSERT_EQ(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+			EXPECT_EQ(0, memcmp(src, out, srcSize));
+		}
+		free(src);
+		free(out);
+		free(dst);
+	}
+	huffman_context_free(&ctx);
+}
+
+/**
+ * Validates error handling of {@link huffman_compress} and
+ * {@link huffman_decompress}.
+ */
+TEST_F(HuffmanTest, huffman_compress_errs) {
+	uint8_t src[256], dst[1024], out[256];
+	uint64_t i, dstSize, outSize;
+	HuffmanHeader header;
+
+	for (i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t) (i % 7);
+	}
+
+	dstSize = sizeof(dst);
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress(NULL, &dstSize, &header, src, sizeof(src), 8));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress(dst, NULL, &header, src, sizeof(src), 8));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress(dst, &dstSize, NULL, src, sizeof(src), 8));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress(dst, &dstSize, &header, NULL, sizeof(src), 8));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress(dst, &dstSize, &header, src, 0, 8));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress(dst, &dstSize, &header, src, sizeof(src), 1));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress(dst, &dstSize, &header, src, sizeof(src), 61));
+
+	// Too little space
+	dstSize = 8;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_compress(dst, &dstSize, &header, src, sizeof(src), 8));
+	EXPECT_EQ(8u, dstSize);
+
+	dstSize = sizeof(dst);
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, sizeof(src), 8));
+	EXPECT_EQ(7u, header.uniqueWords);
+
+	outSize = sizeof(out);
+	EXPECT_EQ(ERR_NULL_PTR, huffman_decompress(NULL, &outSize, dst, dstSize));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_decompress(out, NULL, dst, dstSize));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_decompress(out, &outSize, NULL, dstSize));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_decompress(out, &outSize, dst, 0));
+
+	// Output too small
+	outSize = sizeof(out) - 1;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_decompress(out, &outSize, dst, dstSize));
+
+	// Truncated frame
+	for (i = 1; i < dstSize; i++) {
+		outSize = sizeof(out);
+		EXPECT_NE(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, i)) << "size " << i;
+	}
+
+	// Wrong frame type
+	dst[0] = HUFFMAN_FRAME_DICTIONARY;
+	outSize = sizeof(out);
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_decompress(out, &outSize, dst, dstSize));
+}
+
+/**
+ * Validates that incompressible data is detected by {@link huffman_compress}
+ * and written as a stored frame.
+ */
+TEST_F(HuffmanTest, huffman_compress_stored) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 16;
+	uint8_t *src, *dst, *out;
+	uint64_t i, dstSize, outSize;
+	HuffmanHeader header;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	dst = (uint8_t*) malloc(2 * srcSize + 64);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	ASSERT_NE((uint8_t*)NULL, dst);
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) rand();
+	}
+
+	// Random bytes caught by sample, random wide words by sample or bailout
+	const uint8_t wordSizes[] = {8, 12, 16, 24, 60};
+	for (uint64_t w = 0; w < sizeof(wordSizes) / sizeof(wordSizes[0]); w++) {
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, srcSize, wordSizes[w]));
+		EXPECT_EQ(HUFFMAN_FRAME_STORED, dst[0]) << "wordSize " << (int)wordSizes[w];
+		EXPECT_EQ(srcSize + 1 + 3, dstSize);
+		EXPECT_EQ(wordSizes[w], header.wordSize);
+		EXPECT_EQ(0u, header.uniqueWords);
+		outSize = srcSize;
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize));
+		EXPECT_EQ(srcSize, outSize);
+		EXPECT_EQ(0, memcmp(src, out, srcSize));
+	}
+
+	// Incompressible prefix is caught partway through counting
+	bool bailed;
+	HuffmanHashTable table;
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, 24, &bailed, NULL));
+	EXPECT_TRUE(bailed);
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) (rand() % 4);
+	}
+	EXPECT_EQ(ERR_NO_ERR, generate_table(&header, &table, src, srcSize, 24, &bailed, NULL));
+	EXPECT_FALSE(bailed);
+	free(table.table);
+
+	// Compressible data is not stored
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, srcSize, 8));
+	EXPECT_EQ(HUFFMAN_FRAME_TABLE, dst[0]);
+
+	// Truncated stored frame, output too small, too little space
+	memcpy(src, out, srcSize);
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress(dst, &dstSize, &header, src, srcSize, 8));
+	outSize = srcSize;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_decompress(out, &outSize, dst, dstSize - 1));
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_decompress(out, &outSize, dst, 2));
+	outSize = srcSize - 1;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_decompress(out, &outSize, dst, dstSize));
+	dstSize = srcSize;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_compress(dst, &dstSize, &header, src, srcSize, 8));
+
+	free(src);
+	free(out);
+	free(dst);
+}
+
+/**
+ * Validates {@link huffman_compress_budget}.
+ */
+TEST_F(HuffmanTest, huffman_compress_budget) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 64;
+	const uint64_t budget = 32768;
+	uint8_t *src, *dst, *out, *currPtr;
+	uint8_t currBit;
+	uint64_t i, dstSize, outSize, remaining, word;
+	uint64_t frequent[16];
+	HuffmanHeader header;
+	HuffmanInstrumentation instr;
+	HuffmanContext ctx;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	dst = (uint8_t*) malloc(2 * srcSize + 64);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	ASSERT_NE((uint8_t*)NULL, dst);
+	huffman_context_init(&ctx);
+	memset(&instr, 0x00, sizeof(instr));
+	ctx.instrumentation = &instr;
+
+	// Mostly 16 frequent words, 1 in 5 random and too many to count exactly
+	const uint8_t wordSizes[] = {48, 60};
+	for (uint64_t w = 0; w < sizeof(wordSizes) / sizeof(wordSizes[0]); w++) {
+		uint8_t wordSize = wordSizes[w];
+		for (i = 0; i < 16; i++) {
+			frequent[i] = (((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> (64 - wordSize);
+		}
+		memset(src, 0x00, srcSize);
+		currPtr = src;
+		currBit = 0;
+		remaining = srcSize;
+		for (i = 0; i < srcSize * 8 / wordSize; i++) {
+			word = (rand() % 5 == 0) ?
+					(((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> (64 - wordSize) :
+					frequent[rand() % 16];
+			ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining, word, wordSize));
+		}
+
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_budget(dst, &dstSize, &header, src, srcSize,
+				wordSize, budget, &ctx));
+		EXPECT_EQ(HUFFMAN_FRAME_ESCAPED, dst[0]) << "wordSize " << (int)wordSize;
+		EXPECT_LT(dstSize, srcSize / 2);
+		EXPECT_LT(16u, header.uniqueWords);
+		EXPECT_GE(budget / (4 * sizeof(uint64_t)), header.uniqueWords);
+		outSize = srcSize;
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+		EXPECT_EQ(srcSize, outSize);
+		EXPECT_EQ(0, memcmp(src, out, srcSize));
+		outSize = srcSize;
+		EXPECT_NE(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize / 2, &ctx));
+	}
+#ifdef HUFFMAN_INSTRUMENT
+	EXPECT_GE(budget, instr.peakTableBytes);
+	EXPECT_EQ(0u, instr.tableBytes);
+#endif
+
+	// Few unique words fit in budget, no escape needed
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) (rand() % 4);
+	}
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_budget(dst, &dstSize, &header, src, srcSize - 1,
+			24, budget, &ctx));
+	EXPECT_EQ(HUFFMAN_FRAME_TABLE, dst[0]);
+	outSize = srcSize;
+	ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize));
+	EXPECT_EQ(srcSize - 1, outSize);
+	EXPECT_EQ(0, memcmp(src, out, srcSize - 1));
+
+	// Budget too small
+	dstSize = 2 * srcSize + 64;
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_budget(dst, &dstSize, &header, src, srcSize,
+			24, HUFFMAN_MIN_BUDGET - 1, &ctx));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress_budget(dst, &dstSize, NULL, src, srcSize,
+			24, budget, &ctx));
+
+	huffman_context_free(&ctx);
+	free(src);
+	free(out);
+	free(dst);
+}
+
+/**
+ * Validates {@link huffman_compress_spill}.
+ */
+TEST_F(HuffmanTest, huffman_compress_spill) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 96;
+	const uint8_t wordSize = 48;
+	uint8_t *src, *dst, *out, *currPtr;
+	uint8_t currBit;
+	uint64_t i, dstSize, spillSize, outSize, remaining, word;
+	uint64_t frequent[256];
+	HuffmanHeader header, spillHeader;
+	HuffmanHashTable table, spillTable;
+	HuffmanContext ctx;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	dst = (uint8_t*) malloc(2 * srcSize + 64);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	ASSERT_NE((uint8_t*)NULL, dst);
+	huffman_context_init(&ctx);
+
+	// Mostly 256 frequent words, 1 in 5 random
+	for (i = 0; i < 256; i++) {
+		frequent[i] = (((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> (64 - wordSize);
+	}
+	currPtr = src;
+	currBit = 0;
+	remaining = srcSize;
+	for (i = 0; i < srcSize * 8 / wordSize; i++) {
+		word = (rand() % 5 == 0) ?
+				(((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> (64 - wordSize) :
+				frequent[rand() % 256];
+		ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining, word, wordSize));
+	}
+
+	// Same counts as in memory, many partitions
+	ASSERT_EQ(ERR_NO_ERR, build_sorted_table(&header, &table, src, srcSize, wordSize, NULL, &ctx));
+	ASSERT_EQ(ERR_NO_ERR, build_spill_table(&spillHeader, &spillTable, src, srcSize, wordSize,
+			".", HUFFMAN_MIN_BUDGET, &ctx));
+	EXPECT_EQ(header.uniqueWords, spillHeader.uniqueWords);
+	EXPECT_EQ(header.padBits, spillHeader.padBits);
+	for (i = 0; i < header.uniqueWords; i++) {
+		ASSERT_EQ(*get_table_value(table.table, i), *get_table_value(spillTable.table, i)) << i;
+	}
+	table_free(&ctx, spillTable.table, spillTable.size);
+	table_free(&ctx, table.table, table.size);
+
+	// Same size as in memory, round trip
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_ctx(dst, &dstSize, &header, src, srcSize, wordSize, &ctx));
+	spillSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_spill(dst, &spillSize, &spillHeader, src, srcSize,
+			wordSize, ".", HUFFMAN_MIN_BUDGET, &ctx));
+	EXPECT_EQ(HUFFMAN_FRAME_TABLE, dst[0]);
+	EXPECT_EQ(dstSize, spillSize);
+	outSize = srcSize;
+	ASSERT_EQ(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, spillSize, &ctx));
+	EXPECT_EQ(srcSize, outSize);
+	EXPECT_EQ(0, memcmp(src, out, srcSize));
+
+	// Missing scratch directory, budget too small, null directory
+	spillSize = 2 * srcSize + 64;
+	EXPECT_EQ(ERR_IO, huffman_compress_spill(dst, &spillSize, &header, src, srcSize,
+			wordSize, "./missing/scratch", HUFFMAN_MIN_BUDGET, &ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_spill(dst, &spillSize, &header, src, srcSize,
+			wordSize, ".", HUFFMAN_MIN_BUDGET - 1, &ctx));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress_spill(dst, &spillSize, &header, src, srcSize,
+			wordSize, NULL, HUFFMAN_MIN_BUDGET, &ctx));
+
+	huffman_context_free(&ctx);
+	free(src);
+	free(out);
+	free(dst);
+}
+
+/**
+ * Validates that {@link build_spill_table} counts within its budget. The
+ * sorted table it returns holds every unique word, so only counting is
+ * bounded.
+ */
+TEST_F(HuffmanTest, build_spill_table_peak) {
+	const uint64_t wordCount = 65536;
+	const uint64_t srcSize = wordCount * 6;
+	const uint64_t budget = 65536;
+	uint8_t *src, *currPtr;
+	uint8_t currBit;
+	uint64_t i, remaining, word, sortedBytes;
+	uint64_t frequent[1024];
+	HuffmanHeader header;
+	HuffmanHashTable table;
+	HuffmanInstrumentation instr;
+	HuffmanContext ctx;
+
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	huffman_context_init(&ctx);
+	ctx.instrumentation = &instr;
+	for (i = 0; i < 1024; i++) {
+		frequent[i] = (((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> 16;
+	}
+
+	// 1024 frequent words, then all unique
+	for (int unique = 0; unique < 2; unique++) {
+		currPtr = src;
+		currBit = 0;
+		remaining = srcSize;
+		for (i = 0; i < wordCount; i++) {
+			word = unique ? (((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> 16 :
+					frequent[rand() % 1024];
+			ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining, word, 48));
+		}
+
+		memset(&instr, 0x00, sizeof(instr));
+		ASSERT_EQ(ERR_NO_ERR, build_spill_table(&header, &table, src, srcSize, 48, ".", budget,
+				&ctx));
+		sortedBytes = 2 * sizeof(uint64_t) * table.size;
+		// Counting the source in one table would exceed budget
+		EXPECT_LT(budget, 2 * sizeof(uint64_t) * (wordCount + 1));
+#ifdef HUFFMAN_INSTRUMENT
+		EXPECT_GE((budget > sortedBytes) ? budget : sortedBytes, instr.peakTableBytes)
+				<< "unique " << unique;
+		EXPECT_EQ(sortedBytes, instr.tableBytes);
+#endif
+		if (unique) {
+			EXPECT_LT(budget, sortedBytes);
+		} else {
+			EXPECT_GT(budget, sortedBytes);
+		}
+		table_free(&ctx, table.table, table.size);
+	}
+
+	huffman_context_free(&ctx);
+	free(src);
+}
+
+/**
+ * Validates {@link huffman_compress_runs}.
+ */
+TEST_F(HuffmanTest, huffman_compress_runs) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 64;
+	uint8_t *src, *dst, *out, *currPtr;
+	uint8_t currBit;
+	uint64_t i, j, length, dstSize, tableSize, outSize, remaining, word;
+	HuffmanHeader header;
+	HuffmanContext ctx;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	dst = (uint8_t*) malloc(2 * srcSize + 64);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	ASSERT_NE((uint8_t*)NULL, dst);
+	huffman_context_init(&ctx);
+
+	// Runs of up to 200 of a few words, odd size leaves an incomplete word
+	const uint8_t wordSizes[] = {8, 13, 32, 48};
+	for (uint64_t w = 0; w < sizeof(wordSizes) / sizeof(wordSizes[0]); w++) {
+		uint8_t wordSize = wordSizes[w];
+		memset(src, 0x00, srcSize);
+		currPtr = src;
+		currBit = 0;
+		remaining = srcSize;
+		for (i = 0; i < srcSize * 8 / wordSize; i += length) {
+			word = (uint64_t) (rand() % 6) << (wordSize - 3);
+			length = rand() % 200 + 1;
+			for (j = 0; j < length && i + j < srcSize * 8 / wordSize; j++) {
+				ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining, word, wordSize));
+			}
+		}
+
+		tableSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_ctx(dst, &tableSize, &header, src, srcSize - 1,
+				wordSize, &ctx));
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_runs(dst, &dstSize, &header, src, srcSize - 1,
+				wordSize, &ctx));
+		EXPECT_EQ(HUFFMAN_FRAME_RUNS, dst[0]) << "wordSize " << (int)wordSize;
+		EXPECT_LT(dstSize, tableSize / 4) << "wordSize " << (int)wordSize;
+		outSize = srcSize;
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+		EXPECT_EQ(srcSize - 1, outSize);
+		EXPECT_EQ(0, memcmp(src, out, srcSize - 1)) << "wordSize " << (int)wordSize;
+		outSize = srcSize;
+		EXPECT_NE(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize / 2, &ctx));
+	}
+
+	// No run long enough, table frame as huffman_compress_ctx writes
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) (i % 4);
+	}
+	tableSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_ctx(out, &tableSize, &header, src, srcSize, 8, &ctx));
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_runs(dst, &dstSize, &header, src, srcSize, 8, &ctx));
+	EXPECT_EQ(HUFFMAN_FRAME_TABLE, dst[0]);
+	ASSERT_EQ(tableSize, dstSize);
+	EXPECT_EQ(0, memcmp(out, dst, dstSize));
+
+	// Every possible word found, no room for run escape in header
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (i % 64 < 32) ? 0x1B : 0xFF;
+	}
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_runs(dst, &dstSize, &header, src, srcSize, 2, &ctx));
+	EXPECT_NE(HUFFMAN_FRAME_RUNS, dst[0]);
+	outSize = srcSize;
+	ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst, dstSize));
+	EXPECT_EQ(0, memcmp(src, out, srcSize));
+
+	// Constant data codes as one word and one run
+	dstSize = 2 * srcSize + 64;
+	memset(src, 0x00, srcSize);
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_runs(dst, &dstSize, &header, src, srcSize, 8, &ctx));
+	ASSERT_EQ(HUFFMAN_FRAME_RUNS, dst[0]);
+	EXPECT_GT(16u, dstSize);
+
+	// Invalid parameters
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress_runs(dst, &dstSize, NULL, src, srcSize, 8, &ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_runs(dst, &dstSize, &header, src, 0, 8, &ctx));
+
+	huffman_context_free(&ctx);
+	free(src);
+	free(out);
+	free(dst);
+}
+/**
+ * Validates {@link huffman_compress_interleaved}.
+ */
+TEST_F(HuffmanTest, huffman_compress_interleaved) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 64;
+	uint8_t *src, *dst, *out;
+	uint64_t i, dstSize, tableSize, outSize;
+	HuffmanHeader header;
+	HuffmanContext ctx;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	dst = (uint8_t*) malloc(2 * srcSize + 64);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	ASSERT_NE((uint8_t*)NULL, dst);
+	huffman_context_init(&ctx);
+
+	// Skewed words, odd sizes leave an incomplete word and short last blocks
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (uint8_t) (1 << (rand() % 8)) | (uint8_t) ((rand() % 16 == 0) ? rand() : 0);
+	}
+	const uint8_t wordSizes[] = {8, 13, 16};
+	const uint8_t streams[] = {2, 4, 8};
+	for (uint64_t w = 0; w < sizeof(wordSizes) / sizeof(wordSizes[0]); w++) {
+		uint8_t wordSize = wordSizes[w];
+		for (uint64_t n = 0; n < sizeof(streams) / sizeof(streams[0]); n++) {
+			const uint64_t sizes[] = {srcSize - 1, 777, 7};
+			for (uint64_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+				dstSize = 2 * srcSize + 64;
+				ASSERT_EQ(ERR_NO_ERR, huffman_compress_interleaved(dst, &dstSize, &header, src,
+						sizes[k], wordSize, streams[n], &ctx));
+				if (k == 0) {
+					ASSERT_EQ(HUFFMAN_FRAME_INTERLEAVED, dst[0]) << "wordSize " << (int)wordSize;
+				}
+				outSize = srcSize;
+				ASSERT_EQ(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx))
+						<< "wordSize " << (int)wordSize << " streams " << (int)streams[n];
+				EXPECT_EQ(sizes[k], outSize);
+				EXPECT_EQ(0, memcmp(src, out, sizes[k]))
+						<< "wordSize " << (int)wordSize << " streams " << (int)streams[n];
+				outSize = srcSize;
+				EXPECT_NE(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize / 2, &ctx));
+			}
+		}
+
+		// Jump table costs a few bytes over a single stream
+		tableSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_ctx(out, &tableSize, &header, src, srcSize - 1,
+				wordSize, &ctx));
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_interleaved(dst, &dstSize, &header, src,
+				srcSize - 1, wordSize, HUFFMAN_MAX_STREAMS, &ctx));
+		if (out[0] == HUFFMAN_FRAME_TABLE) {
+			EXPECT_LE(dstSize, tableSize + HUFFMAN_MAX_STREAMS * 4) << "wordSize " << (int)wordSize;
+		}
+	}
+
+	// Bad number of streams in frame
+	dstSize = 2 * srcSize + 64;
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_interleaved(dst, &dstSize, &header, src, srcSize, 8, 4,
+			&ctx));
+	ASSERT_EQ(HUFFMAN_FRAME_INTERLEAVED, dst[0]);
+	uint8_t* currPtr = &dst[1];
+	uint8_t currBit = 0;
+	uint64_t remaining = dstSize - 1, value;
+	HuffmanHeader parsed;
+	ASSERT_EQ(ERR_NO_ERR, parse_header(&parsed, &currPtr, &currBit, &remaining));
+	ASSERT_EQ(ERR_NO_ERR, read_bits(&value, &currPtr, &currBit, &remaining, 16));
+	ASSERT_EQ(ERR_NO_ERR, read_varint(&value, &currPtr, &currBit, &remaining));
+	ASSERT_EQ(srcSize, value);
+	uint64_t streamsBit = (uint64_t) (currPtr - dst) * 8 + currBit;
+	for (uint64_t bad = 0; bad < 2; bad++) {
+		currPtr = &dst[streamsBit / 8];
+		currBit = streamsBit % 8;
+		remaining = dstSize - streamsBit / 8;
+		ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining,
+				bad ? HUFFMAN_MAX_STREAMS + 1 : 0, 8));
+		outSize = srcSize;
+		EXPECT_EQ(ERR_INVALID_DATA, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+	}
+
+	// Invalid parameters
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress_interleaved(dst, &dstSize, NULL, src, srcSize, 8, 4,
+			&ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_interleaved(dst, &dstSize, &header, src, 0, 8, 4,
+			&ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_interleaved(dst, &dstSize, &header, src, srcSize,
+			8, 1, &ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_interleaved(dst, &dstSize, &header, src, srcSize,
+			8, HUFFMAN_MAX_STREAMS + 1, &ctx));
+
+	huffman_context_free(&ctx);
+	free(src);
+	free(out);
+	free(dst);
+}
+
+/**
+ * Validates {@link huffman_compress_checksum} and checksums of run and
+ * interleaved frames.
+ */
+TEST_F(HuffmanTest, huffman_compress_checksum) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 16;
+	uint8_t *src, *dst, *out;
+	uint64_t i, dstSize, plainSize, outSize;
+	HuffmanHeader header;
+	HuffmanContext ctx;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	dst = (uint8_t*) malloc(2 * srcSize + 64);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	ASSERT_NE((uint8_t*)NULL, dst);
+	huffman_context_init(&ctx);
+
+	// Skewed runs in the first half, random words in the second
+	for (i = 0; i < srcSize; i++) {
+		src[i] = (i < srcSize / 2) ? (uint8_t) (1 << ((i / 64) % 4)) : (uint8_t) rand();
+	}
+
+	// Table frame costs the checksum over plain frame, stored frame likewise
+	const uint64_t sizes[] = {srcSize / 2 - 1, srcSize};
+	const uint8_t types[] = {HUFFMAN_FRAME_TABLE, HUFFMAN_FRAME_STORED};
+	for (i = 0; i < 2; i++) {
+		plainSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_ctx(dst, &plainSize, &header, src, sizes[i], 12,
+				&ctx));
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_checksum(dst, &dstSize, &header, src, sizes[i], 12,
+				&ctx));
+		EXPECT_EQ(types[i] | HUFFMAN_FRAME_CHECKSUM, dst[0]);
+		EXPECT_EQ(plainSize + HUFFMAN_CHECKSUM_BYTES, dstSize);
+		EXPECT_EQ(huffman_crc32c(0, src, sizes[i]),
+				get_checksum(dst + dstSize - HUFFMAN_CHECKSUM_BYTES));
+		outSize = srcSize;
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+		ASSERT_EQ(sizes[i], outSize);
+		EXPECT_EQ(0, memcmp(src, out, outSize));
+
+		// Flipped bit in data or checksum
+		dst[dstSize / 2] ^= 0x04;
+		outSize = srcSize;
+		EXPECT_NE(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+		dst[dstSize / 2] ^= 0x04;
+		dst[dstSize - 1] ^= 0x80;
+		outSize = srcSize;
+		EXPECT_EQ(ERR_INVALID_DATA, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+		outSize = srcSize;
+		EXPECT_NE(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, HUFFMAN_CHECKSUM_BYTES, &ctx));
+	}
+
+	// Run and interleaved frames hash in a pass of their own
+	for (i = 0; i < 2; i++) {
+		dstSize = 2 * srcSize + 64;
+		ASSERT_EQ(ERR_NO_ERR, compress_frame(dst, &dstSize, &header, src, srcSize / 2, 8, NULL, 0,
+				i == 0, (i == 0) ? 1 : 4, true, &ctx));
+		EXPECT_EQ(((i == 0) ? HUFFMAN_FRAME_RUNS : HUFFMAN_FRAME_INTERLEAVED) |
+				HUFFMAN_FRAME_CHECKSUM, dst[0]);
+		outSize = srcSize;
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+		ASSERT_EQ(srcSize / 2, outSize);
+		EXPECT_EQ(0, memcmp(src, out, outSize));
+		dst[dstSize - 2] ^= 0x01;
+		outSize = srcSize;
+		EXPECT_EQ(ERR_INVALID_DATA, huffman_decompress_ctx(out, &outSize, dst, dstSize, &ctx));
+	}
+
+	// Invalid parameters
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress_checksum(dst, &dstSize, NULL, src, srcSize, 8, &ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_checksum(dst, &dstSize, &header, src, 0, 8, &ctx));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_checksum(dst, &dstSize, &header, src, srcSize, 0,
+			&ctx));
+
+	huffman_context_free(&ctx);
+	free(src);
+	free(out);
+	free(dst);
+}
+
+/**
+ * Validates {@link huffman_estimate_compressed_size}.
+ */
+TEST_F(HuffmanTest, huffman_estimate_compressed_size) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 96;
+	const uint64_t budget = 16 * HUFFMAN_MIN_BUDGET;
+	const uint8_t wordSize = 48;
+	uint8_t *src, *currPtr;
+	uint8_t currBit;
+	uint64_t i, remaining, word;
+	uint64_t frequent[64];
+	HuffmanStats expected, actual;
+	HuffmanEstimate est;
+	HuffmanHeader header, estHeader;
+	HuffmanInstrumentation instr;
+	HuffmanContext ctx;
+
+	src = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	huffman_context_init(&ctx);
+	memset(&instr, 0x00, sizeof(instr));
+	ctx.instrumentation = &instr;
+
+	// Mostly 64 skewed frequent words, 1 in 4 random
+	for (i = 0; i < 64; i++) {
+		frequent[i] = (((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> (64 - wordSize);
+	}
+	currPtr = src;
+	currBit = 0;
+	remaining = srcSize;
+	for (i = 0; i < srcSize * 8 / wordSize; i++) {
+		word = (rand() % 4 == 0) ?
+				(((uint64_t) rand() << 32) ^ (uint64_t) rand()) >> (64 - wordSize) :
+				frequent[(rand() % 64) * (rand() % 64) / 64];
+		ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining, word, wordSize));
+	}
+
+	// Close to exact size and unique word count
+	ASSERT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&expected, &header, src, srcSize,
+			wordSize, &LogDepthTree, 0));
+	ASSERT_EQ(ERR_NO_ERR, huffman_estimate_compressed_size(&actual, &est, &estHeader, src, srcSize,
+			wordSize, &LogDepthTree, 0, budget, &ctx));
+	EXPECT_EQ(header.wordSize, estHeader.wordSize);
+	EXPECT_EQ(header.padBits, estHeader.padBits);
+	EXPECT_NEAR((double) header.uniqueWords, (double) estHeader.uniqueWords,
+			0.1 * header.uniqueWords);
+	EXPECT_NEAR((double) expected.dataSizeBytes, (double) actual.dataSizeBytes,
+			0.05 * expected.dataSizeBytes);
+	EXPECT_NEAR(expected.entropy, actual.entropy, 0.05 * expected.entropy);
+	EXPECT_EQ(&LogDepthTree, actual.compressor);
+	EXPECT_EQ(srcSize * 8 / wordSize, est.numWords);
+	EXPECT_LT(64u, est.heavyWords);
+	EXPECT_LT(0u, est.countError);
+	EXPECT_LT(0.9, est.confidence);
+	EXPECT_LT(0.0, est.uniqueError);
+#ifdef HUFFMAN_INSTRUMENT
+	EXPECT_GE(budget, instr.peakTableBytes);
+	EXPECT_EQ(0u, instr.tableBytes);
+#endif
+
+	// Few unique words are counted exactly
+	currPtr = src;
+	currBit = 0;
+	remaining = srcSize;
+	for (i = 0; i < srcSize * 8 / wordSize; i++) {
+		ASSERT_EQ(ERR_NO_ERR, put_bits(&currPtr, &currBit, &remaining,
+				frequent[(rand() % 64) * (rand() % 64) / 64], wordSize));
+	}
+	ASSERT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&expected, &header, src, srcSize - 1,
+			wordSize, &LogDepthTree, 0));
+	ASSERT_EQ(ERR_NO_ERR, huffman_estimate_compressed_size(&actual, &est, &estHeader, src,
+			srcSize - 1, wordSize, &LogDepthTree, 0, budget, &ctx));
+	EXPECT_EQ(header.uniqueWords, estHeader.uniqueWords);
+	EXPECT_EQ(header.padBits, estHeader.padBits);
+	EXPECT_EQ(expected.dataSizeBytes, actual.dataSizeBytes);
+	EXPECT_EQ(expected.dataBitsInLastByte, actual.dataBitsInLastByte);
+	EXPECT_EQ(expected.minSizeBits, actual.minSizeBits);
+	EXPECT_EQ(0.0, est.uniqueError);
+
+	// Budget too small, null pointers
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_estimate_compressed_size(&actual, &est, &estHeader, src,
+			srcSize, wordSize, &LogDepthTree, 0, HUFFMAN_MIN_BUDGET - 1, &ctx));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_estimate_compressed_size(&actual, NULL, &estHeader, src,
+			srcSize, wordSize, &LogDepthTree, 0, budget, &ctx));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_estimate_compressed_size(&actual, &est, &estHeader, src,
+			srcSize, wordSize, NULL, 0, budget, &ctx));
+
+	huffman_context_free(&ctx);
+	free(src);
+}
+
+/**
+ * Validates {@link huffman_dictionary_train}, {@link huffman_dictionary_serialize}
+ * and {@link huffman_dictionary_load}.
+ */
+TEST_F(HuffmanTest, huffman_dictionary_train) {
+	HuffmanDictionary dict, loaded;
+	HuffmanContext ctx;
+	uint8_t* corpus;
+	uint8_t buf[4096];
+	uint64_t i, bufSize;
+
+	corpus = (uint8_t*) malloc(HUFFMAN_TEST_MEDIUM_VOLUME);
+	ASSERT_NE((uint8_t*)NULL, corpus);
+	for (i = 0; i < HUFFMAN_TEST_MEDIUM_VOLUME; i++) {
+		corpus[i] = (uint8_t) ('a' + ((rand() % 4 == 0) ? rand() % 26 : rand() % 3));
+	}
+
+	EXPECT_EQ(ERR_NULL_PTR, huffman_dictionary_train(NULL, 1, corpus, 100, 8, NULL));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_dictionary_train(&dict, 1, NULL, 100, 8, NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_dictionary_train(&dict, 1, corpus, 0, 8, NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_dictionary_train(&dict, 1, corpus, 100, 61, NULL));
+
+	huffman_context_init(&ctx);
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_train(&dict, 0xC0FFEE, corpus,
+			HUFFMAN_TEST_MEDIUM_VOLUME, 8, &ctx));
+	EXPECT_EQ(0xC0FFEEu, dict.id);
+	EXPECT_EQ(8u, dict.wordSize);
+	EXPECT_EQ(26u, dict.uniqueWords);
+	EXPECT_EQ(dict.uniqueWords + 1, dict.mapCtx.uniqueWords);
+	EXPECT_NE((const HuffmanCompressor*)NULL, dict.compressor);
+	EXPECT_EQ(0u, ctx.arenaUsed);
+	// Most common words first
+	for (i = 0; i < 3; i++) {
+		EXPECT_LE((uint64_t)'a', dict.words[i]);
+		EXPECT_GE((uint64_t)'c', dict.words[i]);
+	}
+
+	bufSize = 4;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_dictionary_serialize(buf, &bufSize, &dict));
+	bufSize = sizeof(buf);
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_serialize(buf, &bufSize, &dict));
+
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_load(&loaded, buf, bufSize, NULL));
+	EXPECT_EQ(dict.id, loaded.id);
+	EXPECT_EQ(dict.wordSize, loaded.wordSize);
+	EXPECT_EQ(dict.uniqueWords, loaded.uniqueWords);
+	EXPECT_EQ(dict.compressor, loaded.compressor);
+	EXPECT_EQ(dict.depthParam, loaded.depthParam);
+	for (i = 0; i < dict.uniqueWords; i++) {
+		EXPECT_EQ(dict.words[i], loaded.words[i]);
+	}
+	huffman_dictionary_free(&loaded);
+	EXPECT_EQ((uint64_t*)NULL, loaded.words);
+
+	// Truncated and invalid
+	EXPECT_NE(ERR_NO_ERR, huffman_dictionary_load(&loaded, buf, bufSize - 1, NULL));
+	buf[6] = 0xFF;
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_dictionary_load(&loaded, buf, bufSize, NULL));
+
+	huffman_dictionary_free(&dict);
+	huffman_context_free(&ctx);
+	free(corpus);
+}
+
+/**
+ * Validates {@link huffman_dictionary_compress},
+ * {@link huffman_dictionary_decompress} and {@link huffman_get_dictionary_id}.
+ */
+TEST_F(HuffmanTest, huffman_dictionary_compress) {
+	HuffmanDictionary dict, other;
+	uint8_t corpus[4096];
+	uint8_t msg[300], dst[1024], out[300];
+	uint64_t i, dstSize, outSize;
+	uint32_t id;
+
+	for (i = 0; i < sizeof(corpus); i++) {
+		corpus[i] = (uint8_t) ('a' + rand() % 4);
+	}
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_train(&dict, 42, corpus, sizeof(corpus), 8, NULL));
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_train(&other, 43, corpus, sizeof(corpus), 8, NULL));
+
+	// Message drawn from corpus distribution compresses well
+	for (i = 0; i < sizeof(msg); i++) {
+		msg[i] = (uint8_t) ('a' + rand() % 4);
+	}
+	dstSize = sizeof(dst);
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_compress(dst, &dstSize, msg, sizeof(msg), &dict));
+	EXPECT_GT(sizeof(msg) / 2, dstSize);
+	EXPECT_EQ(ERR_NO_ERR, huffman_get_dictionary_id(&id, dst, dstSize));
+	EXPECT_EQ(42u, id);
+	outSize = sizeof(out);
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_decompress(out, &outSize, dst, dstSize, &dict));
+	EXPECT_EQ(sizeof(msg), outSize);
+	EXPECT_EQ(0, memcmp(msg, out, sizeof(msg)));
+
+	// Words missing from dictionary are escaped
+	for (i = 0; i < sizeof(msg); i += 7) {
+		msg[i] = (uint8_t) i;
+	}
+	dstSize = sizeof(dst);
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_compress(dst, &dstSize, msg, sizeof(msg), &dict));
+	outSize = sizeof(out);
+	ASSERT_EQ(ERR_NO_ERR, huffman_dictionary_decompress(out, &outSize, dst, dstSize, &dict));
+	EXPECT_EQ(0, memcmp(msg, out, sizeof(msg)));
+
+	// Wrong dictionary
+	outSize = sizeof(out);
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_dictionary_decompress(out, &outSize, dst, dstSize, &other));
+
+	// Output too small, truncated frame
+	outSize = sizeof(out) - 1;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_dictionary_decompress(out, &outSize, dst, dstSize, &dict));
+	outSize = sizeof(out);
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_dictionary_decompress(out, &outSize, dst, 3, &dict));
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_dictionary_decompress(out, &outSize, dst, dstSize / 2, &dict));
+
+	// Parameter checks
+	dstSize = sizeof(dst);
+	EXPECT_EQ(ERR_NULL_PTR, huffman_dictionary_compress(NULL, &dstSize, msg, sizeof(msg), &dict));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_dictionary_compress(dst, &dstSize, msg, sizeof(msg), NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_dictionary_compress(dst, &dstSize, msg, 0, &dict));
+	dstSize = 4;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_dictionary_compress(dst, &dstSize, msg, sizeof(msg), &dict));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_get_dictionary_id(NULL, dst, sizeof(dst)));
+	dst[0] = HUFFMAN_FRAME_TABLE;
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_get_dictionary_id(&id, dst, sizeof(dst)));
+
+	huffman_dictionary_free(&dict);
+	huffman_dictionary_free(&other);
+}
+
+TEST_F(HuffmanTest, huffman_stream_compress_block) {
+	HuffmanContext ctx;
+	HuffmanStream enc, enc16, dec;
+	uint8_t src[4 * 1024 + 3], dst[8 * 1024], out[sizeof(src)];
+	uint64_t i, block, pos, dstSize, srcSize, outSize;
+	const uint64_t blockSize = 512;
+
+	// Stable skewed distribution with one abrupt change
+	for (i = 0; i < sizeof(src); i++) {
+		if (i < sizeof(src) / 2) {
+			src[i] = (uint8_t) ('a' + __builtin_ctz(rand() | 0x100));
+		} else {
+			src[i] = (uint8_t) ('A' + rand() % 32);
+		}
+	}
+
+	huffman_context_init(&ctx);
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&enc, 8, &ctx));
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&dec, 8, NULL));
+
+	// Compress and decompress block by block, final block partial
+	pos = 0;
+	for (block = 0; block < sizeof(src); block += blockSize) {
+		srcSize = (sizeof(src) - block < blockSize) ? sizeof(src) - block : blockSize;
+		dstSize = sizeof(dst) - pos;
+		ASSERT_EQ(ERR_NO_ERR, huffman_stream_compress_block(&dst[pos], &dstSize, &src[block], srcSize,
+				block + srcSize == sizeof(src), &enc));
+		pos += dstSize;
+	}
+	EXPECT_EQ(1, enc.finished);
+	EXPECT_LT(0u, enc.freshBlocks);
+	EXPECT_LT(0u, enc.reusedBlocks);
+	dstSize = sizeof(dst);
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_stream_compress_block(dst, &dstSize, src, blockSize, 0, &enc));
+
+	pos = 0;
+	for (block = 0; block < sizeof(src); block += outSize) {
+		srcSize = sizeof(dst) - pos;
+		outSize = sizeof(out) - block;
+		ASSERT_EQ(ERR_NO_ERR, huffman_stream_decompress_block(&out[block], &outSize, &dst[pos], &srcSize, &dec));
+		pos += srcSize;
+	}
+	EXPECT_EQ(sizeof(src), block);
+	EXPECT_EQ(0, memcmp(src, out, sizeof(src)));
+	EXPECT_EQ(1, dec.finished);
+	EXPECT_EQ(enc.freshBlocks, dec.freshBlocks);
+	EXPECT_EQ(enc.reusedBlocks, dec.reusedBlocks);
+	huffman_stream_free(&enc);
+	huffman_stream_free(&dec);
+
+	// Checksummed stream carries the checksum of everything so far
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&enc, 8, NULL));
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&dec, 8, NULL));
+	enc.checksum = 1;
+	dec.checksum = 1;
+	pos = 0;
+	for (block = 0; block < sizeof(src); block += blockSize) {
+		srcSize = (sizeof(src) - block < blockSize) ? sizeof(src) - block : blockSize;
+		dstSize = sizeof(dst) - pos;
+		ASSERT_EQ(ERR_NO_ERR, huffman_stream_compress_block(&dst[pos], &dstSize, &src[block], srcSize,
+				block + srcSize == sizeof(src), &enc));
+		EXPECT_EQ(huffman_crc32c(0, src, block + srcSize),
+				get_checksum(&dst[pos + dstSize - HUFFMAN_CHECKSUM_BYTES]));
+		pos += dstSize;
+	}
+	EXPECT_LT(0u, enc.reusedBlocks);
+	dst[pos / 2] ^= 0x20;
+	for (block = 0, i = 0; !dec.finished; block += outSize, i += srcSize) {
+		srcSize = pos - i;
+		outSize = sizeof(out) - block;
+		if (huffman_stream_decompress_block(&out[block], &outSize, &dst[i], &srcSize, &dec)) {
+			break;
+		}
+	}
+	EXPECT_EQ(0, dec.finished);
+	dst[pos / 2] ^= 0x20;
+	huffman_stream_free(&dec);
+
+	// Checksum must be expected on both ends
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&dec, 8, NULL));
+	srcSize = pos;
+	outSize = sizeof(out);
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_stream_decompress_block(out, &outSize, dst, &srcSize, &dec));
+	huffman_stream_free(&dec);
+	huffman_stream_free(&enc);
+
+	// Reused block cannot start a stream, word size must match
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&enc, 8, NULL));
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&dec, 8, NULL));
+	dstSize = sizeof(dst);
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_compress_block(dst, &dstSize, src, blockSize, 0, &enc));
+	pos = dstSize;
+	dstSize = sizeof(dst) - pos;
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_compress_block(&dst[pos], &dstSize, src, blockSize, 0, &enc));
+	EXPECT_EQ(1u, enc.reusedBlocks);
+	srcSize = dstSize;
+	outSize = sizeof(out);
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_stream_decompress_block(out, &outSize, &dst[pos], &srcSize, &dec));
+	huffman_stream_free(&dec);
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&dec, 16, NULL));
+	srcSize = pos;
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_stream_decompress_block(out, &outSize, dst, &srcSize, &dec));
+	huffman_stream_free(&dec);
+
+	// Truncated block, output too small
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&dec, 8, NULL));
+	srcSize = pos / 2;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_stream_decompress_block(out, &outSize, dst, &srcSize, &dec));
+	srcSize = pos;
+	outSize = blockSize - 1;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_stream_decompress_block(out, &outSize, dst, &srcSize, &dec));
+
+	// Parameter checks
+	dstSize = sizeof(dst);
+	EXPECT_EQ(ERR_NULL_PTR, huffman_stream_init(NULL, 8, NULL));
+	ASSERT_EQ(ERR_NO_ERR, huffman_stream_init(&enc16, 16, NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_stream_init(&dec, 0, NULL));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_stream_compress_block(NULL, &dstSize, src, blockSize, 0, &enc));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_stream_compress_block(dst, &dstSize, src, blockSize, 0, NULL));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_stream_compress_block(dst, &dstSize, src, 0, 0, &enc));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_stream_compress_block(dst, &dstSize, src, 3, 0, &enc16));
+	dstSize = 2;
+	EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_stream_compress_block(dst, &dstSize, src, blockSize, 0, &enc));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_stream_decompress_block(out, &outSize, dst, NULL, &dec));
+
+	huffman_stream_free(&enc);
+	huffman_stream_free(&enc16);
+	huffman_stream_free(&dec);
+	huffman_context_free(&ctx);
+}
+
+/**
+ * Validates {@link huffman_compress_file} and {@link huffman_decompress_file}.
+ */
+TEST_F(HuffmanTest, huffman_compress_file) {
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 64 + 123;
+	uint8_t *src, *out;
+	uint64_t i, compressedSize;
+	FILE *in, *mid, *res;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize + 1);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	for (i = 0; i < srcSize; i++) {
+		// Skewed first half, random second half stores its blocks
+		src[i] = (uint8_t) ((i < srcSize / 2) ? 1 << (rand() % 4) : rand());
+	}
+	in = tmpfile();
+	ASSERT_NE((FILE*)NULL, in);
+	ASSERT_EQ(srcSize, fwrite(src, 1, srcSize, in));
+
+	// Serial, one worker without slack, and more workers than blocks in flight
+	const uint8_t threads[] = {0, 1, 4, 4};
+	const uint64_t depths[] = {1, 1, 2, 16};
+	const uint64_t blockSizes[] = {4096, 777, 10000, 4096};
+	const uint8_t checksums[] = {0, 1, 1, 0};
+	uint64_t serialSize = 0;
+	for (uint64_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+		mid = tmpfile();
+		res = tmpfile();
+		ASSERT_NE((FILE*)NULL, mid);
+		ASSERT_NE((FILE*)NULL, res);
+		rewind(in);
+		ASSERT_EQ(ERR_NO_ERR, huffman_compress_file(mid, in, 8, blockSizes[t], checksums[t], threads[t],
+				depths[t]))
+				<< "threads " << (int)threads[t];
+		compressedSize = (uint64_t) ftell(mid);
+		EXPECT_LT(compressedSize, srcSize) << "threads " << (int)threads[t];
+		if (blockSizes[t] == 4096) {
+			// Same blocks give the same output whatever the threads
+			if (serialSize == 0) {
+				serialSize = compressedSize;
+			}
+			EXPECT_EQ(serialSize, compressedSize);
+		}
+		rewind(mid);
+		ASSERT_EQ(ERR_NO_ERR, huffman_decompress_file(res, mid, threads[t], depths[t]))
+				<< "threads " << (int)threads[t];
+		rewind(res);
+		ASSERT_EQ(srcSize, fread(out, 1, srcSize + 1, res));
+		EXPECT_EQ(0, memcmp(src, out, srcSize)) << "threads " << (int)threads[t];
+		fclose(res);
+
+		// Flipped bit in the stored second half, caught by the checksum of its frame
+		if (checksums[t]) {
+			rewind(mid);
+			ASSERT_EQ(compressedSize, fread(out, 1, compressedSize, mid));
+			out[compressedSize * 3 / 4] ^= 0x10;
+			FILE* bad = tmpfile();
+			ASSERT_NE((FILE*)NULL, bad);
+			ASSERT_EQ(compressedSize, fwrite(out, 1, compressedSize, bad));
+			rewind(bad);
+			res = tmpfile();
+			ASSERT_NE((FILE*)NULL, res);
+			EXPECT_EQ(ERR_INVALID_DATA, huffman_decompress_file(res, bad, threads[t], depths[t]));
+			fclose(res);
+			fclose(bad);
+		}
+
+		// Truncated frame
+		res = tmpfile();
+		ASSERT_NE((FILE*)NULL, res);
+		rewind(mid);
+		ASSERT_EQ(compressedSize - 1, fread(out, 1, compressedSize - 1, mid));
+		fclose(mid);
+		mid = tmpfile();
+		ASSERT_NE((FILE*)NULL, mid);
+		ASSERT_EQ(compressedSize - 1, fwrite(out, 1, compressedSize - 1, mid));
+		rewind(mid);
+		EXPECT_EQ(ERR_INSUFFICIENT_SPACE, huffman_decompress_file(res, mid, threads[t], depths[t]));
+		fclose(mid);
+		fclose(res);
+	}
+
+	// Empty file holds only the block size and flags
+	mid = tmpfile();
+	res = tmpfile();
+	ASSERT_NE((FILE*)NULL, mid);
+	ASSERT_NE((FILE*)NULL, res);
+	fseek(in, 0, SEEK_END);
+	ASSERT_EQ(ERR_NO_ERR, huffman_compress_file(mid, in, 8, 4096, 0, 2, 4));
+	EXPECT_EQ(3, ftell(mid));
+	rewind(mid);
+	ASSERT_EQ(ERR_NO_ERR, huffman_decompress_file(res, mid, 2, 4));
+	EXPECT_EQ(0, ftell(res));
+
+	// Frame larger than any block
+	rewind(mid);
+	const uint8_t bad[] = {0x10, 0x00, 0x7F};
+	ASSERT_EQ(sizeof(bad), fwrite(bad, 1, sizeof(bad), mid));
+	rewind(mid);
+	EXPECT_EQ(ERR_INVALID_DATA, huffman_decompress_file(res, mid, 2, 4));
+
+	// Invalid parameters
+	EXPECT_EQ(ERR_NULL_PTR, huffman_compress_file(NULL, in, 8, 4096, 0, 2, 4));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_decompress_file(res, NULL, 2, 4));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_file(mid, in, 0, 4096, 0, 2, 4));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_file(mid, in, 8, 0, 0, 2, 4));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_file(mid, in, 8, 4096, 0, HUFFMAN_MAX_THREADS + 1, 4));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_compress_file(mid, in, 8, 4096, 0, 2, 0));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_decompress_file(res, mid, 2, 0));
+
+	fclose(mid);
+	fclose(res);
+	fclose(in);
+	free(src);
+	free(out);
+}
+
+/**
+ * Completion order and gate shared with {@link huffman_pool_submit} test
+ * callbacks.
+ */
+static std::atomic<int> jobsDone;
+static std::atomic<int> jobsRecorded;
+static std::atomic<int> jobStarted;
+static std::atomic<int> jobGate;
+static int jobOrder[16];
+
+/**
+ * Records the order in which a job finished, its user data holding its id.
+ */
+static void record_job(HuffmanJob* job) {
+	jobOrder[jobsDone++] = (int) (intptr_t) job->user;
+	jobsRecorded++;
+}
+
+/**
+ * Sets jobStarted and holds the worker until jobGate is opened.
+ */
+static void block_job(HuffmanJob* job) {
+	jobStarted = 1;
+	while (!jobGate) {
+		std::this_thread::yield();
+	}
+	record_job(job);
+}
+
+/**
+ * Records a job as done, then releases it.
+ */
+static void free_job(HuffmanJob* job) {
+	jobsDone++;
+	free(job);
+}
+
+/**
+ * Validates {@link huffman_pool_submit}, {@link huffman_job_poll} and
+ * {@link huffman_job_wait}.
+ */
+TEST_F(HuffmanTest, huffman_pool_submit) {
+	const int numJobs = 12;
+	const uint64_t srcSize = HUFFMAN_TEST_SMALL_VOLUME * 16;
+	uint8_t *src, *out;
+	uint8_t* dst[numJobs];
+	HuffmanJob jobs[numJobs];
+	HuffmanJobPool* pool;
+	HuffmanStats stats;
+	HuffmanHeader header;
+	uint64_t outSize;
+	int i;
+
+	src = (uint8_t*) malloc(srcSize);
+	out = (uint8_t*) malloc(srcSize);
+	ASSERT_NE((uint8_t*)NULL, src);
+	ASSERT_NE((uint8_t*)NULL, out);
+	for (i = 0; i < (int) srcSize; i++) {
+		src[i] = (uint8_t) (1 << (rand() % 6));
+	}
+
+	// Compressions and size calculations across several workers
+	ASSERT_EQ(ERR_NO_ERR, huffman_pool_create(&pool, 4));
+	jobsDone = 0;
+	memset(jobs, 0x00, sizeof(jobs));
+	for (i = 0; i < numJobs; i++) {
+		dst[i] = (uint8_t*) malloc(2 * srcSize + 64);
+		ASSERT_NE((uint8_t*)NULL, dst[i]);
+		jobs[i].type = (i % 3 == 0) ? HUFFMAN_JOB_SIZE : HUFFMAN_JOB_COMPRESS;
+		jobs[i].priority = (i % 2) ? HUFFMAN_PRIORITY_LATENCY : HUFFMAN_PRIORITY_BULK;
+		jobs[i].dst = dst[i];
+		jobs[i].dstSize = 2 * srcSize + 64;
+		jobs[i].src = src;
+		jobs[i].srcSize = srcSize - i;
+		jobs[i].wordSize = (uint8_t) (8 + i);
+		jobs[i].compressor = &FixDepthTree;
+		jobs[i].depthParam = 3;
+		jobs[i].done = record_job;
+		jobs[i].user = (void*) (intptr_t) i;
+		ASSERT_EQ(ERR_NO_ERR, huffman_pool_submit(pool, &jobs[i]));
+	}
+	for (i = 0; i < numJobs; i++) {
+		ASSERT_EQ(ERR_NO_ERR, huffman_job_wait(&jobs[i])) << "job " << i;
+		EXPECT_EQ(1, huffman_job_poll(&jobs[i]));
+		if (jobs[i].type == HUFFMAN_JOB_SIZE) {
+			ASSERT_EQ(ERR_NO_ERR, huffman_calculate_compressed_size(&stats, &header, src, srcSize - i,
+					8 + i, &FixDepthTree, 3));
+			EXPECT_EQ(stats.dataSizeBytes, jobs[i].stats.dataSizeBytes) << "job " << i;
+			EXPECT_EQ(header.uniqueWords, jobs[i].hdr.uniqueWords) << "job " << i;
+		} else {
+			outSize = srcSize;
+			ASSERT_EQ(ERR_NO_ERR, huffman_decompress(out, &outSize, dst[i], jobs[i].dstSize));
+			EXPECT_EQ(srcSize - i, outSize);
+			EXPECT_EQ(0, memcmp(src, out, outSize)) << "job " << i;
+		}
+	}
+	huffman_pool_destroy(pool);
+	EXPECT_EQ(numJobs, jobsDone);
+
+	// Callbacks run after the job is reported finished and may release it
+	ASSERT_EQ(ERR_NO_ERR, huffman_pool_create(&pool, 2));
+	jobsDone = 0;
+	for (i = 0; i < numJobs; i++) {
+		HuffmanJob* job = (HuffmanJob*) calloc(1, sizeof(HuffmanJob));
+		ASSERT_NE((HuffmanJob*)NULL, job);
+		job->type = HUFFMAN_JOB_SIZE;
+		job->src = src;
+		job->srcSize = srcSize;
+		job->wordSize = 8;
+		job->compressor = &FixDepthTree;
+		job->depthParam = 3;
+		job->done = free_job;
+		ASSERT_EQ(ERR_NO_ERR, huffman_pool_submit(pool, job));
+	}
+	huffman_pool_destroy(pool);
+	EXPECT_EQ(numJobs, jobsDone);
+
+	ASSERT_EQ(ERR_NO_ERR, huffman_pool_create(&pool, 1));
+#ifdef HUFFMAN_THREADS
+	// Latency-sensitive jobs overtake waiting bulk jobs on a busy worker
+	jobsDone = 0;
+	jobsRecorded = 0;
+	jobStarted = 0;
+	jobGate = 0;
+	for (i = 0; i < 6; i++) {
+		jobs[i].priority = (i == 0 || i >= 4) ? HUFFMAN_PRIORITY_LATENCY : HUFFMAN_PRIORITY_BULK;
+		jobs[i].done = (i == 0) ? block_job : record_job;
+		ASSERT_EQ(ERR_NO_ERR, huffman_pool_submit(pool, &jobs[i]));
+		if (i == 0) {
+			while (!jobStarted) {
+				std::this_thread::yield();
+			}
+		}
+	}
+	EXPECT_EQ(1, huffman_job_poll(&jobs[0]));
+	EXPECT_EQ(0, huffman_job_poll(&jobs[1]));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_pool_submit(pool, &jobs[1]));
+	jobGate = 1;
+	for (i = 0; i < 6; i++) {
+		EXPECT_EQ(ERR_NO_ERR, huffman_job_wait(&jobs[i]));
+	}
+	while (jobsRecorded < 6) {
+		std::this_thread::yield();
+	}
+	const int expected[] = {0, 4, 5, 1, 2, 3};
+	for (i = 0; i < 6; i++) {
+		EXPECT_EQ(expected[i], jobOrder[i]) << "position " << i;
+	}
+#endif
+
+	// Errors of the job itself are reported when it finishes
+	jobs[0].srcSize = 0;
+	jobs[0].done = NULL;
+	ASSERT_EQ(ERR_NO_ERR, huffman_pool_submit(pool, &jobs[0]));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_job_wait(&jobs[0]));
+
+	// Invalid parameters
+	HuffmanJob idle;
+	memset(&idle, 0x00, sizeof(idle));
+	EXPECT_EQ(1, huffman_job_poll(&idle));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_job_wait(&idle));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_job_wait(NULL));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_pool_submit(pool, NULL));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_pool_submit(NULL, &idle));
+	idle.type = 2;
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_pool_submit(pool, &idle));
+	idle.type = HUFFMAN_JOB_SIZE;
+	idle.priority = HUFFMAN_NUM_PRIORITIES;
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_pool_submit(pool, &idle));
+	EXPECT_EQ(ERR_NULL_PTR, huffman_pool_create(NULL, 1));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_pool_create(&pool, 0));
+	EXPECT_EQ(ERR_INVALID_VALUE, huffman_pool_create(&pool, HUFFMAN_MAX_THREADS + 1));
+	huffman_pool_destroy(pool);
+
+	for (i = 0; i < numJobs; i++) {
+		free(dst[i]);
+	}
+	free(src);
+	free(out);
+}
@@ -22,7 +22,12 @@ cd ..;
 # build test file using framework
 echo -e "${ORANGE}[Build unit tests]${NC}"
 g++ -std=gnu++11 -Isrc/inc -Isrc -I../../lib/googletest/include/ -pthread ./test/huffman_test.cc lib/libgtest_main.a lib/libgtest.a -o./huffman_test;
+g++ -std=gnu++11 -DHUFFMAN_INSTRUMENT -Isrc/inc -Isrc -I../../lib/googletest/include/ -pthread ./test/huffman_test.cc lib/libgtest_main.a lib/libgtest.a -o./huffman_test_instrument;
 
 # run unit tests
 echo -e "${ORANGE}[Run unit tests]${NC}"
 ./huffman_test;
+
+# run unit tests again with instrumentation counters compiled in
+echo -e "${ORANGE}[Run instrumented unit tests]${NC}"
+./huffman_test_instrument;